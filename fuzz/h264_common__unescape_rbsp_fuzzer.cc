@@ -18,6 +18,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 #include <vector>
 
@@ -30,6 +31,14 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
   // buffer it sees is always a well-formed NAL unit payload.
   {
     std::vector<uint8_t> unescaped = h264nal::UnescapeRbsp(data, size);
+    // The byte scanner without SIMD must agree with the one picked at
+    // runtime.
+    std::vector<uint8_t> scalar(size);
+    scalar.resize(
+        h264nal::UnescapeRbsp(data, size, scalar.data(), h264nal::SIMD_NONE));
+    if (scalar != unescaped) {
+      abort();
+    }
     // Read the result back so the returned buffer is not optimized away,
     // and so its contents are actually touched.
     if (!unescaped.empty()) {
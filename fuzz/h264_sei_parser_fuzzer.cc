@@ -0,0 +1,59 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+// This file was auto-generated using fuzz/converter.py from
+// h264_sei_parser_unittest.cc.
+// Do not edit directly.
+
+#include "h264_sei_parser.h"
+#include <memory>
+#include <vector>
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "h264_hrd_parameters_parser.h"
+#include "h264_nal_unit_parser.h"
+#include "h264_sps_parser.h"
+#include "h264_vui_parameters_parser.h"
+#include "rtc_common.h"
+
+
+// libfuzzer infra to test the fuzz target
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  // the code below is copied verbatim out of a unit test, where it sits
+  // inside "namespace h264nal", and so refers to the project's types
+  // unqualified. This entry point cannot: it has to be extern "C" at
+  // global scope. Pull the namespace in rather than qualifying each name,
+  // which would mean keeping a list of them here.
+  using namespace h264nal;  // NOLINT(build/namespaces)
+  // a test with no fuzzer::conv markers converts to an empty body
+  (void)data;
+  (void)size;
+  {
+  // get some mock state: an SPS (id 0) whose VUI has NAL hrd_parameters()
+  // with 8-bit delays, and pic_struct_present_flag set
+  H264BitstreamParserState bitstream_parser_state;
+  auto hrd_parameters =
+      std::make_unique<H264HrdParametersParser::HrdParametersState>();
+  hrd_parameters->cpb_cnt_minus1 = 0;
+  hrd_parameters->initial_cpb_removal_delay_length_minus1 = 7;
+  hrd_parameters->cpb_removal_delay_length_minus1 = 7;
+  hrd_parameters->dpb_output_delay_length_minus1 = 7;
+  hrd_parameters->time_offset_length = 0;
+  auto vui_parameters =
+      std::make_unique<H264VuiParametersParser::VuiParametersState>();
+  vui_parameters->nal_hrd_parameters_present_flag = 1;
+  vui_parameters->nal_hrd_parameters = std::move(hrd_parameters);
+  vui_parameters->pic_struct_present_flag = 1;
+  auto sps = std::make_shared<H264SpsParser::SpsState>();
+  sps->sps_data = std::make_unique<H264SpsDataParser::SpsDataState>();
+  sps->sps_data->seq_parameter_set_id = 0;
+  sps->sps_data->vui_parameters_present_flag = 1;
+  sps->sps_data->vui_parameters = std::move(vui_parameters);
+  bitstream_parser_state.sps[0] = sps;
+  ParsingOptions parsing_options;
+  auto sei = H264SeiParser::ParseSei(data, size,
+                                     &bitstream_parser_state, parsing_options);
+  }
+  return 0;
+}
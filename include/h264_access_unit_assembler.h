@@ -0,0 +1,142 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "h264_nal_unit_parser.h"
+#include "h264_pps_parser.h"
+#include "h264_slice_header_parser.h"
+#include "h264_sps_parser.h"
+
+namespace h264nal {
+
+// A class for grouping the NAL units of an H264 bitstream into access
+// units (Section 7.4.1.2). The NAL units are pushed in decoding order, as
+// they are parsed (e.g. from the H264BitstreamParser or H264StreamParser
+// callbacks), and each access unit is handed to the callback as soon as
+// the first NAL unit of the next one arrives, or on Flush().
+//
+// An access unit starts at the first NAL unit after the last VCL NAL unit
+// of a primary coded picture that is either an AUD, SPS, PPS, SEI,
+// prefix NAL unit, SubsetSPS or reserved (16-18) NAL unit (Section
+// 7.4.1.2.3), or the first VCL NAL unit of a new primary coded picture
+// (Section 7.4.1.2.4). The latter needs the slice headers parsed at least
+// up to delta_pic_order_cnt: a slice without a parsed slice header stays
+// in the current access unit. A prefix NAL unit goes with the slice that
+// follows it, so the prefixed base layer slices of an SVC/MVC picture
+// stay together.
+class H264AccessUnitAssembler {
+ public:
+  // An access unit. The NAL units are moved in, not copied, and the span
+  // they cover in the stream is given by |offset| and |length|.
+  struct AccessUnitState {
+    AccessUnitState() = default;
+    ~AccessUnitState() = default;
+    // disable copy ctor, move ctor, and copy&move assignments
+    AccessUnitState(const AccessUnitState&) = delete;
+    AccessUnitState(AccessUnitState&&) = delete;
+    AccessUnitState& operator=(const AccessUnitState&) = delete;
+    AccessUnitState& operator=(AccessUnitState&&) = delete;
+
+    // The slice header of the first slice of the primary coded picture
+    // (nullptr if the access unit has none).
+    const struct H264SliceHeaderParser::SliceHeaderState*
+    GetPrimarySliceHeader() const noexcept;
+
+    // Access unit offset in the full blob: the offset of its first NAL
+    // unit (after the start code)
+    size_t offset;
+    // Access unit length, up to the end of its last NAL unit (the start
+    // codes between its NAL units included)
+    size_t length;
+    // Number of slices of the primary coded picture
+    size_t num_slices;
+    // Total length of the VCL NAL units
+    size_t vcl_length;
+    // NAL units, in decoding order
+    std::vector<std::unique_ptr<struct H264NalUnitParser::NalUnitState>>
+        nal_units;
+    // The PPS and SPS the primary coded picture refers to, as they were
+    // when its first slice was pushed (nullptr if the assembler has no
+    // parser state, or if they are missing). The parameter sets of the
+    // next access unit are parsed before this one is complete, and can
+    // redefine the same ids.
+    std::shared_ptr<struct H264PpsParser::PpsState> pps;
+    std::shared_ptr<struct H264SpsParser::SpsState> sps;
+  };
+
+  // Called once per access unit. The callee owns the access unit.
+  typedef std::function<void(std::unique_ptr<AccessUnitState> access_unit)>
+      AccessUnitCallback;
+
+  explicit H264AccessUnitAssembler(AccessUnitCallback access_unit_callback);
+  // As above, also resolving the PPS and SPS of each primary coded picture
+  // in |bitstream_parser_state| (the state the NAL units are parsed into,
+  // which must outlive the assembler) when its first slice is pushed.
+  H264AccessUnitAssembler(
+      AccessUnitCallback access_unit_callback,
+      const struct H264BitstreamParserState* bitstream_parser_state);
+  ~H264AccessUnitAssembler() = default;
+  // disable copy ctor, move ctor, and copy&move assignments
+  H264AccessUnitAssembler(const H264AccessUnitAssembler&) = delete;
+  H264AccessUnitAssembler(H264AccessUnitAssembler&&) = delete;
+  H264AccessUnitAssembler& operator=(const H264AccessUnitAssembler&) = delete;
+  H264AccessUnitAssembler& operator=(H264AccessUnitAssembler&&) = delete;
+
+  // Adds the next NAL unit (in decoding order). Completes the current
+  // access unit if |nal_unit| starts a new one. nullptr is ignored.
+  void Push(std::unique_ptr<struct H264NalUnitParser::NalUnitState>
+                nal_unit) noexcept;
+  // Ends the stream: completes the current access unit, if any.
+  void Flush() noexcept;
+  // A NAL unit callback that pushes into this assembler, for the parsers
+  // that hand NAL units over one at a time.
+  H264NalUnitParser::NalUnitCallback GetNalUnitCallback() noexcept;
+
+  // Whether the slice with |slice_header| is the first VCL NAL unit of a
+  // new primary coded picture, when |previous| is the slice header of the
+  // previous VCL NAL unit of a primary coded picture (Section 7.4.1.2.4).
+  static bool IsFirstSliceOfPrimaryPicture(
+      const struct H264SliceHeaderParser::SliceHeaderState& previous,
+      const struct H264SliceHeaderParser::SliceHeaderState&
+          slice_header) noexcept;
+
+  // Parses the Annex B bitstream in |data| (see
+  // H264BitstreamParser::ParseBitstream()), and hands its access units to
+  // |access_unit_callback|, in stream order, with their PPS and SPS.
+  static void ParseBitstream(const uint8_t* data, size_t length,
+                             H264BitstreamParserState* bitstream_parser_state,
+                             ParsingOptions parsing_options,
+                             AccessUnitCallback access_unit_callback) noexcept;
+
+ private:
+  // Adds |nal_unit| to the current access unit (starting one if needed).
+  void Append(std::unique_ptr<struct H264NalUnitParser::NalUnitState>
+                  nal_unit) noexcept;
+  // Hands the current access unit (if any) to the callback.
+  void Complete() noexcept;
+
+  const AccessUnitCallback access_unit_callback_;
+  // The state the NAL units are parsed into (nullptr if not given).
+  const struct H264BitstreamParserState* const bitstream_parser_state_;
+  // The access unit being assembled (nullptr before the first NAL unit).
+  std::unique_ptr<AccessUnitState> access_unit_;
+  // The slice header of the last slice of the primary coded picture of
+  // the current access unit (nullptr if there is none yet). It belongs to
+  // a NAL unit in |access_unit_|.
+  const struct H264SliceHeaderParser::SliceHeaderState* last_slice_header_;
+  // A prefix NAL unit after the last VCL NAL unit, held until the NAL unit
+  // after it tells which access unit it belongs to.
+  std::unique_ptr<struct H264NalUnitParser::NalUnitState> pending_prefix_;
+};
+
+}  // namespace h264nal
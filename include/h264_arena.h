@@ -0,0 +1,131 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace h264nal {
+
+// An arena for the parsed NAL unit trees. A parsed slice is a tree of
+// separately allocated state structs (NalUnitState, its header and
+// payload, the slice layer and slice header, and their sub-structures,
+// plus the NAL unit checksum). While an arena is the current one on a
+// thread (see H264Arena::Scope), the nodes created on that thread are
+// carved out of the arena blocks instead of the heap. Deleting a node
+// still runs its destructor, but leaves its memory to the arena, which
+// releases it all at once: on Reset() (which keeps the blocks for the next
+// use) or on destruction.
+//
+// The nodes must be gone (and no copy of a NAL unit checksum kept) before
+// the arena that holds them is reset or destroyed. The parameter sets are
+// not arena nodes: they outlive the access unit that carries them.
+class H264Arena {
+ public:
+  // The size of the blocks allocated by default. A parsed slice takes
+  // about 1 KB.
+  const static size_t kDefaultBlockSize = 64 * 1024;
+  // The alignment of every allocation.
+  const static size_t kAlignment = alignof(std::max_align_t);
+
+  H264Arena();
+  explicit H264Arena(size_t block_size);
+  ~H264Arena() = default;
+  // disable copy ctor, move ctor, and copy&move assignments
+  H264Arena(const H264Arena&) = delete;
+  H264Arena(H264Arena&&) = delete;
+  H264Arena& operator=(const H264Arena&) = delete;
+  H264Arena& operator=(H264Arena&&) = delete;
+
+  // Returns |size| bytes, aligned to kAlignment, from the arena blocks.
+  void* Allocate(size_t size);
+  // Makes all the arena memory available again. The blocks are kept, so
+  // parsing into a reset arena does not touch the heap once the blocks fit
+  // the largest access unit.
+  void Reset() noexcept;
+
+  // Number of blocks allocated.
+  size_t GetBlockCount() const { return blocks_.size(); }
+  // Bytes handed out since the last Reset().
+  size_t GetAllocatedSize() const { return allocated_size_; }
+
+  // Makes |arena| the current arena of the calling thread for its
+  // lifetime. nullptr means the heap. Scopes nest.
+  class Scope {
+   public:
+    explicit Scope(H264Arena* arena);
+    ~Scope();
+    // disable copy ctor, move ctor, and copy&move assignments
+    Scope(const Scope&) = delete;
+    Scope(Scope&&) = delete;
+    Scope& operator=(const Scope&) = delete;
+    Scope& operator=(Scope&&) = delete;
+
+   private:
+    H264Arena* const previous_;
+  };
+  // The current arena of the calling thread (nullptr for the heap).
+  static H264Arena* GetCurrent();
+
+  // Allocates (and frees) a node: from the current arena if there is one,
+  // or else from the heap. Each node remembers where it came from, so it
+  // can be freed after the scope that created it is gone.
+  static void* AllocateNode(size_t size);
+  static void FreeNode(void* ptr) noexcept;
+
+ private:
+  struct Block {
+    std::unique_ptr<uint8_t[]> data;
+    size_t size;
+  };
+
+  const size_t block_size_;
+  std::vector<Block> blocks_;
+  // the block being filled, and its first free byte
+  size_t block_index_;
+  size_t block_offset_;
+  size_t allocated_size_;
+};
+
+// The base of the state structs that make up a parsed NAL unit tree:
+// routes their new/delete through the current H264Arena.
+struct H264ArenaNode {
+  static void* operator new(size_t size) {
+    return H264Arena::AllocateNode(size);
+  }
+  static void operator delete(void* ptr) noexcept { H264Arena::FreeNode(ptr); }
+};
+
+// An allocator on the current H264Arena, for the tree nodes held by
+// shared_ptr (std::allocate_shared()).
+template <typename T>
+class H264ArenaAllocator {
+ public:
+  typedef T value_type;
+
+  H264ArenaAllocator() = default;
+  template <typename U>
+  H264ArenaAllocator(const H264ArenaAllocator<U>&) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(H264Arena::AllocateNode(n * sizeof(T)));
+  }
+  void deallocate(T* ptr, size_t) noexcept { H264Arena::FreeNode(ptr); }
+
+  template <typename U>
+  bool operator==(const H264ArenaAllocator<U>&) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const H264ArenaAllocator<U>&) const {
+    return false;
+  }
+};
+
+}  // namespace h264nal
@@ -9,6 +9,7 @@
 #include <memory>
 #include <vector>
 
+#include "h264_arena.h"
 #include "h264_bitstream_parser_state.h"
 #include "h264_common.h"
 #include "h264_nal_unit_parser.h"
@@ -36,6 +37,9 @@ class H264BitstreamParser {
 #endif  // FDUMP_DEFINE
 
     struct ParsingOptions parsing_options_;
+    // The arena holding the NAL units, with ParsingOptions::use_arena
+    // (nullptr otherwise). Declared first, so it goes last.
+    std::unique_ptr<H264Arena> arena;
     // NAL units
     std::vector<std::unique_ptr<struct H264NalUnitParser::NalUnitState>>
         nal_units;
@@ -43,6 +47,8 @@ class H264BitstreamParser {
 
   // (1) Explicit NAL unit separator version.
   // Unpack RBSP and parse bitstream state from the supplied buffer.
+  // With ParsingOptions::use_arena, the NAL units of (1) and (2) are
+  // allocated in one H264Arena, which the BitstreamState frees at once.
   static std::unique_ptr<BitstreamState> ParseBitstream(
       const uint8_t* data, size_t length,
       H264BitstreamParserState* bitstream_parser_state,
@@ -63,6 +69,58 @@ class H264BitstreamParser {
       const uint8_t* data, size_t length, size_t nalu_length_bytes,
       ParsingOptions parsing_options) noexcept;
 
+  // (3) Callback versions of (1) and (2). Instead of collecting the NAL
+  // units into a BitstreamState, each one is handed to |nal_unit_callback|
+  // as soon as it is parsed, with its offset and length set, so the caller
+  // can drop (or keep) it right away. Memory use does not grow with the
+  // number of NAL units.
+  static void ParseBitstream(
+      const uint8_t* data, size_t length,
+      H264BitstreamParserState* bitstream_parser_state,
+      ParsingOptions parsing_options,
+      H264NalUnitParser::NalUnitCallback nal_unit_callback) noexcept;
+  static void ParseBitstreamNALULength(
+      const uint8_t* data, size_t length, size_t nalu_length_bytes,
+      H264BitstreamParserState* bitstream_parser_state,
+      ParsingOptions parsing_options,
+      H264NalUnitParser::NalUnitCallback nal_unit_callback) noexcept;
+
+  // (4) Multi-threaded version of (1), with the same result. A sequential
+  // pass parses only the parameter sets (SPS/PPS/SubsetSPS) and the SEI
+  // (whose buffering_period() activates an SPS), in stream order, into
+  // |bitstream_parser_state|, and keeps a snapshot of the state where each
+  // run of other NAL units starts. Those NAL units (the slices, which only
+  // read the parameter sets) are then parsed on |num_threads| threads,
+  // each against the snapshot in effect at its position, and returned in
+  // stream order. |num_threads| 0 uses one thread per core.
+  static std::unique_ptr<BitstreamState> ParseBitstreamParallel(
+      const uint8_t* data, size_t length,
+      H264BitstreamParserState* bitstream_parser_state,
+      ParsingOptions parsing_options, size_t num_threads) noexcept;
+  static std::unique_ptr<BitstreamState> ParseBitstreamParallel(
+      const uint8_t* data, size_t length, ParsingOptions parsing_options,
+      size_t num_threads) noexcept;
+
+  // (5) Chunked version of (4), for inputs too large to index in one go
+  // (e.g. a memory-mapped archive file). The input is split into chunks of
+  // |chunk_length| bytes, and each chunk is resynchronized to its first
+  // start code. Waves of |num_threads| chunks are scanned for start codes
+  // in parallel, a prescan parses the parameter sets and SEI of the wave in
+  // stream order (so each chunk gets the SPS/PPS/SubsetSPS active at its
+  // boundary), and then each chunk is parsed on its own thread. The NAL
+  // units are handed to |nal_unit_callback| in stream order, and are the
+  // ones ParseBitstream() returns. Memory is bounded by the wave.
+  // |num_threads| 0 uses one thread per core, and |chunk_length| 0 a
+  // 16 MB default.
+  static void ParseBitstreamChunked(
+      const uint8_t* data, size_t length,
+      H264BitstreamParserState* bitstream_parser_state,
+      ParsingOptions parsing_options, size_t num_threads, size_t chunk_length,
+      H264NalUnitParser::NalUnitCallback nal_unit_callback) noexcept;
+  static std::unique_ptr<BitstreamState> ParseBitstreamChunked(
+      const uint8_t* data, size_t length, ParsingOptions parsing_options,
+      size_t num_threads, size_t chunk_length) noexcept;
+
   struct NaluIndex {
     // Start index of NALU, including start sequence.
     size_t start_offset;
@@ -74,6 +132,10 @@ class H264BitstreamParser {
   // Returns a vector of the NALU indices in the given buffer.
   static std::vector<NaluIndex> FindNaluIndices(const uint8_t* data,
                                                 size_t length) noexcept;
+  // Same, with an explicit start code scanner (see FindZeroZeroByte()).
+  static std::vector<NaluIndex> FindNaluIndices(const uint8_t* data,
+                                                size_t length,
+                                                SimdLevel simd_level) noexcept;
   static std::vector<NaluIndex> FindNaluIndicesExplicitFraming(
       const uint8_t* data, size_t length) noexcept;
 };
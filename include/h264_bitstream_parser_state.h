@@ -6,8 +6,11 @@
 
 #include <stdio.h>
 
-#include <map>
+#include <array>
+#include <cstdint>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "h264_pps_parser.h"
 #include "h264_sps_parser.h"
@@ -29,21 +32,64 @@ struct H264BitstreamParserState {
   // SPS, PPS, and SubsetSPS use shared_ptr because they are referenced
   // by multiple NAL units (e.g., each slice header refers back to its
   // active PPS, which in turn refers to its active SPS).
+  //
+  // The ids are bounded (seq_parameter_set_id in [0, 31], and
+  // pic_parameter_set_id in [0, 255], Sections 7.4.2.1.1 and 7.4.2.2), and
+  // the parsers reject any other value, so the parameter sets are kept in
+  // tables indexed by id. A missing one is nullptr.
+  static const uint32_t kSpsIdCount = 32;
+  static const uint32_t kPpsIdCount = 256;
 
   // SPS state
-  std::map<uint32_t, std::shared_ptr<struct H264SpsParser::SpsState>> sps;
+  std::array<std::shared_ptr<struct H264SpsParser::SpsState>, kSpsIdCount>
+      sps;
   // PPS state
-  std::map<uint32_t, std::shared_ptr<struct H264PpsParser::PpsState>> pps;
+  std::array<std::shared_ptr<struct H264PpsParser::PpsState>, kPpsIdCount>
+      pps;
   // SubsetSPS state
-  std::map<uint32_t,
-           std::shared_ptr<struct H264SubsetSpsParser::SubsetSpsState>>
+  std::array<std::shared_ptr<struct H264SubsetSpsParser::SubsetSpsState>,
+             kSpsIdCount>
       subset_sps;
 
-  // some accessors
+  // The SPS activated by the last buffering_period() SEI message (Section
+  // 7.4.1.2.1), or nullptr if there has been none. An SPS NAL unit that
+  // redefines its id replaces it. pic_timing() messages are decoded
+  // against it, including those in later SEI NAL units. See
+  // H264NalUnitPayloadParser::ParseNalUnitPayload().
+  std::shared_ptr<struct H264SpsParser::SpsState> active_sps;
+
+  // The NAL unit each table entry was parsed from, so that a byte-identical
+  // repeat (encoders resend their SPS/PPS before every IDR, and some before
+  // every frame) reuses the entry instead of parsing it again. See
+  // H264NalUnitParser::ParseNalUnit().
+  struct ParameterSetSource {
+    // the NAL unit bytes, nal_unit_header() included
+    std::vector<uint8_t> data;
+    // whether |data| is escaped (as in a byte stream)
+    bool escaped;
+    // the parsed length of the NAL unit
+    size_t parsed_length;
+    // the table entry |data| parsed into. Only a repeat of the parameter
+    // set still in the table is reused.
+    std::shared_ptr<const void> parameter_set;
+  };
+  // keyed by GetParameterSetKey()
+  std::unordered_map<uint32_t, ParameterSetSource> parameter_set_sources;
+  static uint32_t GetParameterSetKey(uint32_t nal_unit_type, uint32_t id) {
+    return (nal_unit_type << 8) | id;
+  }
+
+  // some accessors (nullptr if missing, or if the id is out of range)
   std::shared_ptr<struct H264SpsParser::SpsState> GetSps(uint32_t sps_id) const;
   std::shared_ptr<struct H264PpsParser::PpsState> GetPps(uint32_t pps_id) const;
   std::shared_ptr<struct H264SubsetSpsParser::SubsetSpsState> GetSubsetSps(
       uint32_t subset_sps_id) const;
+
+  // Resolves the PPS |pps_id| and the SPS it refers to, in one go, for
+  // the slice parsers. Returns false if either is missing (|*pps| is still
+  // set if only the SPS is). The parameter sets are owned by the state.
+  bool ResolvePps(uint32_t pps_id, const struct H264PpsParser::PpsState** pps,
+                  const struct H264SpsParser::SpsState** sps) const;
 };
 
 }  // namespace h264nal
@@ -0,0 +1,99 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+#include <memory>
+#include <vector>
+
+#include "h264_bitstream_parser.h"
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "h264_nal_unit_parser.h"
+
+namespace h264nal {
+
+// A lazy view of an H264 Annex B bitstream. Building it only finds the NAL
+// units and decodes their 1-byte headers, so listing the type and size of
+// every NAL unit costs about as much as scanning for start codes. The full
+// NAL unit (header plus payload) is parsed the first time it is asked for,
+// and cached.
+//
+// Slices still resolve against the SPS/PPS/SubsetSPS that were active at
+// their position in the stream: the parameter sets (and the SEI, which can
+// activate an SPS) are parsed in stream order, once, as far as the
+// furthest NAL unit asked for, and a snapshot of the state is kept after
+// each one that changes it.
+//
+// The view does not copy |data|, which must outlive it.
+class H264BitstreamView {
+ public:
+  // What the view knows about a NAL unit without parsing it.
+  struct NalUnitInfo {
+    // NAL Unit offset in the full blob (the payload, after the start code)
+    size_t offset;
+    // NAL Unit length
+    size_t length;
+    // nal_unit_header() fields (Section 7.3.1)
+    uint32_t forbidden_zero_bit;
+    uint32_t nal_ref_idc;
+    uint32_t nal_unit_type;
+  };
+
+  H264BitstreamView(const uint8_t* data, size_t length,
+                    ParsingOptions parsing_options) noexcept;
+  ~H264BitstreamView() = default;
+  // disable copy ctor, move ctor, and copy&move assignments
+  H264BitstreamView(const H264BitstreamView&) = delete;
+  H264BitstreamView(H264BitstreamView&&) = delete;
+  H264BitstreamView& operator=(const H264BitstreamView&) = delete;
+  H264BitstreamView& operator=(H264BitstreamView&&) = delete;
+
+  // Number of NAL units in the bitstream.
+  size_t GetNalUnitCount() const { return nal_units_.size(); }
+  // The unparsed info of the NAL unit at |index|.
+  const NalUnitInfo& GetNalUnitInfo(size_t index) const {
+    return nal_units_[index];
+  }
+  // The parsed NAL unit at |index|, parsed on first access. Returns
+  // nullptr if it does not parse (or |index| is out of range).
+  const struct H264NalUnitParser::NalUnitState* GetNalUnit(
+      size_t index) noexcept;
+
+ private:
+  // Parses the parameter sets and SEI before |end| that have not been
+  // parsed yet, in stream order.
+  void ParseParameterSets(size_t end) noexcept;
+  // The parameter set state in effect at NAL unit |index|.
+  H264BitstreamParserState* GetParameterSetState(size_t index) noexcept;
+
+  const uint8_t* const data_;
+  const ParsingOptions parsing_options_;
+  std::vector<NalUnitInfo> nal_units_;
+  // Parsed NAL units, by index. Empty until parsed.
+  std::vector<std::unique_ptr<struct H264NalUnitParser::NalUnitState>>
+      parsed_nal_units_;
+  // Whether each NAL unit has been parsed (or has failed to parse).
+  std::vector<bool> parse_attempted_;
+
+  // A snapshot of the parameter set tables (and the active SPS) right after
+  // the parameter set or SEI NAL unit at |index| changed them. Slices never
+  // update them, so a snapshot is only read after it is made. A repeated
+  // parameter set that leaves the tables unchanged makes no snapshot.
+  struct ParameterSetSnapshot {
+    size_t index;
+    std::unique_ptr<H264BitstreamParserState> state;
+  };
+  std::vector<ParameterSetSnapshot> parameter_set_snapshots_;
+  // The state before the first parameter set.
+  H264BitstreamParserState empty_state_;
+  // The state the parameter sets are parsed into, in stream order.
+  H264BitstreamParserState parse_state_;
+  // The first NAL unit not yet checked for being a parameter set.
+  size_t parameter_set_end_;
+};
+
+}  // namespace h264nal
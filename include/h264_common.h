@@ -59,6 +59,8 @@ enum NalUnitType : uint8_t {
 
 std::string NalUnitTypeToString(uint32_t nal_unit_type);
 bool IsSliceSegment(uint32_t nal_unit_type);
+bool IsParameterSet(uint32_t nal_unit_type);
+bool UpdatesParserState(uint32_t nal_unit_type);
 bool IsNalUnitTypeReserved(uint32_t nal_unit_type);
 bool IsNalUnitTypeUnspecified(uint32_t nal_unit_type);
 
@@ -119,6 +121,27 @@ enum SvcSliceType : uint8_t {
   EIb = 7,
 };
 
+// SIMD instruction sets for the byte pattern scanners. SIMD_AUTO picks the
+// best one the CPU supports, at runtime. SIMD_SSE2 and SIMD_AVX2 are only
+// built on x86.
+enum SimdLevel : uint8_t {
+  SIMD_AUTO = 0,
+  SIMD_NONE = 1,
+  SIMD_SSE2 = 2,
+  SIMD_AVX2 = 3,
+};
+
+// Returns whether |simd_level| can run on this build and CPU.
+bool IsSimdLevelSupported(SimdLevel simd_level) noexcept;
+
+// Returns the first offset |i| in [|begin|, |end|) where {data[i],
+// data[i + 1], data[i + 2]} is {0x00, 0x00, |third_byte|}, or |end| if there
+// is none. data[end + 1] must be readable. This finds both start codes
+// (0x000001) and emulation bytes (0x000003). An unsupported |simd_level|
+// falls back to SIMD_AUTO.
+size_t FindZeroZeroByte(const uint8_t* data, size_t begin, size_t end,
+                        uint8_t third_byte, SimdLevel simd_level) noexcept;
+
 // Methods for parsing RBSP. See section 7.4 of the H264 spec.
 //
 // Decoding is simply a matter of finding any 00 00 03 sequence and removing
@@ -128,6 +151,16 @@ enum SvcSliceType : uint8_t {
 // byte-stream format packetization (e.g. Annex B data), but not for
 // packet-stream format packetization (e.g. RTP payloads).
 std::vector<uint8_t> UnescapeRbsp(const uint8_t* data, size_t length);
+// Same, into |out|, which is resized to fit. Reusing one |out| across calls
+// reuses its allocation.
+void UnescapeRbsp(const uint8_t* data, size_t length,
+                  std::vector<uint8_t>& out);
+// Same, into |out|, which must hold at least |length| bytes (the RBSP is
+// never longer than its escaped form). Returns the RBSP size. Clean runs
+// between emulation bytes are found with FindZeroZeroByte() and copied in
+// bulk.
+size_t UnescapeRbsp(const uint8_t* data, size_t length, uint8_t* out,
+                    SimdLevel simd_level) noexcept;
 
 // Syntax functions and descriptors) (Section 7.2)
 bool byte_aligned(BitBuffer* bit_buffer);
@@ -154,6 +187,48 @@ void report_unimplemented(const char* structure, const char* context) noexcept;
 uint32_t get_unimplemented_count() noexcept;
 void reset_unimplemented_count() noexcept;
 
+// How much of a NAL unit to parse (see ParsingOptions::parse_level).
+enum ParseLevel : uint8_t {
+  // parse everything we support
+  PARSE_FULL = 0,
+  // only parse the slice header up to ParsingOptions::slice_header_last_field
+  // (NAL units without a slice_header() are parsed fully)
+  PARSE_PARTIAL = 1,
+  // only parse nal_unit_header(), and leave the payload empty
+  PARSE_HEADER = 2,
+  // do not parse the NAL unit at all: it is dropped
+  PARSE_SKIP = 3,
+};
+
+// slice_header() fields where a partial parse can stop (Section 7.3.3).
+// Each stop includes the fields before it (e.g. SLICE_HEADER_FRAME_NUM also
+// reads colour_plane_id). Stopping at SLICE_HEADER_PIC_PARAMETER_SET_ID or
+// earlier does not need the SPS/PPS.
+enum SliceHeaderField : uint8_t {
+  SLICE_HEADER_FIRST_MB_IN_SLICE = 0,
+  SLICE_HEADER_SLICE_TYPE = 1,
+  SLICE_HEADER_PIC_PARAMETER_SET_ID = 2,
+  SLICE_HEADER_FRAME_NUM = 3,
+  // field_pic_flag, bottom_field_flag, and idr_pic_id
+  SLICE_HEADER_IDR_PIC_ID = 4,
+  // pic_order_cnt_lsb, delta_pic_order_cnt_bottom, and delta_pic_order_cnt
+  SLICE_HEADER_PIC_ORDER_CNT = 5,
+  SLICE_HEADER_ALL = 6,
+};
+
+// NAL unit checksum algorithms. All of them are computed a word at a time
+// over the bytes in memory.
+enum ChecksumType : uint8_t {
+  // 32-bit one's complement sum of the big-endian 32-bit words (the
+  // original h264nal checksum)
+  CHECKSUM_SUM32 = 0,
+  // CRC-32C (Castagnoli), with the SSE4.2 crc32 instruction when the CPU
+  // has it
+  CHECKSUM_CRC32C = 1,
+  // xxHash64, seed 0
+  CHECKSUM_XXHASH64 = 2,
+};
+
 // Generic Parsing Options
 struct ParsingOptions {
   bool add_offset;
@@ -161,26 +236,83 @@ struct ParsingOptions {
   bool add_parsed_length;
   bool add_checksum;
   bool add_resolution;
+  // how much to parse, per nal_unit_type
+  ParseLevel parse_level[32];
+  // where PARSE_PARTIAL stops in slice_header()
+  SliceHeaderField slice_header_last_field;
+  // whether the bitstream parsers that return a BitstreamState place its
+  // NAL units in an arena the BitstreamState owns (see H264Arena)
+  bool use_arena;
+  // the add_checksum algorithm
+  ChecksumType checksum_type;
+  // whether the checksum covers the NAL unit bytes as they are in the
+  // input (escaped, for a byte stream) instead of its RBSP. No unescaping
+  // is needed then, but the same content escaped differently checksums
+  // differently.
+  bool checksum_escaped;
+  // the SEI payloads decoded, one bit per payloadType (for the types below
+  // 32, see SeiPayloadType). The other SEI messages are only located.
+  uint32_t sei_parse_mask;
   ParsingOptions()
       : add_offset(true),
         add_length(true),
         add_parsed_length(true),
         add_checksum(true),
-        add_resolution(true) {}
+        add_resolution(true),
+        parse_level(),  // PARSE_FULL
+        slice_header_last_field(SLICE_HEADER_ALL),
+        use_arena(false),
+        checksum_type(CHECKSUM_SUM32),
+        checksum_escaped(false),
+        sei_parse_mask(0xffffffff) {}
+  // Sets the parse level of every nal_unit_type.
+  void SetParseLevel(ParseLevel level) {
+    for (auto& parse_level_i : parse_level) {
+      parse_level_i = level;
+    }
+  }
+  // Sets the parse level of one nal_unit_type.
+  void SetParseLevel(uint32_t nal_unit_type, ParseLevel level) {
+    parse_level[nal_unit_type & 0x1f] = level;
+  }
+  ParseLevel GetParseLevel(uint32_t nal_unit_type) const {
+    return parse_level[nal_unit_type & 0x1f];
+  }
+  // Sets whether the SEI payloads of type |payload_type| are decoded.
+  void SetSeiParse(uint32_t payload_type, bool parse) {
+    if (payload_type < 32) {
+      uint32_t bit = 1u << payload_type;
+      sei_parse_mask = parse ? (sei_parse_mask | bit) : (sei_parse_mask & ~bit);
+    }
+  }
+  bool GetSeiParse(uint32_t payload_type) const {
+    return payload_type < 32 && ((sei_parse_mask >> payload_type) & 1u) != 0;
+  }
 };
 
 class NaluChecksum {
  public:
   // maximum length (in bytes)
   const static int kMaxLength = 32;
+  // CHECKSUM_SUM32 over the RBSP left in |bit_buffer|.
   static std::shared_ptr<NaluChecksum> GetNaluChecksum(
       BitBuffer* bit_buffer) noexcept;
+  // |checksum_type| over the RBSP left in |bit_buffer|. The bit buffer is
+  // left where it was.
+  static std::shared_ptr<NaluChecksum> GetNaluChecksum(
+      BitBuffer* bit_buffer, ChecksumType checksum_type) noexcept;
+  // |checksum_type| over the |length| bytes at |data|, as they are.
+  static std::shared_ptr<NaluChecksum> GetNaluChecksum(
+      const uint8_t* data, size_t length, ChecksumType checksum_type) noexcept;
   void fdump(char* output, int output_len) const;
   const char* GetChecksum() { return checksum; }
   int GetLength() { return length; }
   std::string GetPrintableChecksum() const;
 
  private:
+  // Stores the low |value_length| bytes of |value|, in network order.
+  void SetValue(uint64_t value, int value_length);
+
   char checksum[kMaxLength];
   int length;
 };
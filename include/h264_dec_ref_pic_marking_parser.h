@@ -9,6 +9,7 @@
 #include <memory>
 #include <vector>
 
+#include "h264_arena.h"
 #include "rtc_common.h"
 
 namespace h264nal {
@@ -19,7 +20,7 @@ namespace h264nal {
 class H264DecRefPicMarkingParser {
  public:
   // The parsed state of the DecRefPicMarking.
-  struct DecRefPicMarkingState {
+  struct DecRefPicMarkingState : public H264ArenaNode {
     DecRefPicMarkingState() = default;
     ~DecRefPicMarkingState() = default;
     // disable copy ctor, move ctor, and copy&move assignments
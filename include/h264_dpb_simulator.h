@@ -0,0 +1,175 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "h264_access_unit_assembler.h"
+#include "h264_bitstream_parser_state.h"
+#include "h264_pic_order_cnt_calculator.h"
+#include "h264_pps_parser.h"
+#include "h264_slice_header_parser.h"
+#include "h264_sps_parser.h"
+
+namespace h264nal {
+
+// How a picture in the DPB is marked (Section 8.2.5).
+enum DpbReferenceMarking : uint8_t {
+  UNUSED_FOR_REFERENCE = 0,
+  SHORT_TERM_REFERENCE = 1,
+  LONG_TERM_REFERENCE = 2
+};
+
+// A class for simulating the decoded picture buffer (DPB) of an H264
+// decoder. It runs the decoded reference picture marking process (Section
+// 8.2.5: sliding window, and memory_management_control_operation 1 to 6),
+// the reference picture list construction (Section 8.2.4, including
+// ref_pic_list_modification()), and the output ("bumping") process of
+// Annex C.4. The pictures must be fed in decoding order, one call per
+// primary coded picture (e.g. the first slice header of each access unit,
+// see H264AccessUnitAssembler).
+//
+// Fields are handled at the frame level: the second field of a
+// complementary field pair shares the frame store of the first one, and
+// the reference lists of a field are built from frames (Section 8.2.4.2.5
+// is not implemented).
+class H264DpbSimulator {
+ public:
+  // A frame in the DPB (or in a reference picture list).
+  struct DpbPicture {
+    // the index (in decoding order) of the picture, counting from 0. For
+    // a "non-existing" frame (Section 8.2.5.2), the index of the picture
+    // whose frame_num gap inferred it.
+    size_t picture_index = 0;
+    uint32_t frame_num = 0;
+    // PicOrderCnt() of the frame (or of its first field)
+    int32_t PicOrderCnt = 0;
+    // whether the frame was inferred from a frame_num gap
+    uint8_t non_existing = 0;
+    DpbReferenceMarking reference_marking = UNUSED_FOR_REFERENCE;
+    // LongTermFrameIdx, for a long-term reference frame
+    uint32_t long_term_frame_idx = 0;
+    // whether the frame is still waiting to be output
+    uint8_t needed_for_output = 0;
+  };
+
+  // The result of decoding one picture.
+  struct PictureState {
+    // the index of the picture in decoding order
+    size_t picture_index = 0;
+    // the picture as seen in its (first) slice header
+    uint32_t nal_unit_type = 0;
+    uint32_t nal_ref_idc = 0;
+    uint32_t slice_type = 0;
+    uint32_t frame_num = 0;
+    H264PicOrderCntCalculator::PicOrderCnt pic_order_cnt;
+    // RefPicList0 and RefPicList1 (Section 8.2.4), after the
+    // modifications, with num_ref_idx_l0_active_minus1 + 1 and
+    // num_ref_idx_l1_active_minus1 + 1 entries at most (fewer if the DPB
+    // does not hold enough reference frames)
+    std::vector<DpbPicture> ref_pic_list0;
+    std::vector<DpbPicture> ref_pic_list1;
+    // the frames output while decoding the picture, in output order (it
+    // may include the picture itself)
+    std::vector<DpbPicture> output;
+    // the DPB after the picture is stored, and its size (in frames)
+    std::vector<DpbPicture> dpb;
+    uint32_t dpb_size = 0;
+  };
+
+  H264DpbSimulator();
+  ~H264DpbSimulator() = default;
+  // disable copy ctor, move ctor, and copy&move assignments
+  H264DpbSimulator(const H264DpbSimulator&) = delete;
+  H264DpbSimulator(H264DpbSimulator&&) = delete;
+  H264DpbSimulator& operator=(const H264DpbSimulator&) = delete;
+  H264DpbSimulator& operator=(H264DpbSimulator&&) = delete;
+
+  // Decodes the picture with |slice_header|, the next one in decoding
+  // order, resolving its PPS and SPS in |bitstream_parser_state|. Returns
+  // false (and leaves the DPB unchanged) if either is missing.
+  bool DecodePicture(
+      const struct H264SliceHeaderParser::SliceHeaderState& slice_header,
+      const struct H264BitstreamParserState& bitstream_parser_state,
+      PictureState* picture) noexcept;
+  // Decodes the primary coded picture of |access_unit| against the PPS and
+  // SPS it was assembled with (see H264AccessUnitAssembler). Use this when
+  // the access units are assembled while parsing, as the parser state may
+  // already hold the parameter sets of the next access unit. Returns false
+  // if the access unit has no primary slice header, PPS, or SPS.
+  bool DecodePicture(
+      const struct H264AccessUnitAssembler::AccessUnitState& access_unit,
+      PictureState* picture) noexcept;
+  // Outputs the frames still waiting in the DPB, in output order, and
+  // empties it, as at the end of the stream.
+  void Flush(std::vector<DpbPicture>* output) noexcept;
+  // Empties the DPB (without output), as at the start of a stream.
+  void Reset() noexcept;
+
+  // The DPB size (in frames) for |sps|: max_dec_frame_buffering when the
+  // VUI carries it, or MaxDpbFrames for the level (Table A-1) otherwise.
+  static uint32_t GetDpbSize(
+      const struct H264SpsDataParser::SpsDataState& sps) noexcept;
+
+ private:
+  // Decodes the picture with |slice_header|, its |pps|, and its |sps|.
+  bool DecodePicture(
+      const struct H264SliceHeaderParser::SliceHeaderState& slice_header,
+      const struct H264PpsParser::PpsState* pps,
+      const struct H264SpsParser::SpsState* sps,
+      PictureState* picture) noexcept;
+  // Section 8.2.5.2: fills a frame_num gap with "non-existing" frames
+  void FillFrameNumGap(uint32_t frame_num, uint32_t MaxFrameNum,
+                       uint32_t max_num_ref_frames, uint32_t dpb_size,
+                       std::vector<DpbPicture>* output) noexcept;
+  // Section 8.2.4.2: the initial reference picture lists
+  void InitRefPicLists(uint32_t slice_type, int32_t pic_order_cnt,
+                       std::vector<DpbPicture>* ref_pic_list0,
+                       std::vector<DpbPicture>* ref_pic_list1) const noexcept;
+  // Section 8.2.4.3: the reference picture list modifications
+  void ModifyRefPicLists(
+      const struct H264SliceHeaderParser::SliceHeaderState& slice_header,
+      uint32_t MaxFrameNum, std::vector<DpbPicture>* ref_pic_list0,
+      std::vector<DpbPicture>* ref_pic_list1) const noexcept;
+  // Section 8.2.5.3: the sliding window marking
+  void SlidingWindow(uint32_t max_num_ref_frames) noexcept;
+  // Section 8.2.5.4: the adaptive memory control marking. Returns whether
+  // a memory_management_control_operation 6 marked the current picture.
+  bool AdaptiveMemoryControl(
+      const struct H264SliceHeaderParser::SliceHeaderState& slice_header,
+      uint32_t* long_term_frame_idx) noexcept;
+  // Annex C.4.5.3: outputs the frame with the smallest PicOrderCnt().
+  // Returns false if no frame is waiting to be output.
+  bool Bump(std::vector<DpbPicture>* output) noexcept;
+  // Annex C.4.2: empties the frames that are neither used for reference
+  // nor waiting to be output
+  void RemoveUnusedFrames() noexcept;
+  // Annex C.4.5.1: stores |picture|, bumping frames out until there is an
+  // empty frame buffer
+  void Store(const DpbPicture& picture, uint32_t dpb_size,
+             std::vector<DpbPicture>* output) noexcept;
+
+  // FrameNumWrap (Equation 8-27) and PicNum of a short-term frame
+  int64_t GetFrameNumWrap(const DpbPicture& picture) const noexcept;
+
+  // the DPB frames, in decoding order
+  std::vector<DpbPicture> dpb_;
+  H264PicOrderCntCalculator pic_order_cnt_calculator_;
+  // the number of pictures decoded so far
+  size_t picture_count_;
+  // the current picture's frame_num and MaxFrameNum (for FrameNumWrap)
+  uint32_t frame_num_;
+  uint32_t max_frame_num_;
+  // PrevRefFrameNum (Section 7.4.3)
+  uint32_t prev_ref_frame_num_;
+  // MaxLongTermFrameIdx (Section 8.2.5.4.4), or -1 for "no long-term
+  // frame indices"
+  int64_t max_long_term_frame_idx_;
+};
+
+}  // namespace h264nal
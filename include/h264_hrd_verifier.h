@@ -0,0 +1,177 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "h264_access_unit_assembler.h"
+#include "h264_bitstream_parser_state.h"
+#include "h264_hrd_parameters_parser.h"
+#include "h264_sei_parser.h"
+#include "h264_sps_parser.h"
+
+namespace h264nal {
+
+// Section C.1: the HRD checks either the NAL HRD parameters (Type II
+// bitstream conformance: every NAL unit) or the VCL HRD parameters (Type I
+// bitstream conformance: the VCL and filler data NAL units).
+enum HrdType : uint8_t { NAL_HRD = 0, VCL_HRD = 1 };
+
+enum HrdViolationType : uint8_t {
+  // an access unit was not fully in the CPB at its removal time
+  CPB_UNDERFLOW = 0,
+  // the CPB held more than CpbSize bits
+  CPB_OVERFLOW = 1,
+  // more decoded pictures waited for output than the DPB has frame
+  // buffers
+  DPB_OVERFLOW = 2
+};
+
+// A class for verifying an H264 bitstream against the hypothetical
+// reference decoder (Annex C). It runs the leaky-bucket model of the coded
+// picture buffer (CPB) of one delivery schedule (SchedSelIdx): each access
+// unit arrives at the bit rate of the HRD parameters (Section C.1.1), and
+// is removed at the time its buffering period and picture timing SEI
+// messages give (Section C.1.2). It reports the access units the CPB
+// underflows or overflows on, and the ones a decoded picture buffer
+// filled with pictures waiting for output (dpb_output_delay) overflows on.
+// The access units must be fed in decoding order.
+//
+// The DPB check only counts the pictures waiting for output, not the
+// reference frames that may share the frame buffers with them (see
+// H264DpbSimulator for the full reference marking).
+class H264HrdVerifier {
+ public:
+  // The timing of one access unit (in seconds, counting from the initial
+  // arrival of the first access unit).
+  struct AccessUnitTiming {
+    // the index of the access unit in decoding order
+    size_t access_unit_index = 0;
+    // the offset of the access unit in the stream
+    size_t offset = 0;
+    // b(n): the size of the access unit, in bits
+    uint64_t size = 0;
+    // t_ai(n) and t_af(n): the initial and final arrival times (Section
+    // C.1.1)
+    double initial_arrival_time = 0;
+    double final_arrival_time = 0;
+    // t_r,n(n) and t_r(n): the nominal and actual removal times (Section
+    // C.1.2). They only differ in low delay mode (low_delay_hrd_flag).
+    double nominal_removal_time = 0;
+    double removal_time = 0;
+    // t_o,dpb(n): the output time (Section C.2.2)
+    double output_time = 0;
+  };
+
+  // A conformance violation.
+  struct HrdViolation {
+    HrdViolationType type = CPB_UNDERFLOW;
+    // the access unit that underflowed the CPB, the last one that had
+    // arrived in the CPB when it overflowed, or the one whose decoded
+    // picture overflowed the DPB
+    size_t access_unit_index = 0;
+    size_t offset = 0;
+    // when the violation happened
+    double time = 0;
+    // the fullness of the buffer, and its size: in bits for the CPB, in
+    // frames for the DPB. For an underflow, the fullness is the number of
+    // bits of the access unit that had arrived at its removal time.
+    uint64_t fullness = 0;
+    uint64_t size = 0;
+  };
+
+  H264HrdVerifier(HrdType hrd_type, uint32_t SchedSelIdx);
+  ~H264HrdVerifier() = default;
+  // disable copy ctor, move ctor, and copy&move assignments
+  H264HrdVerifier(const H264HrdVerifier&) = delete;
+  H264HrdVerifier(H264HrdVerifier&&) = delete;
+  H264HrdVerifier& operator=(const H264HrdVerifier&) = delete;
+  H264HrdVerifier& operator=(H264HrdVerifier&&) = delete;
+
+  // Adds the next access unit, at |offset| in the stream and |size| bits
+  // long, with its SEI messages (|buffering_period| is nullptr when it has
+  // none), and the active SPS. Returns false (and ignores the access unit)
+  // if it cannot be timed: the SPS has no timing information or HRD
+  // parameters for |SchedSelIdx|, the access unit has no picture timing
+  // (or no CPB removal delay), or no buffering period has started yet.
+  bool AddAccessUnit(
+      size_t offset, uint64_t size,
+      const struct H264BufferingPeriodParser::BufferingPeriodState*
+          buffering_period,
+      const struct H264PicTimingParser::PicTimingState& pic_timing,
+      const struct H264SpsDataParser::SpsDataState& sps,
+      AccessUnitTiming* timing) noexcept;
+  // As above, taking the size (all its NAL units for the NAL HRD, the VCL
+  // and filler data NAL units for the VCL HRD), the SEI messages, and the
+  // active SPS from |access_unit|. The start codes are not counted, so the
+  // size does not depend on the stream format. The SPS is the one the
+  // access unit was assembled with, or else the one its PPS refers to in
+  // |bitstream_parser_state|.
+  bool AddAccessUnit(
+      const struct H264AccessUnitAssembler::AccessUnitState& access_unit,
+      const struct H264BitstreamParserState& bitstream_parser_state,
+      AccessUnitTiming* timing) noexcept;
+  // Checks the CPB up to the removal of the last access unit, as at the
+  // end of the stream.
+  void Flush() noexcept;
+  // Forgets the access units and violations, as at the start of a stream.
+  void Reset() noexcept;
+
+  // The violations found so far, in time order for each buffer. A CPB
+  // overflow is only known once the access units arriving before the
+  // removal time it happens at have been added (or after Flush()).
+  const std::vector<HrdViolation>& GetViolations() const noexcept {
+    return violations_;
+  }
+
+  // BitRate[SchedSelIdx] (Equation E-37) and CpbSize[SchedSelIdx]
+  // (Equation E-38), or 0 if |hrd_parameters| has no such schedule.
+  static uint64_t GetBitRate(
+      const struct H264HrdParametersParser::HrdParametersState& hrd_parameters,
+      uint32_t SchedSelIdx) noexcept;
+  static uint64_t GetCpbSize(
+      const struct H264HrdParametersParser::HrdParametersState& hrd_parameters,
+      uint32_t SchedSelIdx) noexcept;
+
+ private:
+  // An access unit waiting in the CPB (until its removal time), or a
+  // picture waiting in the DPB (until its output time).
+  struct BufferedAccessUnit {
+    size_t access_unit_index;
+    size_t offset;
+    uint64_t size;
+    double time;
+  };
+
+  // Section C.3: checks the CPB fullness just before each removal at or
+  // before |time|. No access unit after the last one may arrive before
+  // |time|.
+  void RemoveAccessUnits(double time) noexcept;
+
+  HrdType hrd_type_;
+  uint32_t SchedSelIdx_;
+  std::vector<HrdViolation> violations_;
+  size_t access_unit_count_;
+  // the current buffering period: t_r,n(n_b) of its first access unit,
+  // and its initial CPB removal delays (in 90 kHz units)
+  double buffering_period_removal_time_;
+  uint32_t initial_cpb_removal_delay_;
+  uint32_t initial_cpb_removal_delay_offset_;
+  // the CPB: the access units not removed yet, the bits of the ones
+  // before the last one (which have all arrived), the bits removed so
+  // far, and the last access unit (which may still be arriving)
+  std::vector<BufferedAccessUnit> cpb_;
+  uint64_t arrived_bits_;
+  uint64_t removed_bits_;
+  AccessUnitTiming last_access_unit_;
+  uint64_t cpb_size_;
+  // the DPB: the pictures waiting for output
+  std::vector<BufferedAccessUnit> dpb_;
+};
+
+}  // namespace h264nal
@@ -0,0 +1,60 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include <cstdint>
+
+namespace h264nal {
+
+// A vector with a fixed capacity, stored inline. The parsed state structs
+// use it for the syntax element lists whose length the standard bounds
+// (e.g. the 2 delta_pic_order_cnt values of a slice header), so parsing
+// them needs no heap allocation, and a parsed struct stays in one piece.
+// It keeps the parts of the std::vector API the parsers and their callers
+// use. A push_back() past the capacity is dropped: the parsers check the
+// bounds before they get there.
+template <typename T, size_t N>
+class InlineVector {
+ public:
+  typedef T value_type;
+  typedef size_t size_type;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef T* iterator;
+  typedef const T* const_iterator;
+
+  InlineVector() : values_(), size_(0) {}
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  static constexpr size_t capacity() { return N; }
+
+  T& operator[](size_t i) { return values_[i]; }
+  const T& operator[](size_t i) const { return values_[i]; }
+  T& back() { return values_[size_ - 1]; }
+  const T& back() const { return values_[size_ - 1]; }
+  T* data() { return values_; }
+  const T* data() const { return values_; }
+
+  iterator begin() { return values_; }
+  iterator end() { return values_ + size_; }
+  const_iterator begin() const { return values_; }
+  const_iterator end() const { return values_ + size_; }
+
+  void push_back(const T& value) {
+    if (size_ < N) {
+      values_[size_++] = value;
+    }
+  }
+  void clear() { size_ = 0; }
+
+ private:
+  T values_[N];
+  uint32_t size_;
+};
+
+}  // namespace h264nal
@@ -0,0 +1,149 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "h264_access_unit_assembler.h"
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "h264_sps_parser.h"
+
+namespace h264nal {
+
+// The Annex A limits a level violation breaks.
+enum LevelLimitType : uint8_t {
+  // the level_idc is not in Table A-1
+  UNKNOWN_LEVEL = 0,
+  // the macroblock processing rate
+  MAX_MBPS = 1,
+  // the frame size, or a frame dimension
+  MAX_FS = 2,
+  // the decoded picture buffer size
+  MAX_DPB_MBS = 3,
+  // the bit rate of an HRD delivery schedule
+  MAX_BR = 4,
+  // the coded picture buffer size of an HRD delivery schedule
+  MAX_CPB = 5,
+  // the access unit size (the minimum compression ratio)
+  MIN_CR = 6,
+  // the number of slices per picture
+  MAX_SLICES = 7
+};
+
+// A class for checking an H264 bitstream against the level limits of its
+// SPS (Annex A), from the headers alone: the picture size, the DPB size,
+// and the HRD parameters of the SPS (Section A.3.1 and Table A-1), and
+// the access unit sizes and the number of slices per picture (Sections
+// A.3.1 and A.3.3). The rates come from the frame rate of the VUI timing
+// information (time_scale / (2 * num_units_in_tick)); the checks that need
+// them are skipped when the SPS has none. The access units must be fed in
+// decoding order.
+//
+// MaxBR and MaxCPB bound the bit rates and CPB sizes of the HRD
+// parameters, not a bit rate measured over the stream: whether the stream
+// fits its CPB is for H264HrdVerifier (Annex C). MaxMvsPer2Mb and MaxVmvR
+// depend on the macroblock layer, and are only reported as limits (see
+// GetLevelLimits()).
+class H264LevelChecker {
+ public:
+  // A row of Table A-1.
+  struct LevelLimits {
+    // 10 times the level number, or 9 for level 1b
+    uint8_t level_idc;
+    // macroblocks per second
+    uint32_t MaxMBPS;
+    // macroblocks
+    uint32_t MaxFS;
+    // macroblocks
+    uint32_t MaxDpbMbs;
+    // in units of cpbBrVclFactor or cpbBrNalFactor bits per second
+    uint32_t MaxBR;
+    // in units of cpbBrVclFactor or cpbBrNalFactor bits
+    uint32_t MaxCPB;
+    // the vertical motion vector range, in luma frame samples
+    uint32_t MaxVmvR;
+    uint32_t MinCR;
+    // 0 when there is no limit
+    uint32_t MaxMvsPer2Mb;
+    // Section A.3.3: the slice rate of the Main and High profiles (0 when
+    // there is no limit)
+    uint32_t SliceRate;
+  };
+
+  // A level limit violation.
+  struct LevelViolation {
+    LevelLimitType type = UNKNOWN_LEVEL;
+    // the access unit that broke the limit (for the limits of the SPS, the
+    // first one using it)
+    size_t access_unit_index = 0;
+    size_t offset = 0;
+    // the value, and its limit: macroblocks per second for MAX_MBPS,
+    // macroblocks (or a frame dimension in macroblocks) for MAX_FS, frames
+    // for MAX_DPB_MBS, bits per second for MAX_BR, bits for MAX_CPB, bytes
+    // for MIN_CR, and slices for MAX_SLICES. For UNKNOWN_LEVEL, the
+    // level_idc.
+    uint64_t value = 0;
+    uint64_t max_value = 0;
+  };
+
+  H264LevelChecker();
+  ~H264LevelChecker() = default;
+  // disable copy ctor, move ctor, and copy&move assignments
+  H264LevelChecker(const H264LevelChecker&) = delete;
+  H264LevelChecker(H264LevelChecker&&) = delete;
+  H264LevelChecker& operator=(const H264LevelChecker&) = delete;
+  H264LevelChecker& operator=(H264LevelChecker&&) = delete;
+
+  // Adds the next access unit, at |offset| in the stream, |size| bytes
+  // long (NumBytesInNALunit summed over its NAL units), and with
+  // |num_slices| slices in its primary coded picture, and the active SPS.
+  // The limits of the SPS are reported for the first access unit breaking
+  // them, and again only when an SPS breaks them differently.
+  void AddAccessUnit(
+      size_t offset, uint64_t size, uint32_t num_slices,
+      const struct H264SpsDataParser::SpsDataState& sps) noexcept;
+  // As above, taking the size, the number of slices, and the active SPS
+  // from |access_unit|. The SPS is the one the access unit was assembled
+  // with, or else the one its PPS refers to in |bitstream_parser_state|.
+  // Returns false (and ignores the access unit) if it has no active SPS.
+  bool AddAccessUnit(
+      const struct H264AccessUnitAssembler::AccessUnitState& access_unit,
+      const struct H264BitstreamParserState& bitstream_parser_state) noexcept;
+  // Forgets the access units and violations, as at the start of a stream.
+  void Reset() noexcept;
+
+  // The violations found so far, in stream order.
+  const std::vector<LevelViolation>& GetViolations() const noexcept {
+    return violations_;
+  }
+
+  // The Table A-1 limits of the level of |sps| (level_idc 11 with
+  // constraint_set3_flag is level 1b in the Baseline, Main, and Extended
+  // profiles), or nullptr for an unknown level_idc.
+  static const LevelLimits* GetLevelLimits(
+      const struct H264SpsDataParser::SpsDataState& sps) noexcept;
+  // Table A-2: cpbBrVclFactor and cpbBrNalFactor, or 0 for a profile
+  // without level limits.
+  static uint32_t GetCpbBrVclFactor(ProfileType profile_type) noexcept;
+  static uint32_t GetCpbBrNalFactor(ProfileType profile_type) noexcept;
+
+ private:
+  // Checks the limits that only depend on |sps|.
+  void CheckSps(const struct H264SpsDataParser::SpsDataState& sps,
+                size_t offset) noexcept;
+  void AddViolation(LevelLimitType type, size_t offset, uint64_t value,
+                    uint64_t max_value) noexcept;
+
+  std::vector<LevelViolation> violations_;
+  size_t access_unit_count_;
+  // the violations of the limits of the SPS of the last access unit
+  std::vector<LevelViolation> sps_violations_;
+};
+
+}  // namespace h264nal
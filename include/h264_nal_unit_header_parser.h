@@ -8,6 +8,7 @@
 
 #include <memory>
 
+#include "h264_arena.h"
 #include "h264_common.h"
 #include "h264_nal_unit_header_svc_extension_parser.h"
 #include "rtc_common.h"
@@ -18,7 +19,7 @@ namespace h264nal {
 class H264NalUnitHeaderParser {
  public:
   // The parsed state of the NAL Unit Header.
-  struct NalUnitHeaderState {
+  struct NalUnitHeaderState : public H264ArenaNode {
     NalUnitHeaderState() = default;
     ~NalUnitHeaderState() = default;
     // disable copy ctor, move ctor, and copy&move assignments
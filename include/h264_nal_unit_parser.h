@@ -6,8 +6,10 @@
 
 #include <stdio.h>
 
+#include <functional>
 #include <memory>
 
+#include "h264_arena.h"
 #include "h264_bitstream_parser_state.h"
 #include "h264_common.h"
 #include "h264_nal_unit_header_parser.h"
@@ -21,7 +23,7 @@ class H264NalUnitParser {
  public:
   // The parsed state of the NAL Unit. Only some select values are stored.
   // Add more as they are actually needed.
-  struct NalUnitState {
+  struct NalUnitState : public H264ArenaNode {
     NalUnitState() = default;
     ~NalUnitState() = default;
     // disable copy ctor, move ctor, and copy&move assignments
@@ -35,6 +37,14 @@ class H264NalUnitParser {
                ParsingOptions parsing_options) const;
 #endif  // FDUMP_DEFINE
 
+    // Drops the parsed contents, leaving an empty NAL unit (the arena, if
+    // any, is kept).
+    void Reset() noexcept;
+
+    // The arena holding the sub-structures of a NAL unit parsed in place
+    // (see the reusable ParseNalUnit()), nullptr otherwise. Declared
+    // first, so it goes last.
+    std::unique_ptr<H264Arena> arena;
     // NAL Unit offset in the full blob
     size_t offset;
     // NAL Unit length
@@ -43,6 +53,11 @@ class H264NalUnitParser {
     size_t parsed_length;
     // NAL Unit checksum
     std::shared_ptr<NaluChecksum> checksum;
+    // Whether the NAL unit is a parameter set that changed the parameter
+    // set tables. A byte-identical repeat of the SPS/PPS/SubsetSPS already
+    // in effect for its id leaves this false, so it is a cheap signal that
+    // the stream configuration (e.g. the resolution) may have changed.
+    bool parameter_set_changed;
 
     std::unique_ptr<struct H264NalUnitHeaderParser::NalUnitHeaderState>
         nal_unit_header;
@@ -50,6 +65,12 @@ class H264NalUnitParser {
         nal_unit_payload;
   };
 
+  // Called once per parsed NAL unit, by the parsers that hand NAL units
+  // over one at a time rather than collecting them. The callee owns the
+  // NAL unit: it can keep it, or let it go right away.
+  typedef std::function<void(std::unique_ptr<NalUnitState> nal_unit)>
+      NalUnitCallback;
+
   // Parse NAL unit state from the supplied buffer.
   // Use this function to parse NALUs that have not been escaped
   // into an RBSP, e.g. with NALUs from an mp4 mdat box.
@@ -60,6 +81,13 @@ class H264NalUnitParser {
   // Unpack RBSP and parse NAL unit state from the supplied buffer.
   // Use this function to parse NALUs that have been escaped
   // to avoid the start code prefix (0x000001/0x00000001)
+  // ParsingOptions::parse_level picks how much of the NAL unit is parsed.
+  // A NAL unit whose type is PARSE_SKIP returns nullptr, so the bitstream
+  // parsers drop it.
+  // A parameter set that repeats, byte for byte, the one in the
+  // |bitstream_parser_state| tables for its id is not parsed again: the
+  // payload shares the table entry (this needs the NAL unit bytes, so the
+  // BitBuffer version always parses).
   static std::unique_ptr<NalUnitState> ParseNalUnit(
       const uint8_t* data, size_t length,
       struct H264BitstreamParserState* bitstream_parser_state,
@@ -68,6 +96,24 @@ class H264NalUnitParser {
       BitBuffer* bit_buffer,
       struct H264BitstreamParserState* bitstream_parser_state,
       ParsingOptions parsing_options) noexcept;
+
+  // Reusable versions of ParseNalUnit() and ParseNalUnitUnescaped(), for
+  // long-running parsers that drop each NAL unit once they have looked at
+  // it. The NAL unit is parsed into the caller-owned |nal_unit|, which is
+  // reset in place first. Its sub-structures are allocated in
+  // |nal_unit->arena|, which is created on the first call and reset (not
+  // freed) on the next ones, so parsing a stream of similar NAL units does
+  // no heap allocation once the arena fits the largest one. |offset| is
+  // left at 0, and |length| is set to |length|. Returns false, with
+  // |nal_unit| reset, if the NAL unit does not parse or is PARSE_SKIP.
+  static bool ParseNalUnit(
+      const uint8_t* data, size_t length,
+      struct H264BitstreamParserState* bitstream_parser_state,
+      ParsingOptions parsing_options, NalUnitState* nal_unit) noexcept;
+  static bool ParseNalUnitUnescaped(
+      const uint8_t* data, size_t length,
+      struct H264BitstreamParserState* bitstream_parser_state,
+      ParsingOptions parsing_options, NalUnitState* nal_unit) noexcept;
 };
 
 }  // namespace h264nal
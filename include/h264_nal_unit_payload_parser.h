@@ -8,11 +8,13 @@
 
 #include <memory>
 
+#include "h264_arena.h"
 #include "h264_bitstream_parser_state.h"
 #include "h264_common.h"
 #include "h264_nal_unit_header_parser.h"
 #include "h264_pps_parser.h"
 #include "h264_prefix_nal_unit_parser.h"
+#include "h264_sei_parser.h"
 #include "h264_slice_layer_extension_rbsp_parser.h"
 #include "h264_slice_layer_without_partitioning_rbsp_parser.h"
 #include "h264_sps_parser.h"
@@ -26,7 +28,7 @@ class H264NalUnitPayloadParser {
  public:
   // The parsed state of the NAL Unit Payload. Only some select values are
   // stored. Add more as they are actually needed.
-  struct NalUnitPayloadState {
+  struct NalUnitPayloadState : public H264ArenaNode {
     NalUnitPayloadState() = default;
     ~NalUnitPayloadState() = default;
     // disable copy ctor, move ctor, and copy&move assignments
@@ -43,7 +45,7 @@ class H264NalUnitPayloadParser {
     // Whether the payload of a NAL unit of the given type was parsed. A
     // NAL unit whose payload fails to parse is not fatal (we keep the NAL
     // unit, with an empty payload), so this is how a caller notices.
-    // Types whose payload we do not parse at all (SEI, data partitions,
+    // Types whose payload we do not parse at all (data partitions,
     // filler, ...) count as parsed: nothing is missing that we would have
     // produced. They are whole NAL units we skip, not a structure whose
     // absence knocks the rest of a parse out of alignment.
@@ -60,6 +62,7 @@ class H264NalUnitPayloadParser {
     std::unique_ptr<
         struct H264SliceLayerExtensionRbspParser::SliceLayerExtensionRbspState>
         slice_layer_extension_rbsp;
+    std::unique_ptr<struct H264SeiParser::SeiState> sei;
   };
 
   // Unpack RBSP and parse NAL unit payload state from the supplied buffer.
@@ -71,6 +74,14 @@ class H264NalUnitPayloadParser {
       BitBuffer* bit_buffer,
       H264NalUnitHeaderParser::NalUnitHeaderState& nal_unit_header,
       struct H264BitstreamParserState* bitstream_parser_state) noexcept;
+  // Parses only as much as |parsing_options| asks for the NAL unit type
+  // (ParsingOptions::parse_level): PARSE_HEADER and PARSE_SKIP return an
+  // empty payload, and PARSE_PARTIAL stops the slice header early.
+  static std::unique_ptr<NalUnitPayloadState> ParseNalUnitPayload(
+      BitBuffer* bit_buffer,
+      H264NalUnitHeaderParser::NalUnitHeaderState& nal_unit_header,
+      struct H264BitstreamParserState* bitstream_parser_state,
+      ParsingOptions parsing_options) noexcept;
   // used by RTP fu-a, which has a pseudo-NALU header
   static std::unique_ptr<NalUnitPayloadState> ParseNalUnitPayload(
       BitBuffer* bit_buffer, uint32_t nal_ref_idc, uint32_t nal_unit_type,
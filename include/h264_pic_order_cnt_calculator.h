@@ -0,0 +1,120 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+#include <cstdint>
+
+#include "h264_bitstream_parser_state.h"
+#include "h264_slice_header_parser.h"
+#include "h264_sps_parser.h"
+
+namespace h264nal {
+
+// A class for deriving the picture order counts of an H264 bitstream
+// (Section 8.2.1). It keeps the state the derivation carries from one
+// picture to the next (prevPicOrderCntMsb and prevPicOrderCntLsb, or
+// prevFrameNumOffset and prevFrameNum), so the pictures must be fed in
+// decoding order, one call per primary coded picture (e.g. the first
+// slice header of each access unit, see H264AccessUnitAssembler). All
+// three pic_order_cnt_type values are supported, as are
+// memory_management_control_operation 5 and complementary field pairs.
+//
+// Frame num gaps (gaps_in_frame_num_value_allowed_flag) are not filled
+// in: the "non-existing" frames do not change the picture order counts of
+// the pictures around them, unless the gap reaches MaxFrameNum.
+class H264PicOrderCntCalculator {
+ public:
+  // The picture order counts of a picture.
+  struct PicOrderCnt {
+    // the picture structure (as in the slice header)
+    uint8_t field_pic_flag = 0;
+    uint8_t bottom_field_flag = 0;
+    // whether the picture is the second field of a complementary field
+    // pair, whose first field was the previous picture
+    uint8_t second_field = 0;
+    // whether the picture has a memory_management_control_operation
+    // equal to 5
+    uint8_t memory_management_control_operation_5 = 0;
+    // TopFieldOrderCnt and BottomFieldOrderCnt. For a field, only the one
+    // of its parity is derived, unless it is a second field: then both
+    // are set, the other one coming from the first field. After a
+    // memory_management_control_operation 5, they are the values
+    // tempPicOrderCnt is subtracted from (Section 8.2.1), so the picture
+    // starts the new picture order count sequence.
+    int32_t TopFieldOrderCnt = 0;
+    int32_t BottomFieldOrderCnt = 0;
+    // PicOrderCnt(CurrPic) (Equation 8-1): Min(TopFieldOrderCnt,
+    // BottomFieldOrderCnt) for a frame, or the field's own count.
+    int32_t PicOrderCnt = 0;
+  };
+
+  H264PicOrderCntCalculator();
+  ~H264PicOrderCntCalculator() = default;
+  // disable copy ctor, move ctor, and copy&move assignments
+  H264PicOrderCntCalculator(const H264PicOrderCntCalculator&) = delete;
+  H264PicOrderCntCalculator(H264PicOrderCntCalculator&&) = delete;
+  H264PicOrderCntCalculator& operator=(const H264PicOrderCntCalculator&) =
+      delete;
+  H264PicOrderCntCalculator& operator=(H264PicOrderCntCalculator&&) = delete;
+
+  // Derives the picture order counts of the picture with |slice_header|,
+  // the next one in decoding order, whose active SPS is |sps|. Returns
+  // false (and leaves the state unchanged) if the SPS does not match the
+  // slice header (e.g. offset_for_ref_frame is missing).
+  bool Compute(
+      const struct H264SliceHeaderParser::SliceHeaderState& slice_header,
+      const struct H264SpsDataParser::SpsDataState& sps,
+      PicOrderCnt* pic_order_cnt) noexcept;
+  // As above, resolving the active SPS through the slice header's PPS in
+  // |bitstream_parser_state|. Returns false if either is missing.
+  bool Compute(
+      const struct H264SliceHeaderParser::SliceHeaderState& slice_header,
+      const struct H264BitstreamParserState& bitstream_parser_state,
+      PicOrderCnt* pic_order_cnt) noexcept;
+  // Forgets the previous pictures, as at the start of a stream.
+  void Reset() noexcept;
+
+  // Whether |slice_header| has a memory_management_control_operation
+  // equal to 5.
+  static bool HasMemoryManagementControlOperation5(
+      const struct H264SliceHeaderParser::SliceHeaderState&
+          slice_header) noexcept;
+
+ private:
+  // Section 8.2.1.1 (pic_order_cnt_type 0)
+  void ComputeType0(
+      const struct H264SliceHeaderParser::SliceHeaderState& slice_header,
+      uint32_t MaxPicOrderCntLsb, PicOrderCnt* pic_order_cnt) noexcept;
+  // Section 8.2.1.2 (pic_order_cnt_type 1)
+  bool ComputeType1(
+      const struct H264SliceHeaderParser::SliceHeaderState& slice_header,
+      const struct H264SpsDataParser::SpsDataState& sps,
+      int64_t FrameNumOffset, PicOrderCnt* pic_order_cnt) noexcept;
+  // Section 8.2.1.3 (pic_order_cnt_type 2)
+  void ComputeType2(
+      const struct H264SliceHeaderParser::SliceHeaderState& slice_header,
+      int64_t FrameNumOffset, PicOrderCnt* pic_order_cnt) noexcept;
+
+  // whether a picture was seen since the start (or the last Reset())
+  bool has_previous_picture_;
+  // pic_order_cnt_type 0: the previous reference picture
+  // (prevPicOrderCntMsb and prevPicOrderCntLsb, Section 8.2.1.1)
+  int64_t prev_pic_order_cnt_msb_;
+  int64_t prev_pic_order_cnt_lsb_;
+  // pic_order_cnt_type 1 and 2: the previous picture (prevFrameNumOffset
+  // and prevFrameNum, Section 8.2.1.2)
+  int64_t prev_frame_num_offset_;
+  uint32_t prev_frame_num_;
+  // the previous picture, if it is a first field that may be paired with
+  // the next one
+  bool first_field_pending_;
+  PicOrderCnt first_field_;
+  uint32_t first_field_frame_num_;
+  uint32_t first_field_nal_ref_idc_;
+};
+
+}  // namespace h264nal
@@ -9,6 +9,7 @@
 #include <memory>
 #include <vector>
 
+#include "h264_inline_vector.h"
 #include "rtc_common.h"
 
 namespace h264nal {
@@ -45,6 +46,9 @@ class H264PpsParser {
   // shall be in the range of 0 to 31, inclusive."
   const static uint32_t kNumRefIdxL1DefaultActiveMinus1Min = 0;
   const static uint32_t kNumRefIdxL1DefaultActiveMinus1Max = 31;
+  // Section 7.3.2.2: up to 12 scaling lists (8 unless chroma_format_idc
+  // is 3)
+  const static uint32_t kMaxScalingListCount = 12;
 
   // The parsed state of the PPS. Only some select values are stored.
   // Add more as they are actually needed.
@@ -62,40 +66,43 @@ class H264PpsParser {
 #endif  // FDUMP_DEFINE
 
     // input parameters
-    uint32_t chroma_format_idc = 0;
+    uint8_t chroma_format_idc = 0;
 
     // contents
-    uint32_t pic_parameter_set_id = 0;
-    uint32_t seq_parameter_set_id = 0;
-    uint32_t entropy_coding_mode_flag = 0;
-    uint32_t bottom_field_pic_order_in_frame_present_flag = 0;
-    uint32_t num_slice_groups_minus1 = 0;
-    uint32_t slice_group_map_type = 0;
-    std::vector<uint32_t> run_length_minus1;
-    std::vector<uint32_t> top_left;
-    std::vector<uint32_t> bottom_right;
-    uint32_t slice_group_change_direction_flag = 0;
+    // The fields are as narrow as their ranges allow (Section 7.4.2.2),
+    // and the lists bounded by num_slice_groups_minus1 are inline.
+    // slice_group_id (one per map unit) stays on the heap.
+    uint8_t pic_parameter_set_id = 0;
+    uint8_t seq_parameter_set_id = 0;
+    uint8_t entropy_coding_mode_flag = 0;
+    uint8_t bottom_field_pic_order_in_frame_present_flag = 0;
+    uint8_t num_slice_groups_minus1 = 0;
+    uint8_t slice_group_map_type = 0;
+    InlineVector<uint32_t, kNumSliceGroupsMinus1Max + 1> run_length_minus1;
+    InlineVector<uint32_t, kNumSliceGroupsMinus1Max> top_left;
+    InlineVector<uint32_t, kNumSliceGroupsMinus1Max> bottom_right;
+    uint8_t slice_group_change_direction_flag = 0;
     uint32_t slice_group_change_rate_minus1 = 0;
     uint32_t pic_size_in_map_units_minus1 = 0;
     std::vector<uint32_t> slice_group_id;
-    uint32_t num_ref_idx_l0_default_active_minus1 = 0;
-    uint32_t num_ref_idx_l1_default_active_minus1 = 0;
-    uint32_t weighted_pred_flag = 0;
-    uint32_t weighted_bipred_idc = 0;
+    uint8_t num_ref_idx_l0_default_active_minus1 = 0;
+    uint8_t num_ref_idx_l1_default_active_minus1 = 0;
+    uint8_t weighted_pred_flag = 0;
+    uint8_t weighted_bipred_idc = 0;
     int32_t pic_init_qp_minus26 = 0;
     int32_t pic_init_qs_minus26 = 0;
     int32_t chroma_qp_index_offset = 0;
-    uint32_t deblocking_filter_control_present_flag = 0;
-    uint32_t constrained_intra_pred_flag = 0;
-    uint32_t redundant_pic_cnt_present_flag = 0;
-    uint32_t transform_8x8_mode_flag = 0;
-    uint32_t pic_scaling_matrix_present_flag = 0;
-    std::vector<uint32_t> pic_scaling_list_present_flag;
+    uint8_t deblocking_filter_control_present_flag = 0;
+    uint8_t constrained_intra_pred_flag = 0;
+    uint8_t redundant_pic_cnt_present_flag = 0;
+    uint8_t transform_8x8_mode_flag = 0;
+    uint8_t pic_scaling_matrix_present_flag = 0;
+    InlineVector<uint32_t, kMaxScalingListCount> pic_scaling_list_present_flag;
     // scaling_list()
-    std::vector<uint32_t> ScalingList4x4;
-    std::vector<uint32_t> UseDefaultScalingMatrix4x4Flag;
-    std::vector<uint32_t> ScalingList8x8;
-    std::vector<uint32_t> UseDefaultScalingMatrix8x8Flag;
+    InlineVector<uint32_t, 16> ScalingList4x4;
+    InlineVector<uint32_t, 6> UseDefaultScalingMatrix4x4Flag;
+    InlineVector<uint32_t, 64> ScalingList8x8;
+    InlineVector<uint32_t, 6> UseDefaultScalingMatrix8x8Flag;
     int32_t delta_scale = 0;
     int32_t second_chroma_qp_index_offset = 0;
 
@@ -103,10 +110,11 @@ class H264PpsParser {
     uint32_t getSliceGroupIdLen() noexcept;
 
     // helper functions
+    template <size_t N>
     bool scaling_list(
-        BitBuffer* bit_buffer, uint32_t i, std::vector<uint32_t>& scalingList,
-        uint32_t sizeOfScalingList,
-        std::vector<uint32_t>& useDefaultScalingMatrixFlag) noexcept;
+        BitBuffer* bit_buffer, uint32_t i,
+        InlineVector<uint32_t, N>& scalingList, uint32_t sizeOfScalingList,
+        InlineVector<uint32_t, 6>& useDefaultScalingMatrixFlag) noexcept;
   };
 
   // Unpack RBSP and parse PPS state from the supplied buffer.
@@ -6,9 +6,11 @@
 
 #include <stdio.h>
 
+#include <array>
 #include <memory>
-#include <vector>
 
+#include "h264_arena.h"
+#include "h264_inline_vector.h"
 #include "rtc_common.h"
 
 namespace h264nal {
@@ -26,9 +28,13 @@ class H264PredWeightTableParser {
   // range of 0 to 7, inclusive."
   const static uint32_t kChromaLog2WeightDenomMin = 0;
   const static uint32_t kChromaLog2WeightDenomMax = 7;
+  // Section 7.4.3: "the range of num_ref_idx_l0_active_minus1 is specified
+  // as follows [...] the range of 0 to 31, inclusive" (same for l1).
+  const static uint32_t kNumRefIdxActiveMinus1Max = 31;
+  const static uint32_t kMaxNumRefIdxActive = kNumRefIdxActiveMinus1Max + 1;
 
   // The parsed state of the PredWeightTable.
-  struct PredWeightTableState {
+  struct PredWeightTableState : public H264ArenaNode {
     PredWeightTableState() = default;
     ~PredWeightTableState() = default;
     // disable copy ctor, move ctor, and copy&move assignments
@@ -48,20 +54,23 @@ class H264PredWeightTableParser {
     uint32_t num_ref_idx_l1_active_minus1 = 0;
 
     // contents
+    // The lists are inline, sized by the largest reference list, so
+    // parsing a table needs no heap allocation. As before, the weight and
+    // offset lists only hold the entries whose flag is set.
     uint32_t luma_log2_weight_denom = 0;
     uint32_t chroma_log2_weight_denom = 0;
-    std::vector<uint32_t> luma_weight_l0_flag;
-    std::vector<int32_t> luma_weight_l0;
-    std::vector<int32_t> luma_offset_l0;
-    std::vector<uint32_t> chroma_weight_l0_flag;
-    std::vector<std::vector<int32_t>> chroma_weight_l0;
-    std::vector<std::vector<int32_t>> chroma_offset_l0;
-    std::vector<uint32_t> luma_weight_l1_flag;
-    std::vector<int32_t> luma_weight_l1;
-    std::vector<int32_t> luma_offset_l1;
-    std::vector<uint32_t> chroma_weight_l1_flag;
-    std::vector<std::vector<int32_t>> chroma_weight_l1;
-    std::vector<std::vector<int32_t>> chroma_offset_l1;
+    InlineVector<uint8_t, kMaxNumRefIdxActive> luma_weight_l0_flag;
+    InlineVector<int32_t, kMaxNumRefIdxActive> luma_weight_l0;
+    InlineVector<int32_t, kMaxNumRefIdxActive> luma_offset_l0;
+    InlineVector<uint8_t, kMaxNumRefIdxActive> chroma_weight_l0_flag;
+    InlineVector<std::array<int32_t, 2>, kMaxNumRefIdxActive> chroma_weight_l0;
+    InlineVector<std::array<int32_t, 2>, kMaxNumRefIdxActive> chroma_offset_l0;
+    InlineVector<uint8_t, kMaxNumRefIdxActive> luma_weight_l1_flag;
+    InlineVector<int32_t, kMaxNumRefIdxActive> luma_weight_l1;
+    InlineVector<int32_t, kMaxNumRefIdxActive> luma_offset_l1;
+    InlineVector<uint8_t, kMaxNumRefIdxActive> chroma_weight_l1_flag;
+    InlineVector<std::array<int32_t, 2>, kMaxNumRefIdxActive> chroma_weight_l1;
+    InlineVector<std::array<int32_t, 2>, kMaxNumRefIdxActive> chroma_offset_l1;
   };
 
   // Unpack RBSP and parse PredWeightTable state from the supplied buffer.
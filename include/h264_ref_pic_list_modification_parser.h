@@ -9,6 +9,7 @@
 #include <memory>
 #include <vector>
 
+#include "h264_arena.h"
 #include "rtc_common.h"
 
 namespace h264nal {
@@ -19,7 +20,7 @@ namespace h264nal {
 class H264RefPicListModificationParser {
  public:
   // The parsed state of the RefPicListModification.
-  struct RefPicListModificationState {
+  struct RefPicListModificationState : public H264ArenaNode {
     RefPicListModificationState() = default;
     ~RefPicListModificationState() = default;
     // disable copy ctor, move ctor, and copy&move assignments
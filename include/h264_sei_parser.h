@@ -0,0 +1,317 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "h264_arena.h"
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "h264_inline_vector.h"
+#include "h264_sps_parser.h"
+#include "rtc_common.h"
+
+namespace h264nal {
+
+// The SEI payload types we decode (Section D.1.1, Table D-1 lists the
+// rest).
+enum SeiPayloadType : uint8_t {
+  SEI_BUFFERING_PERIOD = 0,
+  SEI_PIC_TIMING = 1,
+  SEI_USER_DATA_REGISTERED_ITU_T_T35 = 4,
+  SEI_USER_DATA_UNREGISTERED = 5,
+  SEI_RECOVERY_POINT = 6,
+};
+
+// buffering_period()
+class H264BufferingPeriodParser {
+ public:
+  // Section E.2.2: "The value of cpb_cnt_minus1 shall be in the range of
+  // 0 to 31, inclusive."
+  const static uint32_t kMaxCpbCnt = 32;
+
+  struct BufferingPeriodState : public H264ArenaNode {
+    BufferingPeriodState() = default;
+    ~BufferingPeriodState() = default;
+    // disable copy ctor, move ctor, and copy&move assignments
+    BufferingPeriodState(const BufferingPeriodState&) = delete;
+    BufferingPeriodState(BufferingPeriodState&&) = delete;
+    BufferingPeriodState& operator=(const BufferingPeriodState&) = delete;
+    BufferingPeriodState& operator=(BufferingPeriodState&&) = delete;
+
+#ifdef FDUMP_DEFINE
+    void fdump(FILE* outfp, int indent_level) const;
+#endif  // FDUMP_DEFINE
+
+    // input parameters
+    uint8_t nal_hrd_parameters_present_flag = 0;
+    uint8_t vcl_hrd_parameters_present_flag = 0;
+
+    // contents
+    uint8_t seq_parameter_set_id = 0;
+    InlineVector<uint32_t, kMaxCpbCnt> nal_initial_cpb_removal_delay;
+    InlineVector<uint32_t, kMaxCpbCnt> nal_initial_cpb_removal_delay_offset;
+    InlineVector<uint32_t, kMaxCpbCnt> vcl_initial_cpb_removal_delay;
+    InlineVector<uint32_t, kMaxCpbCnt> vcl_initial_cpb_removal_delay_offset;
+  };
+
+  // Parse buffering_period() state from the supplied buffer. The SPS it
+  // refers to must be in |bitstream_parser_state|.
+  static std::unique_ptr<BufferingPeriodState> ParseBufferingPeriod(
+      BitBuffer* bit_buffer,
+      const struct H264BitstreamParserState* bitstream_parser_state) noexcept;
+};
+
+// pic_timing()
+class H264PicTimingParser {
+ public:
+  // Section D.2.2: "pic_struct [...] Table D-1", values 0 to 8.
+  const static uint32_t kPicStructMax = 8;
+  // Table D-1: NumClockTS is at most 3.
+  const static uint32_t kMaxNumClockTs = 3;
+
+  // clock_timestamp_flag[i] and the clock timestamp it guards.
+  struct ClockTimestamp {
+    uint8_t clock_timestamp_flag = 0;
+    uint8_t ct_type = 0;
+    uint8_t nuit_field_based_flag = 0;
+    uint8_t counting_type = 0;
+    uint8_t full_timestamp_flag = 0;
+    uint8_t discontinuity_flag = 0;
+    uint8_t cnt_dropped_flag = 0;
+    uint8_t n_frames = 0;
+    uint8_t seconds_flag = 0;
+    uint8_t seconds_value = 0;
+    uint8_t minutes_flag = 0;
+    uint8_t minutes_value = 0;
+    uint8_t hours_flag = 0;
+    uint8_t hours_value = 0;
+    int32_t time_offset = 0;
+  };
+
+  struct PicTimingState : public H264ArenaNode {
+    PicTimingState() = default;
+    ~PicTimingState() = default;
+    // disable copy ctor, move ctor, and copy&move assignments
+    PicTimingState(const PicTimingState&) = delete;
+    PicTimingState(PicTimingState&&) = delete;
+    PicTimingState& operator=(const PicTimingState&) = delete;
+    PicTimingState& operator=(PicTimingState&&) = delete;
+
+#ifdef FDUMP_DEFINE
+    void fdump(FILE* outfp, int indent_level) const;
+#endif  // FDUMP_DEFINE
+
+    // input parameters
+    uint8_t cpb_dpb_delays_present_flag = 0;
+    uint8_t pic_struct_present_flag = 0;
+
+    // contents
+    uint32_t cpb_removal_delay = 0;
+    uint32_t dpb_output_delay = 0;
+    uint8_t pic_struct = 0;
+    InlineVector<ClockTimestamp, kMaxNumClockTs> clock_timestamps;
+
+    // derived values
+    // NumClockTS (Table D-1), 0 for a reserved pic_struct.
+    static uint32_t getNumClockTs(uint32_t pic_struct) noexcept;
+  };
+
+  // Parse pic_timing() state from the supplied buffer, using the VUI of
+  // |sps| (the active SPS).
+  static std::unique_ptr<PicTimingState> ParsePicTiming(
+      BitBuffer* bit_buffer,
+      const struct H264SpsParser::SpsState* sps) noexcept;
+};
+
+// user_data_registered_itu_t_t35()
+class H264UserDataRegisteredItuTT35Parser {
+ public:
+  struct UserDataRegisteredItuTT35State : public H264ArenaNode {
+    UserDataRegisteredItuTT35State() = default;
+    ~UserDataRegisteredItuTT35State() = default;
+    // disable copy ctor, move ctor, and copy&move assignments
+    UserDataRegisteredItuTT35State(const UserDataRegisteredItuTT35State&) =
+        delete;
+    UserDataRegisteredItuTT35State(UserDataRegisteredItuTT35State&&) = delete;
+    UserDataRegisteredItuTT35State& operator=(
+        const UserDataRegisteredItuTT35State&) = delete;
+    UserDataRegisteredItuTT35State& operator=(
+        UserDataRegisteredItuTT35State&&) = delete;
+
+#ifdef FDUMP_DEFINE
+    void fdump(FILE* outfp, int indent_level) const;
+#endif  // FDUMP_DEFINE
+
+    // contents
+    uint8_t itu_t_t35_country_code = 0;
+    uint8_t itu_t_t35_country_code_extension_byte = 0;
+    // The itu_t_t35_payload_byte values are not copied: they are the
+    // |payload_length| RBSP bytes at |payload_offset| (see
+    // SeiMessageState::payload_offset). In an escaped buffer, they span
+    // the |escaped_payload_length| bytes at |escaped_payload_offset|
+    // instead, emulation prevention bytes included.
+    size_t payload_offset = 0;
+    size_t payload_length = 0;
+    size_t escaped_payload_offset = 0;
+    size_t escaped_payload_length = 0;
+  };
+
+  // Parse user_data_registered_itu_t_t35() state from the supplied
+  // buffer, |payload_size| bytes long.
+  static std::unique_ptr<UserDataRegisteredItuTT35State>
+  ParseUserDataRegisteredItuTT35(BitBuffer* bit_buffer,
+                                 uint32_t payload_size) noexcept;
+};
+
+// user_data_unregistered()
+class H264UserDataUnregisteredParser {
+ public:
+  struct UserDataUnregisteredState : public H264ArenaNode {
+    UserDataUnregisteredState() = default;
+    ~UserDataUnregisteredState() = default;
+    // disable copy ctor, move ctor, and copy&move assignments
+    UserDataUnregisteredState(const UserDataUnregisteredState&) = delete;
+    UserDataUnregisteredState(UserDataUnregisteredState&&) = delete;
+    UserDataUnregisteredState& operator=(const UserDataUnregisteredState&) =
+        delete;
+    UserDataUnregisteredState& operator=(UserDataUnregisteredState&&) =
+        delete;
+
+#ifdef FDUMP_DEFINE
+    void fdump(FILE* outfp, int indent_level) const;
+#endif  // FDUMP_DEFINE
+
+    // contents
+    std::array<uint8_t, 16> uuid_iso_iec_11578 = {};
+    // The user_data_payload_byte values are not copied: they are the
+    // |payload_length| RBSP bytes at |payload_offset| (see
+    // SeiMessageState::payload_offset). In an escaped buffer, they span
+    // the |escaped_payload_length| bytes at |escaped_payload_offset|
+    // instead, emulation prevention bytes included.
+    size_t payload_offset = 0;
+    size_t payload_length = 0;
+    size_t escaped_payload_offset = 0;
+    size_t escaped_payload_length = 0;
+  };
+
+  // Parse user_data_unregistered() state from the supplied buffer,
+  // |payload_size| bytes long.
+  static std::unique_ptr<UserDataUnregisteredState> ParseUserDataUnregistered(
+      BitBuffer* bit_buffer, uint32_t payload_size) noexcept;
+};
+
+// recovery_point()
+class H264RecoveryPointParser {
+ public:
+  struct RecoveryPointState : public H264ArenaNode {
+    RecoveryPointState() = default;
+    ~RecoveryPointState() = default;
+    // disable copy ctor, move ctor, and copy&move assignments
+    RecoveryPointState(const RecoveryPointState&) = delete;
+    RecoveryPointState(RecoveryPointState&&) = delete;
+    RecoveryPointState& operator=(const RecoveryPointState&) = delete;
+    RecoveryPointState& operator=(RecoveryPointState&&) = delete;
+
+#ifdef FDUMP_DEFINE
+    void fdump(FILE* outfp, int indent_level) const;
+#endif  // FDUMP_DEFINE
+
+    // contents
+    uint32_t recovery_frame_cnt = 0;
+    uint8_t exact_match_flag = 0;
+    uint8_t broken_link_flag = 0;
+    uint8_t changing_slice_group_idc = 0;
+  };
+
+  // Parse recovery_point() state from the supplied buffer.
+  static std::unique_ptr<RecoveryPointState> ParseRecoveryPoint(
+      BitBuffer* bit_buffer) noexcept;
+};
+
+// sei_rbsp()
+class H264SeiParser {
+ public:
+  // sei_message()
+  struct SeiMessageState : public H264ArenaNode {
+    SeiMessageState() = default;
+    ~SeiMessageState() = default;
+    // disable copy ctor, move ctor, and copy&move assignments
+    SeiMessageState(const SeiMessageState&) = delete;
+    SeiMessageState(SeiMessageState&&) = delete;
+    SeiMessageState& operator=(const SeiMessageState&) = delete;
+    SeiMessageState& operator=(SeiMessageState&&) = delete;
+
+#ifdef FDUMP_DEFINE
+    void fdump(FILE* outfp, int indent_level) const;
+#endif  // FDUMP_DEFINE
+
+    // contents
+    uint32_t payload_type = 0;
+    uint32_t payload_size = 0;
+    // The sei_payload() is the |payload_size| RBSP bytes at
+    // |payload_offset| in the parsed buffer (for a NAL unit, counting from
+    // its nal_unit_header()). These are offsets into the unescaped RBSP:
+    // the sei_payload() as it sits in the bytes that were passed in (for
+    // a NAL unit from a byte stream, still escaped) is the
+    // |escaped_payload_size| bytes at |escaped_payload_offset|, emulation
+    // prevention bytes included. Both pairs match for an unescaped buffer.
+    size_t payload_offset = 0;
+    size_t escaped_payload_offset = 0;
+    size_t escaped_payload_size = 0;
+    // The decoded payload: at most one is set, and only for the payload
+    // types ParsingOptions::GetSeiParse() selects.
+    std::unique_ptr<struct H264BufferingPeriodParser::BufferingPeriodState>
+        buffering_period;
+    std::unique_ptr<struct H264PicTimingParser::PicTimingState> pic_timing;
+    std::unique_ptr<struct H264UserDataRegisteredItuTT35Parser::
+                        UserDataRegisteredItuTT35State>
+        user_data_registered_itu_t_t35;
+    std::unique_ptr<
+        struct H264UserDataUnregisteredParser::UserDataUnregisteredState>
+        user_data_unregistered;
+    std::unique_ptr<struct H264RecoveryPointParser::RecoveryPointState>
+        recovery_point;
+  };
+
+  // The parsed state of the SEI RBSP.
+  struct SeiState : public H264ArenaNode {
+    SeiState() = default;
+    ~SeiState() = default;
+    // disable copy ctor, move ctor, and copy&move assignments
+    SeiState(const SeiState&) = delete;
+    SeiState(SeiState&&) = delete;
+    SeiState& operator=(const SeiState&) = delete;
+    SeiState& operator=(SeiState&&) = delete;
+
+#ifdef FDUMP_DEFINE
+    void fdump(FILE* outfp, int indent_level) const;
+#endif  // FDUMP_DEFINE
+
+    std::vector<std::unique_ptr<SeiMessageState>> sei_message;
+  };
+
+  // Parse sei_rbsp() state from the supplied buffer. Every sei_message()
+  // is located (its payloadType, payloadSize, and payload offset), but
+  // only the payloads |parsing_options| asks for are decoded: the others
+  // are skipped without being read. A pic_timing() is decoded against the
+  // SPS of the buffering_period() before it in the same NAL unit, if any,
+  // or else the active SPS of |bitstream_parser_state|, or else its only
+  // SPS. With none of these, it is located but not decoded.
+  static std::unique_ptr<SeiState> ParseSei(
+      const uint8_t* data, size_t length,
+      const struct H264BitstreamParserState* bitstream_parser_state,
+      ParsingOptions parsing_options) noexcept;
+  static std::unique_ptr<SeiState> ParseSei(
+      BitBuffer* bit_buffer,
+      const struct H264BitstreamParserState* bitstream_parser_state,
+      ParsingOptions parsing_options) noexcept;
+};
+
+}  // namespace h264nal
@@ -9,8 +9,10 @@
 #include <memory>
 #include <vector>
 
+#include "h264_arena.h"
 #include "h264_bitstream_parser_state.h"
 #include "h264_dec_ref_pic_marking_parser.h"
+#include "h264_inline_vector.h"
 #include "h264_pred_weight_table_parser.h"
 #include "h264_ref_pic_list_modification_parser.h"
 #include "rtc_common.h"
@@ -55,7 +57,7 @@ class H264SliceHeaderParser {
 
   // The parsed state of the slice. Only some select values are stored.
   // Add more as they are actually needed.
-  struct SliceHeaderState {
+  struct SliceHeaderState : public H264ArenaNode {
     SliceHeaderState() = default;
     ~SliceHeaderState() = default;
     // disable copy ctor, move ctor, and copy&move assignments
@@ -68,43 +70,47 @@ class H264SliceHeaderParser {
     void fdump(FILE* outfp, int indent_level) const;
 #endif  // FDUMP_DEFINE
 
+    // The fields are as narrow as their ranges allow (Sections 7.4.2 and
+    // 7.4.3), and the lists are inline, so a parsed slice header takes 2
+    // cache lines, plus its (optional) sub-structures.
+
     // input parameters
-    uint32_t nal_ref_idc = 0;
-    uint32_t nal_unit_type = 0;
-    uint32_t separate_colour_plane_flag = 0;
-    uint32_t log2_max_frame_num_minus4 = 0;
-    uint32_t frame_mbs_only_flag = 0;
-    uint32_t pic_order_cnt_type = 0;
-    uint32_t bottom_field_pic_order_in_frame_present_flag = 0;
-    uint32_t delta_pic_order_always_zero_flag = 0;
-    uint32_t redundant_pic_cnt_present_flag = 0;
-    uint32_t weighted_pred_flag = 0;
-    uint32_t weighted_bipred_idc = 0;
-    uint32_t entropy_coding_mode_flag = 0;
-    uint32_t deblocking_filter_control_present_flag = 0;
-    uint32_t num_slice_groups_minus1 = 0;
-    uint32_t slice_group_map_type = 0;
-    uint32_t pic_width_in_mbs_minus1 = 0;
-    uint32_t pic_height_in_map_units_minus1 = 0;
+    uint8_t nal_ref_idc = 0;
+    uint8_t nal_unit_type = 0;
+    uint8_t separate_colour_plane_flag = 0;
+    uint8_t log2_max_frame_num_minus4 = 0;
+    uint8_t frame_mbs_only_flag = 0;
+    uint8_t pic_order_cnt_type = 0;
+    uint8_t bottom_field_pic_order_in_frame_present_flag = 0;
+    uint8_t delta_pic_order_always_zero_flag = 0;
+    uint8_t redundant_pic_cnt_present_flag = 0;
+    uint8_t weighted_pred_flag = 0;
+    uint8_t weighted_bipred_idc = 0;
+    uint8_t entropy_coding_mode_flag = 0;
+    uint8_t deblocking_filter_control_present_flag = 0;
+    uint8_t num_slice_groups_minus1 = 0;
+    uint8_t slice_group_map_type = 0;
+    uint16_t pic_width_in_mbs_minus1 = 0;
+    uint16_t pic_height_in_map_units_minus1 = 0;
     uint32_t slice_group_change_rate_minus1 = 0;
 
     // contents
     uint32_t first_mb_in_slice = 0;
-    uint32_t slice_type = 0;
-    uint32_t pic_parameter_set_id = 0;
-    uint32_t colour_plane_id = 0;
-    uint32_t frame_num = 0;
-    uint32_t field_pic_flag = 0;
-    uint32_t bottom_field_flag = 0;
-    uint32_t idr_pic_id = 0;
-    uint32_t pic_order_cnt_lsb = 0;
+    uint8_t slice_type = 0;
+    uint8_t pic_parameter_set_id = 0;
+    uint8_t colour_plane_id = 0;
+    uint16_t frame_num = 0;
+    uint8_t field_pic_flag = 0;
+    uint8_t bottom_field_flag = 0;
+    uint16_t idr_pic_id = 0;
+    uint16_t pic_order_cnt_lsb = 0;
     int32_t delta_pic_order_cnt_bottom = 0;
-    std::vector<int32_t> delta_pic_order_cnt;
-    uint32_t redundant_pic_cnt = 0;
-    uint32_t direct_spatial_mv_pred_flag = 0;
-    uint32_t num_ref_idx_active_override_flag = 0;
-    uint32_t num_ref_idx_l0_active_minus1 = 0;
-    uint32_t num_ref_idx_l1_active_minus1 = 0;
+    InlineVector<int32_t, 2> delta_pic_order_cnt;
+    uint8_t redundant_pic_cnt = 0;
+    uint8_t direct_spatial_mv_pred_flag = 0;
+    uint8_t num_ref_idx_active_override_flag = 0;
+    uint8_t num_ref_idx_l0_active_minus1 = 0;
+    uint8_t num_ref_idx_l1_active_minus1 = 0;
     std::unique_ptr<
         struct H264RefPicListModificationParser::RefPicListModificationState>
         ref_pic_list_modification;
@@ -112,13 +118,13 @@ class H264SliceHeaderParser {
         pred_weight_table;
     std::unique_ptr<struct H264DecRefPicMarkingParser::DecRefPicMarkingState>
         dec_ref_pic_marking;
-    uint32_t cabac_init_idc = 0;
-    uint32_t sp_for_switch_flag = 0;
-    int32_t slice_qp_delta = 0;
-    int32_t slice_qs_delta = 0;
-    uint32_t disable_deblocking_filter_idc = 0;
-    int32_t slice_alpha_c0_offset_div2 = 0;
-    int32_t slice_beta_offset_div2 = 0;
+    uint8_t cabac_init_idc = 0;
+    uint8_t sp_for_switch_flag = 0;
+    int8_t slice_qp_delta = 0;
+    int8_t slice_qs_delta = 0;
+    uint8_t disable_deblocking_filter_idc = 0;
+    int8_t slice_alpha_c0_offset_div2 = 0;
+    int8_t slice_beta_offset_div2 = 0;
     uint32_t slice_group_change_cycle = 0;
 
     // derived values
@@ -147,6 +153,13 @@ class H264SliceHeaderParser {
   static std::unique_ptr<SliceHeaderState> ParseSliceHeader(
       BitBuffer* bit_buffer, uint32_t nal_ref_idc, uint32_t nal_unit_type,
       struct H264BitstreamParserState* bitstream_parser_state) noexcept;
+  // Stops after |last_field|. The fields after it keep their default
+  // values, and the sub-structures after it (ref_pic_list_modification,
+  // pred_weight_table, dec_ref_pic_marking) stay null.
+  static std::unique_ptr<SliceHeaderState> ParseSliceHeader(
+      BitBuffer* bit_buffer, uint32_t nal_ref_idc, uint32_t nal_unit_type,
+      SliceHeaderField last_field,
+      struct H264BitstreamParserState* bitstream_parser_state) noexcept;
 };
 
 }  // namespace h264nal
@@ -9,6 +9,7 @@
 #include <memory>
 #include <vector>
 
+#include "h264_arena.h"
 #include "h264_bitstream_parser_state.h"
 #include "h264_slice_header_parser.h"
 #include "rtc_common.h"
@@ -21,7 +22,7 @@ class H264SliceLayerWithoutPartitioningRbspParser {
  public:
   // The parsed state of the slice. Only some select values are stored.
   // Add more as they are actually needed.
-  struct SliceLayerWithoutPartitioningRbspState {
+  struct SliceLayerWithoutPartitioningRbspState : public H264ArenaNode {
     SliceLayerWithoutPartitioningRbspState() = default;
     ~SliceLayerWithoutPartitioningRbspState() = default;
     // disable copy ctor, move ctor, and copy&move assignments
@@ -60,6 +61,12 @@ class H264SliceLayerWithoutPartitioningRbspParser {
   ParseSliceLayerWithoutPartitioningRbsp(
       BitBuffer* bit_buffer, uint32_t nal_ref_idc, uint32_t nal_unit_type,
       struct H264BitstreamParserState* bitstream_parser_state) noexcept;
+  // Stops the slice header after |slice_header_last_field|.
+  static std::unique_ptr<SliceLayerWithoutPartitioningRbspState>
+  ParseSliceLayerWithoutPartitioningRbsp(
+      BitBuffer* bit_buffer, uint32_t nal_ref_idc, uint32_t nal_unit_type,
+      SliceHeaderField slice_header_last_field,
+      struct H264BitstreamParserState* bitstream_parser_state) noexcept;
 };
 
 }  // namespace h264nal
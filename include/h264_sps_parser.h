@@ -10,6 +10,7 @@
 #include <vector>
 
 #include "h264_common.h"
+#include "h264_inline_vector.h"
 #include "h264_vui_parameters_parser.h"
 #include "rtc_common.h"
 
@@ -57,6 +58,9 @@ class H264SpsDataParser {
   // shall be in the range of 0 to 255, inclusive."
   const static uint32_t kNumRefFramesInPicOrderCntCycleMin = 0;
   const static uint32_t kNumRefFramesInPicOrderCntCycleMax = 255;
+  // Section 7.3.2.1.1: up to 12 scaling lists (8 unless chroma_format_idc
+  // is 3)
+  const static uint32_t kMaxScalingListCount = 12;
 
   // The parsed state of an seq_parameter_set_data() RBSP. Only some select
   // values are stored.
@@ -75,55 +79,82 @@ class H264SpsDataParser {
                ParsingOptions parsing_options) const;
 #endif  // FDUMP_DEFINE
 
-    uint32_t profile_idc = 0;
-    uint32_t constraint_set0_flag = 0;
-    uint32_t constraint_set1_flag = 0;
-    uint32_t constraint_set2_flag = 0;
-    uint32_t constraint_set3_flag = 0;
-    uint32_t constraint_set4_flag = 0;
-    uint32_t constraint_set5_flag = 0;
-    uint32_t reserved_zero_2bits = 0;
-    uint32_t level_idc = 0;
-    uint32_t seq_parameter_set_id = 0;
-    uint32_t chroma_format_idc = 1;  // Default per H.264 spec 7.4.2.1.1
-    uint32_t separate_colour_plane_flag = 0;
-    uint32_t bit_depth_luma_minus8 = 0;
-    uint32_t bit_depth_chroma_minus8 = 0;
-    uint32_t qpprime_y_zero_transform_bypass_flag = 0;
-    uint32_t seq_scaling_matrix_present_flag = 0;
-    std::vector<uint32_t> seq_scaling_list_present_flag;
+    // The fields are as narrow as their ranges allow (Section 7.4.2.1.1),
+    // and the bounded lists are inline. offset_for_ref_frame (up to 255
+    // values) stays on the heap: it is empty unless pic_order_cnt_type is 1.
+    uint8_t profile_idc = 0;
+    uint8_t constraint_set0_flag = 0;
+    uint8_t constraint_set1_flag = 0;
+    uint8_t constraint_set2_flag = 0;
+    uint8_t constraint_set3_flag = 0;
+    uint8_t constraint_set4_flag = 0;
+    uint8_t constraint_set5_flag = 0;
+    uint8_t reserved_zero_2bits = 0;
+    uint8_t level_idc = 0;
+    uint8_t seq_parameter_set_id = 0;
+    uint8_t chroma_format_idc = 1;  // Default per H.264 spec 7.4.2.1.1
+    uint8_t separate_colour_plane_flag = 0;
+    uint8_t bit_depth_luma_minus8 = 0;
+    uint8_t bit_depth_chroma_minus8 = 0;
+    uint8_t qpprime_y_zero_transform_bypass_flag = 0;
+    uint8_t seq_scaling_matrix_present_flag = 0;
+    InlineVector<uint32_t, kMaxScalingListCount>
+        seq_scaling_list_present_flag;
     // scaling_list()
-    std::vector<uint32_t> ScalingList4x4;
-    std::vector<uint32_t> UseDefaultScalingMatrix4x4Flag;
-    std::vector<uint32_t> ScalingList8x8;
-    std::vector<uint32_t> UseDefaultScalingMatrix8x8Flag;
+    InlineVector<uint32_t, 16> ScalingList4x4;
+    InlineVector<uint32_t, 6> UseDefaultScalingMatrix4x4Flag;
+    InlineVector<uint32_t, 64> ScalingList8x8;
+    InlineVector<uint32_t, 6> UseDefaultScalingMatrix8x8Flag;
     int32_t delta_scale = 0;
-    uint32_t log2_max_frame_num_minus4 = 0;
-    uint32_t pic_order_cnt_type = 0;
-    uint32_t log2_max_pic_order_cnt_lsb_minus4 = 0;
-    uint32_t delta_pic_order_always_zero_flag = 0;
+    uint8_t log2_max_frame_num_minus4 = 0;
+    uint8_t pic_order_cnt_type = 0;
+    uint8_t log2_max_pic_order_cnt_lsb_minus4 = 0;
+    uint8_t delta_pic_order_always_zero_flag = 0;
     int32_t offset_for_non_ref_pic = 0;
     int32_t offset_for_top_to_bottom_field = 0;
-    uint32_t num_ref_frames_in_pic_order_cnt_cycle = 0;
+    uint8_t num_ref_frames_in_pic_order_cnt_cycle = 0;
     std::vector<int32_t> offset_for_ref_frame;
-    uint32_t max_num_ref_frames = 0;
-    uint32_t gaps_in_frame_num_value_allowed_flag = 0;
-    uint32_t pic_width_in_mbs_minus1 = 0;
-    uint32_t pic_height_in_map_units_minus1 = 0;
-    uint32_t frame_mbs_only_flag = 0;
-    uint32_t mb_adaptive_frame_field_flag = 0;
-    uint32_t direct_8x8_inference_flag = 0;
-    uint32_t frame_cropping_flag = 0;
+    uint8_t max_num_ref_frames = 0;
+    uint8_t gaps_in_frame_num_value_allowed_flag = 0;
+    uint16_t pic_width_in_mbs_minus1 = 0;
+    uint16_t pic_height_in_map_units_minus1 = 0;
+    uint8_t frame_mbs_only_flag = 0;
+    uint8_t mb_adaptive_frame_field_flag = 0;
+    uint8_t direct_8x8_inference_flag = 0;
+    uint8_t frame_cropping_flag = 0;
     uint32_t frame_crop_left_offset = 0;
     uint32_t frame_crop_right_offset = 0;
     uint32_t frame_crop_top_offset = 0;
     uint32_t frame_crop_bottom_offset = 0;
-    uint32_t vui_parameters_present_flag = 0;
+    uint8_t vui_parameters_present_flag = 0;
     std::unique_ptr<struct H264VuiParametersParser::VuiParametersState>
         vui_parameters;
 
     // derived values
     ProfileType profile_type;
+    // Values derived from the fields above, which the slice parsers need
+    // for every slice. ParseSpsData() fills them in once, and they are not
+    // updated afterwards.
+    struct DerivedValues {
+      // false until computed
+      bool valid = false;
+      uint32_t ChromaArrayType = 0;
+      // frame_num and pic_order_cnt_lsb lengths, in bits (Section 7.4.3)
+      uint32_t frame_num_len = 0;
+      uint32_t pic_order_cnt_lsb_len = 0;
+      // Equations 7-10 and 7-11
+      uint32_t MaxFrameNum = 0;
+      uint32_t MaxPicOrderCntLsb = 0;
+      // Equations 7-13 to 7-18
+      uint32_t PicWidthInMbs = 0;
+      uint32_t PicHeightInMapUnits = 0;
+      uint32_t PicSizeInMapUnits = 0;
+      uint32_t FrameHeightInMbs = 0;
+      // the cropped resolution, as returned by getResolution()
+      int width = -1;
+      int height = -1;
+    };
+    DerivedValues derived;
     ProfileType GetProfileType() const noexcept;
     uint32_t getChromaArrayType() const noexcept;
     int getSubWidthC() const noexcept;
@@ -133,12 +164,19 @@ class H264SpsDataParser {
     int getCropUnitX() const noexcept;
     int getCropUnitY() const noexcept;
     int getResolution(int* width, int* height) const noexcept;
+    // Computes the derived values from the fields above.
+    DerivedValues computeDerivedValues() const noexcept;
+    // |derived|, or, for a state that was not built by ParseSpsData() (and
+    // so has no |derived| values), the same values computed into |scratch|.
+    const DerivedValues& getDerivedValues(
+        DerivedValues* scratch) const noexcept;
 
     // helper functions
+    template <size_t N>
     bool scaling_list(
-        BitBuffer* bit_buffer, uint32_t i, std::vector<uint32_t>& scalingList,
-        uint32_t sizeOfScalingList,
-        std::vector<uint32_t>& useDefaultScalingMatrixFlag) noexcept;
+        BitBuffer* bit_buffer, uint32_t i,
+        InlineVector<uint32_t, N>& scalingList, uint32_t sizeOfScalingList,
+        InlineVector<uint32_t, 6>& useDefaultScalingMatrixFlag) noexcept;
   };
 
   // Unpack RBSP and parse SPS data state from the supplied buffer.
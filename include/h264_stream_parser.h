@@ -0,0 +1,86 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+#include <memory>
+#include <vector>
+
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "h264_nal_unit_parser.h"
+
+namespace h264nal {
+
+// A class for parsing an H264 Annex B bitstream pushed in chunks of any
+// size (e.g. read from a pipe, or from a file too large to load whole).
+// It keeps only the trailing NAL unit that has not been terminated by a
+// start code yet, so memory is bounded by the largest NAL unit rather than
+// by the stream. Each NAL unit is parsed (against a persistent
+// H264BitstreamParserState) and handed to the callback as soon as the next
+// start code arrives. The NAL units, and their offsets and lengths, are
+// the ones H264BitstreamParser::ParseBitstream() returns for the whole
+// stream.
+class H264StreamParser {
+ public:
+  // Called once per parsed NAL unit. |offset| and |length| in the NAL unit
+  // are relative to the start of the stream.
+  typedef H264NalUnitParser::NalUnitCallback NalUnitCallback;
+
+  // Keeps its own SPS/PPS/SubsetSPS state.
+  H264StreamParser(ParsingOptions parsing_options,
+                   NalUnitCallback nal_unit_callback);
+  // Uses (and updates) the caller's SPS/PPS/SubsetSPS state.
+  H264StreamParser(H264BitstreamParserState* bitstream_parser_state,
+                   ParsingOptions parsing_options,
+                   NalUnitCallback nal_unit_callback);
+  ~H264StreamParser() = default;
+  // disable copy ctor, move ctor, and copy&move assignments
+  H264StreamParser(const H264StreamParser&) = delete;
+  H264StreamParser(H264StreamParser&&) = delete;
+  H264StreamParser& operator=(const H264StreamParser&) = delete;
+  H264StreamParser& operator=(H264StreamParser&&) = delete;
+
+  // Appends |length| bytes to the stream, and parses every NAL unit they
+  // complete.
+  void Push(const uint8_t* data, size_t length) noexcept;
+  // Ends the stream: parses the trailing NAL unit, if any. A Push() after
+  // this starts a new stream, at offset 0, with the same parser state.
+  void Flush() noexcept;
+
+  // Bytes currently held back (the unterminated NAL unit).
+  size_t GetBufferedLength() const { return buffer_.size(); }
+  H264BitstreamParserState* GetBitstreamParserState() const {
+    return bitstream_parser_state_;
+  }
+
+ private:
+  // Finds the start codes in |buffer_| up to |end|, and parses the NAL
+  // units they terminate.
+  void Scan(size_t end) noexcept;
+  // Parses the pending NAL unit, whose payload ends at |payload_end|
+  // (relative to |buffer_|).
+  void ParsePending(size_t payload_end) noexcept;
+
+  H264BitstreamParserState own_bitstream_parser_state_;
+  H264BitstreamParserState* const bitstream_parser_state_;
+  const ParsingOptions parsing_options_;
+  const NalUnitCallback nal_unit_callback_;
+
+  // The unconsumed tail of the stream, starting at the start code of the
+  // pending NAL unit (or at the last bytes seen, if there is none yet).
+  std::vector<uint8_t> buffer_;
+  // The stream offset of |buffer_[0]|.
+  size_t buffer_offset_;
+  // Where to resume the start code search in |buffer_|.
+  size_t scan_offset_;
+  // The pending NAL unit: whether there is one, and where its payload
+  // starts in |buffer_|.
+  bool pending_;
+  size_t pending_payload_start_;
+};
+
+}  // namespace h264nal
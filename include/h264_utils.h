@@ -18,4 +18,40 @@ class H264Utils {
   static int ReadFile(const char* filename, std::vector<uint8_t>& buffer);
 };
 
+// A read-only view of the contents of an input file, which the bitstream
+// parsers can use directly (data() and size()). Regular files are
+// memory-mapped, and advised for sequential access: parsing starts right
+// away, pages are read in as the parser gets to them, and the file is not
+// copied into (and does not double) the process memory. Inputs that cannot
+// be mapped (stdin, pipes, or platforms without mmap()) are read into
+// memory in large blocks.
+class H264InputFile {
+ public:
+  // Opens |filename| ("-" or nullptr for stdin). Returns nullptr on error.
+  static std::unique_ptr<H264InputFile> Open(const char* filename) noexcept;
+
+  ~H264InputFile();
+  // disable copy ctor, move ctor, and copy&move assignments
+  H264InputFile(const H264InputFile&) = delete;
+  H264InputFile(H264InputFile&&) = delete;
+  H264InputFile& operator=(const H264InputFile&) = delete;
+  H264InputFile& operator=(H264InputFile&&) = delete;
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+  uint8_t operator[](size_t i) const { return data_[i]; }
+  // Whether the contents are memory-mapped (rather than read).
+  bool IsMapped() const { return mapping_ != nullptr; }
+
+ private:
+  H264InputFile();
+
+  const uint8_t* data_;
+  size_t size_;
+  // the mapping, if mapped
+  void* mapping_;
+  // the contents, if read
+  std::vector<uint8_t> buffer_;
+};
+
 }  // namespace h264nal
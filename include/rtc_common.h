@@ -85,6 +85,10 @@ class BitBuffer {
   // data left for the specified bit count.
   bool ReadBits(size_t bit_count, uint32_t& val);
   bool ReadBits(size_t bit_count, uint64_t& val);
+  // For the narrow fields of the parsed state structs. Returns false if
+  // |bit_count| does not fit in |val|.
+  bool ReadBits(size_t bit_count, uint8_t& val);
+  bool ReadBits(size_t bit_count, uint16_t& val);
 
   // Peeks bit-sized values from the buffer. Returns false if there isn't enough
   // data left for the specified number of bits. Doesn't move the current
@@ -116,11 +120,17 @@ class BitBuffer {
   // Returns false if there isn't enough data left for the specified type, or if
   // the value wouldn't fit in a uint32_t.
   bool ReadExponentialGolomb(uint32_t& val);
+  // For the narrow fields of the parsed state structs. Returns false, and
+  // consumes nothing, if the value does not fit in |val|.
+  bool ReadExponentialGolomb(uint8_t& val);
+  bool ReadExponentialGolomb(uint16_t& val);
 
   // Reads signed exponential golomb values at the current offset. Signed
   // exponential golomb values are just the unsigned values mapped to the
   // sequence 0, 1, -1, 2, -2, etc. in order.
   bool ReadSignedExponentialGolomb(int32_t& val);
+  // Returns false, and consumes nothing, if the value does not fit in |val|.
+  bool ReadSignedExponentialGolomb(int8_t& val);
 
   // Moves current position |byte_count| bytes forward. Returns false if
   // there aren't enough bytes left in the buffer.
@@ -133,18 +143,97 @@ class BitBuffer {
   // offset is from the given byte, in the range [0,7].
   bool Seek(size_t byte_offset, size_t bit_offset);
 
+  // The bytes the buffer reads from, as passed to the ctor, and whether
+  // they are escaped (see EscapedBitBuffer). For the code that can work
+  // on the bytes in bulk rather than through the reader.
+  const uint8_t* GetBytes() const { return bytes_; }
+  size_t GetByteCount() const { return byte_count_; }
+  bool IsEscaped() const { return escaped_; }
+  // Maps the RBSP byte at |rbsp_offset| to its offset in the bytes passed
+  // to the ctor (the same offset, unless the buffer is escaped). Returns
+  // false if the buffer ends first.
+  bool GetEscapedOffset(size_t rbsp_offset, size_t* escaped_offset) const;
+
  protected:
+  // With |escaped| set, |bytes| holds an escaped NAL unit, and the reader
+  // drops emulation prevention bytes as it goes (see EscapedBitBuffer).
+  BitBuffer(const uint8_t* bytes, size_t byte_count, bool escaped);
+
+  // A position in an escaped buffer: the RBSP byte at |rbsp_offset| is the
+  // next one read from |bytes_| at |escaped_offset|, after |zero_count|
+  // consecutive RBSP zero bytes.
+  struct EscapedCursor {
+    size_t rbsp_offset;
+    size_t escaped_offset;
+    size_t zero_count;
+  };
+
+  // Returns the bits starting at the current offset, left aligned in a
+  // uint64_t, and sets |bit_count| to the number of them that are valid.
+  // Served from |cache_| while it still covers the current offset, and
+  // refilled from |bytes_| otherwise.
+  uint64_t PeekWindow(size_t* bit_count);
+  // Reloads |cache_| with up to 8 bytes starting at |byte_offset_|. A
+  // refill leaves at least 57 valid bits past the current offset, or every
+  // bit left in the buffer.
+  void RefillCache();
+  // Drops |cache_|, so the next read reloads it. Needed whenever |bytes_|
+  // changes under the reader (see BitBufferWriter).
+  void InvalidateCache() { cache_bit_count_ = 0; }
+  // Moves the current offset |bit_count| bits forward, with no bounds
+  // check. Only for bits a successful peek has already covered.
+  void SkipBits(size_t bit_count);
+  // Whether there are at least |bit_count| bits left. Unlike
+  // RemainingBitCount(), this does not need the size of an escaped buffer,
+  // so it only looks as far ahead as it has to.
+  bool HasBits(uint64_t bit_count) const;
+  // Whether the buffer holds at least |byte_count| bytes.
+  bool HasBytes(size_t byte_count) const;
+  // Walks |cursor| forward to RBSP byte |rbsp_offset|. Returns false, with
+  // |cursor| at the end of |bytes_|, if the buffer ends first.
+  bool AdvanceCursor(EscapedCursor* cursor, size_t rbsp_offset) const;
+
   const uint8_t* const bytes_;
   // The total size of |bytes_|.
   size_t byte_count_;
-  // The current offset, in bytes, from the start of |bytes_|.
+  // The current offset, in bytes, from the start of |bytes_|. In an
+  // escaped buffer, this is counted in RBSP bytes.
   size_t byte_offset_;
   // The current offset, in bits, into the current byte.
   size_t bit_offset_;
+  // Up to 64 bits of |bytes_|, big-endian, starting at |cache_byte_offset_|.
+  // Only the top |cache_bit_count_| bits are valid. Seeking and consuming
+  // only move the offsets above: the cache stays usable for as long as
+  // the current offset falls inside it.
+  uint64_t cache_;
+  size_t cache_byte_offset_;
+  size_t cache_bit_count_;
+  // Escaped buffers only. The RBSP size is only known once something
+  // walks to the end of |bytes_|, so it is filled in lazily. |cursor_|
+  // sits at or before the start of |cache_|, so a refill only walks
+  // forward from it.
+  const bool escaped_;
+  mutable size_t rbsp_byte_count_;
+  mutable bool rbsp_byte_count_known_;
+  EscapedCursor cursor_;
 
   RTC_DISALLOW_COPY_AND_ASSIGN(BitBuffer);
 };
 
+// A BitBuffer that reads a NAL unit as it appears in a byte stream, that is,
+// still escaped. Every emulation_prevention_three_byte (the 0x03 in a
+// 0x000003 sequence, Section 7.4.1 of the H.264 standard) is dropped as the
+// bytes are read. Reads, offsets, and counts are all in RBSP bytes, exactly
+// as on the output of UnescapeRbsp(), but nothing is copied: a parser that
+// stops after the slice header never looks at the rest of the NAL unit.
+class EscapedBitBuffer : public BitBuffer {
+ public:
+  EscapedBitBuffer(const uint8_t* bytes, size_t byte_count);
+
+ private:
+  RTC_DISALLOW_COPY_AND_ASSIGN(EscapedBitBuffer);
+};
+
 // A BitBuffer API for write operations. Supports symmetric write APIs to the
 // reading APIs of BitBuffer. Note that the read/write offset is shared with the
 // BitBuffer API, so both reading and writing will consume bytes/bits.
@@ -0,0 +1,282 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#include "h264_access_unit_assembler.h"
+
+#include <stdio.h>
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "h264_bitstream_parser.h"
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "h264_nal_unit_header_parser.h"
+#include "h264_nal_unit_parser.h"
+#include "h264_nal_unit_payload_parser.h"
+#include "h264_pps_parser.h"
+#include "h264_slice_header_parser.h"
+#include "h264_slice_layer_without_partitioning_rbsp_parser.h"
+#include "h264_sps_parser.h"
+
+namespace {
+// Whether |nal_unit_type| is a VCL NAL unit type of the primary or
+// redundant coded pictures (Table 7-1).
+bool IsVclNalUnitType(uint32_t nal_unit_type) {
+  return nal_unit_type >= h264nal::CODED_SLICE_OF_NON_IDR_PICTURE_NUT &&
+         nal_unit_type <= h264nal::CODED_SLICE_OF_IDR_PICTURE_NUT;
+}
+
+// Whether a NAL unit of type |nal_unit_type| that follows the last VCL NAL
+// unit of a primary coded picture starts a new access unit (Section
+// 7.4.1.2.3).
+bool StartsAccessUnit(uint32_t nal_unit_type) {
+  switch (nal_unit_type) {
+    case h264nal::AUD_NUT:
+    case h264nal::SPS_NUT:
+    case h264nal::PPS_NUT:
+    case h264nal::SEI_NUT:
+    case h264nal::PREFIX_NUT:
+    case h264nal::SUBSET_SPS_NUT:
+    case h264nal::RSV16_NUT:
+    case h264nal::RSV17_NUT:
+    case h264nal::RSV18_NUT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// The slice header of a parsed slice NAL unit of a primary coded picture
+// (nullptr if there is none).
+const struct h264nal::H264SliceHeaderParser::SliceHeaderState*
+FindPrimarySliceHeader(
+    const struct h264nal::H264NalUnitParser::NalUnitState& nal_unit) {
+  if (!IsVclNalUnitType(nal_unit.nal_unit_header->nal_unit_type) ||
+      nal_unit.nal_unit_payload == nullptr ||
+      nal_unit.nal_unit_payload->slice_layer_without_partitioning_rbsp ==
+          nullptr) {
+    return nullptr;
+  }
+  const auto* slice_header =
+      nal_unit.nal_unit_payload->slice_layer_without_partitioning_rbsp
+          ->slice_header.get();
+  if (slice_header == nullptr || slice_header->redundant_pic_cnt != 0) {
+    // redundant coded pictures follow the primary one
+    return nullptr;
+  }
+  return slice_header;
+}
+}  // namespace
+
+namespace h264nal {
+
+const struct H264SliceHeaderParser::SliceHeaderState*
+H264AccessUnitAssembler::AccessUnitState::GetPrimarySliceHeader()
+    const noexcept {
+  for (const auto& nal_unit : nal_units) {
+    const auto* slice_header = FindPrimarySliceHeader(*nal_unit);
+    if (slice_header != nullptr) {
+      return slice_header;
+    }
+  }
+  return nullptr;
+}
+
+H264AccessUnitAssembler::H264AccessUnitAssembler(
+    AccessUnitCallback access_unit_callback)
+    : H264AccessUnitAssembler(access_unit_callback, nullptr) {}
+
+H264AccessUnitAssembler::H264AccessUnitAssembler(
+    AccessUnitCallback access_unit_callback,
+    const struct H264BitstreamParserState* bitstream_parser_state)
+    : access_unit_callback_(access_unit_callback),
+      bitstream_parser_state_(bitstream_parser_state),
+      access_unit_(),
+      last_slice_header_(nullptr),
+      pending_prefix_() {}
+
+void H264AccessUnitAssembler::Push(
+    std::unique_ptr<struct H264NalUnitParser::NalUnitState> nal_unit) noexcept {
+  if (nal_unit == nullptr || nal_unit->nal_unit_header == nullptr) {
+    return;
+  }
+  uint32_t nal_unit_type = nal_unit->nal_unit_header->nal_unit_type;
+  bool has_vcl = (access_unit_ != nullptr && access_unit_->vcl_length > 0);
+  if (nal_unit_type == PREFIX_NUT && has_vcl && pending_prefix_ == nullptr) {
+    // a prefix NAL unit goes with the base layer slice that follows it,
+    // which may belong to the current primary coded picture (Section
+    // 7.4.1.2.3 as extended by Annexes G and H): wait for it
+    pending_prefix_ = std::move(nal_unit);
+    return;
+  }
+
+  // Section 7.4.1.2.3: a new access unit starts at the first of these NAL
+  // units after the last VCL NAL unit of a primary coded picture
+  if (has_vcl) {
+    const struct H264SliceHeaderParser::SliceHeaderState* slice_header =
+        FindPrimarySliceHeader(*nal_unit);
+    bool starts_access_unit = false;
+    if (slice_header != nullptr) {
+      starts_access_unit =
+          (last_slice_header_ != nullptr &&
+           IsFirstSliceOfPrimaryPicture(*last_slice_header_, *slice_header));
+    } else if (!IsVclNalUnitType(nal_unit_type)) {
+      starts_access_unit =
+          (pending_prefix_ != nullptr || StartsAccessUnit(nal_unit_type));
+    }
+    if (starts_access_unit) {
+      Complete();
+    }
+  }
+  if (pending_prefix_ != nullptr) {
+    Append(std::move(pending_prefix_));
+  }
+  Append(std::move(nal_unit));
+}
+
+void H264AccessUnitAssembler::Flush() noexcept {
+  if (pending_prefix_ != nullptr) {
+    // a prefix NAL unit with no slice after it
+    Complete();
+    Append(std::move(pending_prefix_));
+  }
+  Complete();
+}
+
+H264NalUnitParser::NalUnitCallback
+H264AccessUnitAssembler::GetNalUnitCallback() noexcept {
+  return [this](std::unique_ptr<struct H264NalUnitParser::NalUnitState>
+                    nal_unit) { Push(std::move(nal_unit)); };
+}
+
+void H264AccessUnitAssembler::Append(
+    std::unique_ptr<struct H264NalUnitParser::NalUnitState> nal_unit) noexcept {
+  if (access_unit_ == nullptr) {
+    access_unit_ = std::make_unique<AccessUnitState>();
+    access_unit_->offset = nal_unit->offset;
+    access_unit_->length = 0;
+    access_unit_->num_slices = 0;
+    access_unit_->vcl_length = 0;
+  }
+  access_unit_->length =
+      nal_unit->offset + nal_unit->length - access_unit_->offset;
+  if (IsVclNalUnitType(nal_unit->nal_unit_header->nal_unit_type)) {
+    access_unit_->vcl_length += nal_unit->length;
+  }
+  const struct H264SliceHeaderParser::SliceHeaderState* slice_header =
+      FindPrimarySliceHeader(*nal_unit);
+  if (slice_header != nullptr) {
+    if (access_unit_->num_slices == 0 && bitstream_parser_state_ != nullptr) {
+      // the parameter sets in effect now, before those of the next access
+      // unit are parsed
+      access_unit_->pps =
+          bitstream_parser_state_->GetPps(slice_header->pic_parameter_set_id);
+      if (access_unit_->pps != nullptr) {
+        access_unit_->sps = bitstream_parser_state_->GetSps(
+            access_unit_->pps->seq_parameter_set_id);
+      }
+    }
+    access_unit_->num_slices += 1;
+    last_slice_header_ = slice_header;
+  }
+  access_unit_->nal_units.push_back(std::move(nal_unit));
+}
+
+void H264AccessUnitAssembler::Complete() noexcept {
+  last_slice_header_ = nullptr;
+  if (access_unit_ == nullptr) {
+    return;
+  }
+  access_unit_callback_(std::move(access_unit_));
+  access_unit_ = nullptr;
+}
+
+bool H264AccessUnitAssembler::IsFirstSliceOfPrimaryPicture(
+    const struct H264SliceHeaderParser::SliceHeaderState& previous,
+    const struct H264SliceHeaderParser::SliceHeaderState&
+        slice_header) noexcept {
+  // Section 7.4.1.2.4: the first VCL NAL unit of a new primary coded
+  // picture differs from the previous one in any of these
+  // frame_num differs in value
+  if (slice_header.frame_num != previous.frame_num) {
+    return true;
+  }
+  // pic_parameter_set_id differs in value
+  if (slice_header.pic_parameter_set_id != previous.pic_parameter_set_id) {
+    return true;
+  }
+  // field_pic_flag differs in value
+  if (slice_header.field_pic_flag != previous.field_pic_flag) {
+    return true;
+  }
+  // bottom_field_flag is present in both and differs in value
+  if (slice_header.field_pic_flag && previous.field_pic_flag &&
+      slice_header.bottom_field_flag != previous.bottom_field_flag) {
+    return true;
+  }
+  // nal_ref_idc differs in value with one of the nal_ref_idc values being
+  // equal to 0
+  if (slice_header.nal_ref_idc != previous.nal_ref_idc &&
+      (slice_header.nal_ref_idc == 0 || previous.nal_ref_idc == 0)) {
+    return true;
+  }
+  // pic_order_cnt_type is equal to 0 for both and either
+  // pic_order_cnt_lsb differs in value, or delta_pic_order_cnt_bottom
+  // differs in value
+  if (slice_header.pic_order_cnt_type == 0 &&
+      previous.pic_order_cnt_type == 0 &&
+      (slice_header.pic_order_cnt_lsb != previous.pic_order_cnt_lsb ||
+       slice_header.delta_pic_order_cnt_bottom !=
+           previous.delta_pic_order_cnt_bottom)) {
+    return true;
+  }
+  // pic_order_cnt_type is equal to 1 for both and either
+  // delta_pic_order_cnt[0] differs in value, or delta_pic_order_cnt[1]
+  // differs in value
+  if (slice_header.pic_order_cnt_type == 1 &&
+      previous.pic_order_cnt_type == 1) {
+    for (size_t i = 0; i < 2; i++) {
+      int32_t value = (i < slice_header.delta_pic_order_cnt.size())
+                          ? slice_header.delta_pic_order_cnt[i]
+                          : 0;
+      int32_t previous_value = (i < previous.delta_pic_order_cnt.size())
+                                   ? previous.delta_pic_order_cnt[i]
+                                   : 0;
+      if (value != previous_value) {
+        return true;
+      }
+    }
+  }
+  // IdrPicFlag differs in value
+  bool idr_pic_flag =
+      (slice_header.nal_unit_type == CODED_SLICE_OF_IDR_PICTURE_NUT);
+  bool previous_idr_pic_flag =
+      (previous.nal_unit_type == CODED_SLICE_OF_IDR_PICTURE_NUT);
+  if (idr_pic_flag != previous_idr_pic_flag) {
+    return true;
+  }
+  // IdrPicFlag is equal to 1 for both and idr_pic_id differs in value
+  if (idr_pic_flag && slice_header.idr_pic_id != previous.idr_pic_id) {
+    return true;
+  }
+  return false;
+}
+
+void H264AccessUnitAssembler::ParseBitstream(
+    const uint8_t* data, size_t length,
+    H264BitstreamParserState* bitstream_parser_state,
+    ParsingOptions parsing_options,
+    AccessUnitCallback access_unit_callback) noexcept {
+  H264AccessUnitAssembler assembler(access_unit_callback,
+                                    bitstream_parser_state);
+  H264BitstreamParser::ParseBitstream(data, length, bitstream_parser_state,
+                                      parsing_options,
+                                      assembler.GetNalUnitCallback());
+  assembler.Flush();
+}
+
+}  // namespace h264nal
@@ -0,0 +1,102 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#include "h264_arena.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace {
+// the current arena of each thread
+thread_local h264nal::H264Arena* current_arena = nullptr;
+
+// Each node is preceded by a header that says where it came from (keeps
+// the node aligned).
+const size_t kNodeHeaderSize = h264nal::H264Arena::kAlignment;
+const uint8_t kNodeFromHeap = 0;
+const uint8_t kNodeFromArena = 1;
+
+size_t AlignSize(size_t size) {
+  const size_t alignment = h264nal::H264Arena::kAlignment;
+  return (size + alignment - 1) & ~(alignment - 1);
+}
+}  // namespace
+
+namespace h264nal {
+
+H264Arena::H264Arena() : H264Arena(kDefaultBlockSize) {}
+
+H264Arena::H264Arena(size_t block_size)
+    : block_size_(block_size),
+      blocks_(),
+      block_index_(0),
+      block_offset_(0),
+      allocated_size_(0) {}
+
+void* H264Arena::Allocate(size_t size) {
+  size = AlignSize(size);
+  // use the first block (from the current one on) with room left
+  for (; block_index_ < blocks_.size(); block_index_++, block_offset_ = 0) {
+    Block& block = blocks_[block_index_];
+    if (block.size - block_offset_ >= size) {
+      void* ptr = block.data.get() + block_offset_;
+      block_offset_ += size;
+      allocated_size_ += size;
+      return ptr;
+    }
+  }
+  // new operator[] aligns to (at least) kAlignment
+  size_t block_size = std::max(block_size_, size);
+  blocks_.push_back({std::unique_ptr<uint8_t[]>(new uint8_t[block_size]),
+                     block_size});
+  block_index_ = blocks_.size() - 1;
+  block_offset_ = size;
+  allocated_size_ += size;
+  return blocks_.back().data.get();
+}
+
+void H264Arena::Reset() noexcept {
+  block_index_ = 0;
+  block_offset_ = 0;
+  allocated_size_ = 0;
+}
+
+H264Arena::Scope::Scope(H264Arena* arena) : previous_(current_arena) {
+  current_arena = arena;
+}
+
+H264Arena::Scope::~Scope() { current_arena = previous_; }
+
+H264Arena* H264Arena::GetCurrent() { return current_arena; }
+
+void* H264Arena::AllocateNode(size_t size) {
+  uint8_t* base;
+  if (current_arena != nullptr) {
+    base = static_cast<uint8_t*>(
+        current_arena->Allocate(kNodeHeaderSize + size));
+    base[0] = kNodeFromArena;
+  } else {
+    base = static_cast<uint8_t*>(::operator new(kNodeHeaderSize + size));
+    base[0] = kNodeFromHeap;
+  }
+  return base + kNodeHeaderSize;
+}
+
+void H264Arena::FreeNode(void* ptr) noexcept {
+  if (ptr == nullptr) {
+    return;
+  }
+  uint8_t* base = static_cast<uint8_t*>(ptr) - kNodeHeaderSize;
+  if (base[0] == kNodeFromHeap) {
+    ::operator delete(base);
+  }
+  // arena memory goes back with the arena
+}
+
+}  // namespace h264nal
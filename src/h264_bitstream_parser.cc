@@ -12,10 +12,16 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <system_error>
+#include <thread>
 #include <vector>
 
+#include "h264_arena.h"
 #include "h264_bitstream_parser_state.h"
 #include "h264_common.h"
 #include "h264_nal_unit_parser.h"
@@ -50,36 +56,33 @@ namespace h264nal {
 std::vector<H264BitstreamParser::NaluIndex>
 H264BitstreamParser::FindNaluIndices(const uint8_t* data,
                                      size_t length) noexcept {
-  // This is sorta like Boyer-Moore, but with only the first optimization step:
-  // given a 3-byte sequence we're looking at, if the 3rd byte isn't 1 or 0,
-  // skip ahead to the next 3-byte sequence. 0s and 1s are relatively rare, so
-  // this will skip the majority of reads/checks.
+  return FindNaluIndices(data, length, SIMD_AUTO);
+}
+
+std::vector<H264BitstreamParser::NaluIndex>
+H264BitstreamParser::FindNaluIndices(const uint8_t* data, size_t length,
+                                     SimdLevel simd_level) noexcept {
   std::vector<NaluIndex> sequences;
   if (length < kNaluShortStartSequenceSize) {
     return sequences;
   }
 
   const size_t end = length - kNaluShortStartSequenceSize;
-  for (size_t i = 0; i < end;) {
-    if (data[i + 2] > 1) {
-      i += 3;
-    } else if (data[i + 2] == 0x01 && data[i + 1] == 0x00 && data[i] == 0x00) {
-      // We found a start sequence, now check if it was a 3 of 4 byte one.
-      NaluIndex index = {i, i + 3, 0};
-      if (index.start_offset > 0 && data[index.start_offset - 1] == 0)
-        --index.start_offset;
-
-      // Update length of previous entry.
-      auto it = sequences.rbegin();
-      if (it != sequences.rend())
-        it->payload_size = index.start_offset - it->payload_start_offset;
-
-      sequences.push_back(index);
-
-      i += 3;
-    } else {
-      ++i;
-    }
+  for (size_t i = FindZeroZeroByte(data, 0, end, 0x01, simd_level); i < end;
+       i = FindZeroZeroByte(data, i, end, 0x01, simd_level)) {
+    // We found a start sequence, now check if it was a 3 of 4 byte one.
+    NaluIndex index = {i, i + 3, 0};
+    if (index.start_offset > 0 && data[index.start_offset - 1] == 0)
+      --index.start_offset;
+
+    // Update length of previous entry.
+    auto it = sequences.rbegin();
+    if (it != sequences.rend())
+      it->payload_size = index.start_offset - it->payload_start_offset;
+
+    sequences.push_back(index);
+
+    i += 3;
   }
 
   // Update length of last entry, if any.
@@ -120,9 +123,10 @@ H264BitstreamParser::FindNaluIndicesExplicitFraming(const uint8_t* data,
 
 // Parse a raw (RBSP) buffer with explicit NAL unit separator (3- or 4-byte
 // sequence start code prefix). Function splits the stream in NAL units,
-// and then parses each NAL unit. For that, it unpacks the RBSP inside
-// each NAL unit buffer, and adds the corresponding parsed struct into
-// the `bitstream` list (a `BitstreamState` object).
+// and then parses each NAL unit. For that, it reads the RBSP inside
+// each NAL unit buffer (skipping the emulation prevention bytes in place),
+// and adds the corresponding parsed struct into the `bitstream` list (a
+// `BitstreamState` object).
 // Function returns the said `bitstream` list.
 std::unique_ptr<H264BitstreamParser::BitstreamState>
 H264BitstreamParser::ParseBitstream(
@@ -130,7 +134,26 @@ H264BitstreamParser::ParseBitstream(
     H264BitstreamParserState* bitstream_parser_state,
     ParsingOptions parsing_options) noexcept {
   auto bitstream = std::make_unique<BitstreamState>();
+  if (parsing_options.use_arena) {
+    bitstream->arena = std::make_unique<H264Arena>();
+  }
+  // the NAL units parsed on this thread go to the arena (if any)
+  H264Arena::Scope arena_scope(bitstream->arena.get());
+  BitstreamState* bitstream_ptr = bitstream.get();
+  ParseBitstream(
+      data, length, bitstream_parser_state, parsing_options,
+      [bitstream_ptr](
+          std::unique_ptr<struct H264NalUnitParser::NalUnitState> nal_unit) {
+        bitstream_ptr->nal_units.push_back(std::move(nal_unit));
+      });
+  return bitstream;
+}
 
+void H264BitstreamParser::ParseBitstream(
+    const uint8_t* data, size_t length,
+    H264BitstreamParserState* bitstream_parser_state,
+    ParsingOptions parsing_options,
+    H264NalUnitParser::NalUnitCallback nal_unit_callback) noexcept {
   // (1) split the input string into a vector of NAL units
   std::vector<NaluIndex> nalu_indices = FindNaluIndices(data, length);
   if (nalu_indices.size() == 0) {
@@ -142,7 +165,7 @@ H264BitstreamParser::ParseBitstream(
 
   // process each of the NAL units
   for (const NaluIndex& nalu_index : nalu_indices) {
-    // (2) parse the NAL units, and add them to the vector
+    // (2) parse the NAL units, and pass them to the callback
     auto nal_unit = H264NalUnitParser::ParseNalUnit(
         &data[nalu_index.payload_start_offset], nalu_index.payload_size,
         bitstream_parser_state, parsing_options);
@@ -157,10 +180,8 @@ H264BitstreamParser::ParseBitstream(
     nal_unit->offset = nalu_index.payload_start_offset;
     nal_unit->length = nalu_index.payload_size;
 
-    bitstream->nal_units.push_back(std::move(nal_unit));
+    nal_unit_callback(std::move(nal_unit));
   }
-
-  return bitstream;
 }
 
 std::unique_ptr<H264BitstreamParser::BitstreamState>
@@ -183,11 +204,316 @@ H264BitstreamParser::ParseBitstream(const uint8_t* data, size_t length,
   return bitstream;
 }
 
+namespace {
+typedef std::vector<std::unique_ptr<struct H264NalUnitParser::NalUnitState>>
+    NalUnitVector;
+typedef std::vector<std::shared_ptr<H264BitstreamParserState>>
+    SnapshotVector;
+
+// The default chunk length for ParseBitstreamChunked().
+const size_t kDefaultChunkLength = 16 * 1024 * 1024;
+
+size_t GetThreadCount(size_t num_threads) {
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  return num_threads;
+}
+
+// Runs |worker| on |num_threads| threads, including the calling one, and
+// waits for all of them.
+void RunOnThreads(size_t num_threads, const std::function<void()>& worker) {
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_threads; i++) {
+    try {
+      threads.emplace_back(worker);
+    } catch (const std::system_error&) {
+      // could not start a thread: make do with the ones we have
+      break;
+    }
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+// Parses the NAL units that update the state (SPS/PPS/SubsetSPS, and SEI)
+// in |nalu_indices| into |bitstream_parser_state|, in stream order, and
+// stores them in |nal_units|. Every other NAL unit gets a snapshot of the
+// parameter set maps (and the active SPS) in effect at its position in
+// |snapshots|, shared by the run of NAL units between two state updates.
+// Nothing writes into a snapshot afterwards, so the other NAL units can be
+// parsed concurrently.
+void ParseParameterSets(
+    const uint8_t* data,
+    const std::vector<H264BitstreamParser::NaluIndex>& nalu_indices,
+    H264BitstreamParserState* bitstream_parser_state,
+    ParsingOptions parsing_options, NalUnitVector& nal_units,
+    SnapshotVector& snapshots) {
+  std::shared_ptr<H264BitstreamParserState> snapshot;
+  for (size_t i = 0; i < nalu_indices.size(); i++) {
+    const H264BitstreamParser::NaluIndex& nalu_index = nalu_indices[i];
+    // a zero-length NAL unit has no header: it does not parse
+    if (nalu_index.payload_size > 0 &&
+        UpdatesParserState(data[nalu_index.payload_start_offset] & 0x1f)) {
+      nal_units[i] = H264NalUnitParser::ParseNalUnit(
+          &data[nalu_index.payload_start_offset], nalu_index.payload_size,
+          bitstream_parser_state, parsing_options);
+      snapshot.reset();
+      continue;
+    }
+    if (snapshot == nullptr) {
+      snapshot = std::make_shared<H264BitstreamParserState>();
+      snapshot->sps = bitstream_parser_state->sps;
+      snapshot->pps = bitstream_parser_state->pps;
+      snapshot->subset_sps = bitstream_parser_state->subset_sps;
+      snapshot->active_sps = bitstream_parser_state->active_sps;
+    }
+    snapshots[i] = snapshot;
+  }
+}
+
+// Parses the NAL unit at |nalu_index| against its |snapshot|, unless it
+// updates the state (no snapshot), which ParseParameterSets() has parsed.
+void ParseNalUnitWithSnapshot(
+    const uint8_t* data, const H264BitstreamParser::NaluIndex& nalu_index,
+    H264BitstreamParserState* snapshot, ParsingOptions parsing_options,
+    std::unique_ptr<struct H264NalUnitParser::NalUnitState>& nal_unit) {
+  if (snapshot == nullptr) {
+    return;
+  }
+  nal_unit = H264NalUnitParser::ParseNalUnit(
+      &data[nalu_index.payload_start_offset], nalu_index.payload_size,
+      snapshot, parsing_options);
+}
+
+// Hands |nal_unit| to |nal_unit_callback| with its offset and length set,
+// or drops it if it did not parse.
+void DeliverNalUnit(
+    const H264BitstreamParser::NaluIndex& nalu_index,
+    std::unique_ptr<struct H264NalUnitParser::NalUnitState> nal_unit,
+    const H264NalUnitParser::NalUnitCallback& nal_unit_callback) {
+  if (nal_unit == nullptr) {
+    // cannot parse the NalUnit
+#ifdef FPRINT_ERRORS
+    fprintf(stderr, "error: cannot parse buffer into NalUnit\n");
+#endif  // FPRINT_ERRORS
+    return;
+  }
+  // store the offset
+  nal_unit->offset = nalu_index.payload_start_offset;
+  nal_unit->length = nalu_index.payload_size;
+  nal_unit_callback(std::move(nal_unit));
+}
+}  // namespace
+
+std::unique_ptr<H264BitstreamParser::BitstreamState>
+H264BitstreamParser::ParseBitstreamParallel(
+    const uint8_t* data, size_t length,
+    H264BitstreamParserState* bitstream_parser_state,
+    ParsingOptions parsing_options, size_t num_threads) noexcept {
+  // (1) split the input string into a vector of NAL units
+  std::vector<NaluIndex> nalu_indices = FindNaluIndices(data, length);
+  const size_t nalu_count = nalu_indices.size();
+
+  // (2) parse the parameter sets and SEI, in stream order
+  NalUnitVector nal_units(nalu_count);
+  SnapshotVector snapshots(nalu_count);
+  ParseParameterSets(data, nalu_indices, bitstream_parser_state,
+                     parsing_options, nal_units, snapshots);
+
+  // (3) parse the other NAL units on |num_threads| threads, each taking
+  // the next unparsed NAL unit
+  std::atomic<size_t> next_index(0);
+  RunOnThreads(std::min(GetThreadCount(num_threads), nalu_count), [&]() {
+    for (size_t i = next_index.fetch_add(1); i < nalu_count;
+         i = next_index.fetch_add(1)) {
+      ParseNalUnitWithSnapshot(data, nalu_indices[i], snapshots[i].get(),
+                               parsing_options, nal_units[i]);
+    }
+  });
+
+  // (4) collect the NAL units in stream order
+  auto bitstream = std::make_unique<BitstreamState>();
+  BitstreamState* bitstream_ptr = bitstream.get();
+  bitstream->nal_units.reserve(nalu_count);
+  for (size_t i = 0; i < nalu_count; i++) {
+    DeliverNalUnit(
+        nalu_indices[i], std::move(nal_units[i]),
+        [bitstream_ptr](
+            std::unique_ptr<struct H264NalUnitParser::NalUnitState> nal_unit) {
+          bitstream_ptr->nal_units.push_back(std::move(nal_unit));
+        });
+  }
+  return bitstream;
+}
+
+std::unique_ptr<H264BitstreamParser::BitstreamState>
+H264BitstreamParser::ParseBitstreamParallel(const uint8_t* data,
+                                            size_t length,
+                                            ParsingOptions parsing_options,
+                                            size_t num_threads) noexcept {
+  // keep a bitstream parser state (to keep the SPS/PPS/SubsetSPS NALUs)
+  H264BitstreamParserState bitstream_parser_state;
+
+  // parse the file
+  auto bitstream = ParseBitstreamParallel(
+      data, length, &bitstream_parser_state, parsing_options, num_threads);
+  bitstream->parsing_options_ = parsing_options;
+  return bitstream;
+}
+
+void H264BitstreamParser::ParseBitstreamChunked(
+    const uint8_t* data, size_t length,
+    H264BitstreamParserState* bitstream_parser_state,
+    ParsingOptions parsing_options, size_t num_threads, size_t chunk_length,
+    H264NalUnitParser::NalUnitCallback nal_unit_callback) noexcept {
+  if (length < kNaluShortStartSequenceSize) {
+    return;
+  }
+  num_threads = GetThreadCount(num_threads);
+  if (chunk_length == 0) {
+    chunk_length = kDefaultChunkLength;
+  }
+  // FindNaluIndices() looks for start codes in [0, end)
+  const size_t end = length - kNaluShortStartSequenceSize;
+  if (end == 0) {
+    return;
+  }
+  // no chunk needs to be longer than the input split across the threads,
+  // which also keeps |num_threads * chunk_length| from overflowing
+  chunk_length = std::min(
+      chunk_length, end / num_threads + (end % num_threads != 0 ? 1 : 0));
+
+  // The input is processed in waves of |num_threads| chunks, so that memory
+  // is bounded by the wave, not by the input. The NAL unit whose start code
+  // was the last one in a wave does not have a known length until the next
+  // start code is found: it is carried over to the next wave.
+  bool pending = false;
+  NaluIndex pending_nalu_index = {0, 0, 0};
+  std::vector<std::vector<size_t>> start_codes(num_threads);
+  for (size_t wave_offset = 0, wave_end = 0; wave_offset < end;
+       wave_offset = wave_end) {
+    wave_end =
+        wave_offset + std::min(end - wave_offset, num_threads * chunk_length);
+    const size_t num_chunks =
+        (wave_end - wave_offset + chunk_length - 1) / chunk_length;
+
+    // (1) find the start codes of each chunk. A chunk resynchronizes to
+    // its first start code, and owns the NAL units that start in it. Start
+    // codes can not overlap, so each chunk finds the same ones a single
+    // scan of the input would.
+    std::atomic<size_t> next_chunk(0);
+    RunOnThreads(num_chunks, [&]() {
+      for (size_t k = next_chunk.fetch_add(1); k < num_chunks;
+           k = next_chunk.fetch_add(1)) {
+        size_t chunk_offset = wave_offset + k * chunk_length;
+        size_t chunk_end = std::min(wave_end, chunk_offset + chunk_length);
+        start_codes[k].clear();
+        for (size_t i = FindZeroZeroByte(data, chunk_offset, chunk_end, 0x01,
+                                         SIMD_AUTO);
+             i < chunk_end; i = FindZeroZeroByte(data, i + 3, chunk_end, 0x01,
+                                                 SIMD_AUTO)) {
+          start_codes[k].push_back(i);
+        }
+      }
+    });
+
+    // (2) turn them into NAL unit indices, as FindNaluIndices() does. The
+    // NAL units of chunk k are [chunk_begin[k], chunk_begin[k + 1]). The
+    // pending NAL unit goes with chunk 0.
+    std::vector<NaluIndex> nalu_indices;
+    std::vector<size_t> chunk_begin(num_chunks + 1, 0);
+    if (pending) {
+      nalu_indices.push_back(pending_nalu_index);
+    }
+    for (size_t k = 0; k < num_chunks; k++) {
+      for (size_t i : start_codes[k]) {
+        // We found a start sequence, now check if it was a 3 of 4 byte one.
+        NaluIndex index = {i, i + 3, 0};
+        if (index.start_offset > 0 && data[index.start_offset - 1] == 0)
+          --index.start_offset;
+        // Update length of previous entry.
+        if (!nalu_indices.empty()) {
+          nalu_indices.back().payload_size =
+              index.start_offset - nalu_indices.back().payload_start_offset;
+        }
+        nalu_indices.push_back(index);
+      }
+      chunk_begin[k + 1] = nalu_indices.size();
+    }
+    if (nalu_indices.empty()) {
+      continue;
+    }
+    if (wave_end == end) {
+      // Update length of last entry.
+      nalu_indices.back().payload_size =
+          length - nalu_indices.back().payload_start_offset;
+      pending = false;
+    } else {
+      pending_nalu_index = nalu_indices.back();
+      pending = true;
+      nalu_indices.pop_back();
+      for (size_t& begin : chunk_begin) {
+        begin = std::min(begin, nalu_indices.size());
+      }
+    }
+    const size_t nalu_count = nalu_indices.size();
+
+    // (3) prescan: parse the parameter sets and SEI, in stream order, so that
+    // every chunk gets the ones in effect at its boundary (and after it)
+    NalUnitVector nal_units(nalu_count);
+    SnapshotVector snapshots(nalu_count);
+    ParseParameterSets(data, nalu_indices, bitstream_parser_state,
+                       parsing_options, nal_units, snapshots);
+
+    // (4) parse each chunk on its own thread
+    next_chunk.store(0);
+    RunOnThreads(num_chunks, [&]() {
+      for (size_t k = next_chunk.fetch_add(1); k < num_chunks;
+           k = next_chunk.fetch_add(1)) {
+        for (size_t i = chunk_begin[k]; i < chunk_begin[k + 1]; i++) {
+          ParseNalUnitWithSnapshot(data, nalu_indices[i], snapshots[i].get(),
+                                   parsing_options, nal_units[i]);
+        }
+      }
+    });
+
+    // (5) hand the NAL units over in stream order
+    for (size_t i = 0; i < nalu_count; i++) {
+      DeliverNalUnit(nalu_indices[i], std::move(nal_units[i]),
+                     nal_unit_callback);
+    }
+  }
+}
+
+std::unique_ptr<H264BitstreamParser::BitstreamState>
+H264BitstreamParser::ParseBitstreamChunked(const uint8_t* data, size_t length,
+                                           ParsingOptions parsing_options,
+                                           size_t num_threads,
+                                           size_t chunk_length) noexcept {
+  // keep a bitstream parser state (to keep the SPS/PPS/SubsetSPS NALUs)
+  H264BitstreamParserState bitstream_parser_state;
+
+  auto bitstream = std::make_unique<BitstreamState>();
+  BitstreamState* bitstream_ptr = bitstream.get();
+  ParseBitstreamChunked(
+      data, length, &bitstream_parser_state, parsing_options, num_threads,
+      chunk_length,
+      [bitstream_ptr](
+          std::unique_ptr<struct H264NalUnitParser::NalUnitState> nal_unit) {
+        bitstream_ptr->nal_units.push_back(std::move(nal_unit));
+      });
+  bitstream->parsing_options_ = parsing_options;
+  return bitstream;
+}
+
 // Parse a raw (RBSP) buffer with explicit NAL unit length fields.
 // Function splits the stream in NAL units, and then parses each NAL unit.
-// For that, it unpacks the RBSP inside each NAL unit buffer, and adds the
-// corresponding parsed struct into the `bitstream` list (a `BitstreamState`
-// object).
+// For that, it reads the RBSP inside each NAL unit buffer (skipping the
+// emulation prevention bytes in place), and adds the corresponding parsed
+// struct into the `bitstream` list (a `BitstreamState` object).
 // Function returns the said `bitstream` list.
 std::unique_ptr<H264BitstreamParser::BitstreamState>
 H264BitstreamParser::ParseBitstreamNALULength(
@@ -195,7 +521,27 @@ H264BitstreamParser::ParseBitstreamNALULength(
     H264BitstreamParserState* bitstream_parser_state,
     ParsingOptions parsing_options) noexcept {
   auto bitstream = std::make_unique<BitstreamState>();
+  if (parsing_options.use_arena) {
+    bitstream->arena = std::make_unique<H264Arena>();
+  }
+  // the NAL units parsed on this thread go to the arena (if any)
+  H264Arena::Scope arena_scope(bitstream->arena.get());
+  BitstreamState* bitstream_ptr = bitstream.get();
+  ParseBitstreamNALULength(
+      data, length, nalu_length_bytes, bitstream_parser_state,
+      parsing_options,
+      [bitstream_ptr](
+          std::unique_ptr<struct H264NalUnitParser::NalUnitState> nal_unit) {
+        bitstream_ptr->nal_units.push_back(std::move(nal_unit));
+      });
+  return bitstream;
+}
 
+void H264BitstreamParser::ParseBitstreamNALULength(
+    const uint8_t* data, size_t length, size_t nalu_length_bytes,
+    H264BitstreamParserState* bitstream_parser_state,
+    ParsingOptions parsing_options,
+    H264NalUnitParser::NalUnitCallback nal_unit_callback) noexcept {
   size_t i = 0;
 
   if (length < nalu_length_bytes) {
@@ -224,7 +570,7 @@ H264BitstreamParser::ParseBitstreamNALULength(
       nalu_length = length;
     }
 
-    // (2) parse the NAL unit, and add it to the vector
+    // (2) parse the NAL unit, and pass it to the callback
     auto nal_unit = H264NalUnitParser::ParseNalUnit(
         &data[i], nalu_length, bitstream_parser_state, parsing_options);
     if (nal_unit == nullptr) {
@@ -239,12 +585,10 @@ H264BitstreamParser::ParseBitstreamNALULength(
     nal_unit->offset = i;
     nal_unit->length = nalu_length_bytes;
 
-    bitstream->nal_units.push_back(std::move(nal_unit));
+    nal_unit_callback(std::move(nal_unit));
 
     i += nalu_length;
   }
-
-  return bitstream;
 }
 
 std::unique_ptr<H264BitstreamParser::BitstreamState>
@@ -32,31 +32,41 @@ namespace h264nal {
 std::shared_ptr<struct H264SpsParser::SpsState>
 H264BitstreamParserState::GetSps(uint32_t sps_id) const {
   // check the SPS exists in the bitstream parser state
-  auto it = sps.find(sps_id);
-  if (it == sps.end()) {
+  if (sps_id >= kSpsIdCount) {
     return SharedPtrSpsState(nullptr);
   }
-  return SharedPtrSpsState(it->second);
+  return sps[sps_id];
 }
 
 std::shared_ptr<struct H264PpsParser::PpsState>
 H264BitstreamParserState::GetPps(uint32_t pps_id) const {
   // check the PPS exists in the bitstream parser state
-  auto it = pps.find(pps_id);
-  if (it == pps.end()) {
+  if (pps_id >= kPpsIdCount) {
     return SharedPtrPpsState(nullptr);
   }
-  return SharedPtrPpsState(it->second);
+  return pps[pps_id];
 }
 
 std::shared_ptr<struct H264SubsetSpsParser::SubsetSpsState>
 H264BitstreamParserState::GetSubsetSps(uint32_t subset_sps_id) const {
   // check the SubsetSPS exists in the bitstream parser state
-  auto it = subset_sps.find(subset_sps_id);
-  if (it == subset_sps.end()) {
+  if (subset_sps_id >= kSpsIdCount) {
     return SharedPtrSubsetSpsState(nullptr);
   }
-  return SharedPtrSubsetSpsState(it->second);
+  return subset_sps[subset_sps_id];
+}
+
+bool H264BitstreamParserState::ResolvePps(
+    uint32_t pps_id, const struct H264PpsParser::PpsState** pps_out,
+    const struct H264SpsParser::SpsState** sps_out) const {
+  *pps_out = (pps_id < kPpsIdCount) ? pps[pps_id].get() : nullptr;
+  *sps_out = nullptr;
+  if (*pps_out == nullptr) {
+    return false;
+  }
+  uint32_t sps_id = (*pps_out)->seq_parameter_set_id;
+  *sps_out = (sps_id < kSpsIdCount) ? sps[sps_id].get() : nullptr;
+  return *sps_out != nullptr;
 }
 
 }  // namespace h264nal
@@ -0,0 +1,136 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#include "h264_bitstream_view.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "h264_bitstream_parser.h"
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "h264_nal_unit_parser.h"
+
+namespace h264nal {
+
+H264BitstreamView::H264BitstreamView(const uint8_t* data, size_t length,
+                                     ParsingOptions parsing_options) noexcept
+    : data_(data),
+      parsing_options_(parsing_options),
+      nal_units_(),
+      parsed_nal_units_(),
+      parse_attempted_(),
+      parameter_set_snapshots_(),
+      empty_state_(),
+      parse_state_(),
+      parameter_set_end_(0) {
+  std::vector<H264BitstreamParser::NaluIndex> nalu_indices =
+      H264BitstreamParser::FindNaluIndices(data, length);
+  nal_units_.reserve(nalu_indices.size());
+  for (const auto& nalu_index : nalu_indices) {
+    if (nalu_index.payload_size == 0) {
+      // no nal_unit_header(): ParseBitstream() drops these too
+      continue;
+    }
+    // nal_unit_header() is byte aligned, and its first byte can not be an
+    // emulation prevention byte, so no unescaping is needed
+    uint8_t header = data[nalu_index.payload_start_offset];
+    NalUnitInfo info;
+    info.offset = nalu_index.payload_start_offset;
+    info.length = nalu_index.payload_size;
+    // forbidden_zero_bit  f(1)
+    info.forbidden_zero_bit = (header >> 7) & 0x01;
+    // nal_ref_idc  u(2)
+    info.nal_ref_idc = (header >> 5) & 0x03;
+    // nal_unit_type  u(5)
+    info.nal_unit_type = header & 0x1f;
+    nal_units_.push_back(info);
+  }
+  parsed_nal_units_.resize(nal_units_.size());
+  parse_attempted_.resize(nal_units_.size(), false);
+}
+
+const struct H264NalUnitParser::NalUnitState* H264BitstreamView::GetNalUnit(
+    size_t index) noexcept {
+  if (index >= nal_units_.size()) {
+    return nullptr;
+  }
+  if (UpdatesParserState(nal_units_[index].nal_unit_type)) {
+    // parameter sets and SEI are parsed (and cached) in stream order
+    ParseParameterSets(index + 1);
+    return parsed_nal_units_[index].get();
+  }
+  if (!parse_attempted_[index]) {
+    parse_attempted_[index] = true;
+    const NalUnitInfo& info = nal_units_[index];
+    auto nal_unit = H264NalUnitParser::ParseNalUnit(
+        data_ + info.offset, info.length, GetParameterSetState(index),
+        parsing_options_);
+    if (nal_unit != nullptr) {
+      // store the offset
+      nal_unit->offset = info.offset;
+      nal_unit->length = info.length;
+    }
+    parsed_nal_units_[index] = std::move(nal_unit);
+  }
+  return parsed_nal_units_[index].get();
+}
+
+void H264BitstreamView::ParseParameterSets(size_t end) noexcept {
+  for (; parameter_set_end_ < end; parameter_set_end_++) {
+    size_t index = parameter_set_end_;
+    const NalUnitInfo& info = nal_units_[index];
+    if (!UpdatesParserState(info.nal_unit_type)) {
+      continue;
+    }
+    // parse into the running state, whose parameter set sources let a
+    // byte-identical repeat reuse its table entry
+    parse_attempted_[index] = true;
+    auto active_sps = parse_state_.active_sps;
+    auto nal_unit = H264NalUnitParser::ParseNalUnit(
+        data_ + info.offset, info.length, &parse_state_, parsing_options_);
+    if (nal_unit == nullptr) {
+      parsed_nal_units_[index] = nullptr;
+      continue;
+    }
+    // store the offset
+    nal_unit->offset = info.offset;
+    nal_unit->length = info.length;
+    bool state_changed = nal_unit->parameter_set_changed ||
+                         parse_state_.active_sps != active_sps;
+    parsed_nal_units_[index] = std::move(nal_unit);
+    if (!state_changed) {
+      // a repeat (or an SEI that activates no other SPS) leaves the state
+      // as it is: keep using the previous snapshot
+      continue;
+    }
+    auto state = std::make_unique<H264BitstreamParserState>();
+    state->sps = parse_state_.sps;
+    state->pps = parse_state_.pps;
+    state->subset_sps = parse_state_.subset_sps;
+    state->active_sps = parse_state_.active_sps;
+    parameter_set_snapshots_.push_back({index, std::move(state)});
+  }
+}
+
+H264BitstreamParserState* H264BitstreamView::GetParameterSetState(
+    size_t index) noexcept {
+  ParseParameterSets(index);
+  // the last snapshot before |index|
+  auto it = std::lower_bound(
+      parameter_set_snapshots_.begin(), parameter_set_snapshots_.end(), index,
+      [](const ParameterSetSnapshot& snapshot, size_t value) {
+        return snapshot.index < value;
+      });
+  if (it == parameter_set_snapshots_.begin()) {
+    return &empty_state_;
+  }
+  return (it - 1)->state.get();
+}
+
+}  // namespace h264nal
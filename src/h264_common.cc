@@ -10,13 +10,36 @@
 #include <arpa/inet.h>
 #endif
 #include <stdio.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define H264NAL_HAVE_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+// AVX2 is built with a per-function target attribute and only run after a
+// runtime CPU check, so the rest of the library keeps the baseline ISA
+#define H264NAL_HAVE_AVX2
+#include <immintrin.h>
+#if defined(__x86_64__)
+// same for the SSE4.2 crc32 instruction (64-bit form)
+#define H264NAL_HAVE_SSE42
+#endif
+#endif
+#endif
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
 
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "h264_arena.h"
+
 namespace h264nal {
 
 std::string NalUnitTypeToString(uint32_t nal_unit_type) {
@@ -109,6 +132,25 @@ bool IsSliceSegment(uint32_t nal_unit_type) {
   }
 }
 
+bool IsParameterSet(uint32_t nal_unit_type) {
+  // the NAL unit types whose payload goes into the parameter set tables
+  // of H264BitstreamParserState
+  switch (nal_unit_type) {
+    case SPS_NUT:
+    case PPS_NUT:
+    case SUBSET_SPS_NUT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool UpdatesParserState(uint32_t nal_unit_type) {
+  // the parameter sets, and the SEI (a buffering_period() activates its
+  // SPS): these must be parsed in stream order
+  return IsParameterSet(nal_unit_type) || nal_unit_type == SEI_NUT;
+}
+
 bool IsNalUnitTypeReserved(uint32_t nal_unit_type) {
   // payload (Table 7-1, Section 7.4.1)
   switch (nal_unit_type) {
@@ -222,30 +264,183 @@ void profileTypeToString(enum ProfileType profile, std::string& str) {
 // where the first 2x bytes are "\x00" and the third byte is "\x00",
 // "\x01", "\x02", or "\x03" have been escaped (and extra "\x03"
 // has been inserted as third byte), and returns the unescaped one.
-std::vector<uint8_t> UnescapeRbsp(const uint8_t* data, size_t length) {
-  std::vector<uint8_t> out;
-  out.reserve(length);
-
-  for (size_t i = 0; i < length;) {
-    // Be careful about over/underflow here. byte_length_ - 3 can underflow, and
-    // i + 3 can overflow, but byte_length_ - i can't, because i < byte_length_
-    // above, and that expression will produce the number of bytes left in
-    // the stream including the byte at i.
-    if (length - i >= 3 && data[i] == 0x00 && data[i + 1] == 0x00 &&
-        data[i + 2] == 0x03) {
-      // Two RBSP bytes.
-      out.push_back(data[i++]);
-      out.push_back(data[i++]);
-      // Skip the emulation byte.
-      i++;
+namespace {
+// The byte pattern scanners behind FindZeroZeroByte(). Same contract.
+typedef size_t (*FindZeroZeroByteFunction)(const uint8_t* data, size_t begin,
+                                           size_t end, uint8_t third_byte);
+
+size_t FindZeroZeroByteScalar(const uint8_t* data, size_t begin, size_t end,
+                              uint8_t third_byte) {
+  // This is sorta like Boyer-Moore, but with only the first optimization step:
+  // given a 3-byte sequence we're looking at, if the 3rd byte isn't
+  // |third_byte| or 0, skip ahead to the next 3-byte sequence. Both are
+  // relatively rare, so this will skip the majority of reads/checks.
+  for (size_t i = begin; i < end;) {
+    if (data[i + 2] != 0x00 && data[i + 2] != third_byte) {
+      i += 3;
+    } else if (data[i + 2] == third_byte && data[i + 1] == 0x00 &&
+               data[i] == 0x00) {
+      return i;
     } else {
-      // Single rbsp byte.
-      out.push_back(data[i++]);
+      ++i;
     }
   }
+  return end;
+}
+
+#if defined(H264NAL_HAVE_SSE2)
+// Returns the index of the lowest set bit in |mask|, which must not be 0.
+size_t CountTrailingZeros32(uint32_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<size_t>(__builtin_ctz(mask));
+#else
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return static_cast<size_t>(index);
+#endif
+}
+
+// Tests 16 candidate offsets at a time: three unaligned loads, shifted by
+// one byte each, compared against {0, 0, |third_byte|}. A set bit in the
+// combined mask is a match.
+size_t FindZeroZeroByteSse2(const uint8_t* data, size_t begin, size_t end,
+                            uint8_t third_byte) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i third = _mm_set1_epi8(static_cast<char>(third_byte));
+  size_t i = begin;
+  for (; i + 16 <= end; i += 16) {
+    const uint8_t* p = data + i;
+    __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+    __m128i b2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2));
+    __m128i match = _mm_and_si128(
+        _mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)),
+        _mm_cmpeq_epi8(b2, third));
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(match));
+    if (mask != 0) {
+      return i + CountTrailingZeros32(mask);
+    }
+  }
+  return FindZeroZeroByteScalar(data, i, end, third_byte);
+}
+#endif  // H264NAL_HAVE_SSE2
+
+#if defined(H264NAL_HAVE_AVX2)
+// The SSE2 scanner, 32 candidate offsets at a time.
+__attribute__((target("avx2"))) size_t FindZeroZeroByteAvx2(
+    const uint8_t* data, size_t begin, size_t end, uint8_t third_byte) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i third = _mm256_set1_epi8(static_cast<char>(third_byte));
+  size_t i = begin;
+  for (; i + 32 <= end; i += 32) {
+    const uint8_t* p = data + i;
+    __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+    __m256i b2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 2));
+    __m256i match = _mm256_and_si256(
+        _mm256_and_si256(_mm256_cmpeq_epi8(b0, zero),
+                         _mm256_cmpeq_epi8(b1, zero)),
+        _mm256_cmpeq_epi8(b2, third));
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(match));
+    if (mask != 0) {
+      return i + CountTrailingZeros32(mask);
+    }
+  }
+  return FindZeroZeroByteSse2(data, i, end, third_byte);
+}
+
+bool CpuSupportsAvx2() {
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported;
+}
+#endif  // H264NAL_HAVE_AVX2
+
+FindZeroZeroByteFunction GetFindZeroZeroByteFunction(SimdLevel simd_level) {
+  if (!IsSimdLevelSupported(simd_level)) {
+    simd_level = SIMD_AUTO;
+  }
+#if defined(H264NAL_HAVE_AVX2)
+  if (simd_level == SIMD_AVX2 ||
+      (simd_level == SIMD_AUTO && CpuSupportsAvx2())) {
+    return FindZeroZeroByteAvx2;
+  }
+#endif
+#if defined(H264NAL_HAVE_SSE2)
+  if (simd_level == SIMD_SSE2 || simd_level == SIMD_AUTO) {
+    return FindZeroZeroByteSse2;
+  }
+#endif
+  return FindZeroZeroByteScalar;
+}
+}  // namespace
+
+bool IsSimdLevelSupported(SimdLevel simd_level) noexcept {
+  switch (simd_level) {
+    case SIMD_AUTO:
+    case SIMD_NONE:
+      return true;
+    case SIMD_SSE2:
+#if defined(H264NAL_HAVE_SSE2)
+      return true;
+#else
+      return false;
+#endif
+    case SIMD_AVX2:
+#if defined(H264NAL_HAVE_AVX2)
+      return CpuSupportsAvx2();
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
+size_t FindZeroZeroByte(const uint8_t* data, size_t begin, size_t end,
+                        uint8_t third_byte, SimdLevel simd_level) noexcept {
+  return GetFindZeroZeroByteFunction(simd_level)(data, begin, end,
+                                                 third_byte);
+}
+
+std::vector<uint8_t> UnescapeRbsp(const uint8_t* data, size_t length) {
+  std::vector<uint8_t> out;
+  UnescapeRbsp(data, length, out);
   return out;
 }
 
+void UnescapeRbsp(const uint8_t* data, size_t length,
+                  std::vector<uint8_t>& out) {
+  out.resize(length);
+  out.resize(UnescapeRbsp(data, length, out.data(), SIMD_AUTO));
+}
+
+size_t UnescapeRbsp(const uint8_t* data, size_t length, uint8_t* out,
+                    SimdLevel simd_level) noexcept {
+  FindZeroZeroByteFunction find_emulation_byte =
+      GetFindZeroZeroByteFunction(simd_level);
+  size_t out_length = 0;
+  size_t run_start = 0;
+  if (length >= 3) {
+    // Every 00 00 03 is an emulation byte: two matches can never overlap,
+    // as the second would need the 03 of the first to be a 00. So the
+    // clean runs in between can be copied as they are found.
+    const size_t end = length - 2;
+    for (size_t i = find_emulation_byte(data, 0, end, 0x03); i < end;
+         i = find_emulation_byte(data, i, end, 0x03)) {
+      // Copy the run up to the two RBSP zero bytes, and skip the emulation
+      // byte.
+      memcpy(out + out_length, data + run_start, i + 2 - run_start);
+      out_length += i + 2 - run_start;
+      i += 3;
+      run_start = i;
+    }
+  }
+  if (run_start < length) {
+    memcpy(out + out_length, data + run_start, length - run_start);
+    out_length += length - run_start;
+  }
+  return out_length;
+}
+
 // Syntax functions and descriptors) (Section 7.2)
 bool byte_aligned(BitBuffer* bit_buffer) {
   // If the current position in the bitstream is on a byte boundary, i.e.,
@@ -391,50 +586,28 @@ void reset_unimplemented_count() noexcept {
 }
 
 
-std::shared_ptr<NaluChecksum> NaluChecksum::GetNaluChecksum(
-    BitBuffer* bit_buffer) noexcept {
-  // save the bit buffer current state
-  size_t byte_offset = 0;
-  size_t bit_offset = 0;
-  bit_buffer->GetCurrentOffset(&byte_offset, &bit_offset);
-
-  auto checksum = std::make_shared<NaluChecksum>();
-  // implement simple IP-like checksum (extended from 16/32 to 32/64 bits)
-  // Inspired in https://stackoverflow.com/questions/26774761
-
-  // Our algorithm is simple, using a 64 bit accumulator (sum), we add
-  // sequential 32 bit words to it, and at the end, fold back all the
-  // carry bits from the top 32 bits into the lower 32 bits.
-
-  uint64_t sum = 0;
+namespace {
+uint32_t LoadBigEndian32(const uint8_t* data) {
+  return (static_cast<uint32_t>(data[0]) << 24) |
+         (static_cast<uint32_t>(data[1]) << 16) |
+         (static_cast<uint32_t>(data[2]) << 8) | static_cast<uint32_t>(data[3]);
+}
 
-  uint32_t val = 0;
-  while (bit_buffer->ReadUInt32(val)) {
-    sum += val;
-  }
+uint32_t LoadLittleEndian32(const uint8_t* data) {
+  return static_cast<uint32_t>(data[0]) |
+         (static_cast<uint32_t>(data[1]) << 8) |
+         (static_cast<uint32_t>(data[2]) << 16) |
+         (static_cast<uint32_t>(data[3]) << 24);
+}
 
-  // check if there are unread bytes
-  int i = 0;
-  uint8_t val8 = 0;
-  val = 0;
-  // The loop above consumes whole 32 bit words, so at most 3 bytes are
-  // left, and i cannot exceed 2. Both bounds are stated anyway rather than
-  // inferred: a bit buffer that is not byte aligned on entry can be left
-  // with 1 to 7 bits, which is "> 0" but not enough for ReadUInt8. A
-  // failed read consumes nothing, so testing RemainingBitCount() > 0 and
-  // discarding the result of ReadUInt8() spins forever, shifting by
-  // 8 * (3 - i) with i climbing past 3.
-  while (bit_buffer->RemainingBitCount() >= 8 && i < 4) {
-    if (!bit_buffer->ReadUInt8(val8)) {
-      break;
-    }
-    val |= static_cast<uint32_t>(val8) << (8 * (3 - i));
-    i += 1;
-  }
-  if (i > 0) {
-    sum += val;
-  }
+uint64_t LoadLittleEndian64(const uint8_t* data) {
+  return static_cast<uint64_t>(LoadLittleEndian32(data)) |
+         (static_cast<uint64_t>(LoadLittleEndian32(data + 4)) << 32);
+}
 
+// Folds the carry outs of |sum| back into its low 32 bits, and returns
+// their one's complement.
+uint32_t FoldSum32(uint64_t sum) {
   // add back carry outs from top 32 bits to low 32 bits
   // add hi 32 to low 32
   sum = (sum >> 32) + (sum & 0xffffffff);
@@ -443,11 +616,189 @@ std::shared_ptr<NaluChecksum> NaluChecksum::GetNaluChecksum(
   // truncate to 32 bits and get one's complement. sum is 64 bits wide, so
   // dropping the top half is the truncation the comment above describes,
   // not an accident.
-  uint32_t answer = static_cast<uint32_t>(~sum);
+  return static_cast<uint32_t>(~sum);
+}
+
+// CHECKSUM_SUM32 over raw bytes, a word at a time. A trailing partial
+// word is left aligned, as BitBuffer::ReadUInt8() would put it.
+uint32_t Sum32(const uint8_t* data, size_t length) {
+  uint64_t sum = 0;
+  size_t i = 0;
+  for (; i + 4 <= length; i += 4) {
+    sum += LoadBigEndian32(data + i);
+  }
+  if (i < length) {
+    uint32_t val = 0;
+    for (size_t j = 0; i + j < length; j++) {
+      val |= static_cast<uint32_t>(data[i + j]) << (8 * (3 - j));
+    }
+    sum += val;
+  }
+  return FoldSum32(sum);
+}
+
+// CRC-32C (Castagnoli, reflected polynomial 0x82f63b78), a byte at a time.
+uint32_t Crc32cScalar(const uint8_t* data, size_t length) {
+  static const struct Crc32cTable {
+    Crc32cTable() {
+      for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+          crc = (crc >> 1) ^ ((crc & 1) ? 0x82f63b78 : 0);
+        }
+        values[i] = crc;
+      }
+    }
+    uint32_t values[256];
+  } table;
+  uint32_t crc = 0xffffffff;
+  for (size_t i = 0; i < length; i++) {
+    crc = table.values[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+#if defined(H264NAL_HAVE_SSE42)
+// The same, 8 bytes at a time, with the crc32 instruction.
+__attribute__((target("sse4.2"))) uint32_t Crc32cSse42(const uint8_t* data,
+                                                       size_t length) {
+  uint64_t crc = 0xffffffff;
+  size_t i = 0;
+  for (; i + 8 <= length; i += 8) {
+    crc = _mm_crc32_u64(crc, LoadLittleEndian64(data + i));
+  }
+  uint32_t crc32 = static_cast<uint32_t>(crc);
+  for (; i < length; i++) {
+    crc32 = _mm_crc32_u8(crc32, data[i]);
+  }
+  return ~crc32;
+}
+
+bool CpuSupportsSse42() {
+  static const bool supported = __builtin_cpu_supports("sse4.2");
+  return supported;
+}
+#endif  // H264NAL_HAVE_SSE42
+
+uint32_t Crc32c(const uint8_t* data, size_t length) {
+#if defined(H264NAL_HAVE_SSE42)
+  if (CpuSupportsSse42()) {
+    return Crc32cSse42(data, length);
+  }
+#endif  // H264NAL_HAVE_SSE42
+  return Crc32cScalar(data, length);
+}
+
+// xxHash64 (https://github.com/Cyan4973/xxHash), with seed 0.
+const uint64_t kXxHashPrime1 = 0x9e3779b185ebca87ULL;
+const uint64_t kXxHashPrime2 = 0xc2b2ae3d27d4eb4fULL;
+const uint64_t kXxHashPrime3 = 0x165667b19e3779f9ULL;
+const uint64_t kXxHashPrime4 = 0x85ebca77c2b2ae63ULL;
+const uint64_t kXxHashPrime5 = 0x27d4eb2f165667c5ULL;
+
+uint64_t RotateLeft64(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t XxHash64Round(uint64_t acc, uint64_t input) {
+  acc += input * kXxHashPrime2;
+  acc = RotateLeft64(acc, 31);
+  return acc * kXxHashPrime1;
+}
 
-  // write sum into (generic) checksum buffer (network order)
-  *(reinterpret_cast<uint32_t*>(checksum->checksum)) = htonl(answer);
-  checksum->length = 4;
+uint64_t XxHash64Merge(uint64_t acc, uint64_t value) {
+  acc ^= XxHash64Round(0, value);
+  return acc * kXxHashPrime1 + kXxHashPrime4;
+}
+
+uint64_t XxHash64(const uint8_t* data, size_t length) {
+  const uint64_t seed = 0;
+  size_t i = 0;
+  uint64_t hash;
+  if (length >= 32) {
+    uint64_t v1 = seed + kXxHashPrime1 + kXxHashPrime2;
+    uint64_t v2 = seed + kXxHashPrime2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - kXxHashPrime1;
+    for (; i + 32 <= length; i += 32) {
+      v1 = XxHash64Round(v1, LoadLittleEndian64(data + i));
+      v2 = XxHash64Round(v2, LoadLittleEndian64(data + i + 8));
+      v3 = XxHash64Round(v3, LoadLittleEndian64(data + i + 16));
+      v4 = XxHash64Round(v4, LoadLittleEndian64(data + i + 24));
+    }
+    hash = RotateLeft64(v1, 1) + RotateLeft64(v2, 7) + RotateLeft64(v3, 12) +
+           RotateLeft64(v4, 18);
+    hash = XxHash64Merge(hash, v1);
+    hash = XxHash64Merge(hash, v2);
+    hash = XxHash64Merge(hash, v3);
+    hash = XxHash64Merge(hash, v4);
+  } else {
+    hash = seed + kXxHashPrime5;
+  }
+  hash += length;
+  for (; i + 8 <= length; i += 8) {
+    hash ^= XxHash64Round(0, LoadLittleEndian64(data + i));
+    hash = RotateLeft64(hash, 27) * kXxHashPrime1 + kXxHashPrime4;
+  }
+  if (i + 4 <= length) {
+    hash ^= static_cast<uint64_t>(LoadLittleEndian32(data + i)) * kXxHashPrime1;
+    hash = RotateLeft64(hash, 23) * kXxHashPrime2 + kXxHashPrime3;
+    i += 4;
+  }
+  for (; i < length; i++) {
+    hash ^= data[i] * kXxHashPrime5;
+    hash = RotateLeft64(hash, 11) * kXxHashPrime1;
+  }
+  // avalanche
+  hash ^= hash >> 33;
+  hash *= kXxHashPrime2;
+  hash ^= hash >> 29;
+  hash *= kXxHashPrime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+// The bytes a BitBuffer has left, for the algorithms that need them in
+// memory. Reused across calls.
+thread_local std::vector<uint8_t> checksum_scratch;
+}  // namespace
+
+std::shared_ptr<NaluChecksum> NaluChecksum::GetNaluChecksum(
+    BitBuffer* bit_buffer) noexcept {
+  return GetNaluChecksum(bit_buffer, CHECKSUM_SUM32);
+}
+
+std::shared_ptr<NaluChecksum> NaluChecksum::GetNaluChecksum(
+    BitBuffer* bit_buffer, ChecksumType checksum_type) noexcept {
+  // save the bit buffer current state
+  size_t byte_offset = 0;
+  size_t bit_offset = 0;
+  bit_buffer->GetCurrentOffset(&byte_offset, &bit_offset);
+
+  if (bit_offset == 0) {
+    // byte aligned: take the bytes left in bulk. An escaped buffer counts
+    // its offset in RBSP bytes, so unescape it first.
+    const uint8_t* data = bit_buffer->GetBytes();
+    size_t length = bit_buffer->GetByteCount();
+    if (bit_buffer->IsEscaped()) {
+      UnescapeRbsp(data, length, checksum_scratch);
+      data = checksum_scratch.data();
+      length = checksum_scratch.size();
+    }
+    byte_offset = std::min(byte_offset, length);
+    return GetNaluChecksum(data + byte_offset, length - byte_offset,
+                           checksum_type);
+  }
+
+  // not byte aligned: read the bytes left through the bit buffer
+  checksum_scratch.clear();
+  uint8_t val8 = 0;
+  while (bit_buffer->ReadUInt8(val8)) {
+    checksum_scratch.push_back(val8);
+  }
+  // The trailing 1 to 7 bits, which do not make a byte, are left out.
+  auto checksum = GetNaluChecksum(checksum_scratch.data(),
+                                  checksum_scratch.size(), checksum_type);
 
   // return the bit buffer to the original state
   bit_buffer->Seek(byte_offset, bit_offset);
@@ -455,6 +806,34 @@ std::shared_ptr<NaluChecksum> NaluChecksum::GetNaluChecksum(
   return checksum;
 }
 
+std::shared_ptr<NaluChecksum> NaluChecksum::GetNaluChecksum(
+    const uint8_t* data, size_t length, ChecksumType checksum_type) noexcept {
+  auto checksum = std::allocate_shared<NaluChecksum>(
+      H264ArenaAllocator<NaluChecksum>());
+  switch (checksum_type) {
+    case CHECKSUM_CRC32C:
+      checksum->SetValue(Crc32c(data, length), 4);
+      break;
+    case CHECKSUM_XXHASH64:
+      checksum->SetValue(XxHash64(data, length), 8);
+      break;
+    case CHECKSUM_SUM32:
+    default:
+      checksum->SetValue(Sum32(data, length), 4);
+      break;
+  }
+  return checksum;
+}
+
+void NaluChecksum::SetValue(uint64_t value, int value_length) {
+  // network order
+  for (int i = 0; i < value_length; i++) {
+    checksum[i] = static_cast<char>((value >> (8 * (value_length - 1 - i))) &
+                                    0xff);
+  }
+  length = value_length;
+}
+
 void NaluChecksum::fdump(char* output, int output_len) const {
   int i = 0;
   int oi = 0;
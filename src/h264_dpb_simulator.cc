@@ -0,0 +1,713 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#include "h264_dpb_simulator.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "h264_access_unit_assembler.h"
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "h264_dec_ref_pic_marking_parser.h"
+#include "h264_level_checker.h"
+#include "h264_pps_parser.h"
+#include "h264_ref_pic_list_modification_parser.h"
+#include "h264_slice_header_parser.h"
+#include "h264_sps_parser.h"
+#include "h264_vui_parameters_parser.h"
+
+namespace {
+// the next value of a compact syntax element list, or false if the list
+// is exhausted
+bool GetNextValue(const std::vector<uint32_t>& values, size_t* index,
+                  uint32_t* value) {
+  if (*index >= values.size()) {
+    return false;
+  }
+  *value = values[*index];
+  *index += 1;
+  return true;
+}
+
+// whether two DPB pictures are the same frame
+bool IsSameFrame(const h264nal::H264DpbSimulator::DpbPicture& a,
+                 const h264nal::H264DpbSimulator::DpbPicture& b) {
+  return a.picture_index == b.picture_index && a.frame_num == b.frame_num &&
+         a.non_existing == b.non_existing;
+}
+
+bool IsSameList(
+    const std::vector<h264nal::H264DpbSimulator::DpbPicture>& list0,
+    const std::vector<h264nal::H264DpbSimulator::DpbPicture>& list1) {
+  return list0.size() == list1.size() &&
+         std::equal(list0.begin(), list0.end(), list1.begin(), IsSameFrame);
+}
+}  // namespace
+
+namespace h264nal {
+
+// General note: this is based off the 2012 version of the H.264 standard.
+// You can find it on this page:
+// http://www.itu.int/rec/T-REC-H.264
+
+H264DpbSimulator::H264DpbSimulator() { Reset(); }
+
+void H264DpbSimulator::Reset() noexcept {
+  dpb_.clear();
+  pic_order_cnt_calculator_.Reset();
+  picture_count_ = 0;
+  frame_num_ = 0;
+  max_frame_num_ = 0;
+  prev_ref_frame_num_ = 0;
+  max_long_term_frame_idx_ = -1;
+}
+
+uint32_t H264DpbSimulator::GetDpbSize(
+    const struct H264SpsDataParser::SpsDataState& sps) noexcept {
+  uint32_t dpb_size = 16;
+  const auto* vui_parameters = sps.vui_parameters.get();
+  if (sps.vui_parameters_present_flag && vui_parameters != nullptr &&
+      vui_parameters->bitstream_restriction_flag) {
+    dpb_size = vui_parameters->max_dec_frame_buffering;
+  } else {
+    // Section A.3.1: MaxDpbFrames = Min(MaxDpbMbs / (PicWidthInMbs *
+    // FrameHeightInMbs), 16)
+    const H264LevelChecker::LevelLimits* limits =
+        H264LevelChecker::GetLevelLimits(sps);
+    H264SpsDataParser::SpsDataState::DerivedValues scratch;
+    const H264SpsDataParser::SpsDataState::DerivedValues& values =
+        sps.getDerivedValues(&scratch);
+    uint32_t frame_size_in_mbs = values.PicWidthInMbs * values.FrameHeightInMbs;
+    if (limits != nullptr && frame_size_in_mbs > 0) {
+      dpb_size = std::min(limits->MaxDpbMbs / frame_size_in_mbs, 16u);
+    }
+  }
+  // a conforming stream never holds more reference frames than frame
+  // buffers (Section E.2.1), so trust max_num_ref_frames over a smaller
+  // max_dec_frame_buffering
+  return std::max({dpb_size, static_cast<uint32_t>(sps.max_num_ref_frames),
+                   1u});
+}
+
+int64_t H264DpbSimulator::GetFrameNumWrap(
+    const DpbPicture& picture) const noexcept {
+  // Equation 8-27
+  if (picture.frame_num > frame_num_) {
+    return static_cast<int64_t>(picture.frame_num) - max_frame_num_;
+  }
+  return picture.frame_num;
+}
+
+bool H264DpbSimulator::DecodePicture(
+    const struct H264SliceHeaderParser::SliceHeaderState& slice_header,
+    const struct H264BitstreamParserState& bitstream_parser_state,
+    PictureState* picture) noexcept {
+  const struct H264PpsParser::PpsState* pps;
+  const struct H264SpsParser::SpsState* sps;
+  bitstream_parser_state.ResolvePps(slice_header.pic_parameter_set_id, &pps,
+                                    &sps);
+  return DecodePicture(slice_header, pps, sps, picture);
+}
+
+bool H264DpbSimulator::DecodePicture(
+    const struct H264AccessUnitAssembler::AccessUnitState& access_unit,
+    PictureState* picture) noexcept {
+  const auto* slice_header = access_unit.GetPrimarySliceHeader();
+  if (slice_header == nullptr) {
+    return false;
+  }
+  return DecodePicture(*slice_header, access_unit.pps.get(),
+                       access_unit.sps.get(), picture);
+}
+
+bool H264DpbSimulator::DecodePicture(
+    const struct H264SliceHeaderParser::SliceHeaderState& slice_header,
+    const struct H264PpsParser::PpsState* pps,
+    const struct H264SpsParser::SpsState* sps,
+    PictureState* picture) noexcept {
+  if (pps == nullptr || sps == nullptr || sps->sps_data == nullptr) {
+#ifdef FPRINT_ERRORS
+    fprintf(stderr, "error: no active SPS for the DPB of PPS %" PRIu8 "\n",
+            slice_header.pic_parameter_set_id);
+#endif  // FPRINT_ERRORS
+    return false;
+  }
+  const struct H264SpsDataParser::SpsDataState& sps_data = *sps->sps_data;
+  H264SpsDataParser::SpsDataState::DerivedValues scratch;
+  const H264SpsDataParser::SpsDataState::DerivedValues& values =
+      sps_data.getDerivedValues(&scratch);
+
+  PictureState result;
+  if (!pic_order_cnt_calculator_.Compute(slice_header, sps_data,
+                                         &result.pic_order_cnt)) {
+    return false;
+  }
+  result.picture_index = picture_count_;
+  result.nal_unit_type = slice_header.nal_unit_type;
+  result.nal_ref_idc = slice_header.nal_ref_idc;
+  result.slice_type = slice_header.slice_type;
+  result.frame_num = slice_header.frame_num;
+  result.dpb_size = GetDpbSize(sps_data);
+
+  bool idr_pic_flag =
+      (slice_header.nal_unit_type == CODED_SLICE_OF_IDR_PICTURE_NUT);
+  bool second_field = result.pic_order_cnt.second_field;
+  bool mmco5 = result.pic_order_cnt.memory_management_control_operation_5;
+  uint32_t max_num_ref_frames =
+      std::max(static_cast<uint32_t>(sps_data.max_num_ref_frames), 1u);
+  frame_num_ = slice_header.frame_num;
+  max_frame_num_ = values.MaxFrameNum;
+
+  // Section 8.2.5.2: a gap in frame_num
+  if (!idr_pic_flag && !second_field &&
+      sps_data.gaps_in_frame_num_value_allowed_flag &&
+      slice_header.frame_num != prev_ref_frame_num_ &&
+      slice_header.frame_num != (prev_ref_frame_num_ + 1) % max_frame_num_) {
+    FillFrameNumGap(slice_header.frame_num, max_frame_num_,
+                    max_num_ref_frames, result.dpb_size, &result.output);
+  }
+
+  // Section 8.2.4: the reference picture lists, truncated to
+  // num_ref_idx_lX_active_minus1 + 1 entries before and after the
+  // modifications
+  uint32_t slice_type = slice_header.slice_type % 5;
+  size_t num_ref_idx_l0_active =
+      1 + (slice_header.num_ref_idx_active_override_flag
+               ? slice_header.num_ref_idx_l0_active_minus1
+               : pps->num_ref_idx_l0_default_active_minus1);
+  size_t num_ref_idx_l1_active =
+      1 + (slice_header.num_ref_idx_active_override_flag
+               ? slice_header.num_ref_idx_l1_active_minus1
+               : pps->num_ref_idx_l1_default_active_minus1);
+  InitRefPicLists(slice_type, result.pic_order_cnt.PicOrderCnt,
+                  &result.ref_pic_list0, &result.ref_pic_list1);
+  if (result.ref_pic_list0.size() > num_ref_idx_l0_active) {
+    result.ref_pic_list0.resize(num_ref_idx_l0_active);
+  }
+  if (result.ref_pic_list1.size() > num_ref_idx_l1_active) {
+    result.ref_pic_list1.resize(num_ref_idx_l1_active);
+  }
+  ModifyRefPicLists(slice_header, max_frame_num_, &result.ref_pic_list0,
+                    &result.ref_pic_list1);
+  if (result.ref_pic_list0.size() > num_ref_idx_l0_active) {
+    result.ref_pic_list0.resize(num_ref_idx_l0_active);
+  }
+  if (result.ref_pic_list1.size() > num_ref_idx_l1_active) {
+    result.ref_pic_list1.resize(num_ref_idx_l1_active);
+  }
+
+  const auto* dec_ref_pic_marking = slice_header.dec_ref_pic_marking.get();
+  bool adaptive = (slice_header.nal_ref_idc != 0 &&
+                   dec_ref_pic_marking != nullptr &&
+                   dec_ref_pic_marking->adaptive_ref_pic_marking_mode_flag);
+
+  if (second_field) {
+    // the second field shares the frame store of the first one (if it was
+    // stored): only its adaptive memory control operations are left
+    for (auto& frame : dpb_) {
+      if (!frame.non_existing && frame.picture_index + 1 == picture_count_) {
+        frame.PicOrderCnt =
+            std::min(frame.PicOrderCnt, result.pic_order_cnt.PicOrderCnt);
+      }
+    }
+    if (adaptive) {
+      uint32_t long_term_frame_idx = 0;
+      AdaptiveMemoryControl(slice_header, &long_term_frame_idx);
+    }
+    RemoveUnusedFrames();
+
+  } else {
+    // Section 8.2.5.1: mark the reference pictures
+    DpbPicture current;
+    current.picture_index = picture_count_;
+    current.frame_num = slice_header.frame_num;
+    current.PicOrderCnt = result.pic_order_cnt.PicOrderCnt;
+    current.needed_for_output = 1;
+    bool long_term = false;
+    uint32_t long_term_frame_idx = 0;
+    if (idr_pic_flag) {
+      // Section 8.2.5.1: all the reference pictures are marked as unused
+      for (auto& frame : dpb_) {
+        frame.reference_marking = UNUSED_FOR_REFERENCE;
+      }
+      if (dec_ref_pic_marking != nullptr &&
+          dec_ref_pic_marking->long_term_reference_flag) {
+        long_term = true;
+        max_long_term_frame_idx_ = 0;
+      } else {
+        max_long_term_frame_idx_ = -1;
+      }
+    } else if (adaptive) {
+      long_term = AdaptiveMemoryControl(slice_header, &long_term_frame_idx);
+    } else if (slice_header.nal_ref_idc != 0) {
+      SlidingWindow(max_num_ref_frames);
+    }
+    if (mmco5) {
+      // Section 7.4.3: frame_num is inferred to be 0 after a
+      // memory_management_control_operation 5
+      current.frame_num = 0;
+    }
+    if (slice_header.nal_ref_idc != 0) {
+      current.reference_marking =
+          long_term ? LONG_TERM_REFERENCE : SHORT_TERM_REFERENCE;
+      current.long_term_frame_idx = long_term_frame_idx;
+    }
+
+    // Annex C.4.4: an IDR picture or a memory_management_control_operation
+    // 5 empties the DPB, outputting its frames unless
+    // no_output_of_prior_pics_flag is set (it is inferred to be 0 for the
+    // latter)
+    if (idr_pic_flag || mmco5) {
+      if (!(idr_pic_flag && dec_ref_pic_marking != nullptr &&
+            dec_ref_pic_marking->no_output_of_prior_pics_flag)) {
+        while (Bump(&result.output)) {
+        }
+      }
+      dpb_.clear();
+    }
+    RemoveUnusedFrames();
+
+    // Annex C.4.5: store the current picture
+    if (slice_header.nal_ref_idc != 0) {
+      Store(current, result.dpb_size, &result.output);
+    } else {
+      // Annex C.4.5.2: a non-reference picture that would be output next
+      // does not wait in a full DPB
+      bool output_first = true;
+      for (const auto& frame : dpb_) {
+        if (frame.needed_for_output &&
+            frame.PicOrderCnt <= current.PicOrderCnt) {
+          output_first = false;
+        }
+      }
+      if (dpb_.size() >= result.dpb_size && output_first) {
+        current.needed_for_output = 0;
+        result.output.push_back(current);
+      } else {
+        Store(current, result.dpb_size, &result.output);
+      }
+    }
+
+    if (slice_header.nal_ref_idc != 0) {
+      prev_ref_frame_num_ = current.frame_num;
+    }
+  }
+
+  result.dpb = dpb_;
+  picture_count_ += 1;
+  *picture = std::move(result);
+  return true;
+}
+
+void H264DpbSimulator::Flush(std::vector<DpbPicture>* output) noexcept {
+  // Annex C.4.5.3: bump every frame still waiting for output
+  while (Bump(output)) {
+  }
+  dpb_.clear();
+}
+
+void H264DpbSimulator::FillFrameNumGap(
+    uint32_t frame_num, uint32_t MaxFrameNum, uint32_t max_num_ref_frames,
+    uint32_t dpb_size, std::vector<DpbPicture>* output) noexcept {
+  // each "non-existing" frame goes through the sliding window, and is
+  // stored as a short-term reference frame not needed for output
+  uint32_t UnusedShortTermFrameNum = (prev_ref_frame_num_ + 1) % MaxFrameNum;
+  while (UnusedShortTermFrameNum != frame_num) {
+    frame_num_ = UnusedShortTermFrameNum;
+    SlidingWindow(max_num_ref_frames);
+    RemoveUnusedFrames();
+    DpbPicture non_existing;
+    non_existing.picture_index = picture_count_;
+    non_existing.frame_num = UnusedShortTermFrameNum;
+    non_existing.non_existing = 1;
+    non_existing.reference_marking = SHORT_TERM_REFERENCE;
+    Store(non_existing, dpb_size, output);
+    prev_ref_frame_num_ = UnusedShortTermFrameNum;
+    UnusedShortTermFrameNum = (UnusedShortTermFrameNum + 1) % MaxFrameNum;
+  }
+  frame_num_ = frame_num;
+}
+
+void H264DpbSimulator::InitRefPicLists(
+    uint32_t slice_type, int32_t pic_order_cnt,
+    std::vector<DpbPicture>* ref_pic_list0,
+    std::vector<DpbPicture>* ref_pic_list1) const noexcept {
+  ref_pic_list0->clear();
+  ref_pic_list1->clear();
+  if (slice_type != SliceType::P && slice_type != SliceType::SP &&
+      slice_type != SliceType::B) {
+    return;
+  }
+
+  // the long-term reference frames go last, by ascending LongTermPicNum
+  std::vector<DpbPicture> long_term;
+  for (const auto& frame : dpb_) {
+    if (frame.reference_marking == LONG_TERM_REFERENCE) {
+      long_term.push_back(frame);
+    }
+  }
+  std::stable_sort(long_term.begin(), long_term.end(),
+                   [](const DpbPicture& a, const DpbPicture& b) {
+                     return a.long_term_frame_idx < b.long_term_frame_idx;
+                   });
+
+  if (slice_type != SliceType::B) {
+    // Section 8.2.4.2.1: the short-term reference frames by descending
+    // PicNum
+    for (const auto& frame : dpb_) {
+      if (frame.reference_marking == SHORT_TERM_REFERENCE) {
+        ref_pic_list0->push_back(frame);
+      }
+    }
+    std::stable_sort(ref_pic_list0->begin(), ref_pic_list0->end(),
+                     [this](const DpbPicture& a, const DpbPicture& b) {
+                       return GetFrameNumWrap(a) > GetFrameNumWrap(b);
+                     });
+    ref_pic_list0->insert(ref_pic_list0->end(), long_term.begin(),
+                          long_term.end());
+    return;
+  }
+
+  // Section 8.2.4.2.3: the short-term reference frames preceding the
+  // current picture in output order (by descending PicOrderCnt()), then
+  // the following ones (by ascending PicOrderCnt()) in RefPicList0, and
+  // the other way around in RefPicList1. The "non-existing" frames have
+  // no picture order count, so they are left out.
+  std::vector<DpbPicture> before;
+  std::vector<DpbPicture> after;
+  for (const auto& frame : dpb_) {
+    if (frame.reference_marking != SHORT_TERM_REFERENCE ||
+        frame.non_existing) {
+      continue;
+    }
+    if (frame.PicOrderCnt <= pic_order_cnt) {
+      before.push_back(frame);
+    } else {
+      after.push_back(frame);
+    }
+  }
+  std::stable_sort(before.begin(), before.end(),
+                   [](const DpbPicture& a, const DpbPicture& b) {
+                     return a.PicOrderCnt > b.PicOrderCnt;
+                   });
+  std::stable_sort(after.begin(), after.end(),
+                   [](const DpbPicture& a, const DpbPicture& b) {
+                     return a.PicOrderCnt < b.PicOrderCnt;
+                   });
+  ref_pic_list0->insert(ref_pic_list0->end(), before.begin(), before.end());
+  ref_pic_list0->insert(ref_pic_list0->end(), after.begin(), after.end());
+  ref_pic_list0->insert(ref_pic_list0->end(), long_term.begin(),
+                        long_term.end());
+  ref_pic_list1->insert(ref_pic_list1->end(), after.begin(), after.end());
+  ref_pic_list1->insert(ref_pic_list1->end(), before.begin(), before.end());
+  ref_pic_list1->insert(ref_pic_list1->end(), long_term.begin(),
+                        long_term.end());
+  // when RefPicList1 has more than one entry and equals RefPicList0, its
+  // first two entries are switched
+  if (ref_pic_list1->size() > 1 && IsSameList(*ref_pic_list0, *ref_pic_list1)) {
+    std::swap((*ref_pic_list1)[0], (*ref_pic_list1)[1]);
+  }
+}
+
+void H264DpbSimulator::ModifyRefPicLists(
+    const struct H264SliceHeaderParser::SliceHeaderState& slice_header,
+    uint32_t MaxFrameNum, std::vector<DpbPicture>* ref_pic_list0,
+    std::vector<DpbPicture>* ref_pic_list1) const noexcept {
+  const auto* ref_pic_list_modification =
+      slice_header.ref_pic_list_modification.get();
+  if (ref_pic_list_modification == nullptr) {
+    return;
+  }
+  // the operations of both lists share modification_of_pic_nums_idc (each
+  // list's ending with 3), abs_diff_pic_num_minus1, and long_term_pic_num
+  size_t idc_index = 0;
+  size_t abs_diff_pic_num_index = 0;
+  size_t long_term_pic_num_index = 0;
+  int64_t CurrPicNum = frame_num_;
+  int64_t MaxPicNum = MaxFrameNum;
+  for (uint32_t list = 0; list < 2; list++) {
+    uint32_t ref_pic_list_modification_flag =
+        (list == 0)
+            ? ref_pic_list_modification->ref_pic_list_modification_flag_l0
+            : ref_pic_list_modification->ref_pic_list_modification_flag_l1;
+    if (!ref_pic_list_modification_flag) {
+      continue;
+    }
+    std::vector<DpbPicture>* ref_pic_list =
+        (list == 0) ? ref_pic_list0 : ref_pic_list1;
+    // Section 8.2.4.3.1: picNumLXPred starts at CurrPicNum
+    int64_t picNumLXPred = CurrPicNum;
+    size_t refIdxLX = 0;
+    uint32_t modification_of_pic_nums_idc;
+    while (GetNextValue(ref_pic_list_modification->modification_of_pic_nums_idc,
+                        &idc_index, &modification_of_pic_nums_idc) &&
+           modification_of_pic_nums_idc != 3) {
+      const DpbPicture* target = nullptr;
+      if (modification_of_pic_nums_idc == 0 ||
+          modification_of_pic_nums_idc == 1) {
+        // Section 8.2.4.3.1: short-term reference frames (Equations 8-34
+        // to 8-36)
+        uint32_t abs_diff_pic_num_minus1;
+        if (!GetNextValue(ref_pic_list_modification->abs_diff_pic_num_minus1,
+                          &abs_diff_pic_num_index, &abs_diff_pic_num_minus1)) {
+          break;
+        }
+        int64_t picNumLXNoWrap;
+        if (modification_of_pic_nums_idc == 0) {
+          picNumLXNoWrap = picNumLXPred - (abs_diff_pic_num_minus1 + 1);
+          if (picNumLXNoWrap < 0) {
+            picNumLXNoWrap += MaxPicNum;
+          }
+        } else {
+          picNumLXNoWrap = picNumLXPred + (abs_diff_pic_num_minus1 + 1);
+          if (picNumLXNoWrap >= MaxPicNum) {
+            picNumLXNoWrap -= MaxPicNum;
+          }
+        }
+        picNumLXPred = picNumLXNoWrap;
+        int64_t picNumLX = (picNumLXNoWrap > CurrPicNum)
+                               ? picNumLXNoWrap - MaxPicNum
+                               : picNumLXNoWrap;
+        for (const auto& frame : dpb_) {
+          if (frame.reference_marking == SHORT_TERM_REFERENCE &&
+              GetFrameNumWrap(frame) == picNumLX) {
+            target = &frame;
+          }
+        }
+      } else if (modification_of_pic_nums_idc == 2) {
+        // Section 8.2.4.3.2: long-term reference frames
+        uint32_t long_term_pic_num;
+        if (!GetNextValue(ref_pic_list_modification->long_term_pic_num,
+                          &long_term_pic_num_index, &long_term_pic_num)) {
+          break;
+        }
+        for (const auto& frame : dpb_) {
+          if (frame.reference_marking == LONG_TERM_REFERENCE &&
+              frame.long_term_frame_idx == long_term_pic_num) {
+            target = &frame;
+          }
+        }
+      }
+      if (target == nullptr) {
+#ifdef FPRINT_ERRORS
+        fprintf(stderr,
+                "error: modification_of_pic_nums_idc %" PRIu32
+                " refers to no reference frame\n",
+                modification_of_pic_nums_idc);
+#endif  // FPRINT_ERRORS
+        continue;
+      }
+      // place the frame at refIdxLX, and drop its later copy
+      ref_pic_list->insert(
+          ref_pic_list->begin() + static_cast<std::ptrdiff_t>(refIdxLX),
+          *target);
+      refIdxLX += 1;
+      for (size_t i = refIdxLX; i < ref_pic_list->size(); i++) {
+        if (IsSameFrame((*ref_pic_list)[i], *target)) {
+          ref_pic_list->erase(ref_pic_list->begin() +
+                              static_cast<std::ptrdiff_t>(i));
+          break;
+        }
+      }
+    }
+  }
+}
+
+void H264DpbSimulator::SlidingWindow(uint32_t max_num_ref_frames) noexcept {
+  // Section 8.2.5.3: when the DPB holds Max(max_num_ref_frames, 1)
+  // reference frames, the short-term one with the smallest FrameNumWrap is
+  // marked as unused
+  while (true) {
+    uint32_t num_ref_frames = 0;
+    DpbPicture* oldest = nullptr;
+    for (auto& frame : dpb_) {
+      if (frame.reference_marking == UNUSED_FOR_REFERENCE) {
+        continue;
+      }
+      num_ref_frames += 1;
+      if (frame.reference_marking == SHORT_TERM_REFERENCE &&
+          (oldest == nullptr ||
+           GetFrameNumWrap(frame) < GetFrameNumWrap(*oldest))) {
+        oldest = &frame;
+      }
+    }
+    if (num_ref_frames < max_num_ref_frames || oldest == nullptr) {
+      return;
+    }
+    oldest->reference_marking = UNUSED_FOR_REFERENCE;
+  }
+}
+
+bool H264DpbSimulator::AdaptiveMemoryControl(
+    const struct H264SliceHeaderParser::SliceHeaderState& slice_header,
+    uint32_t* long_term_frame_idx) noexcept {
+  const auto* dec_ref_pic_marking = slice_header.dec_ref_pic_marking.get();
+  // each operation takes its values from its own list, in order
+  size_t difference_of_pic_nums_index = 0;
+  size_t long_term_pic_num_index = 0;
+  size_t long_term_frame_idx_index = 0;
+  size_t max_long_term_frame_idx_index = 0;
+  int64_t CurrPicNum = frame_num_;
+  bool current_long_term = false;
+  for (uint32_t memory_management_control_operation :
+       dec_ref_pic_marking->memory_management_control_operation) {
+    uint32_t difference_of_pic_nums_minus1 = 0;
+    uint32_t value = 0;
+    switch (memory_management_control_operation) {
+      case 0:
+        return current_long_term;
+      case 1:
+      case 3: {
+        // Sections 8.2.5.4.1 and 8.2.5.4.3: picNumX (Equation 8-39)
+        if (!GetNextValue(dec_ref_pic_marking->difference_of_pic_nums_minus1,
+                          &difference_of_pic_nums_index,
+                          &difference_of_pic_nums_minus1) ||
+            (memory_management_control_operation == 3 &&
+             !GetNextValue(dec_ref_pic_marking->long_term_frame_idx,
+                           &long_term_frame_idx_index, &value))) {
+          return current_long_term;
+        }
+        int64_t picNumX = CurrPicNum - (difference_of_pic_nums_minus1 + 1);
+        DpbPicture* target = nullptr;
+        for (auto& frame : dpb_) {
+          if (frame.reference_marking == SHORT_TERM_REFERENCE &&
+              GetFrameNumWrap(frame) == picNumX) {
+            target = &frame;
+          }
+        }
+        if (target == nullptr) {
+#ifdef FPRINT_ERRORS
+          fprintf(stderr,
+                  "error: memory_management_control_operation %" PRIu32
+                  " refers to no short-term frame\n",
+                  memory_management_control_operation);
+#endif  // FPRINT_ERRORS
+          break;
+        }
+        if (memory_management_control_operation == 1) {
+          target->reference_marking = UNUSED_FOR_REFERENCE;
+          break;
+        }
+        // a long-term frame already using LongTermFrameIdx loses it
+        for (auto& frame : dpb_) {
+          if (frame.reference_marking == LONG_TERM_REFERENCE &&
+              frame.long_term_frame_idx == value) {
+            frame.reference_marking = UNUSED_FOR_REFERENCE;
+          }
+        }
+        target->reference_marking = LONG_TERM_REFERENCE;
+        target->long_term_frame_idx = value;
+      } break;
+      case 2:
+        // Section 8.2.5.4.2: LongTermPicNum is LongTermFrameIdx for frames
+        if (!GetNextValue(dec_ref_pic_marking->long_term_pic_num,
+                          &long_term_pic_num_index, &value)) {
+          return current_long_term;
+        }
+        for (auto& frame : dpb_) {
+          if (frame.reference_marking == LONG_TERM_REFERENCE &&
+              frame.long_term_frame_idx == value) {
+            frame.reference_marking = UNUSED_FOR_REFERENCE;
+          }
+        }
+        break;
+      case 4:
+        // Section 8.2.5.4.4
+        if (!GetNextValue(dec_ref_pic_marking->max_long_term_frame_idx_plus1,
+                          &max_long_term_frame_idx_index, &value)) {
+          return current_long_term;
+        }
+        max_long_term_frame_idx_ = static_cast<int64_t>(value) - 1;
+        for (auto& frame : dpb_) {
+          if (frame.reference_marking == LONG_TERM_REFERENCE &&
+              static_cast<int64_t>(frame.long_term_frame_idx) >
+                  max_long_term_frame_idx_) {
+            frame.reference_marking = UNUSED_FOR_REFERENCE;
+          }
+        }
+        break;
+      case 5:
+        // Section 8.2.5.4.5
+        for (auto& frame : dpb_) {
+          frame.reference_marking = UNUSED_FOR_REFERENCE;
+        }
+        max_long_term_frame_idx_ = -1;
+        break;
+      case 6:
+        // Section 8.2.5.4.6: the current picture becomes a long-term frame
+        if (!GetNextValue(dec_ref_pic_marking->long_term_frame_idx,
+                          &long_term_frame_idx_index, &value)) {
+          return current_long_term;
+        }
+        for (auto& frame : dpb_) {
+          if (frame.reference_marking == LONG_TERM_REFERENCE &&
+              frame.long_term_frame_idx == value) {
+            frame.reference_marking = UNUSED_FOR_REFERENCE;
+          }
+        }
+        current_long_term = true;
+        *long_term_frame_idx = value;
+        break;
+      default:
+#ifdef FPRINT_ERRORS
+        fprintf(stderr,
+                "error: invalid memory_management_control_operation: %" PRIu32
+                "\n",
+                memory_management_control_operation);
+#endif  // FPRINT_ERRORS
+        return current_long_term;
+    }
+  }
+  return current_long_term;
+}
+
+bool H264DpbSimulator::Bump(std::vector<DpbPicture>* output) noexcept {
+  DpbPicture* next = nullptr;
+  for (auto& frame : dpb_) {
+    if (frame.needed_for_output &&
+        (next == nullptr || frame.PicOrderCnt < next->PicOrderCnt)) {
+      next = &frame;
+    }
+  }
+  if (next == nullptr) {
+    return false;
+  }
+  next->needed_for_output = 0;
+  output->push_back(*next);
+  RemoveUnusedFrames();
+  return true;
+}
+
+void H264DpbSimulator::RemoveUnusedFrames() noexcept {
+  dpb_.erase(std::remove_if(dpb_.begin(), dpb_.end(),
+                            [](const DpbPicture& frame) {
+                              return frame.reference_marking ==
+                                         UNUSED_FOR_REFERENCE &&
+                                     !frame.needed_for_output;
+                            }),
+             dpb_.end());
+}
+
+void H264DpbSimulator::Store(const DpbPicture& picture, uint32_t dpb_size,
+                             std::vector<DpbPicture>* output) noexcept {
+  while (dpb_.size() >= dpb_size && Bump(output)) {
+  }
+#ifdef FPRINT_ERRORS
+  if (dpb_.size() >= dpb_size) {
+    fprintf(stderr,
+            "error: DPB overflow: %zu reference frames in %" PRIu32
+            " frame buffers\n",
+            dpb_.size(), dpb_size);
+  }
+#endif  // FPRINT_ERRORS
+  dpb_.push_back(picture);
+}
+
+}  // namespace h264nal
@@ -19,12 +19,11 @@ namespace h264nal {
 // You can find it on this page:
 // http://www.itu.int/rec/T-REC-H.264
 
-// Unpack RBSP and parse hrd_parameters state from the supplied buffer.
+// Parse hrd_parameters state from the supplied buffer.
 std::unique_ptr<H264HrdParametersParser::HrdParametersState>
 H264HrdParametersParser::ParseHrdParameters(const uint8_t* data,
                                             size_t length) noexcept {
-  std::vector<uint8_t> unpacked_buffer = UnescapeRbsp(data, length);
-  BitBuffer bit_buffer(unpacked_buffer.data(), unpacked_buffer.size());
+  EscapedBitBuffer bit_buffer(data, length);
   return ParseHrdParameters(&bit_buffer);
 }
 
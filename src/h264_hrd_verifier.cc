@@ -0,0 +1,381 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#include "h264_hrd_verifier.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "h264_access_unit_assembler.h"
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "h264_dpb_simulator.h"
+#include "h264_hrd_parameters_parser.h"
+#include "h264_nal_unit_parser.h"
+#include "h264_sei_parser.h"
+#include "h264_sps_parser.h"
+#include "h264_vui_parameters_parser.h"
+
+namespace {
+// the 90 kHz clock of the initial CPB removal delays (Section D.2.1)
+constexpr double kInitialCpbRemovalDelayClock = 90000.0;
+
+// the bits of |access_unit| in the CPB at |time|: it arrives at a constant
+// rate between its initial and final arrival times
+uint64_t GetArrivedBits(
+    const h264nal::H264HrdVerifier::AccessUnitTiming& access_unit,
+    double time) {
+  if (time >= access_unit.final_arrival_time) {
+    return access_unit.size;
+  }
+  if (time <= access_unit.initial_arrival_time) {
+    return 0;
+  }
+  return static_cast<uint64_t>(
+      static_cast<double>(access_unit.size) *
+      (time - access_unit.initial_arrival_time) /
+      (access_unit.final_arrival_time - access_unit.initial_arrival_time));
+}
+}  // namespace
+
+namespace h264nal {
+
+// General note: this is based off the 2012 version of the H.264 standard.
+// You can find it on this page:
+// http://www.itu.int/rec/T-REC-H.264
+
+H264HrdVerifier::H264HrdVerifier(HrdType hrd_type, uint32_t SchedSelIdx)
+    : hrd_type_(hrd_type), SchedSelIdx_(SchedSelIdx) {
+  Reset();
+}
+
+void H264HrdVerifier::Reset() noexcept {
+  violations_.clear();
+  access_unit_count_ = 0;
+  buffering_period_removal_time_ = 0;
+  initial_cpb_removal_delay_ = 0;
+  initial_cpb_removal_delay_offset_ = 0;
+  cpb_.clear();
+  arrived_bits_ = 0;
+  removed_bits_ = 0;
+  last_access_unit_ = AccessUnitTiming();
+  cpb_size_ = 0;
+  dpb_.clear();
+}
+
+uint64_t H264HrdVerifier::GetBitRate(
+    const struct H264HrdParametersParser::HrdParametersState& hrd_parameters,
+    uint32_t SchedSelIdx) noexcept {
+  if (SchedSelIdx > hrd_parameters.cpb_cnt_minus1 ||
+      SchedSelIdx >= hrd_parameters.bit_rate_value_minus1.size()) {
+    return 0;
+  }
+  // Equation E-37
+  return (static_cast<uint64_t>(
+              hrd_parameters.bit_rate_value_minus1[SchedSelIdx]) +
+          1)
+         << (6 + hrd_parameters.bit_rate_scale);
+}
+
+uint64_t H264HrdVerifier::GetCpbSize(
+    const struct H264HrdParametersParser::HrdParametersState& hrd_parameters,
+    uint32_t SchedSelIdx) noexcept {
+  if (SchedSelIdx > hrd_parameters.cpb_cnt_minus1 ||
+      SchedSelIdx >= hrd_parameters.cpb_size_value_minus1.size()) {
+    return 0;
+  }
+  // Equation E-38
+  return (static_cast<uint64_t>(
+              hrd_parameters.cpb_size_value_minus1[SchedSelIdx]) +
+          1)
+         << (4 + hrd_parameters.cpb_size_scale);
+}
+
+bool H264HrdVerifier::AddAccessUnit(
+    const struct H264AccessUnitAssembler::AccessUnitState& access_unit,
+    const struct H264BitstreamParserState& bitstream_parser_state,
+    AccessUnitTiming* timing) noexcept {
+  // the SPS the access unit was parsed with, or else (for an assembler
+  // without the parser state) the current one
+  const auto* slice_header = access_unit.GetPrimarySliceHeader();
+  const struct H264SpsParser::SpsState* sps = access_unit.sps.get();
+  if (sps == nullptr && slice_header != nullptr) {
+    const struct H264PpsParser::PpsState* pps;
+    bitstream_parser_state.ResolvePps(slice_header->pic_parameter_set_id, &pps,
+                                      &sps);
+  }
+  if (slice_header == nullptr || sps == nullptr || sps->sps_data == nullptr) {
+#ifdef FPRINT_ERRORS
+    fprintf(stderr, "error: no active SPS for the HRD access unit at %zu\n",
+            access_unit.offset);
+#endif  // FPRINT_ERRORS
+    return false;
+  }
+
+  // the SEI messages, and the size the HRD counts: the NAL units (not
+  // their start codes) for the NAL HRD, and the VCL and filler data NAL
+  // units for the VCL HRD
+  const struct H264BufferingPeriodParser::BufferingPeriodState*
+      buffering_period = nullptr;
+  const struct H264PicTimingParser::PicTimingState* pic_timing = nullptr;
+  uint64_t length = (hrd_type_ == NAL_HRD) ? 0 : access_unit.vcl_length;
+  for (const auto& nal_unit : access_unit.nal_units) {
+    if (hrd_type_ == NAL_HRD ||
+        nal_unit->nal_unit_header->nal_unit_type == FILLER_DATA_NUT) {
+      length += nal_unit->length;
+    }
+    if (nal_unit->nal_unit_payload == nullptr ||
+        nal_unit->nal_unit_payload->sei == nullptr) {
+      continue;
+    }
+    const auto* sei = nal_unit->nal_unit_payload->sei.get();
+    for (const auto& sei_message : sei->sei_message) {
+      if (buffering_period == nullptr &&
+          sei_message->buffering_period != nullptr) {
+        buffering_period = sei_message->buffering_period.get();
+      }
+      if (pic_timing == nullptr && sei_message->pic_timing != nullptr) {
+        pic_timing = sei_message->pic_timing.get();
+      }
+    }
+  }
+  if (pic_timing == nullptr) {
+#ifdef FPRINT_ERRORS
+    fprintf(stderr, "error: no pic_timing() for the HRD access unit at %zu\n",
+            access_unit.offset);
+#endif  // FPRINT_ERRORS
+    return false;
+  }
+  return AddAccessUnit(access_unit.offset, length * 8, buffering_period,
+                       *pic_timing, *sps->sps_data, timing);
+}
+
+bool H264HrdVerifier::AddAccessUnit(
+    size_t offset, uint64_t size,
+    const struct H264BufferingPeriodParser::BufferingPeriodState*
+        buffering_period,
+    const struct H264PicTimingParser::PicTimingState& pic_timing,
+    const struct H264SpsDataParser::SpsDataState& sps,
+    AccessUnitTiming* timing) noexcept {
+  // Section E.2.1: the clock tick and the HRD parameters
+  const auto* vui_parameters = sps.vui_parameters.get();
+  if (!sps.vui_parameters_present_flag || vui_parameters == nullptr ||
+      !vui_parameters->timing_info_present_flag ||
+      vui_parameters->num_units_in_tick == 0 ||
+      vui_parameters->time_scale == 0) {
+#ifdef FPRINT_ERRORS
+    fprintf(stderr, "error: no timing information for the HRD\n");
+#endif  // FPRINT_ERRORS
+    return false;
+  }
+  const struct H264HrdParametersParser::HrdParametersState* hrd_parameters =
+      nullptr;
+  if (hrd_type_ == NAL_HRD && vui_parameters->nal_hrd_parameters_present_flag) {
+    hrd_parameters = vui_parameters->nal_hrd_parameters.get();
+  } else if (hrd_type_ == VCL_HRD &&
+             vui_parameters->vcl_hrd_parameters_present_flag) {
+    hrd_parameters = vui_parameters->vcl_hrd_parameters.get();
+  }
+  uint64_t bit_rate = (hrd_parameters != nullptr)
+                          ? GetBitRate(*hrd_parameters, SchedSelIdx_)
+                          : 0;
+  if (bit_rate == 0) {
+#ifdef FPRINT_ERRORS
+    fprintf(stderr, "error: no HRD parameters for SchedSelIdx %" PRIu32 "\n",
+            SchedSelIdx_);
+#endif  // FPRINT_ERRORS
+    return false;
+  }
+  if (!pic_timing.cpb_dpb_delays_present_flag) {
+#ifdef FPRINT_ERRORS
+    fprintf(stderr, "error: no cpb_removal_delay in pic_timing()\n");
+#endif  // FPRINT_ERRORS
+    return false;
+  }
+
+  // the initial CPB removal delays of a new buffering period
+  uint32_t initial_cpb_removal_delay = initial_cpb_removal_delay_;
+  uint32_t initial_cpb_removal_delay_offset =
+      initial_cpb_removal_delay_offset_;
+  if (buffering_period != nullptr) {
+    const auto& delays = (hrd_type_ == NAL_HRD)
+                             ? buffering_period->nal_initial_cpb_removal_delay
+                             : buffering_period->vcl_initial_cpb_removal_delay;
+    const auto& offsets =
+        (hrd_type_ == NAL_HRD)
+            ? buffering_period->nal_initial_cpb_removal_delay_offset
+            : buffering_period->vcl_initial_cpb_removal_delay_offset;
+    if (SchedSelIdx_ >= delays.size() || SchedSelIdx_ >= offsets.size()) {
+#ifdef FPRINT_ERRORS
+      fprintf(stderr,
+              "error: no initial_cpb_removal_delay for SchedSelIdx %" PRIu32
+              "\n",
+              SchedSelIdx_);
+#endif  // FPRINT_ERRORS
+      return false;
+    }
+    initial_cpb_removal_delay = delays[SchedSelIdx_];
+    initial_cpb_removal_delay_offset = offsets[SchedSelIdx_];
+  } else if (access_unit_count_ == 0) {
+#ifdef FPRINT_ERRORS
+    fprintf(stderr, "error: the HRD needs a buffering_period() first\n");
+#endif  // FPRINT_ERRORS
+    return false;
+  }
+
+  AccessUnitTiming result;
+  result.access_unit_index = access_unit_count_;
+  result.offset = offset;
+  result.size = size;
+  // Equation C-1: t_c
+  double tc = static_cast<double>(vui_parameters->num_units_in_tick) /
+              static_cast<double>(vui_parameters->time_scale);
+
+  // Section C.1.2: the nominal removal time (Equations C-8 and C-9)
+  if (access_unit_count_ == 0) {
+    result.nominal_removal_time =
+        initial_cpb_removal_delay / kInitialCpbRemovalDelayClock;
+  } else {
+    result.nominal_removal_time =
+        buffering_period_removal_time_ + tc * pic_timing.cpb_removal_delay;
+  }
+
+  // Section C.1.1: the initial arrival time (Equations C-2 to C-5)
+  bool cbr_flag = (SchedSelIdx_ < hrd_parameters->cbr_flag.size() &&
+                   hrd_parameters->cbr_flag[SchedSelIdx_]);
+  if (access_unit_count_ == 0) {
+    result.initial_arrival_time = 0;
+  } else if (cbr_flag) {
+    result.initial_arrival_time = last_access_unit_.final_arrival_time;
+  } else {
+    // the first access unit of a buffering period does not arrive before
+    // its initial_cpb_removal_delay, the others before
+    // initial_cpb_removal_delay + initial_cpb_removal_delay_offset
+    uint32_t earliest_delay =
+        (buffering_period != nullptr)
+            ? initial_cpb_removal_delay
+            : initial_cpb_removal_delay + initial_cpb_removal_delay_offset;
+    double earliest_arrival_time =
+        result.nominal_removal_time -
+        earliest_delay / kInitialCpbRemovalDelayClock;
+    result.initial_arrival_time =
+        std::max(last_access_unit_.final_arrival_time, earliest_arrival_time);
+  }
+  // Equation C-6: the final arrival time
+  result.final_arrival_time =
+      result.initial_arrival_time +
+      static_cast<double>(size) / static_cast<double>(bit_rate);
+
+  // Section C.1.2: the removal time. An access unit that has not fully
+  // arrived is a CPB underflow (Section C.3), unless low_delay_hrd_flag
+  // lets its removal wait for the next clock tick after its arrival
+  // (Equation C-11).
+  result.removal_time = result.nominal_removal_time;
+  if (result.final_arrival_time > result.nominal_removal_time) {
+    if (vui_parameters->low_delay_hrd_flag) {
+      result.removal_time =
+          result.nominal_removal_time +
+          tc * std::ceil((result.final_arrival_time -
+                          result.nominal_removal_time) /
+                         tc);
+    } else {
+      HrdViolation violation;
+      violation.type = CPB_UNDERFLOW;
+      violation.access_unit_index = result.access_unit_index;
+      violation.offset = offset;
+      violation.time = result.nominal_removal_time;
+      violation.fullness = GetArrivedBits(result, result.nominal_removal_time);
+      violation.size = size;
+      violations_.push_back(violation);
+    }
+  }
+  // Equation C-12: the DPB output time
+  result.output_time = result.removal_time + tc * pic_timing.dpb_output_delay;
+
+  // the CPB removals before the access unit starts arriving
+  RemoveAccessUnits(result.initial_arrival_time);
+
+  // the access unit enters the CPB
+  if (access_unit_count_ > 0) {
+    arrived_bits_ += last_access_unit_.size;
+  }
+  last_access_unit_ = result;
+  cpb_size_ = GetCpbSize(*hrd_parameters, SchedSelIdx_);
+  cpb_.push_back({result.access_unit_index, offset, size, result.removal_time});
+  if (buffering_period != nullptr) {
+    buffering_period_removal_time_ = result.nominal_removal_time;
+    initial_cpb_removal_delay_ = initial_cpb_removal_delay;
+    initial_cpb_removal_delay_offset_ = initial_cpb_removal_delay_offset;
+  }
+
+  // Section C.2.2: the decoded picture waits in the DPB until its output
+  // time
+  dpb_.erase(std::remove_if(dpb_.begin(), dpb_.end(),
+                            [&result](const BufferedAccessUnit& picture) {
+                              return picture.time <= result.removal_time;
+                            }),
+             dpb_.end());
+  if (result.output_time > result.removal_time) {
+    dpb_.push_back({result.access_unit_index, offset, size,
+                    result.output_time});
+  }
+  uint32_t dpb_size = H264DpbSimulator::GetDpbSize(sps);
+  if (dpb_.size() > dpb_size) {
+    HrdViolation violation;
+    violation.type = DPB_OVERFLOW;
+    violation.access_unit_index = result.access_unit_index;
+    violation.offset = offset;
+    violation.time = result.removal_time;
+    violation.fullness = dpb_.size();
+    violation.size = dpb_size;
+    violations_.push_back(violation);
+  }
+
+  access_unit_count_ += 1;
+  *timing = result;
+  return true;
+}
+
+void H264HrdVerifier::Flush() noexcept {
+  RemoveAccessUnits(std::numeric_limits<double>::infinity());
+}
+
+void H264HrdVerifier::RemoveAccessUnits(double time) noexcept {
+  size_t removed = 0;
+  for (const auto& access_unit : cpb_) {
+    if (access_unit.time > time) {
+      break;
+    }
+    // Section C.3: the CPB fullness just before the removal: everything
+    // before the last access unit has arrived, and the last one may still
+    // be arriving (an access unit that underflowed the CPB is removed
+    // before it fully arrives)
+    uint64_t bits = arrived_bits_ +
+                    GetArrivedBits(last_access_unit_, access_unit.time);
+    uint64_t fullness = (bits > removed_bits_) ? bits - removed_bits_ : 0;
+    if (fullness > cpb_size_) {
+      HrdViolation violation;
+      violation.type = CPB_OVERFLOW;
+      violation.access_unit_index = last_access_unit_.access_unit_index;
+      violation.offset = last_access_unit_.offset;
+      violation.time = access_unit.time;
+      violation.fullness = fullness;
+      violation.size = cpb_size_;
+      violations_.push_back(violation);
+    }
+    removed_bits_ += access_unit.size;
+    removed += 1;
+  }
+  cpb_.erase(cpb_.begin(),
+             cpb_.begin() + static_cast<std::ptrdiff_t>(removed));
+}
+
+}  // namespace h264nal
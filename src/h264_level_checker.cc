@@ -0,0 +1,331 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#include "h264_level_checker.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "h264_access_unit_assembler.h"
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "h264_hrd_parameters_parser.h"
+#include "h264_hrd_verifier.h"
+#include "h264_sps_parser.h"
+#include "h264_vui_parameters_parser.h"
+
+namespace {
+// Table A-1, with the SliceRate of Section A.3.3
+constexpr h264nal::H264LevelChecker::LevelLimits kLevelLimitsTable[] = {
+    // level_idc, MaxMBPS, MaxFS, MaxDpbMbs, MaxBR, MaxCPB, MaxVmvR, MinCR,
+    // MaxMvsPer2Mb, SliceRate
+    {10, 1485, 99, 396, 64, 175, 64, 2, 0, 0},
+    {9, 1485, 99, 396, 128, 350, 64, 2, 0, 0},
+    {11, 3000, 396, 900, 192, 500, 128, 2, 0, 0},
+    {12, 6000, 396, 2376, 384, 1000, 128, 2, 0, 0},
+    {13, 11880, 396, 2376, 768, 2000, 128, 2, 0, 0},
+    {20, 11880, 396, 2376, 2000, 2000, 128, 2, 0, 0},
+    {21, 19800, 792, 4752, 4000, 4000, 256, 2, 0, 0},
+    {22, 20250, 1620, 8100, 4000, 4000, 256, 2, 0, 0},
+    {30, 40500, 1620, 8100, 10000, 10000, 256, 2, 32, 22},
+    {31, 108000, 3600, 18000, 14000, 14000, 512, 4, 16, 60},
+    {32, 216000, 5120, 20480, 20000, 20000, 512, 4, 16, 60},
+    {40, 245760, 8192, 32768, 20000, 25000, 512, 4, 16, 60},
+    {41, 245760, 8192, 32768, 50000, 62500, 512, 2, 16, 24},
+    {42, 522240, 8704, 34816, 50000, 62500, 512, 2, 16, 24},
+    {50, 589824, 22080, 110400, 135000, 135000, 512, 2, 16, 24},
+    {51, 983040, 36864, 184320, 240000, 240000, 512, 2, 16, 24},
+    {52, 2073600, 36864, 184320, 240000, 240000, 512, 2, 16, 24},
+    {60, 4177920, 139264, 696320, 240000, 240000, 8192, 2, 16, 24},
+    {61, 8355840, 139264, 696320, 480000, 480000, 8192, 2, 16, 24},
+    {62, 16711680, 139264, 696320, 800000, 800000, 8192, 2, 16, 24},
+};
+
+// Section A.3.1: the minimum picture interval fR, in seconds
+constexpr double kMinPictureInterval = 1.0 / 172.0;
+
+// the raw macroblock size that MinCR divides, in bytes (Section A.3.1)
+constexpr uint64_t kRawMbSize = 384;
+}  // namespace
+
+namespace h264nal {
+
+// General note: this is based off the 2012 version of the H.264 standard.
+// You can find it on this page:
+// http://www.itu.int/rec/T-REC-H.264
+
+H264LevelChecker::H264LevelChecker() { Reset(); }
+
+void H264LevelChecker::Reset() noexcept {
+  violations_.clear();
+  access_unit_count_ = 0;
+  sps_violations_.clear();
+}
+
+const H264LevelChecker::LevelLimits* H264LevelChecker::GetLevelLimits(
+    const struct H264SpsDataParser::SpsDataState& sps) noexcept {
+  uint32_t level_idc = sps.level_idc;
+  if (level_idc == 11 && sps.constraint_set3_flag &&
+      (sps.profile_idc == 66 || sps.profile_idc == 77 ||
+       sps.profile_idc == 88)) {
+    level_idc = 9;
+  }
+  for (const auto& entry : kLevelLimitsTable) {
+    if (entry.level_idc == level_idc) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+uint32_t H264LevelChecker::GetCpbBrVclFactor(
+    ProfileType profile_type) noexcept {
+  switch (profile_type) {
+    case ProfileType::BASELINE:
+    case ProfileType::CONSTRAINED_BASELINE:
+    case ProfileType::MAIN:
+    case ProfileType::EXTENDED:
+      return 1000;
+    case ProfileType::HIGH:
+    case ProfileType::PROGRESSIVE_HIGH:
+    case ProfileType::CONSTRAINED_HIGH:
+      return 1250;
+    case ProfileType::HIGH_10:
+    case ProfileType::PROGRESSIVE_HIGH_10:
+    case ProfileType::HIGH_10_INTRA:
+      return 3000;
+    case ProfileType::HIGH_422:
+    case ProfileType::HIGH_422_INTRA:
+    case ProfileType::HIGH_444:
+    case ProfileType::HIGH_444_INTRA:
+    case ProfileType::HIGH_444_PRED:
+    case ProfileType::HIGH_444_PRED_INTRA:
+    case ProfileType::CAVLC_444_INTRA:
+      return 4000;
+    default:
+      return 0;
+  }
+}
+
+uint32_t H264LevelChecker::GetCpbBrNalFactor(
+    ProfileType profile_type) noexcept {
+  // Table A-2: cpbBrNalFactor is 1.2 times cpbBrVclFactor
+  return GetCpbBrVclFactor(profile_type) / 5 * 6;
+}
+
+void H264LevelChecker::AddViolation(LevelLimitType type, size_t offset,
+                                    uint64_t value,
+                                    uint64_t max_value) noexcept {
+  LevelViolation violation;
+  violation.type = type;
+  violation.access_unit_index = access_unit_count_;
+  violation.offset = offset;
+  violation.value = value;
+  violation.max_value = max_value;
+  violations_.push_back(violation);
+}
+
+void H264LevelChecker::CheckSps(
+    const struct H264SpsDataParser::SpsDataState& sps,
+    size_t offset) noexcept {
+  const LevelLimits* limits = GetLevelLimits(sps);
+  if (limits == nullptr) {
+#ifdef FPRINT_ERRORS
+    fprintf(stderr, "error: unknown level_idc: %" PRIu32 "\n", sps.level_idc);
+#endif  // FPRINT_ERRORS
+    AddViolation(UNKNOWN_LEVEL, offset, sps.level_idc, 0);
+    return;
+  }
+  H264SpsDataParser::SpsDataState::DerivedValues scratch;
+  const H264SpsDataParser::SpsDataState::DerivedValues& values =
+      sps.getDerivedValues(&scratch);
+  uint64_t frame_size_in_mbs =
+      static_cast<uint64_t>(values.PicWidthInMbs) * values.FrameHeightInMbs;
+
+  // Section A.3.1: the frame size, and its dimensions
+  if (frame_size_in_mbs > limits->MaxFS) {
+    AddViolation(MAX_FS, offset, frame_size_in_mbs, limits->MaxFS);
+  }
+  uint64_t max_dimension = static_cast<uint64_t>(
+      std::sqrt(static_cast<double>(limits->MaxFS) * 8));
+  if (values.PicWidthInMbs > max_dimension) {
+    AddViolation(MAX_FS, offset, values.PicWidthInMbs, max_dimension);
+  }
+  if (values.FrameHeightInMbs > max_dimension) {
+    AddViolation(MAX_FS, offset, values.FrameHeightInMbs, max_dimension);
+  }
+
+  // Section A.3.1 and Section E.2.1: the frame buffers the stream needs
+  // fit in MaxDpbFrames
+  const auto* vui_parameters =
+      sps.vui_parameters_present_flag ? sps.vui_parameters.get() : nullptr;
+  if (frame_size_in_mbs > 0) {
+    uint64_t max_dpb_frames =
+        std::min<uint64_t>(limits->MaxDpbMbs / frame_size_in_mbs, 16);
+    uint64_t dpb_frames = sps.max_num_ref_frames;
+    if (vui_parameters != nullptr &&
+        vui_parameters->bitstream_restriction_flag) {
+      dpb_frames =
+          std::max<uint64_t>(dpb_frames,
+                             vui_parameters->max_dec_frame_buffering);
+    }
+    if (dpb_frames > max_dpb_frames) {
+      AddViolation(MAX_DPB_MBS, offset, dpb_frames, max_dpb_frames);
+    }
+  }
+
+  // the macroblock processing rate
+  if (vui_parameters != nullptr && vui_parameters->timing_info_present_flag &&
+      vui_parameters->num_units_in_tick > 0) {
+    double frame_rate = vui_parameters->time_scale /
+                        (2.0 * vui_parameters->num_units_in_tick);
+    uint64_t mbps = static_cast<uint64_t>(
+        std::ceil(static_cast<double>(frame_size_in_mbs) * frame_rate));
+    if (mbps > limits->MaxMBPS) {
+      AddViolation(MAX_MBPS, offset, mbps, limits->MaxMBPS);
+    }
+  }
+
+  // Section A.3.1: the HRD bit rates and CPB sizes
+  ProfileType profile_type = sps.GetProfileType();
+  if (vui_parameters == nullptr || GetCpbBrVclFactor(profile_type) == 0) {
+    return;
+  }
+  const struct H264HrdParametersParser::HrdParametersState* hrd_parameters[] =
+      {vui_parameters->nal_hrd_parameters_present_flag
+           ? vui_parameters->nal_hrd_parameters.get()
+           : nullptr,
+       vui_parameters->vcl_hrd_parameters_present_flag
+           ? vui_parameters->vcl_hrd_parameters.get()
+           : nullptr};
+  uint64_t factors[] = {GetCpbBrNalFactor(profile_type),
+                        GetCpbBrVclFactor(profile_type)};
+  for (size_t i = 0; i < 2; i++) {
+    if (hrd_parameters[i] == nullptr) {
+      continue;
+    }
+    uint64_t max_bit_rate = factors[i] * limits->MaxBR;
+    uint64_t max_cpb_size = factors[i] * limits->MaxCPB;
+    for (uint32_t SchedSelIdx = 0;
+         SchedSelIdx <= hrd_parameters[i]->cpb_cnt_minus1; SchedSelIdx++) {
+      uint64_t bit_rate =
+          H264HrdVerifier::GetBitRate(*hrd_parameters[i], SchedSelIdx);
+      if (bit_rate > max_bit_rate) {
+        AddViolation(MAX_BR, offset, bit_rate, max_bit_rate);
+      }
+      uint64_t cpb_size =
+          H264HrdVerifier::GetCpbSize(*hrd_parameters[i], SchedSelIdx);
+      if (cpb_size > max_cpb_size) {
+        AddViolation(MAX_CPB, offset, cpb_size, max_cpb_size);
+      }
+    }
+  }
+}
+
+bool H264LevelChecker::AddAccessUnit(
+    const struct H264AccessUnitAssembler::AccessUnitState& access_unit,
+    const struct H264BitstreamParserState& bitstream_parser_state) noexcept {
+  // the SPS the access unit was parsed with, or else (for an assembler
+  // without the parser state) the current one
+  const auto* slice_header = access_unit.GetPrimarySliceHeader();
+  const struct H264SpsParser::SpsState* sps = access_unit.sps.get();
+  if (sps == nullptr && slice_header != nullptr) {
+    const struct H264PpsParser::PpsState* pps;
+    bitstream_parser_state.ResolvePps(slice_header->pic_parameter_set_id, &pps,
+                                      &sps);
+  }
+  if (slice_header == nullptr || sps == nullptr || sps->sps_data == nullptr) {
+#ifdef FPRINT_ERRORS
+    fprintf(stderr, "error: no active SPS for the access unit at %zu\n",
+            access_unit.offset);
+#endif  // FPRINT_ERRORS
+    return false;
+  }
+  // NumBytesInNALunit: the start codes are not counted
+  uint64_t size = 0;
+  for (const auto& nal_unit : access_unit.nal_units) {
+    size += nal_unit->length;
+  }
+  AddAccessUnit(access_unit.offset, size,
+                static_cast<uint32_t>(access_unit.num_slices),
+                *sps->sps_data);
+  return true;
+}
+
+void H264LevelChecker::AddAccessUnit(
+    size_t offset, uint64_t size, uint32_t num_slices,
+    const struct H264SpsDataParser::SpsDataState& sps) noexcept {
+  // the limits of the SPS are checked for every access unit (the same
+  // SPS may sit at a new address, and an SPS id may be redefined at the
+  // same one), but only reported when they break differently than for the
+  // previous access unit
+  size_t sps_violation_count = violations_.size();
+  CheckSps(sps, offset);
+  std::vector<LevelViolation> sps_violations(
+      violations_.begin() +
+          static_cast<std::ptrdiff_t>(sps_violation_count),
+      violations_.end());
+  if (std::equal(sps_violations.begin(), sps_violations.end(),
+                 sps_violations_.begin(), sps_violations_.end(),
+                 [](const LevelViolation& a, const LevelViolation& b) {
+                   return a.type == b.type && a.value == b.value &&
+                          a.max_value == b.max_value;
+                 })) {
+    violations_.resize(sps_violation_count);
+  }
+  sps_violations_ = std::move(sps_violations);
+  const LevelLimits* limits = GetLevelLimits(sps);
+  const auto* vui_parameters =
+      sps.vui_parameters_present_flag ? sps.vui_parameters.get() : nullptr;
+  if (limits == nullptr || vui_parameters == nullptr ||
+      !vui_parameters->timing_info_present_flag ||
+      vui_parameters->num_units_in_tick == 0 ||
+      vui_parameters->time_scale == 0) {
+    access_unit_count_ += 1;
+    return;
+  }
+  double frame_rate =
+      vui_parameters->time_scale / (2.0 * vui_parameters->num_units_in_tick);
+  H264SpsDataParser::SpsDataState::DerivedValues scratch;
+  const H264SpsDataParser::SpsDataState::DerivedValues& values =
+      sps.getDerivedValues(&scratch);
+  double frame_size_in_mbs =
+      static_cast<double>(values.PicWidthInMbs) * values.FrameHeightInMbs;
+
+  // the macroblocks the decoder may process in the picture interval: the
+  // first access unit may take as long as the whole picture (or fR)
+  double interval_mbs = limits->MaxMBPS / frame_rate;
+  if (access_unit_count_ == 0) {
+    interval_mbs =
+        std::max(frame_size_in_mbs, kMinPictureInterval * limits->MaxMBPS);
+  }
+
+  // Section A.3.1: the access unit size
+  uint64_t max_size = static_cast<uint64_t>(kRawMbSize * interval_mbs /
+                                            limits->MinCR);
+  if (size > max_size) {
+    AddViolation(MIN_CR, offset, size, max_size);
+  }
+
+  // Section A.3.3: the slices per picture
+  ProfileType profile_type = sps.GetProfileType();
+  if (limits->SliceRate > 0 && profile_type != ProfileType::BASELINE &&
+      profile_type != ProfileType::CONSTRAINED_BASELINE &&
+      profile_type != ProfileType::UNSPECIFIED) {
+    uint64_t max_slices =
+        static_cast<uint64_t>(interval_mbs / limits->SliceRate);
+    if (num_slices > max_slices) {
+      AddViolation(MAX_SLICES, offset, num_slices, max_slices);
+    }
+  }
+  access_unit_count_ += 1;
+}
+
+}  // namespace h264nal
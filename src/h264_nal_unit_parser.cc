@@ -6,10 +6,12 @@
 
 #include <stdio.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 #include <vector>
 
+#include "h264_arena.h"
 #include "h264_bitstream_parser_state.h"
 #include "h264_common.h"
 #include "h264_nal_unit_header_parser.h"
@@ -26,6 +28,202 @@ namespace h264nal {
 // You can find it on this page:
 // http://www.itu.int/rec/T-REC-H.264
 
+namespace {
+
+// Reads the id of the parameter set NAL unit in |bit_buffer| without
+// consuming anything. pic_parameter_set_id is the first field of a PPS,
+// and seq_parameter_set_id follows profile_idc, the constraint flags, and
+// level_idc in a SPS or a SubsetSPS (Sections 7.3.2.1.1 and 7.3.2.2).
+// Returns false if the bitstream ends first.
+bool PeekParameterSetId(BitBuffer* bit_buffer, uint32_t nal_unit_type,
+                        uint32_t* id) {
+  // nal_unit_header(), plus the 3 SPS bytes
+  uint64_t skip = (nal_unit_type == PPS_NUT) ? 8 : 32;
+  uint64_t bit_count = std::min<uint64_t>(64, bit_buffer->RemainingBitCount());
+  uint64_t bits = 0;
+  if (bit_count <= skip ||
+      !bit_buffer->PeekBits(static_cast<size_t>(bit_count), bits)) {
+    return false;
+  }
+  // left align the ue(v)
+  bits <<= (64 - bit_count) + skip;
+  uint64_t available = bit_count - skip;
+  uint64_t leading_zeros = 0;
+  while (leading_zeros < available &&
+         ((bits >> (63 - leading_zeros)) & 0x01) == 0) {
+    leading_zeros++;
+  }
+  if (2 * leading_zeros + 1 > available) {
+    return false;
+  }
+  *id = static_cast<uint32_t>((bits >> (63 - 2 * leading_zeros)) - 1);
+  return true;
+}
+
+// Parses the NAL unit in |data|, which |bit_buffer| reads, without its
+// checksum. A parameter set that repeats the source of its table entry is
+// rebuilt from the entry.
+std::unique_ptr<H264NalUnitParser::NalUnitState> ParseNalUnitContents(
+    const uint8_t* data, size_t length, bool escaped, BitBuffer* bit_buffer,
+    struct H264BitstreamParserState* bitstream_parser_state,
+    ParsingOptions parsing_options) noexcept {
+  uint32_t header_byte = 0;
+  if (bitstream_parser_state == nullptr ||
+      !bit_buffer->PeekBits(8, header_byte)) {
+    return H264NalUnitParser::ParseNalUnit(bit_buffer, bitstream_parser_state,
+                                           parsing_options);
+  }
+  uint32_t nal_unit_type = header_byte & 0x1f;
+  ParseLevel parse_level = parsing_options.GetParseLevel(nal_unit_type);
+  uint32_t id = 0;
+  if (!IsParameterSet(nal_unit_type) ||
+      (parse_level != PARSE_FULL && parse_level != PARSE_PARTIAL) ||
+      !PeekParameterSetId(bit_buffer, nal_unit_type, &id)) {
+    return H264NalUnitParser::ParseNalUnit(bit_buffer, bitstream_parser_state,
+                                           parsing_options);
+  }
+  uint32_t key =
+      H264BitstreamParserState::GetParameterSetKey(nal_unit_type, id);
+
+  auto it = bitstream_parser_state->parameter_set_sources.find(key);
+  if (it != bitstream_parser_state->parameter_set_sources.end() &&
+      it->second.escaped == escaped && it->second.data.size() == length &&
+      std::equal(data, data + length, it->second.data.begin())) {
+    // a repeat: share the table entry, if it is still the one |data|
+    // parsed into
+    auto nal_unit_payload =
+        std::make_unique<H264NalUnitPayloadParser::NalUnitPayloadState>();
+    std::shared_ptr<const void> parameter_set;
+    switch (nal_unit_type) {
+      case SPS_NUT:
+        nal_unit_payload->sps = bitstream_parser_state->GetSps(id);
+        parameter_set = nal_unit_payload->sps;
+        break;
+      case PPS_NUT:
+        nal_unit_payload->pps = bitstream_parser_state->GetPps(id);
+        parameter_set = nal_unit_payload->pps;
+        break;
+      case SUBSET_SPS_NUT:
+      default:
+        nal_unit_payload->subset_sps =
+            bitstream_parser_state->GetSubsetSps(id);
+        parameter_set = nal_unit_payload->subset_sps;
+        break;
+    }
+    if (parameter_set != nullptr &&
+        parameter_set == it->second.parameter_set) {
+      auto nal_unit = std::make_unique<H264NalUnitParser::NalUnitState>();
+      nal_unit->nal_unit_header =
+          H264NalUnitHeaderParser::ParseNalUnitHeader(bit_buffer);
+      if (nal_unit->nal_unit_header == nullptr) {
+        return nullptr;
+      }
+      nal_unit->nal_unit_payload = std::move(nal_unit_payload);
+      nal_unit->parsed_length = it->second.parsed_length;
+      nal_unit->parameter_set_changed = false;
+      return nal_unit;
+    }
+  }
+
+  auto nal_unit = H264NalUnitParser::ParseNalUnit(
+      bit_buffer, bitstream_parser_state, parsing_options);
+  if (nal_unit == nullptr || !nal_unit->parameter_set_changed) {
+    return nal_unit;
+  }
+  // remember where the new table entry came from
+  auto& source = bitstream_parser_state->parameter_set_sources[key];
+  source.data.assign(data, data + length);
+  source.escaped = escaped;
+  source.parsed_length = nal_unit->parsed_length;
+  switch (nal_unit_type) {
+    case SPS_NUT:
+      source.parameter_set = nal_unit->nal_unit_payload->sps;
+      break;
+    case PPS_NUT:
+      source.parameter_set = nal_unit->nal_unit_payload->pps;
+      break;
+    case SUBSET_SPS_NUT:
+    default:
+      source.parameter_set = nal_unit->nal_unit_payload->subset_sps;
+      break;
+  }
+  return nal_unit;
+}
+
+// The checksum of the NAL unit in |data|, computed straight from the bytes.
+std::shared_ptr<NaluChecksum> GetNalUnitChecksum(
+    const uint8_t* data, size_t length, bool escaped,
+    ParsingOptions parsing_options) noexcept {
+  if (!escaped || parsing_options.checksum_escaped) {
+    return NaluChecksum::GetNaluChecksum(data, length,
+                                         parsing_options.checksum_type);
+  }
+  // the RBSP, into a buffer that is reused across calls
+  thread_local std::vector<uint8_t> rbsp;
+  UnescapeRbsp(data, length, rbsp);
+  return NaluChecksum::GetNaluChecksum(rbsp.data(), rbsp.size(),
+                                       parsing_options.checksum_type);
+}
+
+// Parses the NAL unit in |data|, which |bit_buffer| reads.
+std::unique_ptr<H264NalUnitParser::NalUnitState> ParseNalUnitFromBytes(
+    const uint8_t* data, size_t length, bool escaped, BitBuffer* bit_buffer,
+    struct H264BitstreamParserState* bitstream_parser_state,
+    ParsingOptions parsing_options) noexcept {
+  // the checksum is computed from the bytes, rather than read back
+  // through |bit_buffer|
+  ParsingOptions contents_parsing_options = parsing_options;
+  contents_parsing_options.add_checksum = false;
+  auto nal_unit =
+      ParseNalUnitContents(data, length, escaped, bit_buffer,
+                           bitstream_parser_state, contents_parsing_options);
+  if (nal_unit != nullptr && parsing_options.add_checksum) {
+    nal_unit->checksum =
+        GetNalUnitChecksum(data, length, escaped, parsing_options);
+  }
+  return nal_unit;
+}
+
+// Parses the NAL unit in |data| into |nal_unit|, with its sub-structures
+// in the |nal_unit| arena.
+bool ParseNalUnitInPlace(
+    const uint8_t* data, size_t length, bool escaped,
+    struct H264BitstreamParserState* bitstream_parser_state,
+    ParsingOptions parsing_options,
+    H264NalUnitParser::NalUnitState* nal_unit) noexcept {
+  // drop the previous contents before their memory is reused
+  nal_unit->Reset();
+  if (nal_unit->arena == nullptr) {
+    nal_unit->arena = std::make_unique<H264Arena>();
+  }
+  nal_unit->arena->Reset();
+  H264Arena::Scope arena_scope(nal_unit->arena.get());
+
+  std::unique_ptr<H264NalUnitParser::NalUnitState> parsed;
+  if (escaped) {
+    EscapedBitBuffer bit_buffer(data, length);
+    parsed = ParseNalUnitFromBytes(data, length, true, &bit_buffer,
+                                   bitstream_parser_state, parsing_options);
+  } else {
+    BitBuffer bit_buffer(data, length);
+    parsed = ParseNalUnitFromBytes(data, length, false, &bit_buffer,
+                                   bitstream_parser_state, parsing_options);
+  }
+  if (parsed == nullptr) {
+    return false;
+  }
+  // move the parsed tree over (the shell of |parsed| is in the arena too)
+  nal_unit->length = length;
+  nal_unit->parsed_length = parsed->parsed_length;
+  nal_unit->checksum = std::move(parsed->checksum);
+  nal_unit->parameter_set_changed = parsed->parameter_set_changed;
+  nal_unit->nal_unit_header = std::move(parsed->nal_unit_header);
+  nal_unit->nal_unit_payload = std::move(parsed->nal_unit_payload);
+  return true;
+}
+
+}  // namespace
+
 // Parse NAL Unit state from the supplied buffer (unescaped version).
 std::unique_ptr<H264NalUnitParser::NalUnitState>
 H264NalUnitParser::ParseNalUnitUnescaped(
@@ -34,19 +232,20 @@ H264NalUnitParser::ParseNalUnitUnescaped(
     ParsingOptions parsing_options) noexcept {
   BitBuffer bit_buffer(data, length);
 
-  return ParseNalUnit(&bit_buffer, bitstream_parser_state, parsing_options);
+  return ParseNalUnitFromBytes(data, length, false, &bit_buffer,
+                               bitstream_parser_state, parsing_options);
 }
 
-// Unpack RBSP and parse NAL Unit state from the supplied buffer.
+// Parse NAL Unit state from the supplied buffer.
 std::unique_ptr<H264NalUnitParser::NalUnitState>
 H264NalUnitParser::ParseNalUnit(
     const uint8_t* data, size_t length,
     struct H264BitstreamParserState* bitstream_parser_state,
     ParsingOptions parsing_options) noexcept {
-  std::vector<uint8_t> unpacked_buffer = UnescapeRbsp(data, length);
-  BitBuffer bit_buffer(unpacked_buffer.data(), unpacked_buffer.size());
+  EscapedBitBuffer bit_buffer(data, length);
 
-  return ParseNalUnit(&bit_buffer, bitstream_parser_state, parsing_options);
+  return ParseNalUnitFromBytes(data, length, true, &bit_buffer,
+                               bitstream_parser_state, parsing_options);
 }
 
 std::unique_ptr<H264NalUnitParser::NalUnitState>
@@ -57,12 +256,20 @@ H264NalUnitParser::ParseNalUnit(
   // H264 NAL Unit (nal_unit()) parser.
   // Section 7.3.1 ("NAL unit syntax") of the H.264
   // standard for a complete description.
+  // a skipped NAL unit costs a peek at its nal_unit_type
+  uint32_t header_byte = 0;
+  if (bit_buffer->PeekBits(8, header_byte) &&
+      parsing_options.GetParseLevel(header_byte & 0x1f) == PARSE_SKIP) {
+    return nullptr;
+  }
+
   auto nal_unit = std::make_unique<NalUnitState>();
 
   // need to calculate the checksum before parsing the bit buffer
   if (parsing_options.add_checksum) {
     // set the checksum
-    nal_unit->checksum = NaluChecksum::GetNaluChecksum(bit_buffer);
+    nal_unit->checksum = NaluChecksum::GetNaluChecksum(
+        bit_buffer, parsing_options.checksum_type);
   }
 
   // nal_unit_header()
@@ -77,7 +284,8 @@ H264NalUnitParser::ParseNalUnit(
 
   // nal_unit_payload()
   nal_unit->nal_unit_payload = H264NalUnitPayloadParser::ParseNalUnitPayload(
-      bit_buffer, *(nal_unit->nal_unit_header), bitstream_parser_state);
+      bit_buffer, *(nal_unit->nal_unit_header), bitstream_parser_state,
+      parsing_options);
   if (nal_unit->nal_unit_payload == nullptr) {
     return nullptr;
   }
@@ -85,9 +293,41 @@ H264NalUnitParser::ParseNalUnit(
   // update the parsed length
   nal_unit->parsed_length = get_current_offset(bit_buffer);
 
+  // a parameter set that parsed went into the tables
+  uint32_t nal_unit_type = nal_unit->nal_unit_header->nal_unit_type;
+  nal_unit->parameter_set_changed =
+      IsParameterSet(nal_unit_type) &&
+      nal_unit->nal_unit_payload->IsPayloadParsed(nal_unit_type);
+
   return nal_unit;
 }
 
+bool H264NalUnitParser::ParseNalUnit(
+    const uint8_t* data, size_t length,
+    struct H264BitstreamParserState* bitstream_parser_state,
+    ParsingOptions parsing_options, NalUnitState* nal_unit) noexcept {
+  return ParseNalUnitInPlace(data, length, true, bitstream_parser_state,
+                             parsing_options, nal_unit);
+}
+
+bool H264NalUnitParser::ParseNalUnitUnescaped(
+    const uint8_t* data, size_t length,
+    struct H264BitstreamParserState* bitstream_parser_state,
+    ParsingOptions parsing_options, NalUnitState* nal_unit) noexcept {
+  return ParseNalUnitInPlace(data, length, false, bitstream_parser_state,
+                             parsing_options, nal_unit);
+}
+
+void H264NalUnitParser::NalUnitState::Reset() noexcept {
+  offset = 0;
+  length = 0;
+  parsed_length = 0;
+  checksum.reset();
+  parameter_set_changed = false;
+  nal_unit_header.reset();
+  nal_unit_payload.reset();
+}
+
 #ifdef FDUMP_DEFINE
 void H264NalUnitParser::NalUnitState::fdump(
     FILE* outfp, int indent_level, ParsingOptions parsing_options) const {
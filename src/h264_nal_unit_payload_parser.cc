@@ -14,6 +14,7 @@
 #include "h264_common.h"
 #include "h264_pps_parser.h"
 #include "h264_prefix_nal_unit_parser.h"
+#include "h264_sei_parser.h"
 #include "h264_slice_layer_extension_rbsp_parser.h"
 #include "h264_slice_layer_without_partitioning_rbsp_parser.h"
 #include "h264_sps_parser.h"
@@ -25,14 +26,13 @@ namespace h264nal {
 // You can find it on this page:
 // http://www.itu.int/rec/T-REC-H.264
 
-// Unpack RBSP and parse NAL Unit payload state from the supplied buffer.
+// Parse NAL Unit payload state from the supplied buffer.
 std::unique_ptr<H264NalUnitPayloadParser::NalUnitPayloadState>
 H264NalUnitPayloadParser::ParseNalUnitPayload(
     const uint8_t* data, size_t length,
     H264NalUnitHeaderParser::NalUnitHeaderState& nal_unit_header,
     struct H264BitstreamParserState* bitstream_parser_state) noexcept {
-  std::vector<uint8_t> unpacked_buffer = UnescapeRbsp(data, length);
-  BitBuffer bit_buffer(unpacked_buffer.data(), unpacked_buffer.size());
+  EscapedBitBuffer bit_buffer(data, length);
 
   return ParseNalUnitPayload(&bit_buffer, nal_unit_header,
                              bitstream_parser_state);
@@ -57,11 +57,36 @@ H264NalUnitPayloadParser::ParseNalUnitPayload(
     BitBuffer* bit_buffer,
     H264NalUnitHeaderParser::NalUnitHeaderState& nal_unit_header,
     struct H264BitstreamParserState* bitstream_parser_state) noexcept {
+  ParsingOptions parsing_options;
+  return ParseNalUnitPayload(bit_buffer, nal_unit_header,
+                             bitstream_parser_state, parsing_options);
+}
+
+std::unique_ptr<H264NalUnitPayloadParser::NalUnitPayloadState>
+H264NalUnitPayloadParser::ParseNalUnitPayload(
+    BitBuffer* bit_buffer,
+    H264NalUnitHeaderParser::NalUnitHeaderState& nal_unit_header,
+    struct H264BitstreamParserState* bitstream_parser_state,
+    ParsingOptions parsing_options) noexcept {
   // H264 NAL Unit Payload (nal_unit()) parser.
   // Section 7.3.1 ("NAL unit syntax") of the H.264
   // standard for a complete description.
   auto nal_unit_payload = std::make_unique<NalUnitPayloadState>();
 
+  SliceHeaderField slice_header_last_field = SLICE_HEADER_ALL;
+  switch (parsing_options.GetParseLevel(nal_unit_header.nal_unit_type)) {
+    case PARSE_FULL:
+      break;
+    case PARSE_PARTIAL:
+      slice_header_last_field = parsing_options.slice_header_last_field;
+      break;
+    case PARSE_HEADER:
+    case PARSE_SKIP:
+    default:
+      // leave the payload empty
+      return nal_unit_payload;
+  }
+
   // payload (Table 7-1, Section 7.4.1)
   switch (nal_unit_header.nal_unit_type) {
     case CODED_SLICE_OF_NON_IDR_PICTURE_NUT: {
@@ -70,7 +95,8 @@ H264NalUnitPayloadParser::ParseNalUnitPayload(
           H264SliceLayerWithoutPartitioningRbspParser::
               ParseSliceLayerWithoutPartitioningRbsp(
                   bit_buffer, nal_unit_header.nal_ref_idc,
-                  nal_unit_header.nal_unit_type, bitstream_parser_state);
+                  nal_unit_header.nal_unit_type, slice_header_last_field,
+                  bitstream_parser_state);
       break;
     }
     case CODED_SLICE_DATA_PARTITION_A_NUT:
@@ -84,11 +110,27 @@ H264NalUnitPayloadParser::ParseNalUnitPayload(
           H264SliceLayerWithoutPartitioningRbspParser::
               ParseSliceLayerWithoutPartitioningRbsp(
                   bit_buffer, nal_unit_header.nal_ref_idc,
-                  nal_unit_header.nal_unit_type, bitstream_parser_state);
+                  nal_unit_header.nal_unit_type, slice_header_last_field,
+                  bitstream_parser_state);
       break;
     }
     case SEI_NUT:
-      // unimplemented
+      // sei_rbsp()
+      nal_unit_payload->sei = H264SeiParser::ParseSei(
+          bit_buffer, bitstream_parser_state, parsing_options);
+      if (nal_unit_payload->sei != nullptr) {
+        // a buffering_period() activates its SPS (Section 7.4.1.2.1)
+        for (const auto& sei_message : nal_unit_payload->sei->sei_message) {
+          if (sei_message->buffering_period == nullptr) {
+            continue;
+          }
+          auto sps = bitstream_parser_state->GetSps(
+              sei_message->buffering_period->seq_parameter_set_id);
+          if (sps != nullptr) {
+            bitstream_parser_state->active_sps = sps;
+          }
+        }
+      }
       break;
     case SPS_NUT: {
       // seq_parameter_set_rbsp()
@@ -96,6 +138,13 @@ H264NalUnitPayloadParser::ParseNalUnitPayload(
       if (nal_unit_payload->sps != nullptr) {
         uint32_t sps_id = nal_unit_payload->sps->sps_data->seq_parameter_set_id;
         bitstream_parser_state->sps[sps_id] = nal_unit_payload->sps;
+        // a redefinition of the active SPS takes its place (it can only
+        // change at an IDR picture, which activates it)
+        const auto& active_sps = bitstream_parser_state->active_sps;
+        if (active_sps != nullptr && active_sps->sps_data != nullptr &&
+            active_sps->sps_data->seq_parameter_set_id == sps_id) {
+          bitstream_parser_state->active_sps = nal_unit_payload->sps;
+        }
       }
       break;
     }
@@ -209,6 +258,8 @@ bool H264NalUnitPayloadParser::NalUnitPayloadState::IsPayloadParsed(
       return subset_sps != nullptr;
     case PREFIX_NUT:
       return prefix_nal_unit != nullptr;
+    case SEI_NUT:
+      return sei != nullptr;
     case CODED_SLICE_OF_NON_IDR_PICTURE_NUT:
     case CODED_SLICE_OF_IDR_PICTURE_NUT:
       return slice_layer_without_partitioning_rbsp != nullptr;
@@ -245,7 +296,9 @@ void H264NalUnitPayloadParser::NalUnitPayloadState::fdump(
       }
       break;
     case SEI_NUT:
-      // unimplemented
+      if (sei) {
+        sei->fdump(outfp, indent_level);
+      }
       break;
     case SPS_NUT:
       if (sps) {
@@ -0,0 +1,349 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#include "h264_pic_order_cnt_calculator.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "h264_dec_ref_pic_marking_parser.h"
+#include "h264_pps_parser.h"
+#include "h264_slice_header_parser.h"
+#include "h264_sps_parser.h"
+
+namespace {
+// delta_pic_order_cnt[i], which is inferred to be 0 when not present
+// (Section 7.4.3)
+int64_t GetDeltaPicOrderCnt(
+    const struct h264nal::H264SliceHeaderParser::SliceHeaderState&
+        slice_header,
+    size_t i) {
+  return (i < slice_header.delta_pic_order_cnt.size())
+             ? slice_header.delta_pic_order_cnt[i]
+             : 0;
+}
+}  // namespace
+
+namespace h264nal {
+
+// General note: this is based off the 2012 version of the H.264 standard.
+// You can find it on this page:
+// http://www.itu.int/rec/T-REC-H.264
+
+H264PicOrderCntCalculator::H264PicOrderCntCalculator() { Reset(); }
+
+void H264PicOrderCntCalculator::Reset() noexcept {
+  has_previous_picture_ = false;
+  prev_pic_order_cnt_msb_ = 0;
+  prev_pic_order_cnt_lsb_ = 0;
+  prev_frame_num_offset_ = 0;
+  prev_frame_num_ = 0;
+  first_field_pending_ = false;
+  first_field_ = PicOrderCnt();
+  first_field_frame_num_ = 0;
+  first_field_nal_ref_idc_ = 0;
+}
+
+bool H264PicOrderCntCalculator::HasMemoryManagementControlOperation5(
+    const struct H264SliceHeaderParser::SliceHeaderState&
+        slice_header) noexcept {
+  const auto* dec_ref_pic_marking = slice_header.dec_ref_pic_marking.get();
+  if (dec_ref_pic_marking == nullptr ||
+      !dec_ref_pic_marking->adaptive_ref_pic_marking_mode_flag) {
+    return false;
+  }
+  return std::find(
+             dec_ref_pic_marking->memory_management_control_operation.begin(),
+             dec_ref_pic_marking->memory_management_control_operation.end(),
+             5) !=
+         dec_ref_pic_marking->memory_management_control_operation.end();
+}
+
+bool H264PicOrderCntCalculator::Compute(
+    const struct H264SliceHeaderParser::SliceHeaderState& slice_header,
+    const struct H264BitstreamParserState& bitstream_parser_state,
+    PicOrderCnt* pic_order_cnt) noexcept {
+  const struct H264PpsParser::PpsState* pps;
+  const struct H264SpsParser::SpsState* sps;
+  if (!bitstream_parser_state.ResolvePps(slice_header.pic_parameter_set_id,
+                                         &pps, &sps) ||
+      sps->sps_data == nullptr) {
+#ifdef FPRINT_ERRORS
+    fprintf(stderr,
+            "error: no active SPS for the picture order count of PPS "
+            "%" PRIu8 "\n",
+            slice_header.pic_parameter_set_id);
+#endif  // FPRINT_ERRORS
+    return false;
+  }
+  return Compute(slice_header, *sps->sps_data, pic_order_cnt);
+}
+
+bool H264PicOrderCntCalculator::Compute(
+    const struct H264SliceHeaderParser::SliceHeaderState& slice_header,
+    const struct H264SpsDataParser::SpsDataState& sps,
+    PicOrderCnt* pic_order_cnt) noexcept {
+  H264SpsDataParser::SpsDataState::DerivedValues scratch;
+  const H264SpsDataParser::SpsDataState::DerivedValues& values =
+      sps.getDerivedValues(&scratch);
+
+  bool idr_pic_flag =
+      (slice_header.nal_unit_type == CODED_SLICE_OF_IDR_PICTURE_NUT);
+  bool mmco5 = HasMemoryManagementControlOperation5(slice_header);
+
+  PicOrderCnt result;
+  result.field_pic_flag = slice_header.field_pic_flag;
+  result.bottom_field_flag = slice_header.bottom_field_flag;
+  result.memory_management_control_operation_5 = mmco5;
+
+  // Section 8.2.1.2: FrameNumOffset (pic_order_cnt_type 1 and 2). A
+  // previous picture with a memory_management_control_operation 5 left
+  // prevFrameNumOffset and prevFrameNum at 0.
+  int64_t FrameNumOffset = 0;
+  if (!idr_pic_flag && has_previous_picture_) {
+    FrameNumOffset = prev_frame_num_offset_;
+    if (prev_frame_num_ > slice_header.frame_num) {
+      FrameNumOffset += values.MaxFrameNum;
+    }
+  }
+
+  switch (sps.pic_order_cnt_type) {
+    case 0:
+      ComputeType0(slice_header, values.MaxPicOrderCntLsb, &result);
+      break;
+    case 1:
+      if (!ComputeType1(slice_header, sps, FrameNumOffset, &result)) {
+        return false;
+      }
+      break;
+    case 2:
+      ComputeType2(slice_header, FrameNumOffset, &result);
+      break;
+    default:
+#ifdef FPRINT_ERRORS
+      fprintf(stderr, "invalid pic_order_cnt_type: %" PRIu8 "\n",
+              sps.pic_order_cnt_type);
+#endif  // FPRINT_ERRORS
+      return false;
+  }
+
+  // Equation 8-1: PicOrderCnt(CurrPic)
+  if (!result.field_pic_flag) {
+    result.PicOrderCnt =
+        std::min(result.TopFieldOrderCnt, result.BottomFieldOrderCnt);
+  } else if (!result.bottom_field_flag) {
+    result.PicOrderCnt = result.TopFieldOrderCnt;
+  } else {
+    result.PicOrderCnt = result.BottomFieldOrderCnt;
+  }
+
+  // Section 8.2.1: after a memory_management_control_operation 5, the
+  // picture order counts are rebased so PicOrderCnt(CurrPic) is 0
+  if (mmco5) {
+    int32_t tempPicOrderCnt = result.PicOrderCnt;
+    if (!result.field_pic_flag || !result.bottom_field_flag) {
+      result.TopFieldOrderCnt -= tempPicOrderCnt;
+    }
+    if (!result.field_pic_flag || result.bottom_field_flag) {
+      result.BottomFieldOrderCnt -= tempPicOrderCnt;
+    }
+    result.PicOrderCnt = 0;
+  }
+
+  // Section 3.30: the second field of a complementary field pair follows
+  // the first one in decoding order, with the opposite parity and the
+  // same frame_num, and both are reference fields or neither is. The
+  // second field of an IDR picture is not an IDR picture.
+  if (result.field_pic_flag && first_field_pending_ && !idr_pic_flag &&
+      first_field_.bottom_field_flag != result.bottom_field_flag &&
+      first_field_frame_num_ == slice_header.frame_num &&
+      (first_field_nal_ref_idc_ != 0) == (slice_header.nal_ref_idc != 0)) {
+    result.second_field = 1;
+    if (result.bottom_field_flag) {
+      result.TopFieldOrderCnt = first_field_.TopFieldOrderCnt;
+    } else {
+      result.BottomFieldOrderCnt = first_field_.BottomFieldOrderCnt;
+    }
+  }
+
+  // carry the state over to the next picture
+  if (mmco5) {
+    // Section 8.2.1.1: after a reference picture with a
+    // memory_management_control_operation 5, prevPicOrderCntMsb is 0, and
+    // prevPicOrderCntLsb its (rebased) TopFieldOrderCnt, or 0 for a bottom
+    // field
+    prev_pic_order_cnt_msb_ = 0;
+    prev_pic_order_cnt_lsb_ =
+        (result.field_pic_flag && result.bottom_field_flag)
+            ? 0
+            : result.TopFieldOrderCnt;
+  }
+  // Section 8.2.1.2: prevFrameNumOffset and prevFrameNum come from the
+  // previous picture. A memory_management_control_operation 5 resets
+  // both (Section 7.4.3 infers frame_num to be 0 after it).
+  prev_frame_num_offset_ = mmco5 ? 0 : FrameNumOffset;
+  prev_frame_num_ = mmco5 ? 0 : slice_header.frame_num;
+  has_previous_picture_ = true;
+
+  // a field that is not a second field may be the first field of a pair
+  first_field_pending_ =
+      (result.field_pic_flag && !result.second_field && !mmco5);
+  if (first_field_pending_) {
+    first_field_ = result;
+    first_field_frame_num_ = slice_header.frame_num;
+    first_field_nal_ref_idc_ = slice_header.nal_ref_idc;
+  }
+
+  *pic_order_cnt = result;
+  return true;
+}
+
+void H264PicOrderCntCalculator::ComputeType0(
+    const struct H264SliceHeaderParser::SliceHeaderState& slice_header,
+    uint32_t MaxPicOrderCntLsb, PicOrderCnt* pic_order_cnt) noexcept {
+  // Section 8.2.1.1: an IDR picture resets prevPicOrderCntMsb and
+  // prevPicOrderCntLsb
+  if (slice_header.nal_unit_type == CODED_SLICE_OF_IDR_PICTURE_NUT) {
+    prev_pic_order_cnt_msb_ = 0;
+    prev_pic_order_cnt_lsb_ = 0;
+  }
+
+  // Equation 8-3
+  int64_t pic_order_cnt_lsb = slice_header.pic_order_cnt_lsb;
+  int64_t max_pic_order_cnt_lsb = MaxPicOrderCntLsb;
+  int64_t PicOrderCntMsb;
+  if ((pic_order_cnt_lsb < prev_pic_order_cnt_lsb_) &&
+      ((prev_pic_order_cnt_lsb_ - pic_order_cnt_lsb) >=
+       (max_pic_order_cnt_lsb / 2))) {
+    PicOrderCntMsb = prev_pic_order_cnt_msb_ + max_pic_order_cnt_lsb;
+  } else if ((pic_order_cnt_lsb > prev_pic_order_cnt_lsb_) &&
+             ((pic_order_cnt_lsb - prev_pic_order_cnt_lsb_) >
+              (max_pic_order_cnt_lsb / 2))) {
+    PicOrderCntMsb = prev_pic_order_cnt_msb_ - max_pic_order_cnt_lsb;
+  } else {
+    PicOrderCntMsb = prev_pic_order_cnt_msb_;
+  }
+
+  // Equations 8-4 and 8-5 (and the bottom field case)
+  if (!slice_header.field_pic_flag) {
+    pic_order_cnt->TopFieldOrderCnt =
+        static_cast<int32_t>(PicOrderCntMsb + pic_order_cnt_lsb);
+    pic_order_cnt->BottomFieldOrderCnt =
+        pic_order_cnt->TopFieldOrderCnt +
+        slice_header.delta_pic_order_cnt_bottom;
+  } else if (!slice_header.bottom_field_flag) {
+    pic_order_cnt->TopFieldOrderCnt =
+        static_cast<int32_t>(PicOrderCntMsb + pic_order_cnt_lsb);
+  } else {
+    pic_order_cnt->BottomFieldOrderCnt =
+        static_cast<int32_t>(PicOrderCntMsb + pic_order_cnt_lsb);
+  }
+
+  if (slice_header.nal_ref_idc != 0) {
+    // the next picture's prevPicOrderCntMsb and prevPicOrderCntLsb (a
+    // memory_management_control_operation 5 overrides them, see Compute())
+    prev_pic_order_cnt_msb_ = PicOrderCntMsb;
+    prev_pic_order_cnt_lsb_ = pic_order_cnt_lsb;
+  }
+}
+
+bool H264PicOrderCntCalculator::ComputeType1(
+    const struct H264SliceHeaderParser::SliceHeaderState& slice_header,
+    const struct H264SpsDataParser::SpsDataState& sps, int64_t FrameNumOffset,
+    PicOrderCnt* pic_order_cnt) noexcept {
+  uint32_t num_ref_frames_in_pic_order_cnt_cycle =
+      sps.num_ref_frames_in_pic_order_cnt_cycle;
+  if (sps.offset_for_ref_frame.size() <
+      num_ref_frames_in_pic_order_cnt_cycle) {
+#ifdef FPRINT_ERRORS
+    fprintf(stderr,
+            "error: offset_for_ref_frame has %zu values, not %" PRIu32 "\n",
+            sps.offset_for_ref_frame.size(),
+            num_ref_frames_in_pic_order_cnt_cycle);
+#endif  // FPRINT_ERRORS
+    return false;
+  }
+
+  // Equation 8-6
+  int64_t absFrameNum = 0;
+  if (num_ref_frames_in_pic_order_cnt_cycle != 0) {
+    absFrameNum = FrameNumOffset + slice_header.frame_num;
+  }
+  if (slice_header.nal_ref_idc == 0 && absFrameNum > 0) {
+    absFrameNum = absFrameNum - 1;
+  }
+
+  // Equation 8-9
+  int64_t expectedPicOrderCnt = 0;
+  if (absFrameNum > 0) {
+    // Equation 8-7
+    int64_t picOrderCntCycleCnt =
+        (absFrameNum - 1) / num_ref_frames_in_pic_order_cnt_cycle;
+    int64_t frameNumInPicOrderCntCycle =
+        (absFrameNum - 1) % num_ref_frames_in_pic_order_cnt_cycle;
+    // Equation 8-8
+    int64_t ExpectedDeltaPerPicOrderCntCycle = 0;
+    for (uint32_t i = 0; i < num_ref_frames_in_pic_order_cnt_cycle; i++) {
+      ExpectedDeltaPerPicOrderCntCycle += sps.offset_for_ref_frame[i];
+    }
+    expectedPicOrderCnt =
+        picOrderCntCycleCnt * ExpectedDeltaPerPicOrderCntCycle;
+    for (int64_t i = 0; i <= frameNumInPicOrderCntCycle; i++) {
+      expectedPicOrderCnt += sps.offset_for_ref_frame[static_cast<size_t>(i)];
+    }
+  }
+  if (slice_header.nal_ref_idc == 0) {
+    expectedPicOrderCnt = expectedPicOrderCnt + sps.offset_for_non_ref_pic;
+  }
+
+  // Equation 8-10
+  if (!slice_header.field_pic_flag) {
+    int64_t TopFieldOrderCnt =
+        expectedPicOrderCnt + GetDeltaPicOrderCnt(slice_header, 0);
+    pic_order_cnt->TopFieldOrderCnt = static_cast<int32_t>(TopFieldOrderCnt);
+    pic_order_cnt->BottomFieldOrderCnt = static_cast<int32_t>(
+        TopFieldOrderCnt + sps.offset_for_top_to_bottom_field +
+        GetDeltaPicOrderCnt(slice_header, 1));
+  } else if (!slice_header.bottom_field_flag) {
+    pic_order_cnt->TopFieldOrderCnt = static_cast<int32_t>(
+        expectedPicOrderCnt + GetDeltaPicOrderCnt(slice_header, 0));
+  } else {
+    pic_order_cnt->BottomFieldOrderCnt = static_cast<int32_t>(
+        expectedPicOrderCnt + sps.offset_for_top_to_bottom_field +
+        GetDeltaPicOrderCnt(slice_header, 0));
+  }
+  return true;
+}
+
+void H264PicOrderCntCalculator::ComputeType2(
+    const struct H264SliceHeaderParser::SliceHeaderState& slice_header,
+    int64_t FrameNumOffset, PicOrderCnt* pic_order_cnt) noexcept {
+  // Equation 8-12
+  int64_t tempPicOrderCnt = 0;
+  if (slice_header.nal_unit_type != CODED_SLICE_OF_IDR_PICTURE_NUT) {
+    tempPicOrderCnt = 2 * (FrameNumOffset + slice_header.frame_num);
+    if (slice_header.nal_ref_idc == 0) {
+      tempPicOrderCnt = tempPicOrderCnt - 1;
+    }
+  }
+
+  // Equation 8-13
+  if (!slice_header.field_pic_flag) {
+    pic_order_cnt->TopFieldOrderCnt = static_cast<int32_t>(tempPicOrderCnt);
+    pic_order_cnt->BottomFieldOrderCnt =
+        static_cast<int32_t>(tempPicOrderCnt);
+  } else if (!slice_header.bottom_field_flag) {
+    pic_order_cnt->TopFieldOrderCnt = static_cast<int32_t>(tempPicOrderCnt);
+  } else {
+    pic_order_cnt->BottomFieldOrderCnt =
+        static_cast<int32_t>(tempPicOrderCnt);
+  }
+}
+
+}  // namespace h264nal
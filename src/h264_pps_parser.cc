@@ -20,11 +20,10 @@ namespace h264nal {
 // You can find it on this page:
 // http://www.itu.int/rec/T-REC-H.264
 
-// Unpack RBSP and parse PPS state from the supplied buffer.
+// Parse PPS state from the supplied buffer.
 std::shared_ptr<H264PpsParser::PpsState> H264PpsParser::ParsePps(
     const uint8_t* data, size_t length, uint32_t chroma_format_idc) noexcept {
-  std::vector<uint8_t> unpacked_buffer = UnescapeRbsp(data, length);
-  BitBuffer bit_buffer(unpacked_buffer.data(), unpacked_buffer.size());
+  EscapedBitBuffer bit_buffer(data, length);
   return ParsePps(&bit_buffer, chroma_format_idc);
 }
 
@@ -39,7 +38,7 @@ std::shared_ptr<H264PpsParser::PpsState> H264PpsParser::ParsePps(
   auto pps = std::make_shared<PpsState>();
 
   // input parameters
-  pps->chroma_format_idc = chroma_format_idc;
+  pps->chroma_format_idc = static_cast<uint8_t>(chroma_format_idc);
 
   // pic_parameter_set_id  ue(v)
   if (!bit_buffer->ReadExponentialGolomb(pps->pic_parameter_set_id)) {
@@ -299,7 +298,8 @@ std::shared_ptr<H264PpsParser::PpsState> H264PpsParser::ParsePps(
 
     if (pps->pic_scaling_matrix_present_flag) {
       uint32_t max_pic_scaling_list_present_flag =
-          6 + ((chroma_format_idc != 3) ? 2 : 6) * pps->transform_8x8_mode_flag;
+          6 + ((chroma_format_idc != 3) ? 2u : 6u) *
+                  pps->transform_8x8_mode_flag;
       for (uint32_t i = 0; i < max_pic_scaling_list_present_flag; ++i) {
         // pic_scaling_list_present_flag  u(1)
         if (!bit_buffer->ReadBits(1, bits_tmp)) {
@@ -343,10 +343,16 @@ uint32_t H264PpsParser::PpsState::getSliceGroupIdLen() noexcept {
 }
 
 // Section 7.3.2.1.1.1
+template <size_t N>
 bool H264PpsParser::PpsState::scaling_list(
-    BitBuffer* bit_buffer, uint32_t i, std::vector<uint32_t>& scalingList,
+    BitBuffer* bit_buffer, uint32_t i, InlineVector<uint32_t, N>& scalingList,
     uint32_t sizeOfScalingList,
-    std::vector<uint32_t>& useDefaultScalingMatrixFlag) noexcept {
+    InlineVector<uint32_t, 6>& useDefaultScalingMatrixFlag) noexcept {
+  // the lists are inline: check they can hold what is asked for
+  if (i >= useDefaultScalingMatrixFlag.capacity() ||
+      sizeOfScalingList > scalingList.capacity()) {
+    return false;
+  }
   uint32_t lastScale = 8;
   uint32_t nextScale = 8;
   for (uint32_t j = 0; j < sizeOfScalingList; j++) {
@@ -6,10 +6,10 @@
 
 #include <stdio.h>
 
+#include <array>
 #include <cinttypes>
 #include <cstdint>
 #include <memory>
-#include <vector>
 
 #include "h264_common.h"
 
@@ -19,14 +19,13 @@ namespace h264nal {
 // You can find it on this page:
 // http://www.itu.int/rec/T-REC-H.264
 
-// Unpack RBSP and parse pred_weight_table state from the supplied buffer.
+// Parse pred_weight_table state from the supplied buffer.
 std::unique_ptr<H264PredWeightTableParser::PredWeightTableState>
 H264PredWeightTableParser::ParsePredWeightTable(
     const uint8_t* data, size_t length, uint32_t chroma_array_type,
     uint32_t slice_type, uint32_t num_ref_idx_l0_active_minus1,
     uint32_t num_ref_idx_l1_active_minus1) noexcept {
-  std::vector<uint8_t> unpacked_buffer = UnescapeRbsp(data, length);
-  BitBuffer bit_buffer(unpacked_buffer.data(), unpacked_buffer.size());
+  EscapedBitBuffer bit_buffer(data, length);
   return ParsePredWeightTable(&bit_buffer, chroma_array_type, slice_type,
                               num_ref_idx_l0_active_minus1,
                               num_ref_idx_l1_active_minus1);
@@ -39,12 +38,28 @@ H264PredWeightTableParser::ParsePredWeightTable(
     uint32_t num_ref_idx_l1_active_minus1) noexcept {
   uint32_t bits_tmp;
   int32_t sgolomb_tmp;
+  std::array<int32_t, 2> weight_tmp;
+  std::array<int32_t, 2> offset_tmp;
 
   // H264 pred_weight_table() NAL Unit.
   // Section 7.3.3.2 ("Prediction weight table syntax") of the
   // H.264 standard for a complete description.
   auto pred_weight_table = std::make_unique<PredWeightTableState>();
 
+  // the lists are inline: check they can hold what is asked for
+  if (num_ref_idx_l0_active_minus1 > kNumRefIdxActiveMinus1Max ||
+      num_ref_idx_l1_active_minus1 > kNumRefIdxActiveMinus1Max) {
+#ifdef FPRINT_ERRORS
+    fprintf(stderr,
+            "invalid num_ref_idx_active_minus1: (%" PRIu32 ", %" PRIu32
+            ") not in range "
+            "[0, %" PRIu32 "]\n",
+            num_ref_idx_l0_active_minus1, num_ref_idx_l1_active_minus1,
+            kNumRefIdxActiveMinus1Max);
+#endif  // FPRINT_ERRORS
+    return nullptr;
+  }
+
   // store input values
   pred_weight_table->chroma_array_type = chroma_array_type;
   pred_weight_table->slice_type = slice_type;
@@ -123,21 +138,19 @@ H264PredWeightTableParser::ParsePredWeightTable(
       pred_weight_table->chroma_weight_l0_flag.push_back(bits_tmp);
 
       if (pred_weight_table->chroma_weight_l0_flag[i]) {
-        pred_weight_table->chroma_weight_l0.emplace_back();
-        pred_weight_table->chroma_offset_l0.emplace_back();
         for (uint32_t j = 0; j < 2; ++j) {
           // chroma_weight_l0[i][j]  se(v)
-          if (!bit_buffer->ReadSignedExponentialGolomb(sgolomb_tmp)) {
+          if (!bit_buffer->ReadSignedExponentialGolomb(weight_tmp[j])) {
             return nullptr;
           }
-          pred_weight_table->chroma_weight_l0.back().push_back(sgolomb_tmp);
 
           // chroma_offset_l0[i][j]  se(v)
-          if (!bit_buffer->ReadSignedExponentialGolomb(sgolomb_tmp)) {
+          if (!bit_buffer->ReadSignedExponentialGolomb(offset_tmp[j])) {
             return nullptr;
           }
-          pred_weight_table->chroma_offset_l0.back().push_back(sgolomb_tmp);
         }
+        pred_weight_table->chroma_weight_l0.push_back(weight_tmp);
+        pred_weight_table->chroma_offset_l0.push_back(offset_tmp);
       }
     }
   }
@@ -174,22 +187,19 @@ H264PredWeightTableParser::ParsePredWeightTable(
         pred_weight_table->chroma_weight_l1_flag.push_back(bits_tmp);
 
         if (pred_weight_table->chroma_weight_l1_flag[i]) {
-          // chroma_weight_l1[i][j]  se(v)
-          pred_weight_table->chroma_weight_l1.emplace_back();
-
-          // chroma_offset_l1[i][j]  se(v)
-          pred_weight_table->chroma_offset_l1.emplace_back();
           for (uint32_t j = 0; j < 2; ++j) {
-            if (!bit_buffer->ReadSignedExponentialGolomb(sgolomb_tmp)) {
+            // chroma_weight_l1[i][j]  se(v)
+            if (!bit_buffer->ReadSignedExponentialGolomb(weight_tmp[j])) {
               return nullptr;
             }
-            pred_weight_table->chroma_weight_l1.back().push_back(sgolomb_tmp);
 
-            if (!bit_buffer->ReadSignedExponentialGolomb(sgolomb_tmp)) {
+            // chroma_offset_l1[i][j]  se(v)
+            if (!bit_buffer->ReadSignedExponentialGolomb(offset_tmp[j])) {
               return nullptr;
             }
-            pred_weight_table->chroma_offset_l1.back().push_back(sgolomb_tmp);
           }
+          pred_weight_table->chroma_weight_l1.push_back(weight_tmp);
+          pred_weight_table->chroma_offset_l1.push_back(offset_tmp);
         }
       }
     }
@@ -214,7 +224,7 @@ void H264PredWeightTableParser::PredWeightTableState::fdump(
 
   fdump_indent_level(outfp, indent_level);
   fprintf(outfp, "luma_weight_l0_flag {");
-  for (const uint32_t& v : luma_weight_l0_flag) {
+  for (const uint8_t& v : luma_weight_l0_flag) {
     fprintf(outfp, " %u", v);
   }
   fprintf(outfp, " }");
@@ -236,14 +246,14 @@ void H264PredWeightTableParser::PredWeightTableState::fdump(
   if (chroma_array_type != 0) {
     fdump_indent_level(outfp, indent_level);
     fprintf(outfp, "chroma_weight_l0_flag {");
-    for (const uint32_t& v : chroma_weight_l0_flag) {
+    for (const uint8_t& v : chroma_weight_l0_flag) {
       fprintf(outfp, " %u", v);
     }
     fprintf(outfp, " }");
 
     fdump_indent_level(outfp, indent_level);
     fprintf(outfp, "chroma_weight_l0 {");
-    for (const std::vector<int32_t>& vv : chroma_weight_l0) {
+    for (const std::array<int32_t, 2>& vv : chroma_weight_l0) {
       fprintf(outfp, " {");
       for (const int32_t& v : vv) {
         fprintf(outfp, " %i", v);
@@ -254,7 +264,7 @@ void H264PredWeightTableParser::PredWeightTableState::fdump(
 
     fdump_indent_level(outfp, indent_level);
     fprintf(outfp, "chroma_offset_l0 {");
-    for (const std::vector<int32_t>& vv : chroma_offset_l0) {
+    for (const std::array<int32_t, 2>& vv : chroma_offset_l0) {
       fprintf(outfp, " {");
       for (const int32_t& v : vv) {
         fprintf(outfp, " %i", v);
@@ -268,7 +278,7 @@ void H264PredWeightTableParser::PredWeightTableState::fdump(
       (slice_type == SliceType::B_ALL)) {  // slice_type == B
     fdump_indent_level(outfp, indent_level);
     fprintf(outfp, "luma_weight_l1_flag {");
-    for (const uint32_t& v : luma_weight_l1_flag) {
+    for (const uint8_t& v : luma_weight_l1_flag) {
       fprintf(outfp, " %u", v);
     }
     fprintf(outfp, " }");
@@ -290,14 +300,14 @@ void H264PredWeightTableParser::PredWeightTableState::fdump(
     if (chroma_array_type != 0) {
       fdump_indent_level(outfp, indent_level);
       fprintf(outfp, "chroma_weight_l1_flag {");
-      for (const uint32_t& v : chroma_weight_l1_flag) {
+      for (const uint8_t& v : chroma_weight_l1_flag) {
         fprintf(outfp, " %u", v);
       }
       fprintf(outfp, " }");
 
       fdump_indent_level(outfp, indent_level);
       fprintf(outfp, "chroma_weight_l1 {");
-      for (const std::vector<int32_t>& vv : chroma_weight_l1) {
+      for (const std::array<int32_t, 2>& vv : chroma_weight_l1) {
         fprintf(outfp, " {");
         for (const int32_t& v : vv) {
           fprintf(outfp, " %i", v);
@@ -308,7 +318,7 @@ void H264PredWeightTableParser::PredWeightTableState::fdump(
 
       fdump_indent_level(outfp, indent_level);
       fprintf(outfp, "chroma_offset_l1 {");
-      for (const std::vector<int32_t>& vv : chroma_offset_l1) {
+      for (const std::array<int32_t, 2>& vv : chroma_offset_l1) {
         fprintf(outfp, " {");
         for (const int32_t& v : vv) {
           fprintf(outfp, " %i", v);
@@ -26,8 +26,7 @@ std::unique_ptr<H264PrefixNalUnitSvcParser::PrefixNalUnitSvcState>
 H264PrefixNalUnitSvcParser::ParsePrefixNalUnitSvc(
     const uint8_t* data, size_t length, uint32_t nal_ref_idc,
     uint32_t use_ref_base_pic_flag, uint32_t idr_flag) noexcept {
-  std::vector<uint8_t> unpacked_buffer = UnescapeRbsp(data, length);
-  BitBuffer bit_buffer(unpacked_buffer.data(), unpacked_buffer.size());
+  EscapedBitBuffer bit_buffer(data, length);
   return ParsePrefixNalUnitSvc(&bit_buffer, nal_ref_idc, use_ref_base_pic_flag,
                                idr_flag);
 }
@@ -102,8 +101,7 @@ H264PrefixNalUnitRbspParser::ParsePrefixNalUnitRbsp(
     const uint8_t* data, size_t length, uint32_t svc_extension_flag,
     uint32_t nal_ref_idc, uint32_t use_ref_base_pic_flag,
     uint32_t idr_flag) noexcept {
-  std::vector<uint8_t> unpacked_buffer = UnescapeRbsp(data, length);
-  BitBuffer bit_buffer(unpacked_buffer.data(), unpacked_buffer.size());
+  EscapedBitBuffer bit_buffer(data, length);
   return ParsePrefixNalUnitRbsp(&bit_buffer, svc_extension_flag, nal_ref_idc,
                                 use_ref_base_pic_flag, idr_flag);
 }
@@ -19,13 +19,11 @@ namespace h264nal {
 // You can find it on this page:
 // http://www.itu.int/rec/T-REC-H.264
 
-// Unpack RBSP and parse ref_pic_list_modification state from the supplied
-// buffer.
+// Parse ref_pic_list_modification state from the supplied buffer.
 std::unique_ptr<H264RefPicListModificationParser::RefPicListModificationState>
 H264RefPicListModificationParser::ParseRefPicListModification(
     const uint8_t* data, size_t length, uint32_t slice_type) noexcept {
-  std::vector<uint8_t> unpacked_buffer = UnescapeRbsp(data, length);
-  BitBuffer bit_buffer(unpacked_buffer.data(), unpacked_buffer.size());
+  EscapedBitBuffer bit_buffer(data, length);
   return ParseRefPicListModification(&bit_buffer, slice_type);
 }
 
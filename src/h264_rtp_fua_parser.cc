@@ -20,12 +20,11 @@ namespace h264nal {
 // You can find it on this page:
 // https://tools.ietf.org/html/rfc6184#section-5.6
 
-// Unpack RBSP and parse RTP FU-A state from the supplied buffer.
+// Parse RTP FU-A state from the supplied buffer.
 std::unique_ptr<H264RtpFuAParser::RtpFuAState> H264RtpFuAParser::ParseRtpFuA(
     const uint8_t* data, size_t length, uint32_t nal_ref_idc,
     struct H264BitstreamParserState* bitstream_parser_state) noexcept {
-  std::vector<uint8_t> unpacked_buffer = UnescapeRbsp(data, length);
-  BitBuffer bit_buffer(unpacked_buffer.data(), unpacked_buffer.size());
+  EscapedBitBuffer bit_buffer(data, length);
   return ParseRtpFuA(&bit_buffer, nal_ref_idc, bitstream_parser_state);
 }
 
@@ -19,13 +19,12 @@ namespace h264nal {
 // You can find it on this page:
 // https://tools.ietf.org/html/rfc6184#section-5.6
 
-// Unpack RBSP and parse RTP Single NAL Unit state from the supplied buffer.
+// Parse RTP Single NAL Unit state from the supplied buffer.
 std::unique_ptr<H264RtpSingleParser::RtpSingleState>
 H264RtpSingleParser::ParseRtpSingle(
     const uint8_t* data, size_t length,
     struct H264BitstreamParserState* bitstream_parser_state) noexcept {
-  std::vector<uint8_t> unpacked_buffer = UnescapeRbsp(data, length);
-  BitBuffer bit_buffer(unpacked_buffer.data(), unpacked_buffer.size());
+  EscapedBitBuffer bit_buffer(data, length);
   return ParseRtpSingle(&bit_buffer, bitstream_parser_state);
 }
 
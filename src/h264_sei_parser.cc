@@ -0,0 +1,773 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#include "h264_sei_parser.h"
+
+#include <stdio.h>
+
+#include <cinttypes>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "h264_hrd_parameters_parser.h"
+#include "h264_sps_parser.h"
+#include "h264_vui_parameters_parser.h"
+
+namespace {
+// Maps the |length| RBSP bytes at |offset| in |bit_buffer| to the bytes
+// they came from, as passed to it. Only the first and last byte are
+// mapped, so the emulation prevention bytes just outside the span are left
+// out.
+void GetEscapedSpan(const h264nal::BitBuffer& bit_buffer, size_t offset,
+                    size_t length, size_t* escaped_offset,
+                    size_t* escaped_length) {
+  if (length == 0) {
+    if (!bit_buffer.GetEscapedOffset(offset, escaped_offset)) {
+      *escaped_offset = bit_buffer.GetByteCount();
+    }
+    *escaped_length = 0;
+    return;
+  }
+  size_t escaped_last = 0;
+  // the callers have already checked the span is in the buffer
+  bit_buffer.GetEscapedOffset(offset, escaped_offset);
+  bit_buffer.GetEscapedOffset(offset + length - 1, &escaped_last);
+  *escaped_length = escaped_last + 1 - *escaped_offset;
+}
+
+// The VUI of |sps| (nullptr if it has none).
+const struct h264nal::H264VuiParametersParser::VuiParametersState* GetVui(
+    const struct h264nal::H264SpsParser::SpsState* sps) {
+  if (sps == nullptr || sps->sps_data == nullptr ||
+      !sps->sps_data->vui_parameters_present_flag) {
+    return nullptr;
+  }
+  return sps->sps_data->vui_parameters.get();
+}
+
+// The hrd_parameters() that give the pic_timing() field lengths: the NAL
+// ones if present, or else the VCL ones (Section D.2.3 requires them to
+// match when both are present).
+const struct h264nal::H264HrdParametersParser::HrdParametersState* GetHrd(
+    const struct h264nal::H264VuiParametersParser::VuiParametersState* vui) {
+  if (vui == nullptr) {
+    return nullptr;
+  }
+  if (vui->nal_hrd_parameters_present_flag) {
+    return vui->nal_hrd_parameters.get();
+  }
+  if (vui->vcl_hrd_parameters_present_flag) {
+    return vui->vcl_hrd_parameters.get();
+  }
+  return nullptr;
+}
+
+// Reads the initial_cpb_removal_delay and initial_cpb_removal_delay_offset
+// of every SchedSelIdx in |hrd|.
+bool ReadInitialCpbRemovalDelays(
+    h264nal::BitBuffer* bit_buffer,
+    const struct h264nal::H264HrdParametersParser::HrdParametersState& hrd,
+    h264nal::InlineVector<uint32_t, 32>* initial_cpb_removal_delay,
+    h264nal::InlineVector<uint32_t, 32>* initial_cpb_removal_delay_offset) {
+  uint32_t bits_tmp;
+  size_t length = hrd.initial_cpb_removal_delay_length_minus1 + 1;
+  for (uint32_t SchedSelIdx = 0; SchedSelIdx <= hrd.cpb_cnt_minus1;
+       SchedSelIdx++) {
+    // initial_cpb_removal_delay[SchedSelIdx]  u(v)
+    if (!bit_buffer->ReadBits(length, bits_tmp)) {
+      return false;
+    }
+    initial_cpb_removal_delay->push_back(bits_tmp);
+    // initial_cpb_removal_delay_offset[SchedSelIdx]  u(v)
+    if (!bit_buffer->ReadBits(length, bits_tmp)) {
+      return false;
+    }
+    initial_cpb_removal_delay_offset->push_back(bits_tmp);
+  }
+  return true;
+}
+}  // namespace
+
+namespace h264nal {
+
+// General note: this is based off the 2012 version of the H.264 standard.
+// You can find it on this page:
+// http://www.itu.int/rec/T-REC-H.264
+
+// buffering_period()
+std::unique_ptr<H264BufferingPeriodParser::BufferingPeriodState>
+H264BufferingPeriodParser::ParseBufferingPeriod(
+    BitBuffer* bit_buffer,
+    const struct H264BitstreamParserState* bitstream_parser_state) noexcept {
+  // H264 buffering period SEI message (buffering_period()) parser.
+  // Section D.1.2 ("Buffering period SEI message syntax") of the H.264
+  // standard for a complete description.
+  auto buffering_period = std::make_unique<BufferingPeriodState>();
+
+  // seq_parameter_set_id  ue(v)
+  if (!bit_buffer->ReadExponentialGolomb(
+          buffering_period->seq_parameter_set_id)) {
+    return nullptr;
+  }
+  auto sps = bitstream_parser_state->GetSps(
+      buffering_period->seq_parameter_set_id);
+  const auto* vui = GetVui(sps.get());
+  if (vui == nullptr) {
+#ifdef FPRINT_ERRORS
+    fprintf(stderr,
+            "error: buffering_period() needs the VUI of SPS %" PRIu8 "\n",
+            buffering_period->seq_parameter_set_id);
+#endif  // FPRINT_ERRORS
+    return nullptr;
+  }
+
+  // input parameters
+  buffering_period->nal_hrd_parameters_present_flag =
+      (vui->nal_hrd_parameters_present_flag &&
+       vui->nal_hrd_parameters != nullptr);
+  buffering_period->vcl_hrd_parameters_present_flag =
+      (vui->vcl_hrd_parameters_present_flag &&
+       vui->vcl_hrd_parameters != nullptr);
+
+  if (buffering_period->nal_hrd_parameters_present_flag) {
+    if (!ReadInitialCpbRemovalDelays(
+            bit_buffer, *vui->nal_hrd_parameters,
+            &buffering_period->nal_initial_cpb_removal_delay,
+            &buffering_period->nal_initial_cpb_removal_delay_offset)) {
+      return nullptr;
+    }
+  }
+  if (buffering_period->vcl_hrd_parameters_present_flag) {
+    if (!ReadInitialCpbRemovalDelays(
+            bit_buffer, *vui->vcl_hrd_parameters,
+            &buffering_period->vcl_initial_cpb_removal_delay,
+            &buffering_period->vcl_initial_cpb_removal_delay_offset)) {
+      return nullptr;
+    }
+  }
+
+  return buffering_period;
+}
+
+// pic_timing()
+std::unique_ptr<H264PicTimingParser::PicTimingState>
+H264PicTimingParser::ParsePicTiming(
+    BitBuffer* bit_buffer, const struct H264SpsParser::SpsState* sps) noexcept {
+  // H264 picture timing SEI message (pic_timing()) parser.
+  // Section D.1.3 ("Picture timing SEI message syntax") of the H.264
+  // standard for a complete description.
+  const auto* vui = GetVui(sps);
+  if (vui == nullptr) {
+#ifdef FPRINT_ERRORS
+    fprintf(stderr, "error: pic_timing() needs the VUI of the active SPS\n");
+#endif  // FPRINT_ERRORS
+    return nullptr;
+  }
+  const auto* hrd = GetHrd(vui);
+
+  auto pic_timing = std::make_unique<PicTimingState>();
+
+  // input parameters
+  pic_timing->cpb_dpb_delays_present_flag = (hrd != nullptr);
+  pic_timing->pic_struct_present_flag =
+      static_cast<uint8_t>(vui->pic_struct_present_flag);
+
+  if (pic_timing->cpb_dpb_delays_present_flag) {
+    // cpb_removal_delay  u(v)
+    if (!bit_buffer->ReadBits(hrd->cpb_removal_delay_length_minus1 + 1,
+                              pic_timing->cpb_removal_delay)) {
+      return nullptr;
+    }
+    // dpb_output_delay  u(v)
+    if (!bit_buffer->ReadBits(hrd->dpb_output_delay_length_minus1 + 1,
+                              pic_timing->dpb_output_delay)) {
+      return nullptr;
+    }
+  }
+
+  if (pic_timing->pic_struct_present_flag) {
+    // pic_struct  u(4)
+    if (!bit_buffer->ReadBits(4, pic_timing->pic_struct)) {
+      return nullptr;
+    }
+    if (pic_timing->pic_struct > kPicStructMax) {
+#ifdef FPRINT_ERRORS
+      fprintf(stderr, "invalid pic_struct: %" PRIu8 " not in range [0, %u]\n",
+              pic_timing->pic_struct, kPicStructMax);
+#endif  // FPRINT_ERRORS
+      return nullptr;
+    }
+    // Section E.2.2: time_offset_length is inferred to be 24 when there
+    // are no hrd_parameters()
+    uint32_t time_offset_length = (hrd != nullptr) ? hrd->time_offset_length
+                                                   : 24;
+    uint32_t num_clock_ts = PicTimingState::getNumClockTs(
+        pic_timing->pic_struct);
+    for (uint32_t i = 0; i < num_clock_ts; i++) {
+      ClockTimestamp clock_timestamp;
+      // clock_timestamp_flag[i]  u(1)
+      if (!bit_buffer->ReadBits(1, clock_timestamp.clock_timestamp_flag)) {
+        return nullptr;
+      }
+      if (clock_timestamp.clock_timestamp_flag) {
+        // ct_type  u(2)
+        // nuit_field_based_flag  u(1)
+        // counting_type  u(5)
+        // full_timestamp_flag  u(1)
+        // discontinuity_flag  u(1)
+        // cnt_dropped_flag  u(1)
+        // n_frames  u(8)
+        if (!bit_buffer->ReadBits(2, clock_timestamp.ct_type) ||
+            !bit_buffer->ReadBits(1, clock_timestamp.nuit_field_based_flag) ||
+            !bit_buffer->ReadBits(5, clock_timestamp.counting_type) ||
+            !bit_buffer->ReadBits(1, clock_timestamp.full_timestamp_flag) ||
+            !bit_buffer->ReadBits(1, clock_timestamp.discontinuity_flag) ||
+            !bit_buffer->ReadBits(1, clock_timestamp.cnt_dropped_flag) ||
+            !bit_buffer->ReadBits(8, clock_timestamp.n_frames)) {
+          return nullptr;
+        }
+        if (clock_timestamp.full_timestamp_flag) {
+          // seconds_value  u(6)
+          // minutes_value  u(6)
+          // hours_value  u(5)
+          if (!bit_buffer->ReadBits(6, clock_timestamp.seconds_value) ||
+              !bit_buffer->ReadBits(6, clock_timestamp.minutes_value) ||
+              !bit_buffer->ReadBits(5, clock_timestamp.hours_value)) {
+            return nullptr;
+          }
+        } else {
+          // seconds_flag  u(1)
+          if (!bit_buffer->ReadBits(1, clock_timestamp.seconds_flag)) {
+            return nullptr;
+          }
+          if (clock_timestamp.seconds_flag) {
+            // seconds_value  u(6)
+            // minutes_flag  u(1)
+            if (!bit_buffer->ReadBits(6, clock_timestamp.seconds_value) ||
+                !bit_buffer->ReadBits(1, clock_timestamp.minutes_flag)) {
+              return nullptr;
+            }
+            if (clock_timestamp.minutes_flag) {
+              // minutes_value  u(6)
+              // hours_flag  u(1)
+              if (!bit_buffer->ReadBits(6, clock_timestamp.minutes_value) ||
+                  !bit_buffer->ReadBits(1, clock_timestamp.hours_flag)) {
+                return nullptr;
+              }
+              if (clock_timestamp.hours_flag) {
+                // hours_value  u(5)
+                if (!bit_buffer->ReadBits(5, clock_timestamp.hours_value)) {
+                  return nullptr;
+                }
+              }
+            }
+          }
+        }
+        if (time_offset_length > 0) {
+          // time_offset  i(v)
+          uint32_t bits_tmp;
+          if (!bit_buffer->ReadBits(time_offset_length, bits_tmp)) {
+            return nullptr;
+          }
+          // sign-extend the two's complement value
+          uint32_t sign_bit = 1u << (time_offset_length - 1);
+          clock_timestamp.time_offset =
+              static_cast<int32_t>(bits_tmp ^ sign_bit) -
+              static_cast<int32_t>(sign_bit);
+        }
+      }
+      pic_timing->clock_timestamps.push_back(clock_timestamp);
+    }
+  }
+
+  return pic_timing;
+}
+
+uint32_t H264PicTimingParser::PicTimingState::getNumClockTs(
+    uint32_t pic_struct) noexcept {
+  // Table D-1
+  switch (pic_struct) {
+    case 0:  // frame
+    case 1:  // top field
+    case 2:  // bottom field
+      return 1;
+    case 3:  // top field, bottom field
+    case 4:  // bottom field, top field
+    case 7:  // frame doubling
+      return 2;
+    case 5:  // top field, bottom field, top field repeated
+    case 6:  // bottom field, top field, bottom field repeated
+    case 8:  // frame tripling
+      return 3;
+    default:
+      return 0;
+  }
+}
+
+// user_data_registered_itu_t_t35()
+std::unique_ptr<
+    H264UserDataRegisteredItuTT35Parser::UserDataRegisteredItuTT35State>
+H264UserDataRegisteredItuTT35Parser::ParseUserDataRegisteredItuTT35(
+    BitBuffer* bit_buffer, uint32_t payload_size) noexcept {
+  // H264 user data registered by Rec. ITU-T T.35 SEI message
+  // (user_data_registered_itu_t_t35()) parser.
+  // Section D.1.5 of the H.264 standard for a complete description.
+  auto user_data = std::make_unique<UserDataRegisteredItuTT35State>();
+
+  // itu_t_t35_country_code  b(8)
+  if (payload_size < 1 ||
+      !bit_buffer->ReadBits(8, user_data->itu_t_t35_country_code)) {
+    return nullptr;
+  }
+  size_t header_size = 1;
+  if (user_data->itu_t_t35_country_code == 0xff) {
+    // itu_t_t35_country_code_extension_byte  b(8)
+    if (payload_size < 2 ||
+        !bit_buffer->ReadBits(
+            8, user_data->itu_t_t35_country_code_extension_byte)) {
+      return nullptr;
+    }
+    header_size = 2;
+  }
+
+  // itu_t_t35_payload_byte  b(8): the rest of the payload
+  size_t bit_offset;
+  bit_buffer->GetCurrentOffset(&user_data->payload_offset, &bit_offset);
+  user_data->payload_length = payload_size - header_size;
+  GetEscapedSpan(*bit_buffer, user_data->payload_offset,
+                 user_data->payload_length, &user_data->escaped_payload_offset,
+                 &user_data->escaped_payload_length);
+
+  return user_data;
+}
+
+// user_data_unregistered()
+std::unique_ptr<H264UserDataUnregisteredParser::UserDataUnregisteredState>
+H264UserDataUnregisteredParser::ParseUserDataUnregistered(
+    BitBuffer* bit_buffer, uint32_t payload_size) noexcept {
+  // H264 user data unregistered SEI message (user_data_unregistered())
+  // parser.
+  // Section D.1.6 of the H.264 standard for a complete description.
+  auto user_data = std::make_unique<UserDataUnregisteredState>();
+
+  // uuid_iso_iec_11578  u(128)
+  if (payload_size < user_data->uuid_iso_iec_11578.size()) {
+    return nullptr;
+  }
+  for (uint8_t& byte : user_data->uuid_iso_iec_11578) {
+    if (!bit_buffer->ReadUInt8(byte)) {
+      return nullptr;
+    }
+  }
+
+  // user_data_payload_byte  b(8): the rest of the payload
+  size_t bit_offset;
+  bit_buffer->GetCurrentOffset(&user_data->payload_offset, &bit_offset);
+  user_data->payload_length =
+      payload_size - user_data->uuid_iso_iec_11578.size();
+  GetEscapedSpan(*bit_buffer, user_data->payload_offset,
+                 user_data->payload_length, &user_data->escaped_payload_offset,
+                 &user_data->escaped_payload_length);
+
+  return user_data;
+}
+
+// recovery_point()
+std::unique_ptr<H264RecoveryPointParser::RecoveryPointState>
+H264RecoveryPointParser::ParseRecoveryPoint(BitBuffer* bit_buffer) noexcept {
+  // H264 recovery point SEI message (recovery_point()) parser.
+  // Section D.1.7 ("Recovery point SEI message syntax") of the H.264
+  // standard for a complete description.
+  auto recovery_point = std::make_unique<RecoveryPointState>();
+
+  // recovery_frame_cnt  ue(v)
+  if (!bit_buffer->ReadExponentialGolomb(recovery_point->recovery_frame_cnt)) {
+    return nullptr;
+  }
+
+  // exact_match_flag  u(1)
+  if (!bit_buffer->ReadBits(1, recovery_point->exact_match_flag)) {
+    return nullptr;
+  }
+
+  // broken_link_flag  u(1)
+  if (!bit_buffer->ReadBits(1, recovery_point->broken_link_flag)) {
+    return nullptr;
+  }
+
+  // changing_slice_group_idc  u(2)
+  if (!bit_buffer->ReadBits(2, recovery_point->changing_slice_group_idc)) {
+    return nullptr;
+  }
+
+  return recovery_point;
+}
+
+// sei_rbsp()
+std::unique_ptr<H264SeiParser::SeiState> H264SeiParser::ParseSei(
+    const uint8_t* data, size_t length,
+    const struct H264BitstreamParserState* bitstream_parser_state,
+    ParsingOptions parsing_options) noexcept {
+  EscapedBitBuffer bit_buffer(data, length);
+  return ParseSei(&bit_buffer, bitstream_parser_state, parsing_options);
+}
+
+std::unique_ptr<H264SeiParser::SeiState> H264SeiParser::ParseSei(
+    BitBuffer* bit_buffer,
+    const struct H264BitstreamParserState* bitstream_parser_state,
+    ParsingOptions parsing_options) noexcept {
+  uint32_t bits_tmp;
+
+  // H264 SEI RBSP (sei_rbsp()) parser.
+  // Section 7.3.2.3 ("Supplemental enhancement information RBSP syntax")
+  // of the H.264 standard for a complete description.
+  auto sei = std::make_unique<SeiState>();
+
+  // the SPS the pic_timing() messages are decoded against: the active one,
+  // or else the only SPS there is (e.g. a stream with pic_struct but no
+  // HRD, which has no buffering_period() to activate it)
+  std::shared_ptr<struct H264SpsParser::SpsState> sps =
+      bitstream_parser_state->active_sps;
+  if (sps == nullptr) {
+    size_t sps_count = 0;
+    for (const auto& sps_i : bitstream_parser_state->sps) {
+      if (sps_i != nullptr) {
+        sps = sps_i;
+        sps_count++;
+      }
+    }
+    if (sps_count != 1) {
+      sps = nullptr;
+    }
+  }
+
+  do {
+    // sei_message()
+    // Section 7.3.2.3.1 ("Supplemental enhancement information message
+    // syntax")
+    auto sei_message = std::make_unique<SeiMessageState>();
+
+    // ff_byte  f(8) (0xff), then last_payload_type_byte  u(8)
+    do {
+      if (!bit_buffer->ReadBits(8, bits_tmp)) {
+        return nullptr;
+      }
+      sei_message->payload_type += bits_tmp;
+    } while (bits_tmp == 0xff);
+
+    // ff_byte  f(8) (0xff), then last_payload_size_byte  u(8)
+    do {
+      if (!bit_buffer->ReadBits(8, bits_tmp)) {
+        return nullptr;
+      }
+      sei_message->payload_size += bits_tmp;
+    } while (bits_tmp == 0xff);
+
+    // sei_payload(payloadType, payloadSize)
+    size_t bit_offset;
+    bit_buffer->GetCurrentOffset(&sei_message->payload_offset, &bit_offset);
+    size_t payload_end =
+        sei_message->payload_offset + sei_message->payload_size;
+    // the whole payload must be there
+    if (!bit_buffer->Seek(payload_end, 0) ||
+        !bit_buffer->Seek(sei_message->payload_offset, 0)) {
+#ifdef FPRINT_ERRORS
+      fprintf(stderr,
+              "error: sei_message() payloadSize %" PRIu32
+              " past the end of the RBSP\n",
+              sei_message->payload_size);
+#endif  // FPRINT_ERRORS
+      return nullptr;
+    }
+    GetEscapedSpan(*bit_buffer, sei_message->payload_offset,
+                   sei_message->payload_size,
+                   &sei_message->escaped_payload_offset,
+                   &sei_message->escaped_payload_size);
+
+    // Section D.1.1: decode only the payloads asked for. A payload that
+    // does not decode is still located.
+    if (parsing_options.GetSeiParse(sei_message->payload_type)) {
+      switch (sei_message->payload_type) {
+        case SEI_BUFFERING_PERIOD:
+          sei_message->buffering_period =
+              H264BufferingPeriodParser::ParseBufferingPeriod(
+                  bit_buffer, bitstream_parser_state);
+          if (sei_message->buffering_period != nullptr) {
+            auto buffering_period_sps = bitstream_parser_state->GetSps(
+                sei_message->buffering_period->seq_parameter_set_id);
+            if (buffering_period_sps != nullptr) {
+              sps = buffering_period_sps;
+            }
+          }
+          break;
+        case SEI_PIC_TIMING:
+          sei_message->pic_timing =
+              H264PicTimingParser::ParsePicTiming(bit_buffer, sps.get());
+          break;
+        case SEI_USER_DATA_REGISTERED_ITU_T_T35:
+          sei_message->user_data_registered_itu_t_t35 =
+              H264UserDataRegisteredItuTT35Parser::
+                  ParseUserDataRegisteredItuTT35(bit_buffer,
+                                                 sei_message->payload_size);
+          break;
+        case SEI_USER_DATA_UNREGISTERED:
+          sei_message->user_data_unregistered =
+              H264UserDataUnregisteredParser::ParseUserDataUnregistered(
+                  bit_buffer, sei_message->payload_size);
+          break;
+        case SEI_RECOVERY_POINT:
+          sei_message->recovery_point =
+              H264RecoveryPointParser::ParseRecoveryPoint(bit_buffer);
+          break;
+        default:
+          // not decoded
+          break;
+      }
+    }
+
+    // skip to the end of the payload, whatever the decoder read
+    bit_buffer->Seek(payload_end, 0);
+    sei->sei_message.push_back(std::move(sei_message));
+  } while (more_rbsp_data(bit_buffer));
+
+  // rbsp_trailing_bits()
+  rbsp_trailing_bits(bit_buffer);
+
+  return sei;
+}
+
+#ifdef FDUMP_DEFINE
+void H264BufferingPeriodParser::BufferingPeriodState::fdump(
+    FILE* outfp, int indent_level) const {
+  fprintf(outfp, "buffering_period {");
+  indent_level = indent_level_incr(indent_level);
+
+  fdump_indent_level(outfp, indent_level);
+  fprintf(outfp, "seq_parameter_set_id: %u", seq_parameter_set_id);
+
+  if (nal_hrd_parameters_present_flag) {
+    fdump_indent_level(outfp, indent_level);
+    fprintf(outfp, "nal_initial_cpb_removal_delay {");
+    for (const uint32_t& v : nal_initial_cpb_removal_delay) {
+      fprintf(outfp, " %u", v);
+    }
+    fprintf(outfp, " }");
+
+    fdump_indent_level(outfp, indent_level);
+    fprintf(outfp, "nal_initial_cpb_removal_delay_offset {");
+    for (const uint32_t& v : nal_initial_cpb_removal_delay_offset) {
+      fprintf(outfp, " %u", v);
+    }
+    fprintf(outfp, " }");
+  }
+
+  if (vcl_hrd_parameters_present_flag) {
+    fdump_indent_level(outfp, indent_level);
+    fprintf(outfp, "vcl_initial_cpb_removal_delay {");
+    for (const uint32_t& v : vcl_initial_cpb_removal_delay) {
+      fprintf(outfp, " %u", v);
+    }
+    fprintf(outfp, " }");
+
+    fdump_indent_level(outfp, indent_level);
+    fprintf(outfp, "vcl_initial_cpb_removal_delay_offset {");
+    for (const uint32_t& v : vcl_initial_cpb_removal_delay_offset) {
+      fprintf(outfp, " %u", v);
+    }
+    fprintf(outfp, " }");
+  }
+
+  indent_level = indent_level_decr(indent_level);
+  fdump_indent_level(outfp, indent_level);
+  fprintf(outfp, "}");
+}
+
+void H264PicTimingParser::PicTimingState::fdump(FILE* outfp,
+                                                int indent_level) const {
+  fprintf(outfp, "pic_timing {");
+  indent_level = indent_level_incr(indent_level);
+
+  if (cpb_dpb_delays_present_flag) {
+    fdump_indent_level(outfp, indent_level);
+    fprintf(outfp, "cpb_removal_delay: %u", cpb_removal_delay);
+
+    fdump_indent_level(outfp, indent_level);
+    fprintf(outfp, "dpb_output_delay: %u", dpb_output_delay);
+  }
+
+  if (pic_struct_present_flag) {
+    fdump_indent_level(outfp, indent_level);
+    fprintf(outfp, "pic_struct: %u", pic_struct);
+
+    for (const ClockTimestamp& clock_timestamp : clock_timestamps) {
+      fdump_indent_level(outfp, indent_level);
+      fprintf(outfp, "clock_timestamp_flag: %u",
+              clock_timestamp.clock_timestamp_flag);
+      if (!clock_timestamp.clock_timestamp_flag) {
+        continue;
+      }
+      fdump_indent_level(outfp, indent_level);
+      fprintf(outfp, "clock_timestamp {");
+      indent_level = indent_level_incr(indent_level);
+
+      fdump_indent_level(outfp, indent_level);
+      fprintf(outfp, "ct_type: %u", clock_timestamp.ct_type);
+
+      fdump_indent_level(outfp, indent_level);
+      fprintf(outfp, "nuit_field_based_flag: %u",
+              clock_timestamp.nuit_field_based_flag);
+
+      fdump_indent_level(outfp, indent_level);
+      fprintf(outfp, "counting_type: %u", clock_timestamp.counting_type);
+
+      fdump_indent_level(outfp, indent_level);
+      fprintf(outfp, "full_timestamp_flag: %u",
+              clock_timestamp.full_timestamp_flag);
+
+      fdump_indent_level(outfp, indent_level);
+      fprintf(outfp, "discontinuity_flag: %u",
+              clock_timestamp.discontinuity_flag);
+
+      fdump_indent_level(outfp, indent_level);
+      fprintf(outfp, "cnt_dropped_flag: %u", clock_timestamp.cnt_dropped_flag);
+
+      fdump_indent_level(outfp, indent_level);
+      fprintf(outfp, "n_frames: %u", clock_timestamp.n_frames);
+
+      fdump_indent_level(outfp, indent_level);
+      fprintf(outfp, "seconds_value: %u", clock_timestamp.seconds_value);
+
+      fdump_indent_level(outfp, indent_level);
+      fprintf(outfp, "minutes_value: %u", clock_timestamp.minutes_value);
+
+      fdump_indent_level(outfp, indent_level);
+      fprintf(outfp, "hours_value: %u", clock_timestamp.hours_value);
+
+      fdump_indent_level(outfp, indent_level);
+      fprintf(outfp, "time_offset: %i", clock_timestamp.time_offset);
+
+      indent_level = indent_level_decr(indent_level);
+      fdump_indent_level(outfp, indent_level);
+      fprintf(outfp, "}");
+    }
+  }
+
+  indent_level = indent_level_decr(indent_level);
+  fdump_indent_level(outfp, indent_level);
+  fprintf(outfp, "}");
+}
+
+void H264UserDataRegisteredItuTT35Parser::UserDataRegisteredItuTT35State::
+    fdump(FILE* outfp, int indent_level) const {
+  fprintf(outfp, "user_data_registered_itu_t_t35 {");
+  indent_level = indent_level_incr(indent_level);
+
+  fdump_indent_level(outfp, indent_level);
+  fprintf(outfp, "itu_t_t35_country_code: %u", itu_t_t35_country_code);
+
+  if (itu_t_t35_country_code == 0xff) {
+    fdump_indent_level(outfp, indent_level);
+    fprintf(outfp, "itu_t_t35_country_code_extension_byte: %u",
+            itu_t_t35_country_code_extension_byte);
+  }
+
+  indent_level = indent_level_decr(indent_level);
+  fdump_indent_level(outfp, indent_level);
+  fprintf(outfp, "}");
+}
+
+void H264UserDataUnregisteredParser::UserDataUnregisteredState::fdump(
+    FILE* outfp, int indent_level) const {
+  fprintf(outfp, "user_data_unregistered {");
+  indent_level = indent_level_incr(indent_level);
+
+  fdump_indent_level(outfp, indent_level);
+  fprintf(outfp, "uuid_iso_iec_11578: ");
+  for (const uint8_t& byte : uuid_iso_iec_11578) {
+    fprintf(outfp, "%02x", byte);
+  }
+
+  indent_level = indent_level_decr(indent_level);
+  fdump_indent_level(outfp, indent_level);
+  fprintf(outfp, "}");
+}
+
+void H264RecoveryPointParser::RecoveryPointState::fdump(
+    FILE* outfp, int indent_level) const {
+  fprintf(outfp, "recovery_point {");
+  indent_level = indent_level_incr(indent_level);
+
+  fdump_indent_level(outfp, indent_level);
+  fprintf(outfp, "recovery_frame_cnt: %u", recovery_frame_cnt);
+
+  fdump_indent_level(outfp, indent_level);
+  fprintf(outfp, "exact_match_flag: %u", exact_match_flag);
+
+  fdump_indent_level(outfp, indent_level);
+  fprintf(outfp, "broken_link_flag: %u", broken_link_flag);
+
+  fdump_indent_level(outfp, indent_level);
+  fprintf(outfp, "changing_slice_group_idc: %u", changing_slice_group_idc);
+
+  indent_level = indent_level_decr(indent_level);
+  fdump_indent_level(outfp, indent_level);
+  fprintf(outfp, "}");
+}
+
+void H264SeiParser::SeiMessageState::fdump(FILE* outfp,
+                                           int indent_level) const {
+  fprintf(outfp, "sei_message {");
+  indent_level = indent_level_incr(indent_level);
+
+  fdump_indent_level(outfp, indent_level);
+  fprintf(outfp, "payload_type: %u", payload_type);
+
+  fdump_indent_level(outfp, indent_level);
+  fprintf(outfp, "payload_size: %u", payload_size);
+
+  if (buffering_period) {
+    fdump_indent_level(outfp, indent_level);
+    buffering_period->fdump(outfp, indent_level);
+  }
+  if (pic_timing) {
+    fdump_indent_level(outfp, indent_level);
+    pic_timing->fdump(outfp, indent_level);
+  }
+  if (user_data_registered_itu_t_t35) {
+    fdump_indent_level(outfp, indent_level);
+    user_data_registered_itu_t_t35->fdump(outfp, indent_level);
+  }
+  if (user_data_unregistered) {
+    fdump_indent_level(outfp, indent_level);
+    user_data_unregistered->fdump(outfp, indent_level);
+  }
+  if (recovery_point) {
+    fdump_indent_level(outfp, indent_level);
+    recovery_point->fdump(outfp, indent_level);
+  }
+
+  indent_level = indent_level_decr(indent_level);
+  fdump_indent_level(outfp, indent_level);
+  fprintf(outfp, "}");
+}
+
+void H264SeiParser::SeiState::fdump(FILE* outfp, int indent_level) const {
+  fprintf(outfp, "sei_rbsp {");
+  indent_level = indent_level_incr(indent_level);
+
+  for (const auto& sei_message_i : sei_message) {
+    fdump_indent_level(outfp, indent_level);
+    sei_message_i->fdump(outfp, indent_level);
+  }
+
+  indent_level = indent_level_decr(indent_level);
+  fdump_indent_level(outfp, indent_level);
+  fprintf(outfp, "}");
+}
+#endif  // FDUMP_DEFINE
+
+}  // namespace h264nal
@@ -30,15 +30,14 @@ namespace h264nal {
 // You can find it on this page:
 // http://www.itu.int/rec/T-REC-H.264
 
-// Unpack RBSP and parse slice header state from the supplied buffer.
+// Parse slice header state from the supplied buffer.
 std::unique_ptr<H264SliceHeaderInScalableExtensionParser::
                     SliceHeaderInScalableExtensionState>
 H264SliceHeaderInScalableExtensionParser::ParseSliceHeaderInScalableExtension(
     const uint8_t* data, size_t length,
     H264NalUnitHeaderParser::NalUnitHeaderState& nal_unit_header,
     struct H264BitstreamParserState* bitstream_parser_state) noexcept {
-  std::vector<uint8_t> unpacked_buffer = UnescapeRbsp(data, length);
-  BitBuffer bit_buffer(unpacked_buffer.data(), unpacked_buffer.size());
+  EscapedBitBuffer bit_buffer(data, length);
   return ParseSliceHeaderInScalableExtension(&bit_buffer, nal_unit_header,
                                              bitstream_parser_state);
 }
@@ -109,36 +108,39 @@ H264SliceHeaderInScalableExtensionParser::ParseSliceHeaderInScalableExtension(
 
   // get pps_id, sps_id, and subset_sps_id and check their existence
   uint32_t pps_id = shise->pic_parameter_set_id;
-  if (bitstream_parser_state->pps.find(pps_id) ==
-      bitstream_parser_state->pps.end()) {
+  const H264PpsParser::PpsState* pps =
+      bitstream_parser_state->pps[pps_id].get();
+  if (pps == nullptr) {
     // non-existent PPS id
 #ifdef FPRINT_ERRORS
     fprintf(stderr, "non-existent PPS id: %u\n", pps_id);
 #endif  // FPRINT_ERRORS
     return nullptr;
   }
-  auto& pps = bitstream_parser_state->pps[pps_id];
 
   // Section 3.2.61: a subset sequence parameter set applies to the layer
   // representations with dependency_id or quality_id not equal to 0, and is
   // the parameter set referred to from the slice headers of the EI, EP and
   // EB slices this parser handles. Subset SPSs have their own
   // seq_parameter_set_id value space, so resolve the id against the subset
-  // SPS map alone: a regular SPS carrying the same id need not exist, and
+  // SPS table alone: a regular SPS carrying the same id need not exist, and
   // if one does it describes the base layer, not this one.
   uint32_t subset_sps_id = pps->seq_parameter_set_id;
-  if (bitstream_parser_state->subset_sps.find(subset_sps_id) ==
-      bitstream_parser_state->subset_sps.end()) {
+  auto subset_sps = bitstream_parser_state->GetSubsetSps(subset_sps_id);
+  if (subset_sps == nullptr) {
     // non-existent subset SPS id
 #ifdef FPRINT_ERRORS
     fprintf(stderr, "non-existent subset SPS id: %u\n", subset_sps_id);
 #endif  // FPRINT_ERRORS
     return nullptr;
   }
-  auto& subset_sps = bitstream_parser_state->subset_sps[subset_sps_id];
   // the subset SPS carries a full seq_parameter_set_data(): that is the one
   // that applies to this layer
   auto& sps_data = subset_sps->seq_parameter_set_data;
+  // the values derived from the SPS (computed here only for an SPS that
+  // was not built by the SPS parser)
+  H264SpsDataParser::SpsDataState::DerivedValues derived_scratch;
+  const auto& derived = sps_data->getDerivedValues(&derived_scratch);
   auto& subset_sps_svc_extension = subset_sps->seq_parameter_set_svc_extension;
   if (subset_sps_svc_extension == nullptr) {
     // slice_header_in_scalable_extension() (defined inside
@@ -157,8 +159,7 @@ H264SliceHeaderInScalableExtensionParser::ParseSliceHeaderInScalableExtension(
 
   // frame_num  u(v)
   shise->log2_max_frame_num_minus4 = sps_data->log2_max_frame_num_minus4;
-  uint32_t frame_num_len =
-      shise->getFrameNumLen(shise->log2_max_frame_num_minus4);
+  uint32_t frame_num_len = derived.frame_num_len;
   if (!bit_buffer->ReadBits(frame_num_len, shise->frame_num)) {
     return nullptr;
   }
@@ -220,11 +221,8 @@ H264SliceHeaderInScalableExtensionParser::ParseSliceHeaderInScalableExtension(
 
   shise->pic_order_cnt_type = sps_data->pic_order_cnt_type;
   if (shise->pic_order_cnt_type == 0) {
-    uint32_t log2_max_pic_order_cnt_lsb_minus4 =
-        sps_data->log2_max_pic_order_cnt_lsb_minus4;
     // pic_order_cnt_lsb  u(v)
-    uint32_t pic_order_cnt_lsb_len =
-        shise->getPicOrderCntLsbLen(log2_max_pic_order_cnt_lsb_minus4);
+    uint32_t pic_order_cnt_lsb_len = derived.pic_order_cnt_lsb_len;
     if (!bit_buffer->ReadBits(pic_order_cnt_lsb_len,
                               shise->pic_order_cnt_lsb)) {
       return nullptr;
@@ -371,7 +369,7 @@ H264SliceHeaderInScalableExtensionParser::ParseSliceHeaderInScalableExtension(
           !shise->base_pred_weight_table_flag) {
         // pred_weight_table(slice_type, num_ref_idx_l0_active_minus1,
         // num_ref_idx_l1_active_minus1)
-        shise->ChromaArrayType = sps_data->getChromaArrayType();
+        shise->ChromaArrayType = derived.ChromaArrayType;
         shise->pred_weight_table =
             H264PredWeightTableParser::ParsePredWeightTable(
                 bit_buffer, shise->ChromaArrayType, shise->slice_type,
@@ -534,7 +532,7 @@ H264SliceHeaderInScalableExtensionParser::ParseSliceHeaderInScalableExtension(
     shise->extended_spatial_scalability_idc =
         subset_sps_svc_extension->extended_spatial_scalability_idc;
     if (shise->extended_spatial_scalability_idc == 2) {
-      shise->ChromaArrayType = sps_data->getChromaArrayType();
+      shise->ChromaArrayType = derived.ChromaArrayType;
       if (shise->ChromaArrayType > 0) {
         // ref_layer_chroma_phase_x_plus1_flag  u(1)
         if (!bit_buffer->ReadBits(1,
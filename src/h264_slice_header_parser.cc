@@ -27,14 +27,13 @@ namespace h264nal {
 // You can find it on this page:
 // http://www.itu.int/rec/T-REC-H.264
 
-// Unpack RBSP and parse slice header state from the supplied buffer.
+// Parse slice header state from the supplied buffer.
 std::unique_ptr<H264SliceHeaderParser::SliceHeaderState>
 H264SliceHeaderParser::ParseSliceHeader(
     const uint8_t* data, size_t length, uint32_t nal_ref_idc,
     uint32_t nal_unit_type,
     struct H264BitstreamParserState* bitstream_parser_state) noexcept {
-  std::vector<uint8_t> unpacked_buffer = UnescapeRbsp(data, length);
-  BitBuffer bit_buffer(unpacked_buffer.data(), unpacked_buffer.size());
+  EscapedBitBuffer bit_buffer(data, length);
   return ParseSliceHeader(&bit_buffer, nal_ref_idc, nal_unit_type,
                           bitstream_parser_state);
 }
@@ -43,6 +42,15 @@ std::unique_ptr<H264SliceHeaderParser::SliceHeaderState>
 H264SliceHeaderParser::ParseSliceHeader(
     BitBuffer* bit_buffer, uint32_t nal_ref_idc, uint32_t nal_unit_type,
     struct H264BitstreamParserState* bitstream_parser_state) noexcept {
+  return ParseSliceHeader(bit_buffer, nal_ref_idc, nal_unit_type,
+                          SLICE_HEADER_ALL, bitstream_parser_state);
+}
+
+std::unique_ptr<H264SliceHeaderParser::SliceHeaderState>
+H264SliceHeaderParser::ParseSliceHeader(
+    BitBuffer* bit_buffer, uint32_t nal_ref_idc, uint32_t nal_unit_type,
+    SliceHeaderField last_field,
+    struct H264BitstreamParserState* bitstream_parser_state) noexcept {
   int32_t sgolomb_tmp;
 
   // H264 slice header (slice_header()) NAL Unit.
@@ -69,6 +77,10 @@ H264SliceHeaderParser::ParseSliceHeader(
     return nullptr;
   }
 
+  if (last_field <= SLICE_HEADER_FIRST_MB_IN_SLICE) {
+    return slice_header;
+  }
+
   // slice_type  ue(v)
   if (!bit_buffer->ReadExponentialGolomb(slice_header->slice_type)) {
     return nullptr;
@@ -85,6 +97,10 @@ H264SliceHeaderParser::ParseSliceHeader(
     return nullptr;
   }
 
+  if (last_field <= SLICE_HEADER_SLICE_TYPE) {
+    return slice_header;
+  }
+
   // pic_parameter_set_id  ue(v)
   if (!bit_buffer->ReadExponentialGolomb(slice_header->pic_parameter_set_id)) {
     return nullptr;
@@ -102,29 +118,31 @@ H264SliceHeaderParser::ParseSliceHeader(
     return nullptr;
   }
 
-  // get pps_id and sps_id and check their existence
-  uint32_t pps_id = slice_header->pic_parameter_set_id;
-  if (bitstream_parser_state->pps.find(pps_id) ==
-      bitstream_parser_state->pps.end()) {
-    // non-existent PPS id
-#ifdef FPRINT_ERRORS
-    fprintf(stderr, "non-existent PPS id: %u\n", pps_id);
-#endif  // FPRINT_ERRORS
-    return nullptr;
+  if (last_field <= SLICE_HEADER_PIC_PARAMETER_SET_ID) {
+    return slice_header;
   }
-  auto& pps = bitstream_parser_state->pps[pps_id];
 
-  uint32_t sps_id = pps->seq_parameter_set_id;
-  if (bitstream_parser_state->sps.find(sps_id) ==
-      bitstream_parser_state->sps.end()) {
-    // non-existent SPS id
+  // get the PPS and the SPS it refers to, and check their existence
+  uint32_t pps_id = slice_header->pic_parameter_set_id;
+  const H264PpsParser::PpsState* pps = nullptr;
+  const H264SpsParser::SpsState* sps = nullptr;
+  if (!bitstream_parser_state->ResolvePps(pps_id, &pps, &sps)) {
 #ifdef FPRINT_ERRORS
-    fprintf(stderr, "non-existent SPS id: %u\n", sps_id);
+    if (pps == nullptr) {
+      // non-existent PPS id
+      fprintf(stderr, "non-existent PPS id: %u\n", pps_id);
+    } else {
+      // non-existent SPS id
+      fprintf(stderr, "non-existent SPS id: %u\n", pps->seq_parameter_set_id);
+    }
 #endif  // FPRINT_ERRORS
     return nullptr;
   }
-  auto& sps = bitstream_parser_state->sps[sps_id];
   auto& sps_data = sps->sps_data;
+  // the values derived from the SPS (computed here only for an SPS that
+  // was not built by the SPS parser)
+  H264SpsDataParser::SpsDataState::DerivedValues derived_scratch;
+  const auto& derived = sps_data->getDerivedValues(&derived_scratch);
 
   slice_header->separate_colour_plane_flag =
       sps_data->separate_colour_plane_flag;
@@ -137,12 +155,15 @@ H264SliceHeaderParser::ParseSliceHeader(
 
   // frame_num  u(v)
   slice_header->log2_max_frame_num_minus4 = sps_data->log2_max_frame_num_minus4;
-  uint32_t frame_num_len =
-      slice_header->getFrameNumLen(slice_header->log2_max_frame_num_minus4);
+  uint32_t frame_num_len = derived.frame_num_len;
   if (!bit_buffer->ReadBits(frame_num_len, slice_header->frame_num)) {
     return nullptr;
   }
 
+  if (last_field <= SLICE_HEADER_FRAME_NUM) {
+    return slice_header;
+  }
+
   slice_header->frame_mbs_only_flag = sps_data->frame_mbs_only_flag;
   if (!slice_header->frame_mbs_only_flag) {
     // field_pic_flag  u(1)
@@ -176,6 +197,10 @@ H264SliceHeaderParser::ParseSliceHeader(
     }
   }
 
+  if (last_field <= SLICE_HEADER_IDR_PIC_ID) {
+    return slice_header;
+  }
+
   // used by both the pic_order_cnt_type == 0 and the pic_order_cnt_type == 1
   // branches below, so copy it before either of them
   slice_header->bottom_field_pic_order_in_frame_present_flag =
@@ -183,11 +208,8 @@ H264SliceHeaderParser::ParseSliceHeader(
 
   slice_header->pic_order_cnt_type = sps_data->pic_order_cnt_type;
   if (slice_header->pic_order_cnt_type == 0) {
-    uint32_t log2_max_pic_order_cnt_lsb_minus4 =
-        sps_data->log2_max_pic_order_cnt_lsb_minus4;
     // pic_order_cnt_lsb  u(v)
-    uint32_t pic_order_cnt_lsb_len =
-        slice_header->getPicOrderCntLsbLen(log2_max_pic_order_cnt_lsb_minus4);
+    uint32_t pic_order_cnt_lsb_len = derived.pic_order_cnt_lsb_len;
     if (!bit_buffer->ReadBits(pic_order_cnt_lsb_len,
                               slice_header->pic_order_cnt_lsb)) {
       return nullptr;
@@ -223,6 +245,10 @@ H264SliceHeaderParser::ParseSliceHeader(
     }
   }
 
+  if (last_field <= SLICE_HEADER_PIC_ORDER_CNT) {
+    return slice_header;
+  }
+
   slice_header->redundant_pic_cnt_present_flag =
       pps->redundant_pic_cnt_present_flag;
   if (slice_header->redundant_pic_cnt_present_flag) {
@@ -355,7 +381,7 @@ H264SliceHeaderParser::ParseSliceHeader(
         (slice_header->slice_type == SliceType::B_ALL)))) {
     // pred_weight_table(slice_type, num_ref_idx_l0_active_minus1,
     // num_ref_idx_l1_active_minus1)
-    uint32_t ChromaArrayType = sps_data->getChromaArrayType();
+    uint32_t ChromaArrayType = derived.ChromaArrayType;
     slice_header->pred_weight_table =
         H264PredWeightTableParser::ParsePredWeightTable(
             bit_buffer, ChromaArrayType, slice_header->slice_type,
@@ -649,19 +675,24 @@ void H264SliceHeaderParser::SliceHeaderState::fdump(FILE* outfp,
     }
   }
 
-  fdump_indent_level(outfp, indent_level);
-  ref_pic_list_modification->fdump(outfp, indent_level);
+  // null in a partial parse
+  if (ref_pic_list_modification) {
+    fdump_indent_level(outfp, indent_level);
+    ref_pic_list_modification->fdump(outfp, indent_level);
+  }
 
   if ((weighted_pred_flag &&
        ((slice_type == SliceType::P) || (slice_type == SliceType::P_ALL) ||
         (slice_type == SliceType::SP) || (slice_type == SliceType::SP_ALL))) ||
       ((weighted_bipred_idc == 1) &&
        ((slice_type == SliceType::B) || (slice_type == SliceType::B_ALL)))) {
-    fdump_indent_level(outfp, indent_level);
-    pred_weight_table->fdump(outfp, indent_level);
+    if (pred_weight_table) {
+      fdump_indent_level(outfp, indent_level);
+      pred_weight_table->fdump(outfp, indent_level);
+    }
   }
 
-  if (nal_ref_idc != 0) {
+  if (nal_ref_idc != 0 && dec_ref_pic_marking) {
     fdump_indent_level(outfp, indent_level);
     dec_ref_pic_marking->fdump(outfp, indent_level);
   }
@@ -24,14 +24,13 @@ namespace h264nal {
 // You can find it on this page:
 // http://www.itu.int/rec/T-REC-H.264
 
-// Unpack RBSP and parse slice header state from the supplied buffer.
+// Parse slice header state from the supplied buffer.
 std::unique_ptr<H264SliceLayerExtensionRbspParser::SliceLayerExtensionRbspState>
 H264SliceLayerExtensionRbspParser::ParseSliceLayerExtensionRbsp(
     const uint8_t* data, size_t length,
     H264NalUnitHeaderParser::NalUnitHeaderState& nal_unit_header,
     struct H264BitstreamParserState* bitstream_parser_state) noexcept {
-  std::vector<uint8_t> unpacked_buffer = UnescapeRbsp(data, length);
-  BitBuffer bit_buffer(unpacked_buffer.data(), unpacked_buffer.size());
+  EscapedBitBuffer bit_buffer(data, length);
   return ParseSliceLayerExtensionRbsp(&bit_buffer, nal_unit_header,
                                       bitstream_parser_state);
 }
@@ -23,7 +23,7 @@ namespace h264nal {
 // You can find it on this page:
 // http://www.itu.int/rec/T-REC-H.264
 
-// Unpack RBSP and parse slice header state from the supplied buffer.
+// Parse slice header state from the supplied buffer.
 std::unique_ptr<H264SliceLayerWithoutPartitioningRbspParser::
                     SliceLayerWithoutPartitioningRbspState>
 H264SliceLayerWithoutPartitioningRbspParser::
@@ -31,8 +31,7 @@ H264SliceLayerWithoutPartitioningRbspParser::
         const uint8_t* data, size_t length, uint32_t nal_ref_idc,
         uint32_t nal_unit_type,
         struct H264BitstreamParserState* bitstream_parser_state) noexcept {
-  std::vector<uint8_t> unpacked_buffer = UnescapeRbsp(data, length);
-  BitBuffer bit_buffer(unpacked_buffer.data(), unpacked_buffer.size());
+  EscapedBitBuffer bit_buffer(data, length);
   return ParseSliceLayerWithoutPartitioningRbsp(
       &bit_buffer, nal_ref_idc, nal_unit_type, bitstream_parser_state);
 }
@@ -43,6 +42,18 @@ H264SliceLayerWithoutPartitioningRbspParser::
     ParseSliceLayerWithoutPartitioningRbsp(
         BitBuffer* bit_buffer, uint32_t nal_ref_idc, uint32_t nal_unit_type,
         struct H264BitstreamParserState* bitstream_parser_state) noexcept {
+  return ParseSliceLayerWithoutPartitioningRbsp(
+      bit_buffer, nal_ref_idc, nal_unit_type, SLICE_HEADER_ALL,
+      bitstream_parser_state);
+}
+
+std::unique_ptr<H264SliceLayerWithoutPartitioningRbspParser::
+                    SliceLayerWithoutPartitioningRbspState>
+H264SliceLayerWithoutPartitioningRbspParser::
+    ParseSliceLayerWithoutPartitioningRbsp(
+        BitBuffer* bit_buffer, uint32_t nal_ref_idc, uint32_t nal_unit_type,
+        SliceHeaderField slice_header_last_field,
+        struct H264BitstreamParserState* bitstream_parser_state) noexcept {
   // H264 slice (slice_layer_without_partitioning_rbsp()) NAL Unit.
   // Section 7.3.2.8 ("Slice layer without partitioning RBSP syntax") of
   // the H.264 standard for a complete description.
@@ -58,7 +69,7 @@ H264SliceLayerWithoutPartitioningRbspParser::
       H264SliceHeaderParser::ParseSliceHeader(
           bit_buffer, slice_layer_without_partitioning_rbsp->nal_ref_idc,
           slice_layer_without_partitioning_rbsp->nal_unit_type,
-          bitstream_parser_state);
+          slice_header_last_field, bitstream_parser_state);
   if (slice_layer_without_partitioning_rbsp->slice_header == nullptr) {
     return nullptr;
   }
@@ -26,12 +26,11 @@ namespace h264nal {
 // You can find it on this page:
 // http://www.itu.int/rec/T-REC-H.264
 
-// Unpack RBSP and parse SPS state from the supplied buffer.
+// Parse SPS state from the supplied buffer.
 std::shared_ptr<H264SpsExtensionParser::SpsExtensionState>
 H264SpsExtensionParser::ParseSpsExtension(const uint8_t* data,
                                           size_t length) noexcept {
-  std::vector<uint8_t> unpacked_buffer = UnescapeRbsp(data, length);
-  BitBuffer bit_buffer(unpacked_buffer.data(), unpacked_buffer.size());
+  EscapedBitBuffer bit_buffer(data, length);
   return ParseSpsExtension(&bit_buffer);
 }
 
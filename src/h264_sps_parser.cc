@@ -21,11 +21,10 @@ namespace h264nal {
 // You can find it on this page:
 // http://www.itu.int/rec/T-REC-H.264
 
-// Unpack RBSP and parse SPS data state from the supplied buffer.
+// Parse SPS data state from the supplied buffer.
 std::unique_ptr<H264SpsDataParser::SpsDataState>
 H264SpsDataParser::ParseSpsData(const uint8_t* data, size_t length) noexcept {
-  std::vector<uint8_t> unpacked_buffer = UnescapeRbsp(data, length);
-  BitBuffer bit_buffer(unpacked_buffer.data(), unpacked_buffer.size());
+  EscapedBitBuffer bit_buffer(data, length);
   return ParseSpsData(&bit_buffer);
 }
 
@@ -454,10 +453,10 @@ H264SpsDataParser::ParseSpsData(BitBuffer* bit_buffer) noexcept {
     // each axis have to leave at least one sample behind. The per-offset
     // checks above only cap each at the largest picture h264nal accepts, so
     // a small picture could be cropped past nothing.
-    uint32_t PicWidthInSamplesL = 16 * (sps_data->pic_width_in_mbs_minus1 + 1);
+    uint32_t PicWidthInSamplesL = 16 * (sps_data->pic_width_in_mbs_minus1 + 1u);
     uint32_t FrameHeightInSamplesL =
-        16 * (2 - sps_data->frame_mbs_only_flag) *
-        (sps_data->pic_height_in_map_units_minus1 + 1);
+        16 * (2u - sps_data->frame_mbs_only_flag) *
+        (sps_data->pic_height_in_map_units_minus1 + 1u);
     uint32_t cropped_width =
         static_cast<uint32_t>(sps_data->getCropUnitX()) *
         (sps_data->frame_crop_left_offset + sps_data->frame_crop_right_offset);
@@ -491,6 +490,9 @@ H264SpsDataParser::ParseSpsData(BitBuffer* bit_buffer) noexcept {
     }
   }
 
+  // derive the values the slice parsers need
+  sps_data->derived = sps_data->computeDerivedValues();
+
   return sps_data;
 }
 
@@ -659,11 +661,52 @@ int H264SpsDataParser::SpsDataState::getResolution(int* width,
   return 0;
 }
 
+H264SpsDataParser::SpsDataState::DerivedValues
+H264SpsDataParser::SpsDataState::computeDerivedValues() const noexcept {
+  DerivedValues values;
+  values.valid = true;
+  values.ChromaArrayType = getChromaArrayType();
+  // Section 7.4.3: frame_num is represented by
+  // log2_max_frame_num_minus4 + 4 bits, and pic_order_cnt_lsb by
+  // log2_max_pic_order_cnt_lsb_minus4 + 4 bits
+  values.frame_num_len = log2_max_frame_num_minus4 + 4u;
+  values.pic_order_cnt_lsb_len = log2_max_pic_order_cnt_lsb_minus4 + 4u;
+  // Equation 7-10: MaxFrameNum = 2 ^ (log2_max_frame_num_minus4 + 4)
+  values.MaxFrameNum = 1u << values.frame_num_len;
+  // Equation 7-11: MaxPicOrderCntLsb =
+  //                  2 ^ (log2_max_pic_order_cnt_lsb_minus4 + 4)
+  values.MaxPicOrderCntLsb = 1u << values.pic_order_cnt_lsb_len;
+  // Equations 7-13, 7-16, 7-17, and 7-18
+  values.PicWidthInMbs = pic_width_in_mbs_minus1 + 1u;
+  values.PicHeightInMapUnits = pic_height_in_map_units_minus1 + 1u;
+  values.PicSizeInMapUnits = values.PicWidthInMbs * values.PicHeightInMapUnits;
+  values.FrameHeightInMbs =
+      (2u - frame_mbs_only_flag) * values.PicHeightInMapUnits;
+  (void)getResolution(&values.width, &values.height);
+  return values;
+}
+
+const H264SpsDataParser::SpsDataState::DerivedValues&
+H264SpsDataParser::SpsDataState::getDerivedValues(
+    DerivedValues* scratch) const noexcept {
+  if (derived.valid) {
+    return derived;
+  }
+  *scratch = computeDerivedValues();
+  return *scratch;
+}
+
 // Section 7.3.2.1.1.1
+template <size_t N>
 bool H264SpsDataParser::SpsDataState::scaling_list(
-    BitBuffer* bit_buffer, uint32_t i, std::vector<uint32_t>& scalingList,
+    BitBuffer* bit_buffer, uint32_t i, InlineVector<uint32_t, N>& scalingList,
     uint32_t sizeOfScalingList,
-    std::vector<uint32_t>& useDefaultScalingMatrixFlag) noexcept {
+    InlineVector<uint32_t, 6>& useDefaultScalingMatrixFlag) noexcept {
+  // the lists are inline: check they can hold what is asked for
+  if (i >= useDefaultScalingMatrixFlag.capacity() ||
+      sizeOfScalingList > scalingList.capacity()) {
+    return false;
+  }
   uint32_t lastScale = 8;
   uint32_t nextScale = 8;
   for (uint32_t j = 0; j < sizeOfScalingList; j++) {
@@ -705,11 +748,10 @@ bool H264SpsDataParser::SpsDataState::scaling_list(
   return true;
 }
 
-// Unpack RBSP and parse SPS state from the supplied buffer.
+// Parse SPS state from the supplied buffer.
 std::shared_ptr<H264SpsParser::SpsState> H264SpsParser::ParseSps(
     const uint8_t* data, size_t length) noexcept {
-  std::vector<uint8_t> unpacked_buffer = UnescapeRbsp(data, length);
-  BitBuffer bit_buffer(unpacked_buffer.data(), unpacked_buffer.size());
+  EscapedBitBuffer bit_buffer(data, length);
   return ParseSps(&bit_buffer);
 }
 
@@ -934,13 +976,12 @@ void H264SpsDataParser::SpsDataState::fdump(
     // add video resolution. Both are int, and getResolution() sets them to
     // -1 when it cannot work them out, so print them signed: "%u" here
     // turned a negative width into 4294967112.
-    int width = -1;
-    int height = -1;
-    (void)getResolution(&width, &height);
+    DerivedValues scratch;
+    const DerivedValues& values = getDerivedValues(&scratch);
     fdump_indent_level(outfp, indent_level);
-    fprintf(outfp, "width: %d", width);
+    fprintf(outfp, "width: %d", values.width);
     fdump_indent_level(outfp, indent_level);
-    fprintf(outfp, "height: %d", height);
+    fprintf(outfp, "height: %d", values.height);
   }
 
   indent_level = indent_level_decr(indent_level);
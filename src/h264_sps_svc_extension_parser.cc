@@ -18,12 +18,11 @@ namespace h264nal {
 // You can find it on this page:
 // http://www.itu.int/rec/T-REC-H.264
 
-// Unpack RBSP and parse SPS SVC extension state from the supplied buffer.
+// Parse SPS SVC extension state from the supplied buffer.
 std::unique_ptr<H264SpsSvcExtensionParser::SpsSvcExtensionState>
 H264SpsSvcExtensionParser::ParseSpsSvcExtension(
     const uint8_t* data, size_t length, uint32_t ChromaArrayType) noexcept {
-  std::vector<uint8_t> unpacked_buffer = UnescapeRbsp(data, length);
-  BitBuffer bit_buffer(unpacked_buffer.data(), unpacked_buffer.size());
+  EscapedBitBuffer bit_buffer(data, length);
   return ParseSpsSvcExtension(&bit_buffer, ChromaArrayType);
 }
 
@@ -0,0 +1,131 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#include "h264_stream_parser.h"
+
+#include <stdio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "h264_nal_unit_parser.h"
+
+namespace {
+// The size of a shortened NALU start sequence {0 0 1}.
+const size_t kNaluShortStartSequenceSize = 3;
+}  // namespace
+
+namespace h264nal {
+
+H264StreamParser::H264StreamParser(ParsingOptions parsing_options,
+                                   NalUnitCallback nal_unit_callback)
+    : H264StreamParser(nullptr, parsing_options, nal_unit_callback) {}
+
+H264StreamParser::H264StreamParser(
+    H264BitstreamParserState* bitstream_parser_state,
+    ParsingOptions parsing_options, NalUnitCallback nal_unit_callback)
+    : own_bitstream_parser_state_(),
+      bitstream_parser_state_((bitstream_parser_state != nullptr)
+                                  ? bitstream_parser_state
+                                  : &own_bitstream_parser_state_),
+      parsing_options_(parsing_options),
+      nal_unit_callback_(nal_unit_callback),
+      buffer_(),
+      buffer_offset_(0),
+      scan_offset_(0),
+      pending_(false),
+      pending_payload_start_(0) {}
+
+void H264StreamParser::Push(const uint8_t* data, size_t length) noexcept {
+  if (length == 0) {
+    return;
+  }
+  buffer_.insert(buffer_.end(), data, data + length);
+  if (buffer_.size() <= kNaluShortStartSequenceSize) {
+    return;
+  }
+  // Same bound as H264BitstreamParser::FindNaluIndices(): a start code
+  // found before it is one FindNaluIndices() would find on the whole
+  // stream, whatever comes next.
+  size_t end = buffer_.size() - kNaluShortStartSequenceSize;
+  Scan(end);
+
+  // drop what no NAL unit needs any more
+  size_t drop = 0;
+  if (pending_) {
+    drop = pending_payload_start_ - kNaluShortStartSequenceSize;
+    // keep the leading zero of a 4-byte start code
+    if (drop > 0 && buffer_[drop - 1] == 0x00) {
+      drop--;
+    }
+  } else {
+    // keep one byte before the next search, to tell a 4-byte start code
+    drop = scan_offset_ - 1;
+  }
+  if (drop > 0) {
+    buffer_.erase(buffer_.begin(),
+                  buffer_.begin() + static_cast<std::ptrdiff_t>(drop));
+    buffer_offset_ += drop;
+    scan_offset_ -= drop;
+    pending_payload_start_ -= pending_ ? drop : 0;
+  }
+}
+
+void H264StreamParser::Flush() noexcept {
+  // Push() has already searched everything FindNaluIndices() would
+  if (pending_) {
+    ParsePending(buffer_.size());
+  }
+  buffer_.clear();
+  buffer_offset_ = 0;
+  scan_offset_ = 0;
+  pending_ = false;
+  pending_payload_start_ = 0;
+}
+
+void H264StreamParser::Scan(size_t end) noexcept {
+  const uint8_t* data = buffer_.data();
+  for (size_t i = FindZeroZeroByte(data, scan_offset_, end, 0x01, SIMD_AUTO);
+       i < end; i = FindZeroZeroByte(data, i, end, 0x01, SIMD_AUTO)) {
+    // We found a start sequence, now check if it was a 3 of 4 byte one.
+    size_t start_offset = i;
+    if (start_offset > 0 && data[start_offset - 1] == 0) {
+      --start_offset;
+    }
+    // it terminates the pending NAL unit
+    if (pending_) {
+      ParsePending(start_offset);
+    }
+    pending_ = true;
+    pending_payload_start_ = i + kNaluShortStartSequenceSize;
+    i += kNaluShortStartSequenceSize;
+  }
+  // a start code can not start at either of the 2 bytes after another
+  // one, so there is nothing to search again before |end|
+  scan_offset_ = end;
+}
+
+void H264StreamParser::ParsePending(size_t payload_end) noexcept {
+  size_t payload_size = payload_end - pending_payload_start_;
+  auto nal_unit = H264NalUnitParser::ParseNalUnit(
+      &buffer_[pending_payload_start_], payload_size, bitstream_parser_state_,
+      parsing_options_);
+  if (nal_unit == nullptr) {
+    // cannot parse the NalUnit
+#ifdef FPRINT_ERRORS
+    fprintf(stderr, "error: cannot parse buffer into NalUnit\n");
+#endif  // FPRINT_ERRORS
+    return;
+  }
+  // store the offset
+  nal_unit->offset = buffer_offset_ + pending_payload_start_;
+  nal_unit->length = payload_size;
+  nal_unit_callback_(std::move(nal_unit));
+}
+
+}  // namespace h264nal
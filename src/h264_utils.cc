@@ -5,24 +5,40 @@
 #include "h264_utils.h"
 
 #include <stdio.h>
+#if !(defined WIN32 || defined _WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include <cstdint>
 #include <cstring>
-#include <iostream>
 #include <memory>
 #include <vector>
 
 namespace {
-int ReadStdinToBuffer(std::vector<uint8_t>& buffer) {
-  constexpr size_t chunk_size = 4096;
-  uint8_t temp[chunk_size];
+// Non-mappable inputs are read in blocks of this size.
+constexpr size_t kReadBlockSize = 1024 * 1024;
+
+// Reads |infp| to its end, in large blocks, straight into |buffer|.
+int ReadStreamToBuffer(FILE* infp, std::vector<uint8_t>& buffer) {
+  size_t length = buffer.size();
   while (true) {
-    std::cin.read(reinterpret_cast<char*>(temp), chunk_size);
-    std::streamsize bytes_read = std::cin.gcount();
-    if (bytes_read <= 0) break;
-    buffer.insert(buffer.end(), temp, temp + bytes_read);
+    buffer.resize(length + kReadBlockSize);
+    size_t bytes_read = fread(buffer.data() + length, 1, kReadBlockSize, infp);
+    length += bytes_read;
+    if (bytes_read < kReadBlockSize) {
+      break;
+    }
   }
-  return 0;
+  buffer.resize(length);
+  return ferror(infp) ? -1 : 0;
+}
+
+bool IsStdin(const char* filename) {
+  return (filename == nullptr) ||
+         (strlen(filename) == 1 && filename[0] == '-');
 }
 }  // namespace
 
@@ -31,9 +47,9 @@ namespace h264nal {
 int H264Utils::ReadFile(const char* filename, std::vector<uint8_t>& buffer) {
   // TODO(chemag): read the infile incrementally
   FILE* infp = nullptr;
-  if ((filename == nullptr) || (strlen(filename) == 1 && filename[0] == '-')) {
+  if (IsStdin(filename)) {
     // read from stdin
-    return ReadStdinToBuffer(buffer);
+    return ReadStreamToBuffer(stdin, buffer);
   }
 
   // open the file
@@ -67,4 +83,74 @@ int H264Utils::ReadFile(const char* filename, std::vector<uint8_t>& buffer) {
   return 0;
 }
 
+H264InputFile::H264InputFile()
+    : data_(nullptr), size_(0), mapping_(nullptr), buffer_() {}
+
+H264InputFile::~H264InputFile() {
+#if !(defined WIN32 || defined _WIN32)
+  if (mapping_ != nullptr) {
+    munmap(mapping_, size_);
+  }
+#endif
+}
+
+std::unique_ptr<H264InputFile> H264InputFile::Open(
+    const char* filename) noexcept {
+  auto input_file = std::unique_ptr<H264InputFile>(new H264InputFile());
+  FILE* infp = nullptr;
+  if (IsStdin(filename)) {
+    // read from stdin
+    infp = stdin;
+  } else {
+#if !(defined WIN32 || defined _WIN32)
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+      // did not work
+      fprintf(stderr, "Could not open input file: \"%s\"\n", filename);
+      return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+      size_t size = static_cast<size_t>(st.st_size);
+      void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapping != MAP_FAILED) {
+        // the parsers read the file front to back: read ahead, and drop
+        // the pages behind
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        close(fd);
+        input_file->mapping_ = mapping;
+        input_file->data_ = static_cast<const uint8_t*>(mapping);
+        input_file->size_ = size;
+        return input_file;
+      }
+    }
+    // not mappable (e.g. a named pipe): read it
+    infp = fdopen(fd, "rb");
+    if (infp == nullptr) {
+      close(fd);
+    }
+#else
+    infp = fopen(filename, "rb");
+#endif
+    if (infp == nullptr) {
+      // did not work
+      fprintf(stderr, "Could not open input file: \"%s\"\n", filename);
+      return nullptr;
+    }
+  }
+
+  int ret = ReadStreamToBuffer(infp, input_file->buffer_);
+  if (infp != stdin) {
+    fclose(infp);
+  }
+  if (ret < 0) {
+    fprintf(stderr, "Could not read input file: \"%s\"\n",
+            IsStdin(filename) ? "-" : filename);
+    return nullptr;
+  }
+  input_file->data_ = input_file->buffer_.data();
+  input_file->size_ = input_file->buffer_.size();
+  return input_file;
+}
+
 }  // namespace h264nal
@@ -19,12 +19,11 @@ namespace h264nal {
 // You can find it on this page:
 // http://www.itu.int/rec/T-REC-H.264
 
-// Unpack RBSP and parse VUI Parameters state from the supplied buffer.
+// Parse VUI Parameters state from the supplied buffer.
 std::unique_ptr<H264VuiParametersParser::VuiParametersState>
 H264VuiParametersParser::ParseVuiParameters(const uint8_t* data,
                                             size_t length) noexcept {
-  std::vector<uint8_t> unpacked_buffer = UnescapeRbsp(data, length);
-  BitBuffer bit_buffer(unpacked_buffer.data(), unpacked_buffer.size());
+  EscapedBitBuffer bit_buffer(data, length);
   return ParseVuiParameters(&bit_buffer);
 }
 
@@ -15,6 +15,10 @@
 #include <algorithm>
 #include <limits>
 
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
 // this is simpler than dealing with checks.*
 #include "assert.h"
 
@@ -27,23 +31,6 @@ namespace h264nal {
 #define RTC_DCHECK_LT(v1, v2) RTC_DCHECK((v1) < (v2))
 #define RTC_DCHECK_GT(v1, v2) RTC_DCHECK((v1) > (v2))
 
-// Returns the lowest (right-most) |bit_count| bits in |byte|.
-uint8_t LowestBits(uint8_t byte, size_t bit_count) {
-  RTC_DCHECK_LE(bit_count, 8);
-  return byte & ((1 << bit_count) - 1);
-}
-
-// Returns the highest (left-most) |bit_count| bits in |byte|, shifted to the
-// lowest bits (to the right).
-uint8_t HighestBits(uint8_t byte, size_t bit_count) {
-  RTC_DCHECK_LE(bit_count, 8);
-  uint8_t shift = 8 - static_cast<uint8_t>(bit_count);
-  // 0xFF promotes to int before the shift; the truncation back to uint8_t
-  // is the point of the mask, not an accident.
-  uint8_t mask = static_cast<uint8_t>(0xFF << shift);
-  return (byte & mask) >> shift;
-}
-
 // Returns the highest byte of |val| in a uint8_t.
 uint8_t HighestByte(uint64_t val) { return static_cast<uint8_t>(val >> 56); }
 
@@ -77,14 +64,208 @@ size_t CountBits(uint64_t val) {
   return bit_count;
 }
 
+// Counts the number of leading zero bits in |val|, which must not be 0.
+// A single instruction on every compiler we build with (lzcnt/bsr on x86,
+// clz on arm).
+size_t CountLeadingZeros64(uint64_t val) {
+  RTC_DCHECK(val != 0);
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<size_t>(__builtin_clzll(val));
+#elif defined(_MSC_VER) && defined(_M_X64)
+  unsigned long index;
+  _BitScanReverse64(&index, val);
+  return 63 - static_cast<size_t>(index);
+#else
+  size_t zero_bit_count = 0;
+  while ((val & (uint64_t{1} << 63)) == 0) {
+    zero_bit_count++;
+    val <<= 1;
+  }
+  return zero_bit_count;
+#endif
+}
+
+// Whether any of the 8 bytes in |val| is zero.
+bool HasZeroByte(uint64_t val) {
+  return ((val - 0x0101010101010101ull) & ~val & 0x8080808080808080ull) != 0;
+}
+
+// Reads 8 bytes from |bytes| as a big-endian uint64_t. Compilers fold the
+// loop into a single 64 bit load plus a byte swap.
+uint64_t LoadBigEndian64(const uint8_t* bytes) {
+  uint64_t val = 0;
+  for (size_t i = 0; i < 8; i++) {
+    val = (val << 8) | bytes[i];
+  }
+  return val;
+}
+
 BitBuffer::BitBuffer(const uint8_t* bytes, size_t byte_count)
-    : bytes_(bytes), byte_count_(byte_count), byte_offset_(), bit_offset_() {
+    : BitBuffer(bytes, byte_count, false) {}
+
+BitBuffer::BitBuffer(const uint8_t* bytes, size_t byte_count, bool escaped)
+    : bytes_(bytes),
+      byte_count_(byte_count),
+      byte_offset_(),
+      bit_offset_(),
+      cache_(),
+      cache_byte_offset_(),
+      cache_bit_count_(),
+      escaped_(escaped),
+      rbsp_byte_count_(escaped ? 0 : byte_count),
+      rbsp_byte_count_known_(!escaped),
+      cursor_() {
   RTC_DCHECK(static_cast<uint64_t>(byte_count_) <=
              std::numeric_limits<uint32_t>::max());
 }
 
+EscapedBitBuffer::EscapedBitBuffer(const uint8_t* bytes, size_t byte_count)
+    : BitBuffer(bytes, byte_count, true) {}
+
+bool BitBuffer::AdvanceCursor(EscapedCursor* cursor,
+                              size_t rbsp_offset) const {
+  // This is UnescapeRbsp(): a 0x03 after two RBSP zero bytes is an
+  // emulation_prevention_three_byte, and the zero count starts over after
+  // it, so 0x00000303 keeps its second 0x03.
+  while (cursor->rbsp_offset < rbsp_offset) {
+    if (cursor->escaped_offset >= byte_count_) {
+      // we now know the RBSP size, so keep it
+      rbsp_byte_count_ = cursor->rbsp_offset;
+      rbsp_byte_count_known_ = true;
+      return false;
+    }
+    uint8_t byte = bytes_[cursor->escaped_offset++];
+    if (cursor->zero_count >= 2 && byte == 0x03) {
+      cursor->zero_count = 0;
+      continue;
+    }
+    cursor->zero_count = (byte == 0x00) ? cursor->zero_count + 1 : 0;
+    cursor->rbsp_offset++;
+  }
+  return true;
+}
+
+bool BitBuffer::GetEscapedOffset(size_t rbsp_offset,
+                                 size_t* escaped_offset) const {
+  if (!escaped_) {
+    if (rbsp_offset >= byte_count_) {
+      return false;
+    }
+    *escaped_offset = rbsp_offset;
+    return true;
+  }
+  // walk past the byte, so that an emulation prevention byte just before
+  // it is skipped, and the cursor ends just after it
+  EscapedCursor cursor =
+      (cursor_.rbsp_offset <= rbsp_offset) ? cursor_ : EscapedCursor();
+  if (!AdvanceCursor(&cursor, rbsp_offset + 1)) {
+    return false;
+  }
+  *escaped_offset = cursor.escaped_offset - 1;
+  return true;
+}
+
+bool BitBuffer::HasBytes(size_t byte_count) const {
+  if (rbsp_byte_count_known_) {
+    return byte_count <= rbsp_byte_count_;
+  }
+  // an escaped buffer: anything already behind the cursor, or in the
+  // cache, exists
+  if (byte_count <= cursor_.rbsp_offset ||
+      byte_count <= cache_byte_offset_ + cache_bit_count_ / 8) {
+    return true;
+  }
+  EscapedCursor cursor = cursor_;
+  return AdvanceCursor(&cursor, byte_count);
+}
+
+bool BitBuffer::HasBits(uint64_t bit_count) const {
+  // an RBSP is never longer than the buffer it was unescaped from. This
+  // also keeps the sum below from overflowing.
+  if (bit_count > static_cast<uint64_t>(byte_count_) * 8) {
+    return false;
+  }
+  uint64_t end_bit = static_cast<uint64_t>(byte_offset_) * 8 + bit_offset_ +
+                     bit_count;
+  return HasBytes(static_cast<size_t>((end_bit + 7) / 8));
+}
+
+void BitBuffer::RefillCache() {
+  size_t cache_byte_count = 0;
+  uint64_t cache = 0;
+  if (!escaped_) {
+    const uint8_t* bytes = bytes_ + byte_offset_;
+    cache_byte_count = std::min<size_t>(8, byte_count_ - byte_offset_);
+    if (cache_byte_count == 8) {
+      cache = LoadBigEndian64(bytes);
+    } else {
+      // the tail of the buffer: pad with zeros, which are never reported
+      // as valid
+      for (size_t i = 0; i < cache_byte_count; i++) {
+        cache |= static_cast<uint64_t>(bytes[i]) << (56 - 8 * i);
+      }
+    }
+  } else {
+    // walk the cursor to the new cache start, from the beginning if a
+    // Seek() went back past it
+    if (byte_offset_ < cursor_.rbsp_offset) {
+      cursor_ = EscapedCursor();
+    }
+    if (AdvanceCursor(&cursor_, byte_offset_)) {
+      const uint8_t* bytes = bytes_ + cursor_.escaped_offset;
+      if (byte_count_ - cursor_.escaped_offset >= 8 &&
+          (cursor_.zero_count < 2 || bytes[0] != 0x03) &&
+          !HasZeroByte(LoadBigEndian64(bytes))) {
+        // no zero byte, so no emulation prevention byte either: the
+        // escaped bytes are the RBSP bytes
+        cache = LoadBigEndian64(bytes);
+        cache_byte_count = 8;
+      } else {
+        // gather the RBSP bytes one at a time, leaving |cursor_| where it
+        // is
+        EscapedCursor cursor = cursor_;
+        while (cache_byte_count < 8 &&
+               AdvanceCursor(&cursor, cursor.rbsp_offset + 1)) {
+          cache |= static_cast<uint64_t>(bytes_[cursor.escaped_offset - 1])
+                   << (56 - 8 * cache_byte_count);
+          cache_byte_count++;
+        }
+      }
+    }
+  }
+  cache_ = cache;
+  cache_byte_offset_ = byte_offset_;
+  cache_bit_count_ = cache_byte_count * 8;
+}
+
+uint64_t BitBuffer::PeekWindow(size_t* bit_count) {
+  // bits of the cache already behind the current offset. A Seek() back
+  // before the cache start, or a cache that has run out, means a refill.
+  size_t skipped_bits = 0;
+  if (byte_offset_ >= cache_byte_offset_) {
+    skipped_bits = (byte_offset_ - cache_byte_offset_) * 8 + bit_offset_;
+  }
+  if (byte_offset_ < cache_byte_offset_ || skipped_bits >= cache_bit_count_) {
+    RefillCache();
+    skipped_bits = bit_offset_;
+  }
+  if (skipped_bits >= cache_bit_count_) {
+    // at the end of the buffer
+    *bit_count = 0;
+    return 0;
+  }
+  *bit_count = cache_bit_count_ - skipped_bits;
+  return cache_ << skipped_bits;
+}
+
 uint64_t BitBuffer::RemainingBitCount() const {
-  return (static_cast<uint64_t>(byte_count_) - byte_offset_) * 8 - bit_offset_;
+  if (!rbsp_byte_count_known_) {
+    // an escaped buffer: walk to the end once to learn its RBSP size
+    EscapedCursor cursor = cursor_;
+    AdvanceCursor(&cursor, std::numeric_limits<size_t>::max());
+  }
+  return (static_cast<uint64_t>(rbsp_byte_count_) - byte_offset_) * 8 -
+         bit_offset_;
 }
 
 bool BitBuffer::ReadUInt8(uint8_t& val) {
@@ -124,33 +305,19 @@ bool BitBuffer::PeekBits(size_t bit_count, uint32_t& val) {
   if (bit_count == 0 || bit_count > 32) {
     return false;
   }
-  // check we have enough bits to read
-  if (bit_count > RemainingBitCount()) {
-    return false;
-  }
-  const uint8_t* bytes = bytes_ + byte_offset_;
-  size_t remaining_bits_in_current_byte = 8 - bit_offset_;
-  uint32_t bits = LowestBits(*bytes++, remaining_bits_in_current_byte);
-  // If we're reading fewer bits than what's left in the current byte, just
-  // return the portion of this byte that we need.
-  if (bit_count < remaining_bits_in_current_byte) {
-    val = HighestBits(bits, bit_offset_ + bit_count);
-    return true;
-  }
-  // Otherwise, subtract what we've read from the bit count and read as many
-  // full bytes as we can into bits.
-  bit_count -= remaining_bits_in_current_byte;
-  while (bit_count >= 8) {
-    bits = (bits << 8) | *bytes++;
-    bit_count -= 8;
+  // check we have enough bits to read. A refill covers 32 bits unless the
+  // buffer ends first, so this needs no RemainingBitCount(), which would
+  // have to walk an escaped buffer to its end.
+  size_t window_bit_count = 0;
+  uint64_t window = PeekWindow(&window_bit_count);
+  if (window_bit_count < bit_count) {
+    RefillCache();
+    window = PeekWindow(&window_bit_count);
+    if (window_bit_count < bit_count) {
+      return false;
+    }
   }
-  // Whatever we have left is smaller than a byte, so grab just the bits we need
-  // and shift them into the lowest bits.
-  if (bit_count > 0) {
-    bits <<= bit_count;
-    bits |= HighestBits(*bytes, bit_count);
-  }
-  val = bits;
+  val = static_cast<uint32_t>(window >> (64 - bit_count));
   return true;
 }
 
@@ -160,42 +327,66 @@ bool BitBuffer::PeekBits(size_t bit_count, uint64_t& val) {
   if (bit_count == 0 || bit_count > 64) {
     return false;
   }
-  // check we have enough bits to read
-  if (bit_count > RemainingBitCount()) {
-    return false;
-  }
-  const uint8_t* bytes = bytes_ + byte_offset_;
-  size_t remaining_bits_in_current_byte = 8 - bit_offset_;
-  uint64_t bits = LowestBits(*bytes++, remaining_bits_in_current_byte);
-  // If we're reading fewer bits than what's left in the current byte, just
-  // return the portion of this byte that we need.
-  if (bit_count < remaining_bits_in_current_byte) {
-    val = HighestBits(bits, bit_offset_ + bit_count);
+  if (bit_count <= 32) {
+    uint32_t val32 = 0;
+    if (!PeekBits(bit_count, val32)) {
+      return false;
+    }
+    val = val32;
     return true;
   }
-  // Otherwise, subtract what we've read from the bit count and read as many
-  // full bytes as we can into bits.
-  bit_count -= remaining_bits_in_current_byte;
-  while (bit_count >= 8) {
-    bits = (bits << 8) | *bytes++;
-    bit_count -= 8;
+  // Wider reads can straddle 9 bytes, more than the cache holds, so they
+  // are served as two peeks.
+  uint32_t high = 0;
+  uint32_t low = 0;
+  if (!PeekBits(32, high)) {
+    return false;
   }
-  // Whatever we have left is smaller than a byte, so grab just the bits we need
-  // and shift them into the lowest bits.
-  if (bit_count > 0) {
-    bits <<= bit_count;
-    bits |= HighestBits(*bytes, bit_count);
+  size_t original_byte_offset = byte_offset_;
+  size_t original_bit_offset = bit_offset_;
+  SkipBits(32);
+  bool success = PeekBits(bit_count - 32, low);
+  byte_offset_ = original_byte_offset;
+  bit_offset_ = original_bit_offset;
+  if (!success) {
+    return false;
   }
-  val = bits;
+  val = (static_cast<uint64_t>(high) << (bit_count - 32)) | low;
   return true;
 }
 
 bool BitBuffer::ReadBits(size_t bit_count, uint32_t& val) {
-  return PeekBits(bit_count, val) && ConsumeBits(bit_count);
+  if (!PeekBits(bit_count, val)) {
+    return false;
+  }
+  SkipBits(bit_count);
+  return true;
 }
 
 bool BitBuffer::ReadBits(size_t bit_count, uint64_t& val) {
-  return PeekBits(bit_count, val) && ConsumeBits(bit_count);
+  if (!PeekBits(bit_count, val)) {
+    return false;
+  }
+  SkipBits(bit_count);
+  return true;
+}
+
+bool BitBuffer::ReadBits(size_t bit_count, uint8_t& val) {
+  uint32_t bit_val = 0;
+  if (bit_count > 8 || !ReadBits(bit_count, bit_val)) {
+    return false;
+  }
+  val = static_cast<uint8_t>(bit_val);
+  return true;
+}
+
+bool BitBuffer::ReadBits(size_t bit_count, uint16_t& val) {
+  uint32_t bit_val = 0;
+  if (bit_count > 16 || !ReadBits(bit_count, bit_val)) {
+    return false;
+  }
+  val = static_cast<uint16_t>(bit_val);
+  return true;
 }
 
 bool BitBuffer::ConsumeBytes(size_t byte_count) {
@@ -204,13 +395,16 @@ bool BitBuffer::ConsumeBytes(size_t byte_count) {
 }
 
 bool BitBuffer::ConsumeBits(size_t bit_count) {
-  if (bit_count > RemainingBitCount()) {
+  if (!HasBits(bit_count)) {
     return false;
   }
+  SkipBits(bit_count);
+  return true;
+}
 
+void BitBuffer::SkipBits(size_t bit_count) {
   byte_offset_ += (bit_offset_ + bit_count) / 8;
   bit_offset_ = (bit_offset_ + bit_count) % 8;
-  return true;
 }
 
 bool BitBuffer::ReadNonSymmetric(uint32_t num_values, uint32_t& val) {
@@ -237,30 +431,58 @@ bool BitBuffer::ReadNonSymmetric(uint32_t num_values, uint32_t& val) {
 }
 
 bool BitBuffer::ReadExponentialGolomb(uint32_t& val) {
-  // Store off the current byte/bit offset, in case we want to restore them due
-  // to a failed parse.
-  size_t original_byte_offset = byte_offset_;
-  size_t original_bit_offset = bit_offset_;
-
-  // Count the number of leading 0 bits by peeking/consuming them one at a time.
-  size_t zero_bit_count = 0;
-  uint32_t peeked_bit;
-  while (PeekBits(1, peeked_bit) && peeked_bit == 0) {
-    zero_bit_count++;
-    ConsumeBits(1);
+  // Count the leading 0 bits with a single count-leading-zeros on the
+  // cached window, rather than peeking/consuming them one at a time.
+  // Nothing is consumed until the whole codeword has been validated, so a
+  // failed parse leaves the offsets where they were.
+  size_t window_bit_count = 0;
+  uint64_t window = PeekWindow(&window_bit_count);
+  // a refilled window holds at least 57 bits, enough for the largest
+  // prefix we accept (31 zeros) plus its 1 bit
+  if (window_bit_count < 32) {
+    RefillCache();
+    window = PeekWindow(&window_bit_count);
+  }
+  if (window_bit_count == 0) {
+    return false;
+  }
+  size_t zero_bit_count = (window == 0) ? 64 : CountLeadingZeros64(window);
+  // We should find a 1 bit before the end of the stream. A window that
+  // is not the end of the stream holds at least 32 bits, so no 1 bit in
+  // it means too many zeros for a uint32_t.
+  if (zero_bit_count >= window_bit_count) {
+    return false;
   }
-
-  // We should either be at the end of the stream, or the next bit should be 1.
-  RTC_DCHECK(!PeekBits(1, peeked_bit) || peeked_bit == 1);
 
   // The bit count of the value is the number of zeros + 1. Make sure that many
   // bits fits in a uint32_t and that we have enough bits left for it, and then
   // read the value.
   size_t value_bit_count = zero_bit_count + 1;
-  if (value_bit_count > 32 || !ReadBits(value_bit_count, val)) {
-    RTC_CHECK(Seek(original_byte_offset, original_bit_offset));
+  size_t codeword_bit_count = zero_bit_count + value_bit_count;
+  if (value_bit_count > 32) {
     return false;
   }
+  if (codeword_bit_count > window_bit_count) {
+    // the tail of the codeword is past the window
+    RefillCache();
+    window = PeekWindow(&window_bit_count);
+  }
+  if (codeword_bit_count > window_bit_count) {
+    // still past it: either the buffer ends first, or a prefix of 29 or
+    // more zeros at an unaligned offset. Read the value after the zeros.
+    size_t original_byte_offset = byte_offset_;
+    size_t original_bit_offset = bit_offset_;
+    if (!ConsumeBits(zero_bit_count) || !ReadBits(value_bit_count, val)) {
+      byte_offset_ = original_byte_offset;
+      bit_offset_ = original_bit_offset;
+      return false;
+    }
+    val -= 1;
+    return true;
+  }
+  val = static_cast<uint32_t>((window << zero_bit_count) >>
+                              (64 - value_bit_count));
+  SkipBits(codeword_bit_count);
   val -= 1;
   return true;
 }
@@ -287,6 +509,52 @@ bool BitBuffer::ReadSignedExponentialGolomb(int32_t& val) {
   return true;
 }
 
+bool BitBuffer::ReadExponentialGolomb(uint8_t& val) {
+  size_t byte_offset = byte_offset_;
+  size_t bit_offset = bit_offset_;
+  uint32_t wide_val = 0;
+  if (!ReadExponentialGolomb(wide_val)) {
+    return false;
+  }
+  if (wide_val > std::numeric_limits<uint8_t>::max()) {
+    Seek(byte_offset, bit_offset);
+    return false;
+  }
+  val = static_cast<uint8_t>(wide_val);
+  return true;
+}
+
+bool BitBuffer::ReadExponentialGolomb(uint16_t& val) {
+  size_t byte_offset = byte_offset_;
+  size_t bit_offset = bit_offset_;
+  uint32_t wide_val = 0;
+  if (!ReadExponentialGolomb(wide_val)) {
+    return false;
+  }
+  if (wide_val > std::numeric_limits<uint16_t>::max()) {
+    Seek(byte_offset, bit_offset);
+    return false;
+  }
+  val = static_cast<uint16_t>(wide_val);
+  return true;
+}
+
+bool BitBuffer::ReadSignedExponentialGolomb(int8_t& val) {
+  size_t byte_offset = byte_offset_;
+  size_t bit_offset = bit_offset_;
+  int32_t wide_val = 0;
+  if (!ReadSignedExponentialGolomb(wide_val)) {
+    return false;
+  }
+  if (wide_val < std::numeric_limits<int8_t>::min() ||
+      wide_val > std::numeric_limits<int8_t>::max()) {
+    Seek(byte_offset, bit_offset);
+    return false;
+  }
+  val = static_cast<int8_t>(wide_val);
+  return true;
+}
+
 void BitBuffer::GetCurrentOffset(size_t* out_byte_offset,
                                  size_t* out_bit_offset) {
   RTC_CHECK(out_byte_offset != nullptr);
@@ -296,8 +564,8 @@ void BitBuffer::GetCurrentOffset(size_t* out_byte_offset,
 }
 
 bool BitBuffer::Seek(size_t byte_offset, size_t bit_offset) {
-  if (byte_offset > byte_count_ || bit_offset > 7 ||
-      (byte_offset == byte_count_ && bit_offset > 0)) {
+  if (bit_offset > 7 || !HasBytes(byte_offset) ||
+      (bit_offset > 0 && !HasBytes(byte_offset + 1))) {
     return false;
   }
   byte_offset_ = byte_offset;
@@ -325,6 +593,8 @@ bool BitBufferWriter::WriteBits(uint64_t val, size_t bit_count) {
     return false;
   }
   size_t total_bits = bit_count;
+  // the bytes about to change may be in the read cache
+  InvalidateCache();
 
   // For simplicity, push the bits we want to read from val to the highest bits.
   val <<= (sizeof(uint64_t) * 8 - bit_count);
@@ -0,0 +1,143 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#include "h264_access_unit_assembler.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include "h264_bitstream_parser.h"
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "h264_slice_header_parser.h"
+#include "rtc_common.h"
+
+namespace h264nal {
+
+class H264AccessUnitAssemblerTest : public ::testing::Test {
+ public:
+  H264AccessUnitAssemblerTest() {}
+  ~H264AccessUnitAssemblerTest() override {}
+};
+
+// SPS, PPS, slice IDR, slice non-IDR twice (601.264), then the PPS again
+const uint8_t buffer[] = {
+    // SPS
+    0x00, 0x00, 0x00, 0x01,
+    0x67, 0x42, 0xc0, 0x16, 0xa6, 0x11, 0x05, 0x07,
+    0xe9, 0xb2, 0x00, 0x00, 0x03, 0x00, 0x02, 0x00,
+    0x00, 0x03, 0x00, 0x64, 0x1e, 0x2c, 0x5c, 0x23,
+    // PPS
+    0x00, 0x00, 0x00, 0x01,
+    0x68, 0xc8, 0x42, 0x02, 0x32, 0xc8,
+    // slice (IDR)
+    0x00, 0x00, 0x00, 0x01,
+    0x65, 0x88, 0x82, 0x06, 0x78, 0x8c, 0x50, 0x00,
+    0x1c, 0xab, 0x8e, 0x00, 0x02, 0xfb, 0x31, 0xc0,
+    0x00, 0x5f, 0x66, 0xfb, 0xef, 0xbe,
+    // slice (non-IDR)
+    0x00, 0x00, 0x00, 0x01,
+    0x41, 0x9a, 0x1c, 0x0c, 0xf0, 0x09, 0x6c,
+    // slice (non-IDR, same picture)
+    0x00, 0x00, 0x00, 0x01,
+    0x41, 0x9a, 0x1c, 0x0c, 0xf0, 0x09, 0x6c,
+    // PPS
+    0x00, 0x00, 0x00, 0x01,
+    0x68, 0xc8, 0x42, 0x02, 0x32, 0xc8
+};
+
+TEST_F(H264AccessUnitAssemblerTest, TestParseBitstream) {
+  H264BitstreamParserState bitstream_parser_state;
+  ParsingOptions parsing_options;
+  std::vector<std::unique_ptr<H264AccessUnitAssembler::AccessUnitState>>
+      access_units;
+  H264AccessUnitAssembler::ParseBitstream(
+      buffer, arraysize(buffer), &bitstream_parser_state, parsing_options,
+      [&access_units](
+          std::unique_ptr<H264AccessUnitAssembler::AccessUnitState>
+              access_unit) { access_units.push_back(std::move(access_unit)); });
+  ASSERT_EQ(3, access_units.size());
+
+  // SPS, PPS and the IDR slice
+  EXPECT_EQ(4, access_units[0]->offset);
+  EXPECT_EQ(60, access_units[0]->length);
+  EXPECT_EQ(3, access_units[0]->nal_units.size());
+  EXPECT_EQ(1, access_units[0]->num_slices);
+  EXPECT_EQ(22, access_units[0]->vcl_length);
+  const auto* slice_header = access_units[0]->GetPrimarySliceHeader();
+  ASSERT_TRUE(slice_header != nullptr);
+  EXPECT_EQ(CODED_SLICE_OF_IDR_PICTURE_NUT, slice_header->nal_unit_type);
+
+  // both non-IDR slices: same picture
+  EXPECT_EQ(68, access_units[1]->offset);
+  EXPECT_EQ(18, access_units[1]->length);
+  EXPECT_EQ(2, access_units[1]->nal_units.size());
+  EXPECT_EQ(2, access_units[1]->num_slices);
+  EXPECT_EQ(14, access_units[1]->vcl_length);
+  slice_header = access_units[1]->GetPrimarySliceHeader();
+  ASSERT_TRUE(slice_header != nullptr);
+  EXPECT_EQ(CODED_SLICE_OF_NON_IDR_PICTURE_NUT, slice_header->nal_unit_type);
+
+  // a PPS after the last VCL NAL unit starts a new access unit
+  EXPECT_EQ(90, access_units[2]->offset);
+  EXPECT_EQ(6, access_units[2]->length);
+  EXPECT_EQ(1, access_units[2]->nal_units.size());
+  EXPECT_EQ(0, access_units[2]->num_slices);
+  EXPECT_EQ(0, access_units[2]->vcl_length);
+  EXPECT_TRUE(access_units[2]->GetPrimarySliceHeader() == nullptr);
+}
+
+TEST_F(H264AccessUnitAssemblerTest, TestFirstSliceOfPrimaryPicture) {
+  H264SliceHeaderParser::SliceHeaderState previous;
+  previous.nal_unit_type = CODED_SLICE_OF_NON_IDR_PICTURE_NUT;
+  previous.nal_ref_idc = 2;
+  previous.frame_num = 3;
+  previous.pic_order_cnt_lsb = 6;
+
+  H264SliceHeaderParser::SliceHeaderState slice_header;
+  slice_header.nal_unit_type = CODED_SLICE_OF_NON_IDR_PICTURE_NUT;
+  slice_header.nal_ref_idc = 2;
+  slice_header.frame_num = 3;
+  slice_header.pic_order_cnt_lsb = 6;
+  slice_header.first_mb_in_slice = 40;
+  EXPECT_FALSE(H264AccessUnitAssembler::IsFirstSliceOfPrimaryPicture(
+      previous, slice_header));
+
+  // nal_ref_idc differing, none of them 0, does not matter
+  slice_header.nal_ref_idc = 1;
+  EXPECT_FALSE(H264AccessUnitAssembler::IsFirstSliceOfPrimaryPicture(
+      previous, slice_header));
+  slice_header.nal_ref_idc = 0;
+  EXPECT_TRUE(H264AccessUnitAssembler::IsFirstSliceOfPrimaryPicture(
+      previous, slice_header));
+  slice_header.nal_ref_idc = 2;
+
+  // a new POC lsb (with pic_order_cnt_type 0)
+  slice_header.pic_order_cnt_lsb = 8;
+  EXPECT_TRUE(H264AccessUnitAssembler::IsFirstSliceOfPrimaryPicture(
+      previous, slice_header));
+  slice_header.pic_order_cnt_lsb = 6;
+
+  // the second field of a field pair
+  previous.field_pic_flag = 1;
+  slice_header.field_pic_flag = 1;
+  slice_header.bottom_field_flag = 1;
+  EXPECT_TRUE(H264AccessUnitAssembler::IsFirstSliceOfPrimaryPicture(
+      previous, slice_header));
+  slice_header.bottom_field_flag = 0;
+
+  // back-to-back IDR pictures
+  previous.nal_unit_type = CODED_SLICE_OF_IDR_PICTURE_NUT;
+  slice_header.nal_unit_type = CODED_SLICE_OF_IDR_PICTURE_NUT;
+  EXPECT_FALSE(H264AccessUnitAssembler::IsFirstSliceOfPrimaryPicture(
+      previous, slice_header));
+  slice_header.idr_pic_id = 1;
+  EXPECT_TRUE(H264AccessUnitAssembler::IsFirstSliceOfPrimaryPicture(
+      previous, slice_header));
+}
+
+}  // namespace h264nal
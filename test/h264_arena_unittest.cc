@@ -0,0 +1,133 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#include "h264_arena.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "h264_bitstream_parser.h"
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "h264_nal_unit_parser.h"
+#include "rtc_common.h"
+
+namespace h264nal {
+
+class H264ArenaTest : public ::testing::Test {
+ public:
+  H264ArenaTest() {}
+  ~H264ArenaTest() override {}
+};
+
+// SPS, PPS, slice IDR, slice non-IDR (601.264)
+const uint8_t buffer[] = {
+    // SPS
+    0x00, 0x00, 0x00, 0x01,
+    0x67, 0x42, 0xc0, 0x16, 0xa6, 0x11, 0x05, 0x07,
+    0xe9, 0xb2, 0x00, 0x00, 0x03, 0x00, 0x02, 0x00,
+    0x00, 0x03, 0x00, 0x64, 0x1e, 0x2c, 0x5c, 0x23,
+    // PPS
+    0x00, 0x00, 0x00, 0x01,
+    0x68, 0xc8, 0x42, 0x02, 0x32, 0xc8,
+    // slice (IDR)
+    0x00, 0x00, 0x00, 0x01,
+    0x65, 0x88, 0x82, 0x06, 0x78, 0x8c, 0x50, 0x00,
+    0x1c, 0xab, 0x8e, 0x00, 0x02, 0xfb, 0x31, 0xc0,
+    0x00, 0x5f, 0x66, 0xfb, 0xef, 0xbe,
+    // slice (non-IDR)
+    0x00, 0x00, 0x00, 0x01,
+    0x41, 0x9a, 0x1c, 0x0c, 0xf0, 0x09, 0x6c
+};
+
+TEST_F(H264ArenaTest, TestAllocate) {
+  H264Arena arena(256);
+  EXPECT_EQ(0, arena.GetBlockCount());
+
+  void* first = arena.Allocate(10);
+  void* second = arena.Allocate(10);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(first) % H264Arena::kAlignment);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(second) % H264Arena::kAlignment);
+  EXPECT_EQ(static_cast<uint8_t*>(first) + H264Arena::kAlignment, second);
+  EXPECT_EQ(1, arena.GetBlockCount());
+
+  // larger than a block: gets a block of its own
+  (void)arena.Allocate(1000);
+  EXPECT_EQ(2, arena.GetBlockCount());
+
+  // the blocks are kept, and reused
+  arena.Reset();
+  EXPECT_EQ(0, arena.GetAllocatedSize());
+  EXPECT_EQ(first, arena.Allocate(10));
+  (void)arena.Allocate(1000);
+  EXPECT_EQ(2, arena.GetBlockCount());
+}
+
+TEST_F(H264ArenaTest, TestParseNalUnitInArena) {
+  // parameter sets on the heap
+  H264BitstreamParserState bitstream_parser_state;
+  ParsingOptions parsing_options;
+  auto bitstream = H264BitstreamParser::ParseBitstream(
+      buffer, 38, &bitstream_parser_state, parsing_options);
+  ASSERT_TRUE(bitstream != nullptr);
+  ASSERT_EQ(2, bitstream->nal_units.size());
+
+  // slices in the arena, one access unit at a time
+  H264Arena arena;
+  const uint8_t* slice = buffer + 68;
+  size_t slice_length = arraysize(buffer) - 68;
+  size_t allocated_size = 0;
+  for (int i = 0; i < 3; i++) {
+    {
+      H264Arena::Scope arena_scope(&arena);
+      EXPECT_EQ(&arena, H264Arena::GetCurrent());
+      auto nal_unit = H264NalUnitParser::ParseNalUnit(
+          slice, slice_length, &bitstream_parser_state, parsing_options);
+      ASSERT_TRUE(nal_unit != nullptr);
+      const auto& slice_header =
+          nal_unit->nal_unit_payload->slice_layer_without_partitioning_rbsp
+              ->slice_header;
+      ASSERT_TRUE(slice_header != nullptr);
+      EXPECT_EQ(1, slice_header->frame_num);
+      if (i == 0) {
+        allocated_size = arena.GetAllocatedSize();
+        EXPECT_LT(0, allocated_size);
+      } else {
+        EXPECT_EQ(allocated_size, arena.GetAllocatedSize());
+      }
+    }
+    EXPECT_EQ(nullptr, H264Arena::GetCurrent());
+    arena.Reset();
+    EXPECT_EQ(1, arena.GetBlockCount());
+  }
+}
+
+TEST_F(H264ArenaTest, TestParseBitstreamWithArena) {
+  ParsingOptions parsing_options;
+  auto expected = H264BitstreamParser::ParseBitstream(
+      buffer, arraysize(buffer), parsing_options);
+  ASSERT_TRUE(expected != nullptr);
+  EXPECT_TRUE(expected->arena == nullptr);
+
+  parsing_options.use_arena = true;
+  auto bitstream = H264BitstreamParser::ParseBitstream(
+      buffer, arraysize(buffer), parsing_options);
+  ASSERT_TRUE(bitstream != nullptr);
+  ASSERT_TRUE(bitstream->arena != nullptr);
+  EXPECT_LT(0, bitstream->arena->GetAllocatedSize());
+  EXPECT_EQ(nullptr, H264Arena::GetCurrent());
+
+  ASSERT_EQ(expected->nal_units.size(), bitstream->nal_units.size());
+  for (size_t i = 0; i < bitstream->nal_units.size(); i++) {
+    EXPECT_EQ(expected->nal_units[i]->offset, bitstream->nal_units[i]->offset);
+    EXPECT_EQ(expected->nal_units[i]->parsed_length,
+              bitstream->nal_units[i]->parsed_length);
+    EXPECT_EQ(expected->nal_units[i]->checksum->GetPrintableChecksum(),
+              bitstream->nal_units[i]->checksum->GetPrintableChecksum());
+  }
+}
+
+}  // namespace h264nal
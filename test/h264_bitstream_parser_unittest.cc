@@ -7,6 +7,10 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <cstdint>
+#include <random>
+#include <vector>
+
 #include "h264_bitstream_parser_state.h"
 #include "h264_common.h"
 #include "rtc_common.h"
@@ -179,6 +183,240 @@ TEST_F(H264BitstreamParserTest, TestSampleBitstream601Alt) {
   // counter += length;
 }
 
+TEST_F(H264BitstreamParserTest, TestSampleBitstream601Callback) {
+  // the callback version hands over the same NAL units, one at a time
+  ParsingOptions parsing_options;
+  auto bitstream = H264BitstreamParser::ParseBitstream(
+      buffer, arraysize(buffer), parsing_options);
+  ASSERT_TRUE(bitstream != nullptr);
+
+  H264BitstreamParserState bitstream_parser_state;
+  size_t index = 0;
+  H264BitstreamParser::ParseBitstream(
+      buffer, arraysize(buffer), &bitstream_parser_state, parsing_options,
+      [&bitstream, &index](
+          std::unique_ptr<struct H264NalUnitParser::NalUnitState> nal_unit) {
+        ASSERT_TRUE(nal_unit != nullptr);
+        ASSERT_LT(index, bitstream->nal_units.size());
+        const auto& expected = bitstream->nal_units[index];
+        EXPECT_EQ(expected->offset, nal_unit->offset);
+        EXPECT_EQ(expected->length, nal_unit->length);
+        EXPECT_EQ(expected->parsed_length, nal_unit->parsed_length);
+        EXPECT_EQ(expected->nal_unit_header->nal_unit_type,
+                  nal_unit->nal_unit_header->nal_unit_type);
+        EXPECT_EQ(expected->checksum->GetPrintableChecksum(),
+                  nal_unit->checksum->GetPrintableChecksum());
+        index++;
+      });
+  EXPECT_EQ(4, index);
+  // the SPS/PPS still go into the parser state
+  EXPECT_TRUE(bitstream_parser_state.GetSps(0) != nullptr);
+  EXPECT_TRUE(bitstream_parser_state.GetPps(0) != nullptr);
+}
+
+TEST_F(H264BitstreamParserTest, TestParseLevel) {
+  // classify the slices, without the rest of their headers
+  ParsingOptions parsing_options;
+  parsing_options.SetParseLevel(CODED_SLICE_OF_IDR_PICTURE_NUT,
+                                PARSE_PARTIAL);
+  parsing_options.SetParseLevel(CODED_SLICE_OF_NON_IDR_PICTURE_NUT,
+                                PARSE_HEADER);
+  parsing_options.slice_header_last_field = SLICE_HEADER_SLICE_TYPE;
+  auto bitstream = H264BitstreamParser::ParseBitstream(
+      buffer, arraysize(buffer), parsing_options);
+  ASSERT_TRUE(bitstream != nullptr);
+  ASSERT_EQ(4, bitstream->nal_units.size());
+
+  // the parameter sets are parsed fully
+  EXPECT_TRUE(bitstream->nal_units[0]->nal_unit_payload->sps != nullptr);
+  EXPECT_TRUE(bitstream->nal_units[1]->nal_unit_payload->pps != nullptr);
+
+  // partial: first_mb_in_slice and slice_type (8 bits) after the header
+  const auto& idr = bitstream->nal_units[2];
+  const auto& slice_header =
+      idr->nal_unit_payload->slice_layer_without_partitioning_rbsp
+          ->slice_header;
+  ASSERT_TRUE(slice_header != nullptr);
+  EXPECT_EQ(7, slice_header->slice_type);
+  EXPECT_EQ(0, slice_header->slice_qp_delta);
+  EXPECT_EQ(nullptr, slice_header->dec_ref_pic_marking);
+  EXPECT_EQ(2, idr->parsed_length);
+
+  // header only
+  const auto& non_idr = bitstream->nal_units[3];
+  EXPECT_EQ(CODED_SLICE_OF_NON_IDR_PICTURE_NUT,
+            non_idr->nal_unit_header->nal_unit_type);
+  EXPECT_EQ(nullptr,
+            non_idr->nal_unit_payload->slice_layer_without_partitioning_rbsp);
+  EXPECT_EQ(1, non_idr->parsed_length);
+
+  // skipped NAL units are dropped
+  parsing_options.SetParseLevel(PARSE_SKIP);
+  parsing_options.SetParseLevel(SPS_NUT, PARSE_FULL);
+  bitstream = H264BitstreamParser::ParseBitstream(buffer, arraysize(buffer),
+                                                  parsing_options);
+  ASSERT_TRUE(bitstream != nullptr);
+  ASSERT_EQ(1, bitstream->nal_units.size());
+  EXPECT_EQ(SPS_NUT, bitstream->nal_units[0]->nal_unit_header->nal_unit_type);
+}
+
+TEST_F(H264BitstreamParserTest, TestParseBitstreamParallel) {
+  // 601.264, then PPS id 0 redefined with entropy_coding_mode_flag set (so
+  // the non-IDR slice after it does not parse), all repeated: every slice
+  // must be parsed against the PPS in effect at its position
+  const uint8_t cabac_pps_and_slice[] = {
+      0x00, 0x00, 0x00, 0x01, 0x68, 0xe8, 0x42, 0x02, 0x32, 0xc8,
+      0x00, 0x00, 0x00, 0x01, 0x41, 0x9a, 0x1c, 0x0c, 0xf0, 0x09, 0x6c};
+  std::vector<uint8_t> data;
+  for (int i = 0; i < 16; i++) {
+    data.insert(data.end(), buffer, buffer + arraysize(buffer));
+    data.insert(data.end(), cabac_pps_and_slice,
+                cabac_pps_and_slice + arraysize(cabac_pps_and_slice));
+  }
+
+  ParsingOptions parsing_options;
+  auto expected = H264BitstreamParser::ParseBitstream(
+      data.data(), data.size(), parsing_options);
+  ASSERT_TRUE(expected != nullptr);
+  ASSERT_EQ(16 * 6, expected->nal_units.size());
+
+  for (size_t num_threads : std::vector<size_t>({0, 1, 2, 3, 8})) {
+    H264BitstreamParserState bitstream_parser_state;
+    auto bitstream = H264BitstreamParser::ParseBitstreamParallel(
+        data.data(), data.size(), &bitstream_parser_state, parsing_options,
+        num_threads);
+    ASSERT_TRUE(bitstream != nullptr);
+    ASSERT_EQ(expected->nal_units.size(), bitstream->nal_units.size());
+    for (size_t i = 0; i < bitstream->nal_units.size(); i++) {
+      const auto& e = expected->nal_units[i];
+      const auto& a = bitstream->nal_units[i];
+      EXPECT_EQ(e->offset, a->offset) << "num_threads: " << num_threads;
+      EXPECT_EQ(e->length, a->length);
+      EXPECT_EQ(e->parsed_length, a->parsed_length);
+      EXPECT_EQ(e->nal_unit_header->nal_unit_type,
+                a->nal_unit_header->nal_unit_type);
+      EXPECT_EQ(e->checksum->GetPrintableChecksum(),
+                a->checksum->GetPrintableChecksum());
+      EXPECT_EQ(
+          e->nal_unit_payload->slice_layer_without_partitioning_rbsp ==
+              nullptr,
+          a->nal_unit_payload->slice_layer_without_partitioning_rbsp ==
+              nullptr)
+          << "nal unit: " << i << " num_threads: " << num_threads;
+    }
+    // the parameter sets went into the caller's state, as in order
+    ASSERT_TRUE(bitstream_parser_state.GetPps(0) != nullptr);
+    EXPECT_EQ(1, bitstream_parser_state.GetPps(0)->entropy_coding_mode_flag);
+  }
+}
+
+TEST_F(H264BitstreamParserTest, TestParseBitstreamChunked) {
+  // garbage before the first start code, 601.264 with the PPS redefined
+  // halfway through, 3-byte start codes, and a start code in the last 3
+  // bytes (which FindNaluIndices() does not count)
+  std::vector<uint8_t> data = {0x12, 0x00, 0x34, 0x00, 0x00};
+  const uint8_t cabac_pps_and_slice[] = {
+      0x00, 0x00, 0x00, 0x01, 0x68, 0xe8, 0x42, 0x02, 0x32, 0xc8,
+      0x00, 0x00, 0x01, 0x41, 0x9a, 0x1c, 0x0c, 0xf0, 0x09, 0x6c};
+  for (int i = 0; i < 4; i++) {
+    data.insert(data.end(), buffer, buffer + arraysize(buffer));
+    data.insert(data.end(), cabac_pps_and_slice,
+                cabac_pps_and_slice + arraysize(cabac_pps_and_slice));
+  }
+  const uint8_t tail[] = {0x00, 0x00, 0x00, 0x01, 0x09, 0xf0, 0x00, 0x00,
+                          0x01, 0x09, 0x10, 0x00, 0x00, 0x01};
+  data.insert(data.end(), tail, tail + arraysize(tail));
+
+  ParsingOptions parsing_options;
+  auto expected = H264BitstreamParser::ParseBitstream(
+      data.data(), data.size(), parsing_options);
+  ASSERT_TRUE(expected != nullptr);
+
+  // every chunk length, so that start codes are split across chunks (and
+  // waves) at every position
+  for (size_t num_threads : std::vector<size_t>({1, 2, 3})) {
+    for (size_t chunk_length = 1; chunk_length <= data.size();
+         chunk_length++) {
+      auto bitstream = H264BitstreamParser::ParseBitstreamChunked(
+          data.data(), data.size(), parsing_options, num_threads,
+          chunk_length);
+      ASSERT_TRUE(bitstream != nullptr);
+      ASSERT_EQ(expected->nal_units.size(), bitstream->nal_units.size())
+          << "num_threads: " << num_threads
+          << " chunk_length: " << chunk_length;
+      for (size_t i = 0; i < bitstream->nal_units.size(); i++) {
+        const auto& e = expected->nal_units[i];
+        const auto& a = bitstream->nal_units[i];
+        EXPECT_EQ(e->offset, a->offset);
+        EXPECT_EQ(e->length, a->length);
+        EXPECT_EQ(e->parsed_length, a->parsed_length);
+        EXPECT_EQ(e->checksum->GetPrintableChecksum(),
+                  a->checksum->GetPrintableChecksum());
+        EXPECT_EQ(
+            e->nal_unit_payload->slice_layer_without_partitioning_rbsp ==
+                nullptr,
+            a->nal_unit_payload->slice_layer_without_partitioning_rbsp ==
+                nullptr);
+      }
+    }
+  }
+
+  // the default chunk length, and one thread per core
+  auto bitstream = H264BitstreamParser::ParseBitstreamChunked(
+      data.data(), data.size(), parsing_options, 0, 0);
+  ASSERT_TRUE(bitstream != nullptr);
+  EXPECT_EQ(expected->nal_units.size(), bitstream->nal_units.size());
+
+  // chunk lengths whose wave length overflows
+  for (size_t num_threads : std::vector<size_t>({1, 2, 3})) {
+    for (size_t chunk_length : std::vector<size_t>(
+             {SIZE_MAX, SIZE_MAX / 2 + 1, SIZE_MAX / num_threads + 1})) {
+      bitstream = H264BitstreamParser::ParseBitstreamChunked(
+          data.data(), data.size(), parsing_options, num_threads,
+          chunk_length);
+      ASSERT_TRUE(bitstream != nullptr);
+      ASSERT_EQ(expected->nal_units.size(), bitstream->nal_units.size())
+          << "num_threads: " << num_threads
+          << " chunk_length: " << chunk_length;
+      for (size_t i = 0; i < bitstream->nal_units.size(); i++) {
+        EXPECT_EQ(expected->nal_units[i]->offset,
+                  bitstream->nal_units[i]->offset);
+        EXPECT_EQ(expected->nal_units[i]->length,
+                  bitstream->nal_units[i]->length);
+        EXPECT_EQ(expected->nal_units[i]->checksum->GetPrintableChecksum(),
+                  bitstream->nal_units[i]->checksum->GetPrintableChecksum());
+      }
+    }
+  }
+}
+
+TEST_F(H264BitstreamParserTest, TestNaluLengthCallback) {
+  // 4-byte NALU length fields: an SPS and a PPS (601.264)
+  const uint8_t length_buffer[] = {
+      0x00, 0x00, 0x00, 0x18, 0x67, 0x42, 0xc0, 0x16, 0xa6, 0x11, 0x05,
+      0x07, 0xe9, 0xb2, 0x00, 0x00, 0x03, 0x00, 0x02, 0x00, 0x00, 0x03,
+      0x00, 0x64, 0x1e, 0x2c, 0x5c, 0x23, 0x00, 0x00, 0x00, 0x06, 0x68,
+      0xc8, 0x42, 0x02, 0x32, 0xc8};
+  ParsingOptions parsing_options;
+  auto bitstream = H264BitstreamParser::ParseBitstreamNALULength(
+      length_buffer, arraysize(length_buffer), 4, parsing_options);
+  ASSERT_TRUE(bitstream != nullptr);
+  ASSERT_EQ(2, bitstream->nal_units.size());
+
+  H264BitstreamParserState bitstream_parser_state;
+  std::vector<size_t> offsets;
+  H264BitstreamParser::ParseBitstreamNALULength(
+      length_buffer, arraysize(length_buffer), 4, &bitstream_parser_state,
+      parsing_options,
+      [&offsets](
+          std::unique_ptr<struct H264NalUnitParser::NalUnitState> nal_unit) {
+        offsets.push_back(nal_unit->offset);
+      });
+  EXPECT_THAT(offsets, ::testing::ElementsAreArray(
+                           {bitstream->nal_units[0]->offset,
+                            bitstream->nal_units[1]->offset}));
+}
+
 TEST_F(H264BitstreamParserTest, TestZeroLengthBitstream) {
   const uint8_t empty_buffer[] = {0};
   H264BitstreamParserState bitstream_parser_state;
@@ -225,4 +463,78 @@ TEST_F(H264BitstreamParserTest, TestZeroNaluLength) {
   EXPECT_EQ(0, bitstream->nal_units.size());
 }
 
+TEST_F(H264BitstreamParserTest, TestStartCodeScanners) {
+  // every scanner must return exactly what the scalar one does. Use a byte
+  // mix heavy in 0x00 and 0x01, so that start codes (3- and 4-byte), runs
+  // of zeros, and near misses land at every offset of a SIMD block,
+  // including the block edges and the unaligned tail.
+  std::mt19937 generator(0x264);
+  std::vector<uint8_t> data(4096);
+  for (auto& byte : data) {
+    uint32_t r = generator() % 8;
+    byte = (r < 4) ? 0x00 : (r < 6) ? 0x01 : static_cast<uint8_t>(generator());
+  }
+  const SimdLevel kScanners[] = {SIMD_AUTO, SIMD_SSE2, SIMD_AVX2};
+
+  for (size_t offset = 0; offset < 33; offset++) {
+    for (size_t length = 0; offset + length <= 200; length++) {
+      auto expected = H264BitstreamParser::FindNaluIndices(
+          data.data() + offset, length, SIMD_NONE);
+      for (const auto& scanner : kScanners) {
+        if (!IsSimdLevelSupported(scanner)) {
+          continue;
+        }
+        auto actual = H264BitstreamParser::FindNaluIndices(
+            data.data() + offset, length, scanner);
+        ASSERT_EQ(expected.size(), actual.size())
+            << "scanner: " << static_cast<int>(scanner)
+            << " offset: " << offset << " length: " << length;
+        for (size_t i = 0; i < expected.size(); i++) {
+          EXPECT_EQ(expected[i].start_offset, actual[i].start_offset);
+          EXPECT_EQ(expected[i].payload_start_offset,
+                    actual[i].payload_start_offset);
+          EXPECT_EQ(expected[i].payload_size, actual[i].payload_size);
+        }
+      }
+    }
+  }
+
+  // and on the whole buffer
+  auto expected = H264BitstreamParser::FindNaluIndices(
+      data.data(), data.size(), SIMD_NONE);
+  EXPECT_GT(expected.size(), 100u);
+  for (const auto& scanner : kScanners) {
+    if (!IsSimdLevelSupported(scanner)) {
+      continue;
+    }
+    auto actual =
+        H264BitstreamParser::FindNaluIndices(data.data(), data.size(), scanner);
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+      EXPECT_EQ(expected[i].start_offset, actual[i].start_offset);
+      EXPECT_EQ(expected[i].payload_size, actual[i].payload_size);
+    }
+  }
+}
+
+TEST_F(H264BitstreamParserTest, TestStartCodeScannerSparse) {
+  // long runs with no 0x00 or 0x01 at all take the SIMD fast path end to
+  // end. Place single start codes at each offset of a 64 byte window.
+  for (size_t position = 0; position < 64; position++) {
+    std::vector<uint8_t> data(128, 0xab);
+    data[position] = 0x00;
+    data[position + 1] = 0x00;
+    data[position + 2] = 0x01;
+    auto expected = H264BitstreamParser::FindNaluIndices(
+        data.data(), data.size(), SIMD_NONE);
+    ASSERT_EQ(1u, expected.size());
+    EXPECT_EQ(position, expected[0].start_offset);
+    auto actual =
+        H264BitstreamParser::FindNaluIndices(data.data(), data.size());
+    ASSERT_EQ(1u, actual.size());
+    EXPECT_EQ(position, actual[0].start_offset);
+    EXPECT_EQ(expected[0].payload_size, actual[0].payload_size);
+  }
+}
+
 }  // namespace h264nal
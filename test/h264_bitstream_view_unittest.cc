@@ -0,0 +1,176 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#include "h264_bitstream_view.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <map>
+#include <vector>
+
+#include "h264_bitstream_parser.h"
+#include "h264_common.h"
+#include "rtc_common.h"
+
+namespace h264nal {
+
+class H264BitstreamViewTest : public ::testing::Test {
+ public:
+  H264BitstreamViewTest() {}
+  ~H264BitstreamViewTest() override {}
+};
+
+// SPS, PPS, slice IDR, slice non-IDR (601.264), then the same PPS id
+// redefined with entropy_coding_mode_flag set, and the non-IDR slice again
+const uint8_t buffer[] = {
+    // SPS
+    0x00, 0x00, 0x00, 0x01,
+    0x67, 0x42, 0xc0, 0x16, 0xa6, 0x11, 0x05, 0x07,
+    0xe9, 0xb2, 0x00, 0x00, 0x03, 0x00, 0x02, 0x00,
+    0x00, 0x03, 0x00, 0x64, 0x1e, 0x2c, 0x5c, 0x23,
+    // PPS
+    0x00, 0x00, 0x00, 0x01,
+    0x68, 0xc8, 0x42, 0x02, 0x32, 0xc8,
+    // slice (IDR)
+    0x00, 0x00, 0x00, 0x01,
+    0x65, 0x88, 0x82, 0x06, 0x78, 0x8c, 0x50, 0x00,
+    0x1c, 0xab, 0x8e, 0x00, 0x02, 0xfb, 0x31, 0xc0,
+    0x00, 0x5f, 0x66, 0xfb, 0xef, 0xbe,
+    // slice (non-IDR)
+    0x00, 0x00, 0x00, 0x01,
+    0x41, 0x9a, 0x1c, 0x0c, 0xf0, 0x09, 0x6c,
+    // PPS (id 0, entropy_coding_mode_flag = 1)
+    0x00, 0x00, 0x00, 0x01,
+    0x68, 0xe8, 0x42, 0x02, 0x32, 0xc8,
+    // slice (non-IDR)
+    0x00, 0x00, 0x00, 0x01,
+    0x41, 0x9a, 0x1c, 0x0c, 0xf0, 0x09, 0x6c
+};
+
+TEST_F(H264BitstreamViewTest, TestNalUnitInfo) {
+  // listing the NAL units parses none of them
+  ParsingOptions parsing_options;
+  H264BitstreamView view(buffer, arraysize(buffer), parsing_options);
+  ASSERT_EQ(6, view.GetNalUnitCount());
+
+  std::map<uint32_t, size_t> histogram;
+  std::vector<size_t> keyframes;
+  for (size_t i = 0; i < view.GetNalUnitCount(); i++) {
+    const auto& info = view.GetNalUnitInfo(i);
+    histogram[info.nal_unit_type]++;
+    if (info.nal_unit_type == CODED_SLICE_OF_IDR_PICTURE_NUT) {
+      keyframes.push_back(info.offset);
+    }
+  }
+  EXPECT_EQ(1, histogram[SPS_NUT]);
+  EXPECT_EQ(2, histogram[PPS_NUT]);
+  EXPECT_EQ(1, histogram[CODED_SLICE_OF_IDR_PICTURE_NUT]);
+  EXPECT_EQ(2, histogram[CODED_SLICE_OF_NON_IDR_PICTURE_NUT]);
+  EXPECT_THAT(keyframes, ::testing::ElementsAreArray({42}));
+  EXPECT_EQ(3, view.GetNalUnitInfo(0).nal_ref_idc);
+  EXPECT_EQ(2, view.GetNalUnitInfo(3).nal_ref_idc);
+}
+
+TEST_F(H264BitstreamViewTest, TestMatchesParseBitstream) {
+  // access the NAL units backwards, so that every slice is parsed before
+  // the parameter sets that precede it have been asked for, and the last
+  // slice before the first one
+  ParsingOptions parsing_options;
+  auto bitstream = H264BitstreamParser::ParseBitstream(
+      buffer, arraysize(buffer), parsing_options);
+  ASSERT_TRUE(bitstream != nullptr);
+  H264BitstreamView view(buffer, arraysize(buffer), parsing_options);
+  ASSERT_EQ(bitstream->nal_units.size(), view.GetNalUnitCount());
+
+  for (size_t i = view.GetNalUnitCount(); i-- > 0;) {
+    const auto* nal_unit = view.GetNalUnit(i);
+    ASSERT_TRUE(nal_unit != nullptr);
+    const auto& expected = bitstream->nal_units[i];
+    EXPECT_EQ(expected->offset, nal_unit->offset);
+    EXPECT_EQ(expected->length, nal_unit->length);
+    EXPECT_EQ(expected->parsed_length, nal_unit->parsed_length);
+    EXPECT_EQ(expected->nal_unit_header->nal_unit_type,
+              nal_unit->nal_unit_header->nal_unit_type);
+    EXPECT_EQ(expected->checksum->GetPrintableChecksum(),
+              nal_unit->checksum->GetPrintableChecksum());
+    // cached
+    EXPECT_EQ(nal_unit, view.GetNalUnit(i));
+  }
+
+  // each non-IDR slice resolved against the PPS in effect at its position.
+  // Under the redefined (CABAC) PPS, the same slice bytes read a
+  // cabac_init_idc out of range, so its slice layer does not parse.
+  const auto& first = view.GetNalUnit(3)
+                          ->nal_unit_payload
+                          ->slice_layer_without_partitioning_rbsp;
+  ASSERT_TRUE(first != nullptr);
+  EXPECT_EQ(0, first->slice_header->entropy_coding_mode_flag);
+  EXPECT_TRUE(view.GetNalUnit(5)
+                  ->nal_unit_payload->slice_layer_without_partitioning_rbsp ==
+              nullptr);
+  EXPECT_TRUE(bitstream->nal_units[5]
+                  ->nal_unit_payload->slice_layer_without_partitioning_rbsp ==
+              nullptr);
+
+  EXPECT_TRUE(view.GetNalUnit(view.GetNalUnitCount()) == nullptr);
+}
+
+TEST_F(H264BitstreamViewTest, TestRepeatedParameterSets) {
+  // SPS, PPS, slice IDR, then the same SPS and PPS resent before the
+  // non-IDR slice
+  const uint8_t repeated_buffer[] = {
+      // SPS
+      0x00, 0x00, 0x00, 0x01,
+      0x67, 0x42, 0xc0, 0x16, 0xa6, 0x11, 0x05, 0x07,
+      0xe9, 0xb2, 0x00, 0x00, 0x03, 0x00, 0x02, 0x00,
+      0x00, 0x03, 0x00, 0x64, 0x1e, 0x2c, 0x5c, 0x23,
+      // PPS
+      0x00, 0x00, 0x00, 0x01,
+      0x68, 0xc8, 0x42, 0x02, 0x32, 0xc8,
+      // slice (IDR)
+      0x00, 0x00, 0x00, 0x01,
+      0x65, 0x88, 0x82, 0x06, 0x78, 0x8c, 0x50, 0x00,
+      0x1c, 0xab, 0x8e, 0x00, 0x02, 0xfb, 0x31, 0xc0,
+      0x00, 0x5f, 0x66, 0xfb, 0xef, 0xbe,
+      // SPS (repeat)
+      0x00, 0x00, 0x00, 0x01,
+      0x67, 0x42, 0xc0, 0x16, 0xa6, 0x11, 0x05, 0x07,
+      0xe9, 0xb2, 0x00, 0x00, 0x03, 0x00, 0x02, 0x00,
+      0x00, 0x03, 0x00, 0x64, 0x1e, 0x2c, 0x5c, 0x23,
+      // PPS (repeat)
+      0x00, 0x00, 0x00, 0x01,
+      0x68, 0xc8, 0x42, 0x02, 0x32, 0xc8,
+      // slice (non-IDR)
+      0x00, 0x00, 0x00, 0x01,
+      0x41, 0x9a, 0x1c, 0x0c, 0xf0, 0x09, 0x6c};
+  ParsingOptions parsing_options;
+  H264BitstreamView view(repeated_buffer, arraysize(repeated_buffer),
+                         parsing_options);
+  ASSERT_EQ(6, view.GetNalUnitCount());
+
+  // the repeats share the table entries of the first parameter sets
+  const auto* sps = view.GetNalUnit(0);
+  const auto* pps = view.GetNalUnit(1);
+  const auto* repeated_sps = view.GetNalUnit(3);
+  const auto* repeated_pps = view.GetNalUnit(4);
+  ASSERT_TRUE(sps != nullptr && pps != nullptr);
+  ASSERT_TRUE(repeated_sps != nullptr && repeated_pps != nullptr);
+  EXPECT_TRUE(sps->parameter_set_changed);
+  EXPECT_TRUE(pps->parameter_set_changed);
+  EXPECT_FALSE(repeated_sps->parameter_set_changed);
+  EXPECT_FALSE(repeated_pps->parameter_set_changed);
+  EXPECT_EQ(sps->nal_unit_payload->sps, repeated_sps->nal_unit_payload->sps);
+  EXPECT_EQ(pps->nal_unit_payload->pps, repeated_pps->nal_unit_payload->pps);
+
+  // and the slice after them still resolves its PPS
+  const auto* slice = view.GetNalUnit(5);
+  ASSERT_TRUE(slice != nullptr);
+  const auto& slice_layer =
+      slice->nal_unit_payload->slice_layer_without_partitioning_rbsp;
+  ASSERT_TRUE(slice_layer != nullptr);
+  EXPECT_EQ(0, slice_layer->slice_header->pic_parameter_set_id);
+}
+
+}  // namespace h264nal
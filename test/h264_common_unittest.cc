@@ -7,6 +7,8 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <random>
 #include <vector>
 
 #include "rtc_common.h"
@@ -201,6 +203,169 @@ TEST_F(H264CommonSignedGolombTest, TestReadSignedExponentialGolomb) {
   }
 }
 
+class H264CommonExponentialGolombTest : public ::testing::Test {
+ public:
+  H264CommonExponentialGolombTest() {}
+  ~H264CommonExponentialGolombTest() override {}
+};
+
+TEST_F(H264CommonExponentialGolombTest, TestRoundTripAtEveryBitOffset) {
+  // ReadExponentialGolomb() decodes out of a cached 64 bit window. Write a
+  // run of codewords of every prefix length, starting at each bit offset,
+  // so that codewords straddle the window edge at every position.
+  std::vector<uint32_t> values;
+  for (uint32_t bits = 0; bits < 32; bits++) {
+    values.push_back((uint32_t{1} << bits) - 1);
+    values.push_back(uint32_t{1} << bits);
+  }
+  values.push_back(0xfffffffe);
+
+  for (size_t bit_offset = 0; bit_offset < 8; bit_offset++) {
+    std::vector<uint8_t> buffer(values.size() * 8 + 2);
+    BitBufferWriter writer(buffer.data(), buffer.size());
+    ASSERT_TRUE(writer.ConsumeBits(bit_offset));
+    for (const uint32_t& value : values) {
+      ASSERT_TRUE(writer.WriteExponentialGolomb(value));
+    }
+    // a stop bit, so the tail is not all zeros
+    ASSERT_TRUE(writer.WriteBits(1, 1));
+
+    BitBuffer bit_buffer(buffer.data(), buffer.size());
+    ASSERT_TRUE(bit_buffer.ConsumeBits(bit_offset));
+    for (const uint32_t& value : values) {
+      uint32_t read_value = 0;
+      EXPECT_TRUE(bit_buffer.ReadExponentialGolomb(read_value))
+          << "bit_offset: " << bit_offset << " value: " << value;
+      EXPECT_EQ(value, read_value)
+          << "bit_offset: " << bit_offset << " value: " << value;
+    }
+    uint32_t stop_bit = 0;
+    EXPECT_TRUE(bit_buffer.ReadBits(1, stop_bit));
+    EXPECT_EQ(1u, stop_bit);
+  }
+}
+
+TEST_F(H264CommonExponentialGolombTest, TestFailureKeepsOffset) {
+  // a failed read must consume nothing
+  struct {
+    std::vector<uint8_t> buffer;
+    size_t bit_offset;
+    const char* what;
+  } kTestcases[] = {
+      {{0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00},
+       0,
+       "32 zero prefix"},
+      {{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+       3,
+       "no 1 bit at all"},
+      {{0x00, 0x01}, 0, "value truncated by the end of the buffer"},
+      {{0x00, 0x00, 0x00, 0x01, 0xff}, 1, "long value truncated"},
+      {{}, 0, "empty buffer"},
+  };
+
+  for (const auto& testcase : kTestcases) {
+    BitBuffer bit_buffer(testcase.buffer.data(), testcase.buffer.size());
+    ASSERT_TRUE(bit_buffer.ConsumeBits(testcase.bit_offset)) << testcase.what;
+    uint32_t value = 0;
+    EXPECT_FALSE(bit_buffer.ReadExponentialGolomb(value)) << testcase.what;
+    size_t byte_offset = 0;
+    size_t bit_offset = 0;
+    bit_buffer.GetCurrentOffset(&byte_offset, &bit_offset);
+    EXPECT_EQ(0u, byte_offset) << testcase.what;
+    EXPECT_EQ(testcase.bit_offset, bit_offset) << testcase.what;
+  }
+}
+
+TEST_F(H264CommonExponentialGolombTest, TestNarrowValues) {
+  // the largest values a narrow field takes, then the smallest ones it
+  // does not: those fail the read, and leave the bit buffer where it was
+  std::vector<uint8_t> buffer(32);
+  BitBufferWriter writer(buffer.data(), buffer.size());
+  ASSERT_TRUE(writer.WriteExponentialGolomb(255));
+  ASSERT_TRUE(writer.WriteExponentialGolomb(256));
+  ASSERT_TRUE(writer.WriteExponentialGolomb(65535));
+  ASSERT_TRUE(writer.WriteExponentialGolomb(65536));
+  ASSERT_TRUE(writer.WriteSignedExponentialGolomb(127));
+  ASSERT_TRUE(writer.WriteSignedExponentialGolomb(-128));
+  ASSERT_TRUE(writer.WriteSignedExponentialGolomb(128));
+  ASSERT_TRUE(writer.WriteSignedExponentialGolomb(-129));
+
+  BitBuffer bit_buffer(buffer.data(), buffer.size());
+  size_t byte_offset = 0;
+  size_t bit_offset = 0;
+  size_t failed_byte_offset = 0;
+  size_t failed_bit_offset = 0;
+  uint8_t value8 = 0;
+  EXPECT_TRUE(bit_buffer.ReadExponentialGolomb(value8));
+  EXPECT_EQ(255, value8);
+  bit_buffer.GetCurrentOffset(&byte_offset, &bit_offset);
+  EXPECT_FALSE(bit_buffer.ReadExponentialGolomb(value8));
+  bit_buffer.GetCurrentOffset(&failed_byte_offset, &failed_bit_offset);
+  EXPECT_EQ(byte_offset, failed_byte_offset);
+  EXPECT_EQ(bit_offset, failed_bit_offset);
+  uint16_t value16 = 0;
+  EXPECT_TRUE(bit_buffer.ReadExponentialGolomb(value16));
+  EXPECT_EQ(256, value16);
+  EXPECT_TRUE(bit_buffer.ReadExponentialGolomb(value16));
+  EXPECT_EQ(65535, value16);
+  bit_buffer.GetCurrentOffset(&byte_offset, &bit_offset);
+  EXPECT_FALSE(bit_buffer.ReadExponentialGolomb(value16));
+  bit_buffer.GetCurrentOffset(&failed_byte_offset, &failed_bit_offset);
+  EXPECT_EQ(byte_offset, failed_byte_offset);
+  EXPECT_EQ(bit_offset, failed_bit_offset);
+  uint32_t value32 = 0;
+  EXPECT_TRUE(bit_buffer.ReadExponentialGolomb(value32));
+  EXPECT_EQ(65536, value32);
+
+  int8_t signed_value8 = 0;
+  EXPECT_TRUE(bit_buffer.ReadSignedExponentialGolomb(signed_value8));
+  EXPECT_EQ(127, signed_value8);
+  EXPECT_TRUE(bit_buffer.ReadSignedExponentialGolomb(signed_value8));
+  EXPECT_EQ(-128, signed_value8);
+  for (const int32_t expected : {128, -129}) {
+    bit_buffer.GetCurrentOffset(&byte_offset, &bit_offset);
+    EXPECT_FALSE(bit_buffer.ReadSignedExponentialGolomb(signed_value8));
+    bit_buffer.GetCurrentOffset(&failed_byte_offset, &failed_bit_offset);
+    EXPECT_EQ(byte_offset, failed_byte_offset);
+    EXPECT_EQ(bit_offset, failed_bit_offset);
+    int32_t signed_value32 = 0;
+    EXPECT_TRUE(bit_buffer.ReadSignedExponentialGolomb(signed_value32));
+    EXPECT_EQ(expected, signed_value32);
+  }
+
+  // a narrow ReadBits() wider than its value reads nothing
+  BitBuffer bits_buffer(buffer.data(), buffer.size());
+  EXPECT_FALSE(bits_buffer.ReadBits(9, value8));
+  EXPECT_FALSE(bits_buffer.ReadBits(17, value16));
+  EXPECT_EQ(buffer.size() * 8, bits_buffer.RemainingBitCount());
+  EXPECT_TRUE(bits_buffer.ReadBits(8, value8));
+  EXPECT_EQ(buffer[0], value8);
+  EXPECT_TRUE(bits_buffer.ReadBits(16, value16));
+  EXPECT_EQ((buffer[1] << 8) | buffer[2], value16);
+}
+
+TEST_F(H264CommonExponentialGolombTest, TestSeekBackAndWrite) {
+  // the read cache must follow a Seek() backwards, and must not serve
+  // bytes a BitBufferWriter has since overwritten
+  uint8_t buffer[] = {0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0, 0x11};
+  BitBufferWriter bit_buffer(buffer, arraysize(buffer));
+  uint32_t val = 0;
+  ASSERT_TRUE(bit_buffer.ReadBits(16, val));
+  EXPECT_EQ(0x1234u, val);
+  ASSERT_TRUE(bit_buffer.Seek(1, 4));
+  ASSERT_TRUE(bit_buffer.ReadBits(8, val));
+  EXPECT_EQ(0x45u, val);
+  ASSERT_TRUE(bit_buffer.Seek(0, 0));
+  ASSERT_TRUE(bit_buffer.WriteUInt8(0xab));
+  ASSERT_TRUE(bit_buffer.Seek(0, 0));
+  ASSERT_TRUE(bit_buffer.ReadBits(16, val));
+  EXPECT_EQ(0xab34u, val);
+  uint64_t val64 = 0;
+  ASSERT_TRUE(bit_buffer.Seek(0, 4));
+  ASSERT_TRUE(bit_buffer.ReadBits(64, val64));
+  EXPECT_EQ(0xb3456789abcdef01ull, val64);
+}
+
 class H264CommonZeroWidthReadTest : public ::testing::Test {
  public:
   H264CommonZeroWidthReadTest() {}
@@ -287,4 +452,307 @@ TEST_F(H264CommonNaluChecksumTest, TestAlignedBitBuffer) {
   EXPECT_EQ(arraysize(buffer) * 8, bit_buffer.RemainingBitCount());
 }
 
+TEST_F(H264CommonNaluChecksumTest, TestChecksumTypes) {
+  // reference values
+  const uint8_t digits[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+  EXPECT_EQ("e3069283", NaluChecksum::GetNaluChecksum(digits,
+                                                      arraysize(digits),
+                                                      CHECKSUM_CRC32C)
+                            ->GetPrintableChecksum());
+  const uint8_t abc[] = {'a', 'b', 'c'};
+  EXPECT_EQ("44bc2cf5ad770999",
+            NaluChecksum::GetNaluChecksum(abc, arraysize(abc),
+                                          CHECKSUM_XXHASH64)
+                ->GetPrintableChecksum());
+  EXPECT_EQ("ef46db3751d8e999",
+            NaluChecksum::GetNaluChecksum(abc, 0, CHECKSUM_XXHASH64)
+                ->GetPrintableChecksum());
+  // long enough for the word-at-a-time paths, with a tail
+  std::vector<uint8_t> bytes(100);
+  for (size_t i = 0; i < bytes.size(); i++) {
+    bytes[i] = static_cast<uint8_t>(i);
+  }
+  EXPECT_EQ("c1caebe5", NaluChecksum::GetNaluChecksum(
+                            bytes.data(), bytes.size(), CHECKSUM_CRC32C)
+                            ->GetPrintableChecksum());
+  EXPECT_EQ("6ac1e58032166597",
+            NaluChecksum::GetNaluChecksum(bytes.data(), bytes.size(),
+                                          CHECKSUM_XXHASH64)
+                ->GetPrintableChecksum());
+
+  // the bytes and the BitBuffer versions agree, for every algorithm, and
+  // the BitBuffer is left where it was
+  for (ChecksumType checksum_type :
+       {CHECKSUM_SUM32, CHECKSUM_CRC32C, CHECKSUM_XXHASH64}) {
+    for (size_t length : {0u, 1u, 7u, 8u, 99u}) {
+      BitBuffer bit_buffer(bytes.data(), length);
+      auto expected =
+          NaluChecksum::GetNaluChecksum(bytes.data(), length, checksum_type);
+      EXPECT_EQ(expected->GetPrintableChecksum(),
+                NaluChecksum::GetNaluChecksum(&bit_buffer, checksum_type)
+                    ->GetPrintableChecksum());
+      EXPECT_EQ(length * 8, bit_buffer.RemainingBitCount());
+    }
+  }
+}
+
+TEST_F(H264CommonNaluChecksumTest, TestBitBufferOffsets) {
+  // an escaped buffer is checksummed as its RBSP, from the current offset
+  const uint8_t escaped[] = {0x65, 0x00, 0x00, 0x03, 0x01, 0x12,
+                             0x00, 0x00, 0x03, 0x00, 0x34};
+  std::vector<uint8_t> rbsp = UnescapeRbsp(escaped, arraysize(escaped));
+  for (ChecksumType checksum_type :
+       {CHECKSUM_SUM32, CHECKSUM_CRC32C, CHECKSUM_XXHASH64}) {
+    for (size_t offset = 0; offset <= rbsp.size(); offset++) {
+      EscapedBitBuffer bit_buffer(escaped, arraysize(escaped));
+      ASSERT_TRUE(bit_buffer.ConsumeBytes(offset));
+      auto expected = NaluChecksum::GetNaluChecksum(
+          rbsp.data() + offset, rbsp.size() - offset, checksum_type);
+      EXPECT_EQ(expected->GetPrintableChecksum(),
+                NaluChecksum::GetNaluChecksum(&bit_buffer, checksum_type)
+                    ->GetPrintableChecksum())
+          << "offset: " << offset;
+      EXPECT_EQ((rbsp.size() - offset) * 8, bit_buffer.RemainingBitCount());
+    }
+  }
+
+  // an unaligned buffer is checksummed as the whole bytes it has left
+  const uint8_t buffer[] = {0xde, 0xad, 0xbe, 0xef, 0x12, 0x34};
+  const uint8_t shifted[] = {0xbd, 0x5b, 0x7d, 0xde, 0x24};
+  for (ChecksumType checksum_type :
+       {CHECKSUM_SUM32, CHECKSUM_CRC32C, CHECKSUM_XXHASH64}) {
+    BitBuffer bit_buffer(buffer, arraysize(buffer));
+    ASSERT_TRUE(bit_buffer.ConsumeBits(1));
+    auto expected = NaluChecksum::GetNaluChecksum(
+        shifted, arraysize(shifted), checksum_type);
+    EXPECT_EQ(expected->GetPrintableChecksum(),
+              NaluChecksum::GetNaluChecksum(&bit_buffer, checksum_type)
+                  ->GetPrintableChecksum());
+    EXPECT_EQ(arraysize(buffer) * 8 - 1, bit_buffer.RemainingBitCount());
+  }
+}
+
+class H264CommonEscapedBitBufferTest : public ::testing::Test {
+ public:
+  H264CommonEscapedBitBufferTest() {}
+  ~H264CommonEscapedBitBufferTest() override {}
+};
+
+TEST_F(H264CommonEscapedBitBufferTest, TestMatchesUnescapeRbsp) {
+  // EscapedBitBuffer must read exactly what a BitBuffer over the
+  // UnescapeRbsp() copy reads, at the same (RBSP) offsets
+  std::vector<std::vector<uint8_t>> kTestcases = {
+      {0x00, 0x00, 0x03, 0x01, 0x00, 0x00, 0x03, 0x00, 0x12, 0x34},
+      {0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x03, 0x00, 0x00},
+      {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x00, 0x00, 0x03},
+      {0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x00,
+       0x03, 0x01, 0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10, 0x00},
+      {0x03, 0x00, 0x03, 0x00, 0x00, 0x03},
+      {},
+  };
+
+  for (const auto& buffer : kTestcases) {
+    std::vector<uint8_t> unescaped = UnescapeRbsp(buffer.data(), buffer.size());
+    // every read width, from every bit offset
+    for (size_t start = 0; start < unescaped.size() * 8 + 1; start++) {
+      for (size_t bit_count = 1; bit_count <= 64; bit_count++) {
+        BitBuffer expected(unescaped.data(), unescaped.size());
+        EscapedBitBuffer actual(buffer.data(), buffer.size());
+        ASSERT_TRUE(expected.ConsumeBits(start));
+        ASSERT_TRUE(actual.ConsumeBits(start));
+        EXPECT_EQ(expected.RemainingBitCount(), actual.RemainingBitCount());
+        uint64_t expected_value = 0;
+        uint64_t actual_value = 0;
+        bool expected_success = expected.ReadBits(bit_count, expected_value);
+        EXPECT_EQ(expected_success, actual.ReadBits(bit_count, actual_value))
+            << "start: " << start << " bit_count: " << bit_count;
+        if (expected_success) {
+          EXPECT_EQ(expected_value, actual_value)
+              << "start: " << start << " bit_count: " << bit_count;
+        }
+        size_t expected_byte_offset = 0;
+        size_t expected_bit_offset = 0;
+        size_t actual_byte_offset = 0;
+        size_t actual_bit_offset = 0;
+        expected.GetCurrentOffset(&expected_byte_offset, &expected_bit_offset);
+        actual.GetCurrentOffset(&actual_byte_offset, &actual_bit_offset);
+        EXPECT_EQ(expected_byte_offset, actual_byte_offset);
+        EXPECT_EQ(expected_bit_offset, actual_bit_offset);
+        EXPECT_EQ(more_rbsp_data(&expected), more_rbsp_data(&actual));
+      }
+    }
+    // one past the end
+    EscapedBitBuffer actual(buffer.data(), buffer.size());
+    EXPECT_FALSE(actual.ConsumeBits(unescaped.size() * 8 + 1));
+  }
+}
+
+TEST_F(H264CommonEscapedBitBufferTest, TestSeekAndExponentialGolomb) {
+  // ue(v) 0x0000 codewords (17 bits each) force emulation prevention
+  // bytes into the middle of codewords
+  std::vector<uint8_t> unescaped(64);
+  BitBufferWriter writer(unescaped.data(), unescaped.size());
+  std::vector<uint32_t> values = {65534, 0, 65534, 65534, 1, 65534, 65534,
+                                  65534, 7, 0xfffffffe, 65534, 3};
+  for (const uint32_t& value : values) {
+    ASSERT_TRUE(writer.WriteExponentialGolomb(value));
+  }
+  // escape the RBSP, as an encoder would
+  std::vector<uint8_t> buffer;
+  size_t zero_count = 0;
+  for (const uint8_t& byte : unescaped) {
+    if (zero_count >= 2 && byte <= 0x03) {
+      buffer.push_back(0x03);
+      zero_count = 0;
+    }
+    buffer.push_back(byte);
+    zero_count = (byte == 0x00) ? zero_count + 1 : 0;
+  }
+  ASSERT_EQ(unescaped, UnescapeRbsp(buffer.data(), buffer.size()));
+  ASSERT_GT(buffer.size(), unescaped.size());
+
+  EscapedBitBuffer bit_buffer(buffer.data(), buffer.size());
+  for (size_t pass = 0; pass < 2; pass++) {
+    for (const uint32_t& value : values) {
+      uint32_t read_value = 0;
+      EXPECT_TRUE(bit_buffer.ReadExponentialGolomb(read_value));
+      EXPECT_EQ(value, read_value);
+    }
+    // a Seek() backwards restarts the escaped walk
+    ASSERT_TRUE(bit_buffer.Seek(0, 0));
+  }
+  EXPECT_EQ(unescaped.size() * 8, bit_buffer.RemainingBitCount());
+  EXPECT_TRUE(bit_buffer.Seek(unescaped.size(), 0));
+  EXPECT_FALSE(bit_buffer.Seek(unescaped.size(), 1));
+  EXPECT_FALSE(bit_buffer.Seek(unescaped.size() + 1, 0));
+
+  // the checksum covers the RBSP, not the escaped bytes
+  BitBuffer unescaped_bit_buffer(unescaped.data(), unescaped.size());
+  ASSERT_TRUE(bit_buffer.Seek(0, 0));
+  auto expected = NaluChecksum::GetNaluChecksum(&unescaped_bit_buffer);
+  auto actual = NaluChecksum::GetNaluChecksum(&bit_buffer);
+  ASSERT_TRUE(expected != nullptr);
+  ASSERT_TRUE(actual != nullptr);
+  EXPECT_EQ(expected->GetPrintableChecksum(), actual->GetPrintableChecksum());
+}
+
+TEST_F(H264CommonEscapedBitBufferTest, TestGetEscapedOffset) {
+  // 0x00 0x00 0x03 0x01 0x00 0x00 0x03 0x03 0x42
+  const uint8_t buffer[] = {0x00, 0x00, 0x03, 0x01, 0x00,
+                            0x00, 0x03, 0x03, 0x42};
+  const size_t kEscapedOffsets[] = {0, 1, 3, 4, 5, 7, 8};
+  EscapedBitBuffer bit_buffer(buffer, arraysize(buffer));
+  size_t escaped_offset = 0;
+  for (size_t i = 0; i < arraysize(kEscapedOffsets); i++) {
+    EXPECT_TRUE(bit_buffer.GetEscapedOffset(i, &escaped_offset));
+    EXPECT_EQ(kEscapedOffsets[i], escaped_offset) << "rbsp_offset: " << i;
+  }
+  EXPECT_FALSE(bit_buffer.GetEscapedOffset(arraysize(kEscapedOffsets),
+                                           &escaped_offset));
+
+  // mapping does not move the reader, and works behind it
+  ASSERT_TRUE(bit_buffer.ConsumeBytes(5));
+  EXPECT_TRUE(bit_buffer.GetEscapedOffset(2, &escaped_offset));
+  EXPECT_EQ(3, escaped_offset);
+  uint8_t value = 0;
+  EXPECT_TRUE(bit_buffer.ReadUInt8(value));
+  EXPECT_EQ(0x03, value);
+
+  // an unescaped buffer maps every offset to itself
+  BitBuffer unescaped_bit_buffer(buffer, arraysize(buffer));
+  EXPECT_TRUE(unescaped_bit_buffer.GetEscapedOffset(2, &escaped_offset));
+  EXPECT_EQ(2, escaped_offset);
+  EXPECT_FALSE(unescaped_bit_buffer.GetEscapedOffset(arraysize(buffer),
+                                                     &escaped_offset));
+}
+
+class H264CommonUnescapeRbspTest : public ::testing::Test {
+ public:
+  H264CommonUnescapeRbspTest() {}
+  ~H264CommonUnescapeRbspTest() override {}
+};
+
+// The byte at a time UnescapeRbsp(), kept as the reference.
+std::vector<uint8_t> UnescapeRbspReference(const uint8_t* data,
+                                           size_t length) {
+  std::vector<uint8_t> out;
+  for (size_t i = 0; i < length;) {
+    if (length - i >= 3 && data[i] == 0x00 && data[i + 1] == 0x00 &&
+        data[i + 2] == 0x03) {
+      out.push_back(data[i++]);
+      out.push_back(data[i++]);
+      i++;
+    } else {
+      out.push_back(data[i++]);
+    }
+  }
+  return out;
+}
+
+TEST_F(H264CommonUnescapeRbspTest, TestMatchesReference) {
+  // a byte mix heavy in 0x00 and 0x03, so that emulation bytes (including
+  // 00 00 00 03, 00 00 03 03, and one as the last byte) land at every
+  // offset of a SIMD block, including the block edges and the tail
+  std::mt19937 generator(0x264);
+  std::vector<uint8_t> data(1024);
+  for (auto& byte : data) {
+    uint32_t r = generator() % 8;
+    byte = (r < 4) ? 0x00 : (r < 6) ? 0x03 : static_cast<uint8_t>(generator());
+  }
+  const SimdLevel kSimdLevels[] = {SIMD_AUTO, SIMD_NONE, SIMD_SSE2,
+                                   SIMD_AVX2};
+
+  std::vector<uint8_t> out(data.size());
+  for (size_t offset = 0; offset < 33; offset++) {
+    for (size_t length = 0; offset + length <= 160; length++) {
+      const uint8_t* escaped = data.data() + offset;
+      std::vector<uint8_t> expected = UnescapeRbspReference(escaped, length);
+      for (const auto& simd_level : kSimdLevels) {
+        if (!IsSimdLevelSupported(simd_level)) {
+          continue;
+        }
+        size_t out_length = UnescapeRbsp(escaped, length, out.data(),
+                                         simd_level);
+        ASSERT_EQ(expected.size(), out_length)
+            << "simd_level: " << static_cast<int>(simd_level)
+            << " offset: " << offset << " length: " << length;
+        EXPECT_TRUE(std::equal(expected.begin(), expected.end(), out.begin()))
+            << "simd_level: " << static_cast<int>(simd_level)
+            << " offset: " << offset << " length: " << length;
+      }
+      EXPECT_EQ(expected, UnescapeRbsp(escaped, length));
+    }
+  }
+
+  // clean runs much longer than a SIMD block, and the whole buffer
+  std::vector<uint8_t> sparse(4096, 0xab);
+  for (size_t i = 100; i + 3 < sparse.size(); i += 997) {
+    sparse[i] = 0x00;
+    sparse[i + 1] = 0x00;
+    sparse[i + 2] = 0x03;
+  }
+  for (const auto* buffer : {&data, &sparse}) {
+    EXPECT_EQ(UnescapeRbspReference(buffer->data(), buffer->size()),
+              UnescapeRbsp(buffer->data(), buffer->size()));
+  }
+}
+
+TEST_F(H264CommonUnescapeRbspTest, TestReuseOutput) {
+  // the overload with an output vector keeps its allocation across calls
+  std::vector<uint8_t> out;
+  const uint8_t kLong[] = {0x11, 0x00, 0x00, 0x03, 0x01, 0x22, 0x33, 0x44};
+  UnescapeRbsp(kLong, arraysize(kLong), out);
+  EXPECT_THAT(out, ::testing::ElementsAreArray(
+                       {0x11, 0x00, 0x00, 0x01, 0x22, 0x33, 0x44}));
+  const uint8_t* allocation = out.data();
+
+  const uint8_t kShort[] = {0x00, 0x00, 0x03};
+  UnescapeRbsp(kShort, arraysize(kShort), out);
+  EXPECT_THAT(out, ::testing::ElementsAreArray({0x00, 0x00}));
+  EXPECT_EQ(allocation, out.data());
+
+  UnescapeRbsp(kShort, 0, out);
+  EXPECT_TRUE(out.empty());
+}
+
 }  // namespace h264nal
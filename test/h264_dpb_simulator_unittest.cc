@@ -0,0 +1,415 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#include "h264_dpb_simulator.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include "h264_access_unit_assembler.h"
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "h264_dec_ref_pic_marking_parser.h"
+#include "h264_pps_parser.h"
+#include "h264_ref_pic_list_modification_parser.h"
+#include "h264_slice_header_parser.h"
+#include "h264_sps_parser.h"
+#include "h264_vui_parameters_parser.h"
+
+namespace h264nal {
+
+class H264DpbSimulatorTest : public ::testing::Test {
+ public:
+  H264DpbSimulatorTest() {}
+  ~H264DpbSimulatorTest() override {}
+
+  // Adds an SPS and a PPS (both id 0) to |bitstream_parser_state|:
+  // pic_order_cnt_type 0, MaxFrameNum 16, MaxPicOrderCntLsb 256, and one
+  // active reference index per list by default.
+  static void AddParameterSets(H264BitstreamParserState* bitstream_parser_state,
+                               uint32_t max_num_ref_frames,
+                               uint32_t max_dec_frame_buffering,
+                               uint32_t gaps_in_frame_num_value_allowed_flag) {
+    auto vui_parameters =
+        std::make_unique<H264VuiParametersParser::VuiParametersState>();
+    vui_parameters->bitstream_restriction_flag = 1;
+    vui_parameters->max_dec_frame_buffering = max_dec_frame_buffering;
+    auto sps = std::make_shared<H264SpsParser::SpsState>();
+    sps->sps_data = std::make_unique<H264SpsDataParser::SpsDataState>();
+    sps->sps_data->pic_order_cnt_type = 0;
+    sps->sps_data->log2_max_frame_num_minus4 = 0;
+    sps->sps_data->log2_max_pic_order_cnt_lsb_minus4 = 4;
+    sps->sps_data->max_num_ref_frames =
+        static_cast<uint8_t>(max_num_ref_frames);
+    sps->sps_data->gaps_in_frame_num_value_allowed_flag =
+        static_cast<uint8_t>(gaps_in_frame_num_value_allowed_flag);
+    sps->sps_data->frame_mbs_only_flag = 1;
+    sps->sps_data->vui_parameters_present_flag = 1;
+    sps->sps_data->vui_parameters = std::move(vui_parameters);
+    bitstream_parser_state->sps[0] = sps;
+    bitstream_parser_state->pps[0] =
+        std::make_shared<H264PpsParser::PpsState>();
+  }
+
+  // A frame slice header with the fields the simulator reads.
+  static std::unique_ptr<H264SliceHeaderParser::SliceHeaderState> SliceHeader(
+      uint32_t nal_unit_type, uint32_t nal_ref_idc, uint32_t slice_type,
+      uint32_t frame_num, uint32_t pic_order_cnt_lsb) {
+    auto slice_header =
+        std::make_unique<H264SliceHeaderParser::SliceHeaderState>();
+    slice_header->nal_unit_type = static_cast<uint8_t>(nal_unit_type);
+    slice_header->nal_ref_idc = static_cast<uint8_t>(nal_ref_idc);
+    slice_header->slice_type = static_cast<uint8_t>(slice_type);
+    slice_header->frame_num = static_cast<uint16_t>(frame_num);
+    slice_header->pic_order_cnt_lsb = static_cast<uint16_t>(pic_order_cnt_lsb);
+    slice_header->dec_ref_pic_marking =
+        std::make_unique<H264DecRefPicMarkingParser::DecRefPicMarkingState>();
+    return slice_header;
+  }
+
+  // The frame_num of each frame in |pictures|.
+  static std::vector<uint32_t> FrameNums(
+      const std::vector<H264DpbSimulator::DpbPicture>& pictures) {
+    std::vector<uint32_t> frame_nums;
+    for (const auto& picture : pictures) {
+      frame_nums.push_back(picture.frame_num);
+    }
+    return frame_nums;
+  }
+
+  // The frame_num of each frame in |pictures| with |reference_marking|.
+  static std::vector<uint32_t> FrameNums(
+      const std::vector<H264DpbSimulator::DpbPicture>& pictures,
+      DpbReferenceMarking reference_marking) {
+    std::vector<uint32_t> frame_nums;
+    for (const auto& picture : pictures) {
+      if (picture.reference_marking == reference_marking) {
+        frame_nums.push_back(picture.frame_num);
+      }
+    }
+    return frame_nums;
+  }
+
+  // The PicOrderCnt() of each frame in |pictures|.
+  static std::vector<int32_t> PicOrderCnts(
+      const std::vector<H264DpbSimulator::DpbPicture>& pictures) {
+    std::vector<int32_t> pic_order_cnts;
+    for (const auto& picture : pictures) {
+      pic_order_cnts.push_back(picture.PicOrderCnt);
+    }
+    return pic_order_cnts;
+  }
+};
+
+TEST_F(H264DpbSimulatorTest, TestSlidingWindow) {
+  H264BitstreamParserState bitstream_parser_state;
+  AddParameterSets(&bitstream_parser_state, 2, 2, 0);
+  H264DpbSimulator simulator;
+  H264DpbSimulator::PictureState picture;
+
+  auto idr = SliceHeader(CODED_SLICE_OF_IDR_PICTURE_NUT, 3, SliceType::I, 0, 0);
+  ASSERT_TRUE(simulator.DecodePicture(*idr, bitstream_parser_state, &picture));
+  EXPECT_EQ(0, picture.picture_index);
+  EXPECT_EQ(2, picture.dpb_size);
+  EXPECT_TRUE(picture.ref_pic_list0.empty());
+  EXPECT_THAT(FrameNums(picture.dpb), ::testing::ElementsAreArray({0}));
+
+  auto p1 =
+      SliceHeader(CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, SliceType::P, 1, 2);
+  ASSERT_TRUE(simulator.DecodePicture(*p1, bitstream_parser_state, &picture));
+  EXPECT_THAT(FrameNums(picture.ref_pic_list0),
+              ::testing::ElementsAreArray({0}));
+  EXPECT_TRUE(picture.ref_pic_list1.empty());
+  EXPECT_TRUE(picture.output.empty());
+
+  // the DPB holds max_num_ref_frames frames: the oldest one slides out,
+  // and is output to make room
+  auto p2 =
+      SliceHeader(CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, SliceType::P, 2, 4);
+  p2->num_ref_idx_active_override_flag = 1;
+  p2->num_ref_idx_l0_active_minus1 = 1;
+  ASSERT_TRUE(simulator.DecodePicture(*p2, bitstream_parser_state, &picture));
+  EXPECT_EQ(2, picture.picture_index);
+  EXPECT_THAT(FrameNums(picture.ref_pic_list0),
+              ::testing::ElementsAreArray({1, 0}));
+  EXPECT_THAT(FrameNums(picture.output), ::testing::ElementsAreArray({0}));
+  EXPECT_THAT(FrameNums(picture.dpb, SHORT_TERM_REFERENCE),
+              ::testing::ElementsAreArray({1, 2}));
+
+  std::vector<H264DpbSimulator::DpbPicture> output;
+  simulator.Flush(&output);
+  EXPECT_THAT(FrameNums(output), ::testing::ElementsAreArray({1, 2}));
+}
+
+TEST_F(H264DpbSimulatorTest, TestMemoryManagementControlOperations) {
+  H264BitstreamParserState bitstream_parser_state;
+  AddParameterSets(&bitstream_parser_state, 4, 4, 0);
+  H264DpbSimulator simulator;
+  H264DpbSimulator::PictureState picture;
+
+  auto idr = SliceHeader(CODED_SLICE_OF_IDR_PICTURE_NUT, 3, SliceType::I, 0, 0);
+  ASSERT_TRUE(simulator.DecodePicture(*idr, bitstream_parser_state, &picture));
+  for (uint32_t frame_num = 1; frame_num < 3; frame_num++) {
+    auto p = SliceHeader(CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, SliceType::P,
+                         frame_num, 2 * frame_num);
+    ASSERT_TRUE(simulator.DecodePicture(*p, bitstream_parser_state, &picture));
+  }
+
+  // memory_management_control_operation 1 (picNumX 1) and 3 (picNumX 0
+  // becomes LongTermFrameIdx 0)
+  auto p3 =
+      SliceHeader(CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, SliceType::P, 3, 6);
+  p3->dec_ref_pic_marking->adaptive_ref_pic_marking_mode_flag = 1;
+  p3->dec_ref_pic_marking->memory_management_control_operation = {1, 3, 0};
+  p3->dec_ref_pic_marking->difference_of_pic_nums_minus1 = {1, 2};
+  p3->dec_ref_pic_marking->long_term_frame_idx = {0};
+  ASSERT_TRUE(simulator.DecodePicture(*p3, bitstream_parser_state, &picture));
+  EXPECT_THAT(FrameNums(picture.dpb, SHORT_TERM_REFERENCE),
+              ::testing::ElementsAreArray({2, 3}));
+  EXPECT_THAT(FrameNums(picture.dpb, LONG_TERM_REFERENCE),
+              ::testing::ElementsAreArray({0}));
+  // the unused frame waits for output
+  EXPECT_THAT(FrameNums(picture.dpb, UNUSED_FOR_REFERENCE),
+              ::testing::ElementsAreArray({1}));
+
+  // the long-term frames follow the short-term ones
+  auto p4 =
+      SliceHeader(CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, SliceType::P, 4, 8);
+  p4->num_ref_idx_active_override_flag = 1;
+  p4->num_ref_idx_l0_active_minus1 = 2;
+  ASSERT_TRUE(simulator.DecodePicture(*p4, bitstream_parser_state, &picture));
+  EXPECT_THAT(FrameNums(picture.ref_pic_list0),
+              ::testing::ElementsAreArray({3, 2, 0}));
+  EXPECT_EQ(LONG_TERM_REFERENCE, picture.ref_pic_list0[2].reference_marking);
+  EXPECT_EQ(0, picture.ref_pic_list0[2].long_term_frame_idx);
+  EXPECT_THAT(FrameNums(picture.output), ::testing::ElementsAreArray({0, 1}));
+
+  // memory_management_control_operation 2 (LongTermPicNum 0) and 6 (the
+  // current picture becomes LongTermFrameIdx 1)
+  auto p5 =
+      SliceHeader(CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, SliceType::P, 5, 10);
+  p5->dec_ref_pic_marking->adaptive_ref_pic_marking_mode_flag = 1;
+  p5->dec_ref_pic_marking->memory_management_control_operation = {2, 6, 0};
+  p5->dec_ref_pic_marking->long_term_pic_num = {0};
+  p5->dec_ref_pic_marking->long_term_frame_idx = {1};
+  ASSERT_TRUE(simulator.DecodePicture(*p5, bitstream_parser_state, &picture));
+  EXPECT_THAT(FrameNums(picture.dpb, SHORT_TERM_REFERENCE),
+              ::testing::ElementsAreArray({2, 3, 4}));
+  EXPECT_THAT(FrameNums(picture.dpb, LONG_TERM_REFERENCE),
+              ::testing::ElementsAreArray({5}));
+  EXPECT_EQ(1, picture.dpb.back().long_term_frame_idx);
+
+  // memory_management_control_operation 4 (MaxLongTermFrameIdx 0)
+  auto p6 =
+      SliceHeader(CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, SliceType::P, 6, 12);
+  p6->dec_ref_pic_marking->adaptive_ref_pic_marking_mode_flag = 1;
+  p6->dec_ref_pic_marking->memory_management_control_operation = {4, 0};
+  p6->dec_ref_pic_marking->max_long_term_frame_idx_plus1 = {1};
+  ASSERT_TRUE(simulator.DecodePicture(*p6, bitstream_parser_state, &picture));
+  EXPECT_TRUE(FrameNums(picture.dpb, LONG_TERM_REFERENCE).empty());
+  EXPECT_THAT(FrameNums(picture.dpb, SHORT_TERM_REFERENCE),
+              ::testing::ElementsAreArray({2, 3, 4, 6}));
+  EXPECT_THAT(FrameNums(picture.output),
+              ::testing::ElementsAreArray({2, 3, 4, 5}));
+
+  // memory_management_control_operation 5: the DPB is emptied (with
+  // output of the frames still waiting), and the picture restarts as
+  // frame_num 0
+  auto p7 =
+      SliceHeader(CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, SliceType::P, 7, 14);
+  p7->dec_ref_pic_marking->adaptive_ref_pic_marking_mode_flag = 1;
+  p7->dec_ref_pic_marking->memory_management_control_operation = {5, 0};
+  ASSERT_TRUE(simulator.DecodePicture(*p7, bitstream_parser_state, &picture));
+  EXPECT_THAT(FrameNums(picture.output), ::testing::ElementsAreArray({6}));
+  ASSERT_EQ(1, picture.dpb.size());
+  EXPECT_EQ(0, picture.dpb[0].frame_num);
+  EXPECT_EQ(0, picture.dpb[0].PicOrderCnt);
+}
+
+TEST_F(H264DpbSimulatorTest, TestRefPicListModification) {
+  H264BitstreamParserState bitstream_parser_state;
+  AddParameterSets(&bitstream_parser_state, 4, 4, 0);
+  H264DpbSimulator simulator;
+  H264DpbSimulator::PictureState picture;
+
+  auto idr = SliceHeader(CODED_SLICE_OF_IDR_PICTURE_NUT, 3, SliceType::I, 0, 0);
+  ASSERT_TRUE(simulator.DecodePicture(*idr, bitstream_parser_state, &picture));
+  for (uint32_t frame_num = 1; frame_num < 3; frame_num++) {
+    auto p = SliceHeader(CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, SliceType::P,
+                         frame_num, 2 * frame_num);
+    ASSERT_TRUE(simulator.DecodePicture(*p, bitstream_parser_state, &picture));
+  }
+
+  // the initial list is {2, 1, 0}: move picNum 1 (3 - 2) to the front,
+  // then picNum 0 (1 - 1) after it
+  auto p3 =
+      SliceHeader(CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, SliceType::P, 3, 6);
+  p3->num_ref_idx_active_override_flag = 1;
+  p3->num_ref_idx_l0_active_minus1 = 2;
+  p3->ref_pic_list_modification = std::make_unique<
+      H264RefPicListModificationParser::RefPicListModificationState>();
+  p3->ref_pic_list_modification->ref_pic_list_modification_flag_l0 = 1;
+  p3->ref_pic_list_modification->modification_of_pic_nums_idc = {0, 0, 3};
+  p3->ref_pic_list_modification->abs_diff_pic_num_minus1 = {1, 0};
+  ASSERT_TRUE(simulator.DecodePicture(*p3, bitstream_parser_state, &picture));
+  EXPECT_THAT(FrameNums(picture.ref_pic_list0),
+              ::testing::ElementsAreArray({1, 0, 2}));
+
+  // a modification may bring in a frame the truncated list left out
+  auto p4 =
+      SliceHeader(CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, SliceType::P, 4, 8);
+  p4->ref_pic_list_modification = std::make_unique<
+      H264RefPicListModificationParser::RefPicListModificationState>();
+  p4->ref_pic_list_modification->ref_pic_list_modification_flag_l0 = 1;
+  p4->ref_pic_list_modification->modification_of_pic_nums_idc = {0, 3};
+  p4->ref_pic_list_modification->abs_diff_pic_num_minus1 = {2};
+  ASSERT_TRUE(simulator.DecodePicture(*p4, bitstream_parser_state, &picture));
+  EXPECT_THAT(FrameNums(picture.ref_pic_list0),
+              ::testing::ElementsAreArray({1}));
+}
+
+TEST_F(H264DpbSimulatorTest, TestOutputOrder) {
+  // I0 P6 B2 B4 P12 B8 B10 (PicOrderCnt, in decoding order), with 2
+  // reference frames in 3 frame buffers
+  H264BitstreamParserState bitstream_parser_state;
+  AddParameterSets(&bitstream_parser_state, 2, 3, 0);
+  struct Picture {
+    uint32_t nal_unit_type;
+    uint32_t nal_ref_idc;
+    uint32_t slice_type;
+    uint32_t frame_num;
+    uint32_t pic_order_cnt_lsb;
+    std::vector<int32_t> output;
+  };
+  const std::vector<Picture> pictures = {
+      {CODED_SLICE_OF_IDR_PICTURE_NUT, 3, SliceType::I, 0, 0, {}},
+      {CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, SliceType::P, 1, 6, {}},
+      {CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 0, SliceType::B, 2, 2, {}},
+      {CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 0, SliceType::B, 2, 4, {0, 2}},
+      {CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, SliceType::P, 2, 12, {}},
+      {CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 0, SliceType::B, 3, 8, {4}},
+      {CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 0, SliceType::B, 3, 10, {6, 8}},
+  };
+
+  H264DpbSimulator simulator;
+  for (const Picture& picture : pictures) {
+    auto slice_header =
+        SliceHeader(picture.nal_unit_type, picture.nal_ref_idc,
+                    picture.slice_type, picture.frame_num,
+                    picture.pic_order_cnt_lsb);
+    slice_header->num_ref_idx_active_override_flag = 1;
+    slice_header->num_ref_idx_l0_active_minus1 = 1;
+    slice_header->num_ref_idx_l1_active_minus1 = 1;
+    H264DpbSimulator::PictureState picture_state;
+    ASSERT_TRUE(simulator.DecodePicture(*slice_header, bitstream_parser_state,
+                                        &picture_state));
+    EXPECT_THAT(PicOrderCnts(picture_state.output),
+                ::testing::ElementsAreArray(picture.output));
+    if (picture.pic_order_cnt_lsb == 2) {
+      // the frames before the picture come first in RefPicList0, and
+      // the ones after it in RefPicList1
+      EXPECT_THAT(PicOrderCnts(picture_state.ref_pic_list0),
+                  ::testing::ElementsAreArray({0, 6}));
+      EXPECT_THAT(PicOrderCnts(picture_state.ref_pic_list1),
+                  ::testing::ElementsAreArray({6, 0}));
+    }
+  }
+  std::vector<H264DpbSimulator::DpbPicture> output;
+  simulator.Flush(&output);
+  EXPECT_THAT(PicOrderCnts(output), ::testing::ElementsAreArray({10, 12}));
+}
+
+TEST_F(H264DpbSimulatorTest, TestFrameNumGap) {
+  H264BitstreamParserState bitstream_parser_state;
+  AddParameterSets(&bitstream_parser_state, 3, 4, 1);
+  H264DpbSimulator simulator;
+  H264DpbSimulator::PictureState picture;
+
+  auto idr = SliceHeader(CODED_SLICE_OF_IDR_PICTURE_NUT, 3, SliceType::I, 0, 0);
+  ASSERT_TRUE(simulator.DecodePicture(*idr, bitstream_parser_state, &picture));
+
+  // frame_num 1 and 2 are missing: they are inferred as "non-existing"
+  // frames, which are never output
+  auto p3 =
+      SliceHeader(CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, SliceType::P, 3, 6);
+  p3->num_ref_idx_active_override_flag = 1;
+  p3->num_ref_idx_l0_active_minus1 = 2;
+  ASSERT_TRUE(simulator.DecodePicture(*p3, bitstream_parser_state, &picture));
+  ASSERT_THAT(FrameNums(picture.ref_pic_list0),
+              ::testing::ElementsAreArray({2, 1, 0}));
+  EXPECT_EQ(1, picture.ref_pic_list0[0].non_existing);
+  EXPECT_EQ(1, picture.ref_pic_list0[1].non_existing);
+  EXPECT_EQ(0, picture.ref_pic_list0[2].non_existing);
+  // the sliding window drops frame_num 0, which still waits for output
+  EXPECT_THAT(FrameNums(picture.dpb, SHORT_TERM_REFERENCE),
+              ::testing::ElementsAreArray({1, 2, 3}));
+
+  // an IDR picture with no_output_of_prior_pics_flag drops the DPB
+  auto idr2 =
+      SliceHeader(CODED_SLICE_OF_IDR_PICTURE_NUT, 3, SliceType::I, 0, 0);
+  idr2->dec_ref_pic_marking->no_output_of_prior_pics_flag = 1;
+  ASSERT_TRUE(simulator.DecodePicture(*idr2, bitstream_parser_state, &picture));
+  EXPECT_TRUE(picture.output.empty());
+  EXPECT_THAT(FrameNums(picture.dpb), ::testing::ElementsAreArray({0}));
+  EXPECT_EQ(2, picture.dpb[0].picture_index);
+}
+
+TEST_F(H264DpbSimulatorTest, TestMissingParameterSets) {
+  H264BitstreamParserState bitstream_parser_state;
+  H264DpbSimulator simulator;
+  H264DpbSimulator::PictureState picture;
+  auto idr = SliceHeader(CODED_SLICE_OF_IDR_PICTURE_NUT, 3, SliceType::I, 0, 0);
+  EXPECT_FALSE(simulator.DecodePicture(*idr, bitstream_parser_state, &picture));
+}
+
+TEST_F(H264DpbSimulatorTest, TestParameterSetsSharingAnId) {
+  // SPS, PPS, and IDR (the 601.264 ones, with one reference frame and no
+  // VUI, so the DPB size comes from the level), then the SPS redefined
+  // with the same id at a lower level, and the same PPS and IDR again
+  const uint8_t buffer[] = {
+      // SPS (level 2.2: MaxDpbMbs 8100)
+      0x00, 0x00, 0x00, 0x01,
+      0x67, 0x42, 0xc0, 0x16, 0xa6, 0x81, 0x41, 0xf9,
+      // PPS
+      0x00, 0x00, 0x00, 0x01,
+      0x68, 0xc8, 0x42, 0x02, 0x32, 0xc8,
+      // slice (IDR)
+      0x00, 0x00, 0x00, 0x01,
+      0x65, 0x88, 0x82, 0x06, 0x78, 0x8c, 0x50, 0x00,
+      0x1c, 0xab, 0x8e, 0x00, 0x02, 0xfb, 0x31, 0xc0,
+      0x00, 0x5f, 0x66, 0xfb, 0xef, 0xbe,
+      // SPS (level 1: MaxDpbMbs 396)
+      0x00, 0x00, 0x00, 0x01,
+      0x67, 0x42, 0xc0, 0x0a, 0xa6, 0x81, 0x41, 0xf9,
+      // PPS
+      0x00, 0x00, 0x00, 0x01,
+      0x68, 0xc8, 0x42, 0x02, 0x32, 0xc8,
+      // slice (IDR)
+      0x00, 0x00, 0x00, 0x01,
+      0x65, 0x88, 0x82, 0x06, 0x78, 0x8c, 0x50, 0x00,
+      0x1c, 0xab, 0x8e, 0x00, 0x02, 0xfb, 0x31, 0xc0,
+      0x00, 0x5f, 0x66, 0xfb, 0xef, 0xbe};
+
+  // the first access unit is only complete once the second SPS has been
+  // parsed into the state, but it keeps the SPS it was parsed with
+  H264BitstreamParserState bitstream_parser_state;
+  ParsingOptions parsing_options;
+  H264DpbSimulator simulator;
+  std::vector<uint32_t> dpb_sizes;
+  H264AccessUnitAssembler::ParseBitstream(
+      buffer, arraysize(buffer), &bitstream_parser_state, parsing_options,
+      [&](std::unique_ptr<H264AccessUnitAssembler::AccessUnitState>
+              access_unit) {
+        H264DpbSimulator::PictureState picture;
+        ASSERT_TRUE(simulator.DecodePicture(*access_unit, &picture));
+        dpb_sizes.push_back(picture.dpb_size);
+      });
+  // 300 macroblocks per frame: Min(8100 / 300, 16) and 396 / 300 frames
+  EXPECT_THAT(dpb_sizes, ::testing::ElementsAreArray({16, 1}));
+}
+
+}  // namespace h264nal
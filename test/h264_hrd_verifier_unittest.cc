@@ -0,0 +1,291 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#include "h264_hrd_verifier.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include "h264_access_unit_assembler.h"
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "h264_hrd_parameters_parser.h"
+#include "h264_sei_parser.h"
+#include "h264_sps_parser.h"
+#include "h264_vui_parameters_parser.h"
+#include "rtc_common.h"
+
+namespace h264nal {
+
+class H264HrdVerifierTest : public ::testing::Test {
+ public:
+  H264HrdVerifierTest() {}
+  ~H264HrdVerifierTest() override {}
+
+  // An SPS whose VUI has a 20 ms clock tick, NAL hrd_parameters() with one
+  // schedule (64000 bps, CpbSize 16 * (cpb_size_value_minus1 + 1) bits),
+  // and max_dec_frame_buffering 1.
+  static std::unique_ptr<H264SpsDataParser::SpsDataState> HrdSps(
+      uint32_t cpb_size_value_minus1, uint32_t cbr_flag) {
+    auto hrd_parameters =
+        std::make_unique<H264HrdParametersParser::HrdParametersState>();
+    hrd_parameters->cpb_cnt_minus1 = 0;
+    hrd_parameters->bit_rate_scale = 0;
+    hrd_parameters->cpb_size_scale = 0;
+    hrd_parameters->bit_rate_value_minus1 = {999};
+    hrd_parameters->cpb_size_value_minus1 = {cpb_size_value_minus1};
+    hrd_parameters->cbr_flag = {cbr_flag};
+    auto vui_parameters =
+        std::make_unique<H264VuiParametersParser::VuiParametersState>();
+    vui_parameters->timing_info_present_flag = 1;
+    vui_parameters->num_units_in_tick = 1;
+    vui_parameters->time_scale = 50;
+    vui_parameters->nal_hrd_parameters_present_flag = 1;
+    vui_parameters->nal_hrd_parameters = std::move(hrd_parameters);
+    vui_parameters->bitstream_restriction_flag = 1;
+    vui_parameters->max_dec_frame_buffering = 1;
+    auto sps = std::make_unique<H264SpsDataParser::SpsDataState>();
+    sps->vui_parameters_present_flag = 1;
+    sps->vui_parameters = std::move(vui_parameters);
+    return sps;
+  }
+
+  // A buffering_period() with one NAL schedule.
+  static std::unique_ptr<H264BufferingPeriodParser::BufferingPeriodState>
+  BufferingPeriod(uint32_t initial_cpb_removal_delay) {
+    auto buffering_period =
+        std::make_unique<H264BufferingPeriodParser::BufferingPeriodState>();
+    buffering_period->nal_hrd_parameters_present_flag = 1;
+    buffering_period->nal_initial_cpb_removal_delay.push_back(
+        initial_cpb_removal_delay);
+    buffering_period->nal_initial_cpb_removal_delay_offset.push_back(0);
+    return buffering_period;
+  }
+
+  static std::unique_ptr<H264PicTimingParser::PicTimingState> PicTiming(
+      uint32_t cpb_removal_delay, uint32_t dpb_output_delay) {
+    auto pic_timing =
+        std::make_unique<H264PicTimingParser::PicTimingState>();
+    pic_timing->cpb_dpb_delays_present_flag = 1;
+    pic_timing->cpb_removal_delay = cpb_removal_delay;
+    pic_timing->dpb_output_delay = dpb_output_delay;
+    return pic_timing;
+  }
+};
+
+TEST_F(H264HrdVerifierTest, TestConformingStream) {
+  auto sps = HrdSps(1999, 0);
+  // initial_cpb_removal_delay: 0.5 s
+  auto buffering_period = BufferingPeriod(45000);
+  H264HrdVerifier verifier(NAL_HRD, 0);
+  H264HrdVerifier::AccessUnitTiming timing;
+
+  ASSERT_TRUE(verifier.AddAccessUnit(0, 8000, buffering_period.get(),
+                                     *PicTiming(0, 0), *sps, &timing));
+  EXPECT_EQ(0, timing.access_unit_index);
+  EXPECT_DOUBLE_EQ(0.0, timing.initial_arrival_time);
+  EXPECT_DOUBLE_EQ(0.125, timing.final_arrival_time);
+  EXPECT_DOUBLE_EQ(0.5, timing.nominal_removal_time);
+  EXPECT_DOUBLE_EQ(0.5, timing.removal_time);
+
+  // the next access units arrive right after the previous one (they may
+  // not arrive earlier than 0.5 s before their removal)
+  for (uint32_t i = 1; i < 4; i++) {
+    ASSERT_TRUE(verifier.AddAccessUnit(1000 * i, 1280, nullptr,
+                                       *PicTiming(i, 0), *sps, &timing));
+    EXPECT_EQ(i, timing.access_unit_index);
+    EXPECT_EQ(1000 * i, timing.offset);
+    EXPECT_DOUBLE_EQ(0.125 + 0.02 * (i - 1), timing.initial_arrival_time);
+    EXPECT_DOUBLE_EQ(0.125 + 0.02 * i, timing.final_arrival_time);
+    EXPECT_DOUBLE_EQ(0.5 + 0.02 * i, timing.removal_time);
+    EXPECT_DOUBLE_EQ(timing.removal_time, timing.output_time);
+  }
+  verifier.Flush();
+  EXPECT_TRUE(verifier.GetViolations().empty());
+}
+
+TEST_F(H264HrdVerifierTest, TestCpbUnderflow) {
+  auto sps = HrdSps(1999, 0);
+  auto buffering_period = BufferingPeriod(45000);
+  H264HrdVerifier verifier(NAL_HRD, 0);
+  H264HrdVerifier::AccessUnitTiming timing;
+
+  ASSERT_TRUE(verifier.AddAccessUnit(0, 8000, buffering_period.get(),
+                                     *PicTiming(0, 0), *sps, &timing));
+  // 0.5 s worth of bits, due 20 ms after the first access unit
+  ASSERT_TRUE(verifier.AddAccessUnit(1000, 32000, nullptr, *PicTiming(1, 0),
+                                     *sps, &timing));
+  EXPECT_DOUBLE_EQ(0.625, timing.final_arrival_time);
+  verifier.Flush();
+
+  const auto& violations = verifier.GetViolations();
+  ASSERT_EQ(1, violations.size());
+  EXPECT_EQ(CPB_UNDERFLOW, violations[0].type);
+  EXPECT_EQ(1, violations[0].access_unit_index);
+  EXPECT_EQ(1000, violations[0].offset);
+  EXPECT_DOUBLE_EQ(0.52, violations[0].time);
+  // (0.52 - 0.125) s at 64000 bps
+  EXPECT_EQ(25280, violations[0].fullness);
+  EXPECT_EQ(32000, violations[0].size);
+}
+
+TEST_F(H264HrdVerifierTest, TestCpbOverflow) {
+  // CBR: the access units arrive back to back, and pile up in the CPB
+  // before the first removal
+  auto sps = HrdSps(999, 1);
+  auto buffering_period = BufferingPeriod(45000);
+  H264HrdVerifier verifier(NAL_HRD, 0);
+  H264HrdVerifier::AccessUnitTiming timing;
+
+  ASSERT_TRUE(verifier.AddAccessUnit(0, 1000, buffering_period.get(),
+                                     *PicTiming(0, 0), *sps, &timing));
+  for (uint32_t i = 1; i < 4; i++) {
+    ASSERT_TRUE(verifier.AddAccessUnit(1000 * i, 10000, nullptr,
+                                       *PicTiming(10 * i, 0), *sps, &timing));
+  }
+  // the removals are only checked once the stream ends
+  EXPECT_TRUE(verifier.GetViolations().empty());
+  verifier.Flush();
+
+  const auto& violations = verifier.GetViolations();
+  ASSERT_EQ(3, violations.size());
+  EXPECT_EQ(CPB_OVERFLOW, violations[0].type);
+  EXPECT_EQ(3, violations[0].access_unit_index);
+  EXPECT_EQ(3000, violations[0].offset);
+  EXPECT_DOUBLE_EQ(0.5, violations[0].time);
+  EXPECT_EQ(31000, violations[0].fullness);
+  EXPECT_EQ(16000, violations[0].size);
+  EXPECT_EQ(30000, violations[1].fullness);
+  EXPECT_EQ(20000, violations[2].fullness);
+}
+
+TEST_F(H264HrdVerifierTest, TestDpbOverflow) {
+  auto sps = HrdSps(1999, 0);
+  auto buffering_period = BufferingPeriod(45000);
+  H264HrdVerifier verifier(NAL_HRD, 0);
+  H264HrdVerifier::AccessUnitTiming timing;
+
+  // two pictures wait for output in a 1-frame DPB
+  ASSERT_TRUE(verifier.AddAccessUnit(0, 1000, buffering_period.get(),
+                                     *PicTiming(0, 10), *sps, &timing));
+  EXPECT_DOUBLE_EQ(0.7, timing.output_time);
+  ASSERT_TRUE(verifier.AddAccessUnit(1000, 1000, nullptr, *PicTiming(1, 10),
+                                     *sps, &timing));
+  // the first one is output by then
+  ASSERT_TRUE(verifier.AddAccessUnit(2000, 1000, nullptr, *PicTiming(20, 0),
+                                     *sps, &timing));
+
+  const auto& violations = verifier.GetViolations();
+  ASSERT_EQ(1, violations.size());
+  EXPECT_EQ(DPB_OVERFLOW, violations[0].type);
+  EXPECT_EQ(1, violations[0].access_unit_index);
+  EXPECT_EQ(2, violations[0].fullness);
+  EXPECT_EQ(1, violations[0].size);
+}
+
+TEST_F(H264HrdVerifierTest, TestMissingTiming) {
+  auto sps = HrdSps(1999, 0);
+  auto buffering_period = BufferingPeriod(45000);
+  H264HrdVerifier::AccessUnitTiming timing;
+
+  // no buffering period to start from
+  H264HrdVerifier verifier(NAL_HRD, 0);
+  EXPECT_FALSE(verifier.AddAccessUnit(0, 1000, nullptr, *PicTiming(0, 0),
+                                      *sps, &timing));
+  // no VCL HRD parameters, or no such schedule
+  H264HrdVerifier vcl_verifier(VCL_HRD, 0);
+  EXPECT_FALSE(vcl_verifier.AddAccessUnit(0, 1000, buffering_period.get(),
+                                          *PicTiming(0, 0), *sps, &timing));
+  H264HrdVerifier schedule_verifier(NAL_HRD, 1);
+  EXPECT_FALSE(schedule_verifier.AddAccessUnit(
+      0, 1000, buffering_period.get(), *PicTiming(0, 0), *sps, &timing));
+  // no clock tick
+  sps->vui_parameters->timing_info_present_flag = 0;
+  EXPECT_FALSE(verifier.AddAccessUnit(0, 1000, buffering_period.get(),
+                                      *PicTiming(0, 0), *sps, &timing));
+}
+
+TEST_F(H264HrdVerifierTest, TestParseBitstream) {
+  // the 601.264 SPS, with NAL and VCL hrd_parameters() (64000 bps, 24-bit
+  // initial delays, 8-bit CPB and DPB delays), then its PPS, an SEI
+  // (buffering_period, initial_cpb_removal_delay 0.5 s, and pic_timing),
+  // the IDR slice, and a filler data NAL unit. Then an SEI (pic_timing,
+  // cpb_removal_delay 1) and two non-IDR slices of one picture. Then the
+  // SPS is redefined without a VUI.
+  const uint8_t buffer[] = {
+      // SPS
+      0x00, 0x00, 0x00, 0x01,
+      0x67, 0x42, 0xc0, 0x16, 0xa6, 0x11, 0x05, 0x07,
+      0xe9, 0xb2, 0x00, 0x00, 0x03, 0x00, 0x02, 0x00,
+      0x00, 0x03, 0x00, 0x64, 0xc0, 0x00, 0x1f, 0x40,
+      0x01, 0xf4, 0x17, 0x39, 0xc1, 0x80, 0x00, 0x3e,
+      0x80, 0x03, 0xe8, 0x2e, 0x73, 0x80, 0xf1, 0x62,
+      0xe1, 0x18,
+      // PPS
+      0x00, 0x00, 0x00, 0x01,
+      0x68, 0xc8, 0x42, 0x02, 0x32, 0xc8,
+      // SEI (buffering_period, pic_timing)
+      0x00, 0x00, 0x00, 0x01,
+      0x06, 0x00, 0x0d, 0x80, 0x57, 0xe4, 0x00, 0x00,
+      0x03, 0x00, 0x00, 0x57, 0xe4, 0x00, 0x00, 0x03,
+      0x00, 0x00, 0x03, 0x01, 0x02, 0x00, 0x00, 0x80,
+      // slice (IDR)
+      0x00, 0x00, 0x00, 0x01,
+      0x65, 0x88, 0x82, 0x06, 0x78, 0x8c, 0x50, 0x00,
+      0x1c, 0xab, 0x8e, 0x00, 0x02, 0xfb, 0x31, 0xc0,
+      0x00, 0x5f, 0x66, 0xfb, 0xef, 0xbe,
+      // filler data
+      0x00, 0x00, 0x00, 0x01,
+      0x0c, 0xff, 0xff, 0x80,
+      // SEI (pic_timing)
+      0x00, 0x00, 0x00, 0x01,
+      0x06, 0x01, 0x02, 0x01, 0x00, 0x80,
+      // slice (non-IDR)
+      0x00, 0x00, 0x00, 0x01,
+      0x41, 0x9a, 0x1c, 0x0c, 0xf0, 0x09, 0x6c,
+      // slice (non-IDR, same picture)
+      0x00, 0x00, 0x00, 0x01,
+      0x41, 0x9a, 0x1c, 0x0c, 0xf0, 0x09, 0x6c,
+      // SPS (no VUI)
+      0x00, 0x00, 0x00, 0x01,
+      0x67, 0x42, 0xc0, 0x16, 0xa6, 0x81, 0x41, 0xf9};
+
+  for (const HrdType hrd_type : {NAL_HRD, VCL_HRD}) {
+    // the second access unit is only complete once the SPS has been
+    // redefined, but it is timed against the SPS it was parsed with
+    H264BitstreamParserState bitstream_parser_state;
+    ParsingOptions parsing_options;
+    H264HrdVerifier verifier(hrd_type, 0);
+    std::vector<H264HrdVerifier::AccessUnitTiming> timings;
+    H264AccessUnitAssembler::ParseBitstream(
+        buffer, arraysize(buffer), &bitstream_parser_state, parsing_options,
+        [&](std::unique_ptr<H264AccessUnitAssembler::AccessUnitState>
+                access_unit) {
+          H264HrdVerifier::AccessUnitTiming timing;
+          if (verifier.AddAccessUnit(*access_unit, bitstream_parser_state,
+                                     &timing)) {
+            timings.push_back(timing);
+          }
+        });
+    verifier.Flush();
+    EXPECT_TRUE(verifier.GetViolations().empty());
+    ASSERT_EQ(2, timings.size());
+
+    // the NAL HRD counts every NAL unit, but no start code: SPS (42), PPS
+    // (6), SEI (24), IDR slice (22), and filler data (4), then SEI (6) and
+    // both slices (7 each). The VCL HRD counts the slices and the filler
+    // data.
+    EXPECT_EQ(4, timings[0].offset);
+    EXPECT_EQ((hrd_type == NAL_HRD) ? 98 * 8 : 26 * 8, timings[0].size);
+    EXPECT_DOUBLE_EQ(0.5, timings[0].removal_time);
+    EXPECT_EQ(122, timings[1].offset);
+    EXPECT_EQ((hrd_type == NAL_HRD) ? 20 * 8 : 14 * 8, timings[1].size);
+    EXPECT_DOUBLE_EQ(0.52, timings[1].removal_time);
+  }
+}
+
+}  // namespace h264nal
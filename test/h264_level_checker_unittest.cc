@@ -0,0 +1,238 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#include "h264_level_checker.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include "h264_access_unit_assembler.h"
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "h264_hrd_parameters_parser.h"
+#include "h264_sps_parser.h"
+#include "h264_vui_parameters_parser.h"
+#include "rtc_common.h"
+
+namespace h264nal {
+
+class H264LevelCheckerTest : public ::testing::Test {
+ public:
+  H264LevelCheckerTest() {}
+  ~H264LevelCheckerTest() override {}
+
+  // A progressive SPS whose VUI gives the frame rate (time_scale / 2).
+  static std::unique_ptr<H264SpsDataParser::SpsDataState> Sps(
+      uint32_t profile_idc, uint8_t level_idc, uint32_t width_in_mbs,
+      uint32_t height_in_mbs, uint32_t max_num_ref_frames,
+      uint32_t time_scale) {
+    auto vui_parameters =
+        std::make_unique<H264VuiParametersParser::VuiParametersState>();
+    vui_parameters->timing_info_present_flag = 1;
+    vui_parameters->num_units_in_tick = 1;
+    vui_parameters->time_scale = time_scale;
+    auto sps = std::make_unique<H264SpsDataParser::SpsDataState>();
+    sps->profile_idc = profile_idc;
+    sps->level_idc = level_idc;
+    sps->pic_width_in_mbs_minus1 = width_in_mbs - 1;
+    sps->pic_height_in_map_units_minus1 = height_in_mbs - 1;
+    sps->frame_mbs_only_flag = 1;
+    sps->max_num_ref_frames = max_num_ref_frames;
+    sps->vui_parameters_present_flag = 1;
+    sps->vui_parameters = std::move(vui_parameters);
+    return sps;
+  }
+};
+
+TEST_F(H264LevelCheckerTest, TestLevelLimits) {
+  // Main profile, level 3 (720x576)
+  auto sps = Sps(77, 30, 45, 36, 5, 50);
+  const auto* limits = H264LevelChecker::GetLevelLimits(*sps);
+  ASSERT_NE(nullptr, limits);
+  EXPECT_EQ(30, limits->level_idc);
+  EXPECT_EQ(40500, limits->MaxMBPS);
+  EXPECT_EQ(1620, limits->MaxFS);
+  EXPECT_EQ(8100, limits->MaxDpbMbs);
+  EXPECT_EQ(10000, limits->MaxBR);
+  EXPECT_EQ(10000, limits->MaxCPB);
+  EXPECT_EQ(2, limits->MinCR);
+  EXPECT_EQ(32, limits->MaxMvsPer2Mb);
+  EXPECT_EQ(22, limits->SliceRate);
+
+  // level 1b is level_idc 11 with constraint_set3_flag in the Main
+  // profile, but not in the High profile
+  sps->level_idc = 11;
+  sps->constraint_set3_flag = 1;
+  limits = H264LevelChecker::GetLevelLimits(*sps);
+  ASSERT_NE(nullptr, limits);
+  EXPECT_EQ(9, limits->level_idc);
+  EXPECT_EQ(128, limits->MaxBR);
+  sps->profile_idc = 100;
+  limits = H264LevelChecker::GetLevelLimits(*sps);
+  ASSERT_NE(nullptr, limits);
+  EXPECT_EQ(11, limits->level_idc);
+
+  sps->level_idc = 14;
+  EXPECT_EQ(nullptr, H264LevelChecker::GetLevelLimits(*sps));
+
+  EXPECT_EQ(1000, H264LevelChecker::GetCpbBrVclFactor(ProfileType::MAIN));
+  EXPECT_EQ(1200, H264LevelChecker::GetCpbBrNalFactor(ProfileType::MAIN));
+  EXPECT_EQ(1250, H264LevelChecker::GetCpbBrVclFactor(ProfileType::HIGH));
+  EXPECT_EQ(1500, H264LevelChecker::GetCpbBrNalFactor(ProfileType::HIGH));
+  EXPECT_EQ(4800,
+            H264LevelChecker::GetCpbBrNalFactor(ProfileType::HIGH_444_PRED));
+  EXPECT_EQ(0,
+            H264LevelChecker::GetCpbBrNalFactor(ProfileType::UNSPECIFIED));
+}
+
+TEST_F(H264LevelCheckerTest, TestConformingStream) {
+  // 720x576 at 25 fps is exactly MaxMBPS, and 5 frames exactly MaxDpbMbs
+  auto sps = Sps(77, 30, 45, 36, 5, 50);
+  H264LevelChecker checker;
+  for (size_t i = 0; i < 50; i++) {
+    checker.AddAccessUnit(1000 * i, 20000, 1, *sps);
+  }
+  EXPECT_TRUE(checker.GetViolations().empty());
+}
+
+TEST_F(H264LevelCheckerTest, TestSpsViolations) {
+  // one macroblock column too many: 1656 > MaxFS 1620, and 41400 > MaxMBPS
+  // 40500 at 25 fps, and only 8100 / 1656 = 4 frames fit in the DPB
+  auto sps = Sps(77, 30, 46, 36, 5, 50);
+  auto hrd_parameters =
+      std::make_unique<H264HrdParametersParser::HrdParametersState>();
+  hrd_parameters->cpb_cnt_minus1 = 0;
+  hrd_parameters->bit_rate_scale = 0;
+  hrd_parameters->cpb_size_scale = 0;
+  hrd_parameters->bit_rate_value_minus1 = {199999};
+  hrd_parameters->cpb_size_value_minus1 = {799999};
+  hrd_parameters->cbr_flag = {0};
+  sps->vui_parameters->nal_hrd_parameters_present_flag = 1;
+  sps->vui_parameters->nal_hrd_parameters = std::move(hrd_parameters);
+
+  H264LevelChecker checker;
+  checker.AddAccessUnit(0, 1000, 1, *sps);
+  // the SPS limits are only reported once
+  checker.AddAccessUnit(1000, 1000, 1, *sps);
+
+  const auto& violations = checker.GetViolations();
+  ASSERT_EQ(5, violations.size());
+  EXPECT_EQ(MAX_FS, violations[0].type);
+  EXPECT_EQ(0, violations[0].access_unit_index);
+  EXPECT_EQ(1656, violations[0].value);
+  EXPECT_EQ(1620, violations[0].max_value);
+  EXPECT_EQ(MAX_DPB_MBS, violations[1].type);
+  EXPECT_EQ(5, violations[1].value);
+  EXPECT_EQ(4, violations[1].max_value);
+  EXPECT_EQ(MAX_MBPS, violations[2].type);
+  EXPECT_EQ(41400, violations[2].value);
+  EXPECT_EQ(40500, violations[2].max_value);
+  // cpbBrNalFactor is 1200 in the Main profile
+  EXPECT_EQ(MAX_BR, violations[3].type);
+  EXPECT_EQ(12800000, violations[3].value);
+  EXPECT_EQ(12000000, violations[3].max_value);
+  EXPECT_EQ(MAX_CPB, violations[4].type);
+  EXPECT_EQ(12800000, violations[4].value);
+  EXPECT_EQ(12000000, violations[4].max_value);
+
+  // an SPS redefined in place, with an unknown level
+  sps->level_idc = 14;
+  checker.AddAccessUnit(2000, 1000, 1, *sps);
+  ASSERT_EQ(6, violations.size());
+  EXPECT_EQ(UNKNOWN_LEVEL, violations[5].type);
+  EXPECT_EQ(2, violations[5].access_unit_index);
+  EXPECT_EQ(2000, violations[5].offset);
+  EXPECT_EQ(14, violations[5].value);
+}
+
+TEST_F(H264LevelCheckerTest, TestAccessUnitViolations) {
+  auto sps = Sps(77, 30, 45, 36, 5, 50);
+  H264LevelChecker checker;
+  // 384 * 1620 / MinCR = 311040 bytes
+  checker.AddAccessUnit(0, 400000, 1, *sps);
+  // 1620 / SliceRate = 73 slices
+  checker.AddAccessUnit(1000, 1000, 80, *sps);
+  // a second of access units well above MaxBR (about 16 Mbps against 12
+  // Mbps) is not a level violation: the bit rate is an HRD limit
+  for (size_t i = 2; i < 27; i++) {
+    checker.AddAccessUnit(1000 * i, 80000, 1, *sps);
+  }
+
+  const auto& violations = checker.GetViolations();
+  ASSERT_EQ(2, violations.size());
+  EXPECT_EQ(MIN_CR, violations[0].type);
+  EXPECT_EQ(0, violations[0].access_unit_index);
+  EXPECT_EQ(400000, violations[0].value);
+  EXPECT_EQ(311040, violations[0].max_value);
+  EXPECT_EQ(MAX_SLICES, violations[1].type);
+  EXPECT_EQ(1, violations[1].access_unit_index);
+  EXPECT_EQ(1000, violations[1].offset);
+  EXPECT_EQ(80, violations[1].value);
+  EXPECT_EQ(73, violations[1].max_value);
+
+  // the Baseline profile has no slice limit
+  auto baseline_sps = Sps(66, 30, 45, 36, 5, 50);
+  H264LevelChecker baseline_checker;
+  baseline_checker.AddAccessUnit(0, 1000, 80, *baseline_sps);
+  EXPECT_TRUE(baseline_checker.GetViolations().empty());
+}
+
+TEST_F(H264LevelCheckerTest, TestParseBitstream) {
+  // SPS, PPS, and IDR (601.264, at level 2.2 and with no VUI), then the
+  // SPS redefined with the same id at level 1, and the same PPS and IDR
+  // again
+  const uint8_t buffer[] = {
+      // SPS (level 2.2)
+      0x00, 0x00, 0x00, 0x01,
+      0x67, 0x42, 0xc0, 0x16, 0xa6, 0x81, 0x41, 0xf9,
+      // PPS
+      0x00, 0x00, 0x00, 0x01,
+      0x68, 0xc8, 0x42, 0x02, 0x32, 0xc8,
+      // slice (IDR)
+      0x00, 0x00, 0x00, 0x01,
+      0x65, 0x88, 0x82, 0x06, 0x78, 0x8c, 0x50, 0x00,
+      0x1c, 0xab, 0x8e, 0x00, 0x02, 0xfb, 0x31, 0xc0,
+      0x00, 0x5f, 0x66, 0xfb, 0xef, 0xbe,
+      // SPS (level 1)
+      0x00, 0x00, 0x00, 0x01,
+      0x67, 0x42, 0xc0, 0x0a, 0xa6, 0x81, 0x41, 0xf9,
+      // PPS
+      0x00, 0x00, 0x00, 0x01,
+      0x68, 0xc8, 0x42, 0x02, 0x32, 0xc8,
+      // slice (IDR)
+      0x00, 0x00, 0x00, 0x01,
+      0x65, 0x88, 0x82, 0x06, 0x78, 0x8c, 0x50, 0x00,
+      0x1c, 0xab, 0x8e, 0x00, 0x02, 0xfb, 0x31, 0xc0,
+      0x00, 0x5f, 0x66, 0xfb, 0xef, 0xbe};
+
+  // the first access unit is only complete once the second SPS has been
+  // parsed into the state, but it is checked against the SPS it was
+  // parsed with
+  H264BitstreamParserState bitstream_parser_state;
+  ParsingOptions parsing_options;
+  H264LevelChecker checker;
+  H264AccessUnitAssembler::ParseBitstream(
+      buffer, arraysize(buffer), &bitstream_parser_state, parsing_options,
+      [&](std::unique_ptr<H264AccessUnitAssembler::AccessUnitState>
+              access_unit) {
+        EXPECT_TRUE(
+            checker.AddAccessUnit(*access_unit, bitstream_parser_state));
+      });
+
+  // 20x15 macroblocks: 300 > MaxFS 99, and 20 > Sqrt(8 * 99)
+  const auto& violations = checker.GetViolations();
+  ASSERT_FALSE(violations.empty());
+  for (const auto& violation : violations) {
+    EXPECT_EQ(1, violation.access_unit_index);
+    EXPECT_EQ(52, violation.offset);
+  }
+  EXPECT_EQ(MAX_FS, violations[0].type);
+  EXPECT_EQ(300, violations[0].value);
+  EXPECT_EQ(99, violations[0].max_value);
+}
+
+}  // namespace h264nal
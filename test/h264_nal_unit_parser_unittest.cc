@@ -61,8 +61,8 @@ TEST_F(H264NalUnitParserTest, TestSampleNalUnit) {
   EXPECT_FALSE(nal_unit->nal_unit_payload->IsPayloadParsed(
       nal_unit->nal_unit_header->nal_unit_type));
   // a type whose payload we do not parse at all is not missing anything
-  EXPECT_TRUE(
-      nal_unit->nal_unit_payload->IsPayloadParsed(NalUnitType::SEI_NUT));
+  EXPECT_TRUE(nal_unit->nal_unit_payload->IsPayloadParsed(
+      NalUnitType::FILLER_DATA_NUT));
 }
 
 TEST_F(H264NalUnitParserTest, TestEmptyNalUnit) {
@@ -91,6 +91,129 @@ TEST_F(H264NalUnitParserTest, TestTruncatedNalUnit) {
   // as long as it does not crash
 }
 
+TEST_F(H264NalUnitParserTest, TestRepeatedParameterSets) {
+  // SPS and PPS (601.264), and the same PPS id with
+  // entropy_coding_mode_flag set
+  const uint8_t sps[] = {0x67, 0x42, 0xc0, 0x16, 0xa6, 0x11, 0x05, 0x07,
+                         0xe9, 0xb2, 0x00, 0x00, 0x03, 0x00, 0x02, 0x00,
+                         0x00, 0x03, 0x00, 0x64, 0x1e, 0x2c, 0x5c, 0x23};
+  const uint8_t pps[] = {0x68, 0xc8, 0x42, 0x02, 0x32, 0xc8};
+  const uint8_t pps_cabac[] = {0x68, 0xe8, 0x42, 0x02, 0x32, 0xc8};
+  H264BitstreamParserState bitstream_parser_state;
+  ParsingOptions parsing_options;
+  parsing_options.add_checksum = true;
+
+  auto first = H264NalUnitParser::ParseNalUnit(
+      sps, arraysize(sps), &bitstream_parser_state, parsing_options);
+  ASSERT_TRUE(first != nullptr);
+  EXPECT_TRUE(first->parameter_set_changed);
+  auto repeat = H264NalUnitParser::ParseNalUnit(
+      sps, arraysize(sps), &bitstream_parser_state, parsing_options);
+  ASSERT_TRUE(repeat != nullptr);
+  EXPECT_FALSE(repeat->parameter_set_changed);
+  // the repeat shares the table entry, and looks like a full parse
+  EXPECT_EQ(first->nal_unit_payload->sps, repeat->nal_unit_payload->sps);
+  EXPECT_EQ(first->nal_unit_payload->sps, bitstream_parser_state.GetSps(0));
+  EXPECT_EQ(first->parsed_length, repeat->parsed_length);
+  EXPECT_EQ(first->checksum->GetPrintableChecksum(),
+            repeat->checksum->GetPrintableChecksum());
+  EXPECT_EQ(NalUnitType::SPS_NUT, repeat->nal_unit_header->nal_unit_type);
+
+  // the same bytes, read unescaped, are a different SPS
+  auto unescaped = H264NalUnitParser::ParseNalUnitUnescaped(
+      sps, arraysize(sps), &bitstream_parser_state, parsing_options);
+  ASSERT_TRUE(unescaped != nullptr);
+  EXPECT_TRUE(unescaped->parameter_set_changed);
+
+  // a PPS only repeats the one in effect for its id
+  auto nal_unit = H264NalUnitParser::ParseNalUnit(
+      pps, arraysize(pps), &bitstream_parser_state, parsing_options);
+  EXPECT_TRUE(nal_unit->parameter_set_changed);
+  nal_unit = H264NalUnitParser::ParseNalUnit(
+      pps, arraysize(pps), &bitstream_parser_state, parsing_options);
+  EXPECT_FALSE(nal_unit->parameter_set_changed);
+  nal_unit = H264NalUnitParser::ParseNalUnit(
+      pps_cabac, arraysize(pps_cabac), &bitstream_parser_state,
+      parsing_options);
+  EXPECT_TRUE(nal_unit->parameter_set_changed);
+  EXPECT_EQ(1, bitstream_parser_state.GetPps(0)->entropy_coding_mode_flag);
+  nal_unit = H264NalUnitParser::ParseNalUnit(
+      pps, arraysize(pps), &bitstream_parser_state, parsing_options);
+  EXPECT_TRUE(nal_unit->parameter_set_changed);
+  EXPECT_EQ(0, bitstream_parser_state.GetPps(0)->entropy_coding_mode_flag);
+
+  // a table entry written by hand is not mistaken for a repeat
+  bitstream_parser_state.pps[0] = nullptr;
+  nal_unit = H264NalUnitParser::ParseNalUnit(
+      pps, arraysize(pps), &bitstream_parser_state, parsing_options);
+  EXPECT_TRUE(nal_unit->parameter_set_changed);
+  EXPECT_TRUE(bitstream_parser_state.GetPps(0) != nullptr);
+
+  // other NAL units never change the tables
+  const uint8_t aud[] = {0x09, 0xf0};
+  nal_unit = H264NalUnitParser::ParseNalUnit(
+      aud, arraysize(aud), &bitstream_parser_state, parsing_options);
+  EXPECT_FALSE(nal_unit->parameter_set_changed);
+}
+
+TEST_F(H264NalUnitParserTest, TestParseNalUnitInPlace) {
+  // SPS, PPS, and a non-IDR slice (601.264)
+  const uint8_t sps[] = {0x67, 0x42, 0xc0, 0x16, 0xa6, 0x11, 0x05, 0x07,
+                         0xe9, 0xb2, 0x00, 0x00, 0x03, 0x00, 0x02, 0x00,
+                         0x00, 0x03, 0x00, 0x64, 0x1e, 0x2c, 0x5c, 0x23};
+  const uint8_t pps[] = {0x68, 0xc8, 0x42, 0x02, 0x32, 0xc8};
+  const uint8_t slice[] = {0x41, 0x9a, 0x1c, 0x0c, 0xf0, 0x09, 0x6c};
+  H264BitstreamParserState bitstream_parser_state;
+  ParsingOptions parsing_options;
+  parsing_options.add_checksum = true;
+
+  H264NalUnitParser::NalUnitState nal_unit;
+  ASSERT_TRUE(H264NalUnitParser::ParseNalUnit(sps, arraysize(sps),
+                                              &bitstream_parser_state,
+                                              parsing_options, &nal_unit));
+  EXPECT_TRUE(nal_unit.parameter_set_changed);
+  EXPECT_EQ(arraysize(sps), nal_unit.length);
+  ASSERT_TRUE(H264NalUnitParser::ParseNalUnit(pps, arraysize(pps),
+                                              &bitstream_parser_state,
+                                              parsing_options, &nal_unit));
+  EXPECT_EQ(NalUnitType::PPS_NUT, nal_unit.nal_unit_header->nal_unit_type);
+  EXPECT_TRUE(nal_unit.nal_unit_payload->sps == nullptr);
+
+  auto expected = H264NalUnitParser::ParseNalUnit(
+      slice, arraysize(slice), &bitstream_parser_state, parsing_options);
+  ASSERT_TRUE(expected != nullptr);
+  ASSERT_TRUE(nal_unit.arena != nullptr);
+  size_t block_count = nal_unit.arena->GetBlockCount();
+  for (int i = 0; i < 3; i++) {
+    ASSERT_TRUE(H264NalUnitParser::ParseNalUnit(slice, arraysize(slice),
+                                                &bitstream_parser_state,
+                                                parsing_options, &nal_unit));
+    EXPECT_EQ(expected->parsed_length, nal_unit.parsed_length);
+    EXPECT_EQ(expected->checksum->GetPrintableChecksum(),
+              nal_unit.checksum->GetPrintableChecksum());
+    EXPECT_FALSE(nal_unit.parameter_set_changed);
+    const auto& slice_header =
+        nal_unit.nal_unit_payload->slice_layer_without_partitioning_rbsp
+            ->slice_header;
+    ASSERT_TRUE(slice_header != nullptr);
+    EXPECT_EQ(expected->nal_unit_payload->slice_layer_without_partitioning_rbsp
+                  ->slice_header->frame_num,
+              slice_header->frame_num);
+    // the arena memory is reused
+    EXPECT_EQ(block_count, nal_unit.arena->GetBlockCount());
+  }
+
+  // a NAL unit that is not parsed leaves the state reset
+  parsing_options.SetParseLevel(PARSE_SKIP);
+  EXPECT_FALSE(H264NalUnitParser::ParseNalUnitUnescaped(
+      slice, arraysize(slice), &bitstream_parser_state, parsing_options,
+      &nal_unit));
+  EXPECT_TRUE(nal_unit.nal_unit_header == nullptr);
+  EXPECT_TRUE(nal_unit.nal_unit_payload == nullptr);
+  EXPECT_TRUE(nal_unit.checksum == nullptr);
+  EXPECT_EQ(0, nal_unit.parsed_length);
+}
+
 class H264NalUnitHeaderParserTest : public ::testing::Test {
  public:
   H264NalUnitHeaderParserTest() {}
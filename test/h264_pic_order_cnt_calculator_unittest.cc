@@ -0,0 +1,288 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#include "h264_pic_order_cnt_calculator.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include "h264_bitstream_parser.h"
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "h264_dec_ref_pic_marking_parser.h"
+#include "h264_nal_unit_parser.h"
+#include "h264_slice_header_parser.h"
+#include "h264_sps_parser.h"
+#include "rtc_common.h"
+
+namespace h264nal {
+
+class H264PicOrderCntCalculatorTest : public ::testing::Test {
+ public:
+  H264PicOrderCntCalculatorTest() {}
+  ~H264PicOrderCntCalculatorTest() override {}
+
+  // Sets the fields of |slice_header| the derivation reads.
+  static void SetSliceHeader(
+      H264SliceHeaderParser::SliceHeaderState* slice_header,
+      uint32_t nal_unit_type, uint32_t nal_ref_idc, uint32_t frame_num,
+      uint32_t pic_order_cnt_lsb) {
+    slice_header->nal_unit_type = static_cast<uint8_t>(nal_unit_type);
+    slice_header->nal_ref_idc = static_cast<uint8_t>(nal_ref_idc);
+    slice_header->frame_num = static_cast<uint16_t>(frame_num);
+    slice_header->pic_order_cnt_lsb =
+        static_cast<uint16_t>(pic_order_cnt_lsb);
+  }
+};
+
+TEST_F(H264PicOrderCntCalculatorTest, TestPicOrderCntType0) {
+  // MaxPicOrderCntLsb: 16
+  H264SpsDataParser::SpsDataState sps;
+  sps.pic_order_cnt_type = 0;
+  sps.log2_max_frame_num_minus4 = 0;
+  sps.log2_max_pic_order_cnt_lsb_minus4 = 0;
+  sps.frame_mbs_only_flag = 1;
+
+  struct Picture {
+    uint32_t nal_unit_type;
+    uint32_t nal_ref_idc;
+    uint32_t frame_num;
+    uint32_t pic_order_cnt_lsb;
+    int32_t TopFieldOrderCnt;
+  };
+  const std::vector<Picture> pictures = {
+      {CODED_SLICE_OF_IDR_PICTURE_NUT, 3, 0, 0, 0},
+      {CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, 1, 4, 4},
+      // a non-reference picture does not move prevPicOrderCntLsb
+      {CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 0, 2, 2, 2},
+      {CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, 2, 10, 10},
+      // pic_order_cnt_lsb wraps around
+      {CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, 3, 0, 16},
+      {CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 0, 4, 14, 14},
+      {CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, 4, 6, 22},
+      // a new IDR picture restarts the sequence
+      {CODED_SLICE_OF_IDR_PICTURE_NUT, 3, 0, 2, 2},
+  };
+
+  H264PicOrderCntCalculator calculator;
+  for (const Picture& picture : pictures) {
+    H264SliceHeaderParser::SliceHeaderState slice_header;
+    SetSliceHeader(&slice_header, picture.nal_unit_type, picture.nal_ref_idc,
+                   picture.frame_num, picture.pic_order_cnt_lsb);
+    slice_header.delta_pic_order_cnt_bottom = 1;
+    H264PicOrderCntCalculator::PicOrderCnt pic_order_cnt;
+    ASSERT_TRUE(calculator.Compute(slice_header, sps, &pic_order_cnt));
+    EXPECT_EQ(picture.TopFieldOrderCnt, pic_order_cnt.TopFieldOrderCnt);
+    EXPECT_EQ(picture.TopFieldOrderCnt + 1, pic_order_cnt.BottomFieldOrderCnt);
+    EXPECT_EQ(picture.TopFieldOrderCnt, pic_order_cnt.PicOrderCnt);
+    EXPECT_EQ(0, pic_order_cnt.second_field);
+  }
+}
+
+TEST_F(H264PicOrderCntCalculatorTest, TestPicOrderCntType0Mmco5) {
+  H264SpsDataParser::SpsDataState sps;
+  sps.pic_order_cnt_type = 0;
+  sps.log2_max_pic_order_cnt_lsb_minus4 = 0;
+  sps.frame_mbs_only_flag = 1;
+
+  H264PicOrderCntCalculator calculator;
+  H264PicOrderCntCalculator::PicOrderCnt pic_order_cnt;
+  H264SliceHeaderParser::SliceHeaderState idr;
+  SetSliceHeader(&idr, CODED_SLICE_OF_IDR_PICTURE_NUT, 3, 0, 0);
+  ASSERT_TRUE(calculator.Compute(idr, sps, &pic_order_cnt));
+  H264SliceHeaderParser::SliceHeaderState p;
+  SetSliceHeader(&p, CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, 1, 6);
+  ASSERT_TRUE(calculator.Compute(p, sps, &pic_order_cnt));
+  EXPECT_EQ(6, pic_order_cnt.PicOrderCnt);
+
+  // memory_management_control_operation 5: the picture is rebased to 0
+  H264SliceHeaderParser::SliceHeaderState mmco5;
+  SetSliceHeader(&mmco5, CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, 2, 8);
+  mmco5.delta_pic_order_cnt_bottom = 2;
+  mmco5.dec_ref_pic_marking =
+      std::make_unique<H264DecRefPicMarkingParser::DecRefPicMarkingState>();
+  mmco5.dec_ref_pic_marking->adaptive_ref_pic_marking_mode_flag = 1;
+  mmco5.dec_ref_pic_marking->memory_management_control_operation = {5, 0};
+  EXPECT_TRUE(
+      H264PicOrderCntCalculator::HasMemoryManagementControlOperation5(mmco5));
+  ASSERT_TRUE(calculator.Compute(mmco5, sps, &pic_order_cnt));
+  EXPECT_EQ(1, pic_order_cnt.memory_management_control_operation_5);
+  EXPECT_EQ(0, pic_order_cnt.TopFieldOrderCnt);
+  EXPECT_EQ(2, pic_order_cnt.BottomFieldOrderCnt);
+  EXPECT_EQ(0, pic_order_cnt.PicOrderCnt);
+
+  // the next picture counts from prevPicOrderCntMsb 0 and
+  // prevPicOrderCntLsb 0 (the rebased TopFieldOrderCnt), so its lsb of 2
+  // does not wrap around
+  H264SliceHeaderParser::SliceHeaderState next;
+  SetSliceHeader(&next, CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, 1, 2);
+  ASSERT_TRUE(calculator.Compute(next, sps, &pic_order_cnt));
+  EXPECT_EQ(0, pic_order_cnt.memory_management_control_operation_5);
+  EXPECT_EQ(2, pic_order_cnt.PicOrderCnt);
+}
+
+TEST_F(H264PicOrderCntCalculatorTest, TestPicOrderCntType0FieldPair) {
+  H264SpsDataParser::SpsDataState sps;
+  sps.pic_order_cnt_type = 0;
+  sps.log2_max_pic_order_cnt_lsb_minus4 = 0;
+  sps.frame_mbs_only_flag = 0;
+
+  H264PicOrderCntCalculator calculator;
+  H264PicOrderCntCalculator::PicOrderCnt pic_order_cnt;
+  // an IDR top field
+  H264SliceHeaderParser::SliceHeaderState top;
+  SetSliceHeader(&top, CODED_SLICE_OF_IDR_PICTURE_NUT, 3, 0, 0);
+  top.field_pic_flag = 1;
+  ASSERT_TRUE(calculator.Compute(top, sps, &pic_order_cnt));
+  EXPECT_EQ(0, pic_order_cnt.second_field);
+  EXPECT_EQ(0, pic_order_cnt.TopFieldOrderCnt);
+  EXPECT_EQ(0, pic_order_cnt.PicOrderCnt);
+
+  // its (non-IDR) bottom field completes the pair
+  H264SliceHeaderParser::SliceHeaderState bottom;
+  SetSliceHeader(&bottom, CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 3, 0, 1);
+  bottom.field_pic_flag = 1;
+  bottom.bottom_field_flag = 1;
+  ASSERT_TRUE(calculator.Compute(bottom, sps, &pic_order_cnt));
+  EXPECT_EQ(1, pic_order_cnt.second_field);
+  EXPECT_EQ(0, pic_order_cnt.TopFieldOrderCnt);
+  EXPECT_EQ(1, pic_order_cnt.BottomFieldOrderCnt);
+  EXPECT_EQ(1, pic_order_cnt.PicOrderCnt);
+
+  // a bottom field with a new frame_num starts a new pair
+  bottom.frame_num = 1;
+  bottom.pic_order_cnt_lsb = 5;
+  ASSERT_TRUE(calculator.Compute(bottom, sps, &pic_order_cnt));
+  EXPECT_EQ(0, pic_order_cnt.second_field);
+  EXPECT_EQ(5, pic_order_cnt.BottomFieldOrderCnt);
+  EXPECT_EQ(5, pic_order_cnt.PicOrderCnt);
+}
+
+TEST_F(H264PicOrderCntCalculatorTest, TestPicOrderCntType1) {
+  H264SpsDataParser::SpsDataState sps;
+  sps.pic_order_cnt_type = 1;
+  sps.log2_max_frame_num_minus4 = 0;
+  sps.frame_mbs_only_flag = 1;
+  sps.offset_for_non_ref_pic = -1;
+  sps.offset_for_top_to_bottom_field = 1;
+  sps.num_ref_frames_in_pic_order_cnt_cycle = 2;
+  sps.offset_for_ref_frame = {2, 4};
+
+  struct Picture {
+    uint32_t nal_unit_type;
+    uint32_t nal_ref_idc;
+    uint32_t frame_num;
+    int32_t TopFieldOrderCnt;
+  };
+  const std::vector<Picture> pictures = {
+      {CODED_SLICE_OF_IDR_PICTURE_NUT, 3, 0, 0},
+      // absFrameNum 1: offset_for_ref_frame[0]
+      {CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, 1, 2},
+      // absFrameNum 2: offset_for_ref_frame[0] + offset_for_ref_frame[1]
+      {CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, 2, 6},
+      // non-reference, absFrameNum 2: 6 + offset_for_non_ref_pic
+      {CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 0, 3, 5},
+      // absFrameNum 3: one full cycle (6) + offset_for_ref_frame[0]
+      {CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, 3, 8},
+  };
+
+  H264PicOrderCntCalculator calculator;
+  for (const Picture& picture : pictures) {
+    H264SliceHeaderParser::SliceHeaderState slice_header;
+    SetSliceHeader(&slice_header, picture.nal_unit_type, picture.nal_ref_idc,
+                   picture.frame_num, 0);
+    H264PicOrderCntCalculator::PicOrderCnt pic_order_cnt;
+    ASSERT_TRUE(calculator.Compute(slice_header, sps, &pic_order_cnt));
+    EXPECT_EQ(picture.TopFieldOrderCnt, pic_order_cnt.TopFieldOrderCnt);
+    EXPECT_EQ(picture.TopFieldOrderCnt + 1, pic_order_cnt.BottomFieldOrderCnt);
+    EXPECT_EQ(picture.TopFieldOrderCnt, pic_order_cnt.PicOrderCnt);
+  }
+
+  // offset_for_ref_frame does not match the SPS
+  sps.offset_for_ref_frame = {2};
+  H264SliceHeaderParser::SliceHeaderState slice_header;
+  SetSliceHeader(&slice_header, CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, 4, 0);
+  H264PicOrderCntCalculator::PicOrderCnt pic_order_cnt;
+  EXPECT_FALSE(calculator.Compute(slice_header, sps, &pic_order_cnt));
+}
+
+TEST_F(H264PicOrderCntCalculatorTest, TestPicOrderCntType2) {
+  // MaxFrameNum: 16
+  H264SpsDataParser::SpsDataState sps;
+  sps.pic_order_cnt_type = 2;
+  sps.log2_max_frame_num_minus4 = 0;
+  sps.frame_mbs_only_flag = 1;
+
+  H264PicOrderCntCalculator calculator;
+  H264PicOrderCntCalculator::PicOrderCnt pic_order_cnt;
+  H264SliceHeaderParser::SliceHeaderState slice_header;
+  SetSliceHeader(&slice_header, CODED_SLICE_OF_IDR_PICTURE_NUT, 3, 0, 0);
+  ASSERT_TRUE(calculator.Compute(slice_header, sps, &pic_order_cnt));
+  EXPECT_EQ(0, pic_order_cnt.PicOrderCnt);
+  for (uint32_t frame_num = 1; frame_num < 16; frame_num++) {
+    SetSliceHeader(&slice_header, CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2,
+                   frame_num, 0);
+    ASSERT_TRUE(calculator.Compute(slice_header, sps, &pic_order_cnt));
+    EXPECT_EQ(2 * frame_num, pic_order_cnt.PicOrderCnt);
+  }
+  // frame_num wraps around: FrameNumOffset is MaxFrameNum
+  SetSliceHeader(&slice_header, CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 2, 0, 0);
+  ASSERT_TRUE(calculator.Compute(slice_header, sps, &pic_order_cnt));
+  EXPECT_EQ(32, pic_order_cnt.TopFieldOrderCnt);
+  EXPECT_EQ(32, pic_order_cnt.BottomFieldOrderCnt);
+  // a non-reference picture sits just before the reference one
+  SetSliceHeader(&slice_header, CODED_SLICE_OF_NON_IDR_PICTURE_NUT, 0, 1, 0);
+  ASSERT_TRUE(calculator.Compute(slice_header, sps, &pic_order_cnt));
+  EXPECT_EQ(33, pic_order_cnt.PicOrderCnt);
+}
+
+// SPS, PPS, slice IDR, slice non-IDR (601.264)
+const uint8_t buffer[] = {
+    // SPS
+    0x00, 0x00, 0x00, 0x01,
+    0x67, 0x42, 0xc0, 0x16, 0xa6, 0x11, 0x05, 0x07,
+    0xe9, 0xb2, 0x00, 0x00, 0x03, 0x00, 0x02, 0x00,
+    0x00, 0x03, 0x00, 0x64, 0x1e, 0x2c, 0x5c, 0x23,
+    // PPS
+    0x00, 0x00, 0x00, 0x01,
+    0x68, 0xc8, 0x42, 0x02, 0x32, 0xc8,
+    // slice (IDR)
+    0x00, 0x00, 0x00, 0x01,
+    0x65, 0x88, 0x82, 0x06, 0x78, 0x8c, 0x50, 0x00,
+    0x1c, 0xab, 0x8e, 0x00, 0x02, 0xfb, 0x31, 0xc0,
+    0x00, 0x5f, 0x66, 0xfb, 0xef, 0xbe,
+    // slice (non-IDR)
+    0x00, 0x00, 0x00, 0x01,
+    0x41, 0x9a, 0x1c, 0x0c, 0xf0, 0x09, 0x6c
+};
+
+TEST_F(H264PicOrderCntCalculatorTest, TestBitstream) {
+  H264BitstreamParserState bitstream_parser_state;
+  ParsingOptions parsing_options;
+  H264PicOrderCntCalculator calculator;
+  std::vector<int32_t> pic_order_cnts;
+  H264BitstreamParser::ParseBitstream(
+      buffer, arraysize(buffer), &bitstream_parser_state, parsing_options,
+      [&](std::unique_ptr<H264NalUnitParser::NalUnitState> nal_unit) {
+        if (nal_unit->nal_unit_payload == nullptr ||
+            nal_unit->nal_unit_payload
+                    ->slice_layer_without_partitioning_rbsp == nullptr) {
+          return;
+        }
+        const auto& slice_header =
+            *nal_unit->nal_unit_payload->slice_layer_without_partitioning_rbsp
+                 ->slice_header;
+        H264PicOrderCntCalculator::PicOrderCnt pic_order_cnt;
+        ASSERT_TRUE(calculator.Compute(slice_header, bitstream_parser_state,
+                                       &pic_order_cnt));
+        pic_order_cnts.push_back(pic_order_cnt.PicOrderCnt);
+      });
+  // pic_order_cnt_type 2
+  EXPECT_THAT(pic_order_cnts, ::testing::ElementsAre(0, 2));
+}
+
+}  // namespace h264nal
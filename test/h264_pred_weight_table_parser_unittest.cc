@@ -123,4 +123,58 @@ TEST_F(H264PredWeightTableParserTest, TestSamplePredWeightTable2) {
   EXPECT_EQ(0, pred_weight_table->chroma_offset_l1.size());
 }
 
+TEST_F(H264PredWeightTableParserTest, TestBSlicePredWeightTable) {
+  // pred_weight_table with both reference lists
+  const uint8_t buffer[] = {0xe9, 0xe9, 0xdd, 0x38};
+  uint32_t chroma_array_type = 1;
+  uint32_t slice_type = SliceType::B_ALL;
+  uint32_t num_ref_idx_l0_active_minus1 = 0;
+  uint32_t num_ref_idx_l1_active_minus1 = 0;
+
+  auto pred_weight_table = H264PredWeightTableParser::ParsePredWeightTable(
+      buffer, arraysize(buffer), chroma_array_type, slice_type,
+      num_ref_idx_l0_active_minus1, num_ref_idx_l1_active_minus1);
+
+  EXPECT_TRUE(pred_weight_table != nullptr);
+
+  EXPECT_EQ(0, pred_weight_table->luma_log2_weight_denom);
+  EXPECT_EQ(0, pred_weight_table->chroma_log2_weight_denom);
+  EXPECT_THAT(pred_weight_table->luma_weight_l0_flag,
+              ::testing::ElementsAreArray({1}));
+  EXPECT_THAT(pred_weight_table->luma_weight_l0,
+              ::testing::ElementsAreArray({1}));
+  EXPECT_THAT(pred_weight_table->luma_offset_l0,
+              ::testing::ElementsAreArray({-1}));
+  EXPECT_THAT(pred_weight_table->chroma_weight_l0_flag,
+              ::testing::ElementsAreArray({1}));
+  EXPECT_THAT(pred_weight_table->chroma_weight_l0,
+              ::testing::ElementsAreArray({
+                  ::testing::ElementsAreArray({0, -1}),
+              }));
+  EXPECT_THAT(pred_weight_table->chroma_offset_l0,
+              ::testing::ElementsAreArray({
+                  ::testing::ElementsAreArray({1, 0}),
+              }));
+  EXPECT_THAT(pred_weight_table->luma_weight_l1_flag,
+              ::testing::ElementsAreArray({0}));
+  EXPECT_EQ(0, pred_weight_table->luma_weight_l1.size());
+  EXPECT_EQ(0, pred_weight_table->luma_offset_l1.size());
+  EXPECT_THAT(pred_weight_table->chroma_weight_l1_flag,
+              ::testing::ElementsAreArray({1}));
+  EXPECT_THAT(pred_weight_table->chroma_weight_l1,
+              ::testing::ElementsAreArray({
+                  ::testing::ElementsAreArray({0, 1}),
+              }));
+  EXPECT_THAT(pred_weight_table->chroma_offset_l1,
+              ::testing::ElementsAreArray({
+                  ::testing::ElementsAreArray({0, -1}),
+              }));
+
+  // more reference indices than the standard allows
+  EXPECT_TRUE(H264PredWeightTableParser::ParsePredWeightTable(
+                  buffer, arraysize(buffer), chroma_array_type, slice_type,
+                  H264PredWeightTableParser::kNumRefIdxActiveMinus1Max + 1,
+                  num_ref_idx_l1_active_minus1) == nullptr);
+}
+
 }  // namespace h264nal
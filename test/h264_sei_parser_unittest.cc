@@ -0,0 +1,376 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#include "h264_sei_parser.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "h264_hrd_parameters_parser.h"
+#include "h264_nal_unit_parser.h"
+#include "h264_sps_parser.h"
+#include "h264_vui_parameters_parser.h"
+#include "rtc_common.h"
+
+namespace h264nal {
+
+class H264SeiParserTest : public ::testing::Test {
+ public:
+  H264SeiParserTest() {}
+  ~H264SeiParserTest() override {}
+
+  // An SPS (id 0) whose VUI has NAL hrd_parameters() with 8-bit delays,
+  // no time offset, and pic_struct_present_flag set.
+  static std::shared_ptr<H264SpsParser::SpsState> HrdSps() {
+    auto hrd_parameters =
+        std::make_unique<H264HrdParametersParser::HrdParametersState>();
+    hrd_parameters->cpb_cnt_minus1 = 0;
+    hrd_parameters->initial_cpb_removal_delay_length_minus1 = 7;
+    hrd_parameters->cpb_removal_delay_length_minus1 = 7;
+    hrd_parameters->dpb_output_delay_length_minus1 = 7;
+    hrd_parameters->time_offset_length = 0;
+    auto vui_parameters =
+        std::make_unique<H264VuiParametersParser::VuiParametersState>();
+    vui_parameters->nal_hrd_parameters_present_flag = 1;
+    vui_parameters->nal_hrd_parameters = std::move(hrd_parameters);
+    vui_parameters->pic_struct_present_flag = 1;
+    auto sps = std::make_shared<H264SpsParser::SpsState>();
+    sps->sps_data = std::make_unique<H264SpsDataParser::SpsDataState>();
+    sps->sps_data->seq_parameter_set_id = 0;
+    sps->sps_data->vui_parameters_present_flag = 1;
+    sps->sps_data->vui_parameters = std::move(vui_parameters);
+    return sps;
+  }
+};
+
+TEST_F(H264SeiParserTest, TestSampleSei) {
+  // user_data_unregistered (x264 uuid, 4 bytes of user data), recovery_point,
+  // buffering_period (referring to a missing SPS), and buffering_period and
+  // pic_timing (referring to SPS 0)
+  // fuzzer::conv: data
+  const uint8_t buffer[] = {
+      // user_data_unregistered: payloadType 5, payloadSize 20
+      0x05, 0x14,
+      0xdc, 0x45, 0xe9, 0xbd, 0xe6, 0xd9, 0x48, 0xb7,
+      0x96, 0x2c, 0xd8, 0x20, 0xd9, 0x23, 0xee, 0xef,
+      0x61, 0x62, 0x63, 0x64,
+      // recovery_point: payloadType 6, payloadSize 1
+      0x06, 0x01,
+      0xc0,
+      // buffering_period: payloadType 0, payloadSize 1
+      0x00, 0x01,
+      0x40,
+      // buffering_period: payloadType 0, payloadSize 3
+      0x00, 0x03,
+      0x88, 0x10, 0x00,
+      // pic_timing: payloadType 1, payloadSize 8
+      0x01, 0x08,
+      0x02, 0x04, 0x3a, 0x04, 0x05, 0x04, 0x21, 0xa0,
+      // rbsp_trailing_bits()
+      0x80
+  };
+  // fuzzer::conv: begin
+  // get some mock state: an SPS (id 0) whose VUI has NAL hrd_parameters()
+  // with 8-bit delays, and pic_struct_present_flag set
+  H264BitstreamParserState bitstream_parser_state;
+  auto hrd_parameters =
+      std::make_unique<H264HrdParametersParser::HrdParametersState>();
+  hrd_parameters->cpb_cnt_minus1 = 0;
+  hrd_parameters->initial_cpb_removal_delay_length_minus1 = 7;
+  hrd_parameters->cpb_removal_delay_length_minus1 = 7;
+  hrd_parameters->dpb_output_delay_length_minus1 = 7;
+  hrd_parameters->time_offset_length = 0;
+  auto vui_parameters =
+      std::make_unique<H264VuiParametersParser::VuiParametersState>();
+  vui_parameters->nal_hrd_parameters_present_flag = 1;
+  vui_parameters->nal_hrd_parameters = std::move(hrd_parameters);
+  vui_parameters->pic_struct_present_flag = 1;
+  auto sps = std::make_shared<H264SpsParser::SpsState>();
+  sps->sps_data = std::make_unique<H264SpsDataParser::SpsDataState>();
+  sps->sps_data->seq_parameter_set_id = 0;
+  sps->sps_data->vui_parameters_present_flag = 1;
+  sps->sps_data->vui_parameters = std::move(vui_parameters);
+  bitstream_parser_state.sps[0] = sps;
+  ParsingOptions parsing_options;
+  auto sei = H264SeiParser::ParseSei(buffer, arraysize(buffer),
+                                     &bitstream_parser_state, parsing_options);
+  // fuzzer::conv: end
+
+  ASSERT_TRUE(sei != nullptr);
+  ASSERT_EQ(5, sei->sei_message.size());
+
+  const auto& user_data_message = sei->sei_message[0];
+  EXPECT_EQ(SEI_USER_DATA_UNREGISTERED, user_data_message->payload_type);
+  EXPECT_EQ(20, user_data_message->payload_size);
+  EXPECT_EQ(2, user_data_message->payload_offset);
+  ASSERT_TRUE(user_data_message->user_data_unregistered != nullptr);
+  EXPECT_THAT(
+      user_data_message->user_data_unregistered->uuid_iso_iec_11578,
+      ::testing::ElementsAreArray({0xdc, 0x45, 0xe9, 0xbd, 0xe6, 0xd9, 0x48,
+                                   0xb7, 0x96, 0x2c, 0xd8, 0x20, 0xd9, 0x23,
+                                   0xee, 0xef}));
+  EXPECT_EQ(18, user_data_message->user_data_unregistered->payload_offset);
+  EXPECT_EQ(4, user_data_message->user_data_unregistered->payload_length);
+
+  const auto& recovery_point_message = sei->sei_message[1];
+  EXPECT_EQ(SEI_RECOVERY_POINT, recovery_point_message->payload_type);
+  EXPECT_EQ(1, recovery_point_message->payload_size);
+  EXPECT_EQ(24, recovery_point_message->payload_offset);
+  ASSERT_TRUE(recovery_point_message->recovery_point != nullptr);
+  EXPECT_EQ(0, recovery_point_message->recovery_point->recovery_frame_cnt);
+  EXPECT_EQ(1, recovery_point_message->recovery_point->exact_match_flag);
+  EXPECT_EQ(0, recovery_point_message->recovery_point->broken_link_flag);
+  EXPECT_EQ(0,
+            recovery_point_message->recovery_point->changing_slice_group_idc);
+
+  // a payload that does not decode is still located
+  const auto& buffering_period_message = sei->sei_message[2];
+  EXPECT_EQ(SEI_BUFFERING_PERIOD, buffering_period_message->payload_type);
+  EXPECT_EQ(1, buffering_period_message->payload_size);
+  EXPECT_EQ(27, buffering_period_message->payload_offset);
+  EXPECT_TRUE(buffering_period_message->buffering_period == nullptr);
+
+  const auto& hrd_buffering_period_message = sei->sei_message[3];
+  EXPECT_EQ(SEI_BUFFERING_PERIOD, hrd_buffering_period_message->payload_type);
+  EXPECT_EQ(30, hrd_buffering_period_message->payload_offset);
+  ASSERT_TRUE(hrd_buffering_period_message->buffering_period != nullptr);
+  EXPECT_EQ(
+      0, hrd_buffering_period_message->buffering_period->seq_parameter_set_id);
+
+  const auto& pic_timing_message = sei->sei_message[4];
+  EXPECT_EQ(SEI_PIC_TIMING, pic_timing_message->payload_type);
+  EXPECT_EQ(8, pic_timing_message->payload_size);
+  EXPECT_EQ(35, pic_timing_message->payload_offset);
+  ASSERT_TRUE(pic_timing_message->pic_timing != nullptr);
+  EXPECT_EQ(2, pic_timing_message->pic_timing->cpb_removal_delay);
+  EXPECT_EQ(4, pic_timing_message->pic_timing->dpb_output_delay);
+  EXPECT_EQ(3, pic_timing_message->pic_timing->pic_struct);
+}
+
+TEST_F(H264SeiParserTest, TestSeiParseMask) {
+  // user_data_unregistered and recovery_point
+  const uint8_t buffer[] = {
+      0x05, 0x14,
+      0xdc, 0x45, 0xe9, 0xbd, 0xe6, 0xd9, 0x48, 0xb7,
+      0x96, 0x2c, 0xd8, 0x20, 0xd9, 0x23, 0xee, 0xef,
+      0x61, 0x62, 0x63, 0x64,
+      0x06, 0x01,
+      0xc0,
+      0x80
+  };
+  H264BitstreamParserState bitstream_parser_state;
+  ParsingOptions parsing_options;
+  parsing_options.SetSeiParse(SEI_USER_DATA_UNREGISTERED, false);
+  EXPECT_FALSE(parsing_options.GetSeiParse(SEI_USER_DATA_UNREGISTERED));
+  EXPECT_TRUE(parsing_options.GetSeiParse(SEI_RECOVERY_POINT));
+  auto sei = H264SeiParser::ParseSei(buffer, arraysize(buffer),
+                                     &bitstream_parser_state, parsing_options);
+  ASSERT_TRUE(sei != nullptr);
+  ASSERT_EQ(2, sei->sei_message.size());
+
+  // located, but not decoded
+  EXPECT_EQ(SEI_USER_DATA_UNREGISTERED, sei->sei_message[0]->payload_type);
+  EXPECT_EQ(20, sei->sei_message[0]->payload_size);
+  EXPECT_EQ(2, sei->sei_message[0]->payload_offset);
+  EXPECT_TRUE(sei->sei_message[0]->user_data_unregistered == nullptr);
+
+  EXPECT_TRUE(sei->sei_message[1]->recovery_point != nullptr);
+}
+
+TEST_F(H264SeiParserTest, TestEscapedPayloadOffsets) {
+  // user_data_unregistered and recovery_point, with emulation prevention
+  // bytes in the uuid and in the user data
+  const uint8_t buffer[] = {
+      0x05, 0x14,
+      0x00, 0x00, 0x03, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+      0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+      0x00, 0x00, 0x03, 0x01, 0x61,
+      0x06, 0x01,
+      0xc0,
+      0x80
+  };
+  H264BitstreamParserState bitstream_parser_state;
+  ParsingOptions parsing_options;
+  auto sei = H264SeiParser::ParseSei(buffer, arraysize(buffer),
+                                     &bitstream_parser_state, parsing_options);
+  ASSERT_TRUE(sei != nullptr);
+  ASSERT_EQ(2, sei->sei_message.size());
+
+  auto& user_data_message = sei->sei_message[0];
+  EXPECT_EQ(20, user_data_message->payload_size);
+  EXPECT_EQ(2, user_data_message->payload_offset);
+  EXPECT_EQ(2, user_data_message->escaped_payload_offset);
+  EXPECT_EQ(22, user_data_message->escaped_payload_size);
+  auto& user_data = user_data_message->user_data_unregistered;
+  ASSERT_TRUE(user_data != nullptr);
+  EXPECT_EQ(18, user_data->payload_offset);
+  EXPECT_EQ(4, user_data->payload_length);
+  EXPECT_EQ(19, user_data->escaped_payload_offset);
+  EXPECT_EQ(5, user_data->escaped_payload_length);
+  const uint8_t expected_user_data[] = {0x00, 0x00, 0x03, 0x01, 0x61};
+  EXPECT_THAT(std::vector<uint8_t>(buffer + user_data->escaped_payload_offset,
+                                   buffer + user_data->escaped_payload_offset +
+                                       user_data->escaped_payload_length),
+              ::testing::ElementsAreArray(expected_user_data));
+
+  auto& recovery_point_message = sei->sei_message[1];
+  EXPECT_EQ(24, recovery_point_message->payload_offset);
+  EXPECT_EQ(26, recovery_point_message->escaped_payload_offset);
+  EXPECT_EQ(1, recovery_point_message->escaped_payload_size);
+  EXPECT_TRUE(recovery_point_message->recovery_point != nullptr);
+}
+
+TEST_F(H264SeiParserTest, TestTruncatedSei) {
+  H264BitstreamParserState bitstream_parser_state;
+  ParsingOptions parsing_options;
+  // payloadSize 20, but only 4 bytes follow
+  const uint8_t truncated[] = {0x05, 0x14, 0xdc, 0x45, 0xe9, 0x80};
+  auto sei = H264SeiParser::ParseSei(truncated, arraysize(truncated),
+                                     &bitstream_parser_state, parsing_options);
+  EXPECT_TRUE(sei == nullptr);
+}
+
+TEST_F(H264SeiParserTest, TestBufferingPeriod) {
+  // seq_parameter_set_id: 0, initial_cpb_removal_delay: 16,
+  // initial_cpb_removal_delay_offset: 32
+  const uint8_t data[] = {0x88, 0x10, 0x00};
+  H264BitstreamParserState bitstream_parser_state;
+  bitstream_parser_state.sps[0] = HrdSps();
+  BitBuffer bit_buffer(data, arraysize(data));
+  auto buffering_period = H264BufferingPeriodParser::ParseBufferingPeriod(
+      &bit_buffer, &bitstream_parser_state);
+  ASSERT_TRUE(buffering_period != nullptr);
+  EXPECT_EQ(0, buffering_period->seq_parameter_set_id);
+  EXPECT_EQ(1, buffering_period->nal_hrd_parameters_present_flag);
+  EXPECT_EQ(0, buffering_period->vcl_hrd_parameters_present_flag);
+  ASSERT_EQ(1, buffering_period->nal_initial_cpb_removal_delay.size());
+  EXPECT_EQ(16, buffering_period->nal_initial_cpb_removal_delay[0]);
+  ASSERT_EQ(1, buffering_period->nal_initial_cpb_removal_delay_offset.size());
+  EXPECT_EQ(32, buffering_period->nal_initial_cpb_removal_delay_offset[0]);
+  EXPECT_EQ(0, buffering_period->vcl_initial_cpb_removal_delay.size());
+}
+
+TEST_F(H264SeiParserTest, TestPicTiming) {
+  // cpb_removal_delay: 2, dpb_output_delay: 4, pic_struct: 3 (two clock
+  // timestamps), the first one a full timestamp (03:02:01, 5 frames)
+  const uint8_t data[] = {0x02, 0x04, 0x3a, 0x04, 0x05, 0x04, 0x21, 0xa0};
+  auto sps = HrdSps();
+  BitBuffer bit_buffer(data, arraysize(data));
+  auto pic_timing = H264PicTimingParser::ParsePicTiming(&bit_buffer, sps.get());
+  ASSERT_TRUE(pic_timing != nullptr);
+  EXPECT_EQ(1, pic_timing->cpb_dpb_delays_present_flag);
+  EXPECT_EQ(2, pic_timing->cpb_removal_delay);
+  EXPECT_EQ(4, pic_timing->dpb_output_delay);
+  EXPECT_EQ(3, pic_timing->pic_struct);
+  ASSERT_EQ(2, pic_timing->clock_timestamps.size());
+  const auto& clock_timestamp = pic_timing->clock_timestamps[0];
+  EXPECT_EQ(1, clock_timestamp.clock_timestamp_flag);
+  EXPECT_EQ(1, clock_timestamp.ct_type);
+  EXPECT_EQ(0, clock_timestamp.nuit_field_based_flag);
+  EXPECT_EQ(0, clock_timestamp.counting_type);
+  EXPECT_EQ(1, clock_timestamp.full_timestamp_flag);
+  EXPECT_EQ(5, clock_timestamp.n_frames);
+  EXPECT_EQ(1, clock_timestamp.seconds_value);
+  EXPECT_EQ(2, clock_timestamp.minutes_value);
+  EXPECT_EQ(3, clock_timestamp.hours_value);
+  EXPECT_EQ(0, clock_timestamp.time_offset);
+  EXPECT_EQ(0, pic_timing->clock_timestamps[1].clock_timestamp_flag);
+
+  // no VUI: nothing to decode against
+  EXPECT_TRUE(H264PicTimingParser::ParsePicTiming(&bit_buffer, nullptr) ==
+              nullptr);
+}
+
+TEST_F(H264SeiParserTest, TestActiveSps) {
+  // SPS 0 has 8-bit delays, SPS 1 16-bit cpb_removal_delay and
+  // dpb_output_delay
+  auto sps = HrdSps();
+  auto sps1 = HrdSps();
+  sps1->sps_data->seq_parameter_set_id = 1;
+  auto* hrd_parameters =
+      sps1->sps_data->vui_parameters->nal_hrd_parameters.get();
+  hrd_parameters->cpb_removal_delay_length_minus1 = 15;
+  hrd_parameters->dpb_output_delay_length_minus1 = 15;
+
+  // an SEI NAL unit with a buffering_period (SPS 1, initial_cpb_removal_delay:
+  // 16, initial_cpb_removal_delay_offset: 32)
+  const uint8_t buffering_period_nal_unit[] = {0x06, 0x00, 0x03, 0x42,
+                                               0x04, 0x00, 0x80};
+  // an SEI NAL unit with a pic_timing (cpb_removal_delay: 2,
+  // dpb_output_delay: 4 in 16 bits, pic_struct: 0)
+  const uint8_t pic_timing_nal_unit[] = {0x06, 0x01, 0x05, 0x00, 0x02,
+                                         0x00, 0x04, 0x00, 0x80};
+  ParsingOptions parsing_options;
+
+  // before any buffering_period, with two SPSs, there is no telling which
+  // one the pic_timing needs
+  H264BitstreamParserState bitstream_parser_state;
+  bitstream_parser_state.sps[0] = sps;
+  bitstream_parser_state.sps[1] = sps1;
+  auto nal_unit = H264NalUnitParser::ParseNalUnit(
+      pic_timing_nal_unit, arraysize(pic_timing_nal_unit),
+      &bitstream_parser_state, parsing_options);
+  ASSERT_TRUE(nal_unit != nullptr);
+  ASSERT_TRUE(nal_unit->nal_unit_payload->sei != nullptr);
+  ASSERT_EQ(1, nal_unit->nal_unit_payload->sei->sei_message.size());
+  EXPECT_TRUE(nal_unit->nal_unit_payload->sei->sei_message[0]->pic_timing ==
+              nullptr);
+
+  // the buffering_period activates SPS 1
+  nal_unit = H264NalUnitParser::ParseNalUnit(
+      buffering_period_nal_unit, arraysize(buffering_period_nal_unit),
+      &bitstream_parser_state, parsing_options);
+  ASSERT_TRUE(nal_unit != nullptr);
+  EXPECT_EQ(sps1, bitstream_parser_state.active_sps);
+
+  // and the pic_timing of the next SEI NAL unit is decoded against it
+  nal_unit = H264NalUnitParser::ParseNalUnit(
+      pic_timing_nal_unit, arraysize(pic_timing_nal_unit),
+      &bitstream_parser_state, parsing_options);
+  ASSERT_TRUE(nal_unit != nullptr);
+  ASSERT_TRUE(nal_unit->nal_unit_payload->sei != nullptr);
+  ASSERT_EQ(1, nal_unit->nal_unit_payload->sei->sei_message.size());
+  const auto& pic_timing =
+      nal_unit->nal_unit_payload->sei->sei_message[0]->pic_timing;
+  ASSERT_TRUE(pic_timing != nullptr);
+  EXPECT_EQ(2, pic_timing->cpb_removal_delay);
+  EXPECT_EQ(4, pic_timing->dpb_output_delay);
+  EXPECT_EQ(0, pic_timing->pic_struct);
+
+  // an SPS NAL unit redefining SPS 1 (without a VUI) replaces the active
+  // SPS, so the same pic_timing no longer decodes
+  const uint8_t sps_nal_unit[] = {0x67, 0x42, 0xc0, 0x16, 0x49,
+                                  0xa0, 0x50, 0x7e, 0x40};
+  nal_unit = H264NalUnitParser::ParseNalUnit(
+      sps_nal_unit, arraysize(sps_nal_unit), &bitstream_parser_state,
+      parsing_options);
+  ASSERT_TRUE(nal_unit != nullptr);
+  ASSERT_TRUE(nal_unit->nal_unit_payload->sps != nullptr);
+  EXPECT_EQ(1, nal_unit->nal_unit_payload->sps->sps_data->seq_parameter_set_id);
+  EXPECT_EQ(nal_unit->nal_unit_payload->sps, bitstream_parser_state.active_sps);
+  nal_unit = H264NalUnitParser::ParseNalUnit(
+      pic_timing_nal_unit, arraysize(pic_timing_nal_unit),
+      &bitstream_parser_state, parsing_options);
+  ASSERT_TRUE(nal_unit != nullptr);
+  ASSERT_TRUE(nal_unit->nal_unit_payload->sei != nullptr);
+  EXPECT_TRUE(nal_unit->nal_unit_payload->sei->sei_message[0]->pic_timing ==
+              nullptr);
+
+  // redefining another SPS leaves the active one alone
+  const auto active_sps = bitstream_parser_state.active_sps;
+  const uint8_t sps0_nal_unit[] = {0x67, 0x42, 0xc0, 0x16,
+                                   0xa6, 0x81, 0x41, 0xf9};
+  nal_unit = H264NalUnitParser::ParseNalUnit(
+      sps0_nal_unit, arraysize(sps0_nal_unit), &bitstream_parser_state,
+      parsing_options);
+  ASSERT_TRUE(nal_unit != nullptr);
+  EXPECT_EQ(active_sps, bitstream_parser_state.active_sps);
+}
+
+}  // namespace h264nal
@@ -7,6 +7,8 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
 #include "h264_bitstream_parser.h"
 #include "h264_bitstream_parser_state.h"
 #include "h264_common.h"
@@ -257,12 +259,13 @@ TEST_F(H264SliceHeaderInScalableExtensionParserTest, TestSubsetSpsIdValueSpace)
   ASSERT_EQ(4, bitstream->nal_units.size());
 
   // the subset SPS uses an id the regular SPS space does not have
-  EXPECT_EQ(1u, bitstream_parser_state.sps.size());
-  EXPECT_EQ(1u, bitstream_parser_state.subset_sps.size());
-  EXPECT_TRUE(bitstream_parser_state.sps.find(1) ==
-              bitstream_parser_state.sps.end());
-  EXPECT_TRUE(bitstream_parser_state.subset_sps.find(1) !=
-              bitstream_parser_state.subset_sps.end());
+  const auto& sps = bitstream_parser_state.sps;
+  const auto& subset_sps = bitstream_parser_state.subset_sps;
+  EXPECT_EQ(sps.size() - 1, std::count(sps.begin(), sps.end(), nullptr));
+  EXPECT_EQ(subset_sps.size() - 1,
+            std::count(subset_sps.begin(), subset_sps.end(), nullptr));
+  EXPECT_TRUE(bitstream_parser_state.GetSps(1) == nullptr);
+  EXPECT_TRUE(bitstream_parser_state.GetSubsetSps(1) != nullptr);
 
   // the scalable extension slice must still resolve
   auto& nal_unit = bitstream->nal_units[3];
@@ -122,6 +122,38 @@ TEST_F(H264SliceHeaderParserTest, TestSampleSliceIDR601) {
   EXPECT_EQ(0, slice_header->slice_group_change_cycle);
 }
 
+TEST_F(H264SliceHeaderParserTest, TestSampleSliceIDR601Partial) {
+  const uint8_t buffer[] = {
+      0x88, 0x82, 0x06, 0x78, 0x8c, 0x50, 0x00, 0x1c,
+      0xab, 0x8e, 0x00, 0x02, 0xfb, 0x31, 0xc0, 0x00,
+      0x5f, 0x66, 0xfb, 0xef, 0xbe
+  };
+
+  // stopping at pic_parameter_set_id needs no SPS/PPS
+  H264BitstreamParserState bitstream_parser_state;
+  uint32_t nal_ref_idc = 3;
+  uint32_t nal_unit_type = NalUnitType::CODED_SLICE_OF_IDR_PICTURE_NUT;
+  BitBuffer bit_buffer(buffer, arraysize(buffer));
+  auto slice_header = H264SliceHeaderParser::ParseSliceHeader(
+      &bit_buffer, nal_ref_idc, nal_unit_type,
+      SLICE_HEADER_PIC_PARAMETER_SET_ID, &bitstream_parser_state);
+  ASSERT_TRUE(slice_header != nullptr);
+
+  EXPECT_EQ(0, slice_header->first_mb_in_slice);
+  EXPECT_EQ(7, slice_header->slice_type);
+  EXPECT_EQ(0, slice_header->pic_parameter_set_id);
+  EXPECT_EQ(nullptr, slice_header->ref_pic_list_modification);
+  EXPECT_EQ(nullptr, slice_header->dec_ref_pic_marking);
+  // ue(v) 0 (1 bit), ue(v) 7 (7 bits), ue(v) 0 (1 bit)
+  EXPECT_EQ(arraysize(buffer) * 8 - 9, bit_buffer.RemainingBitCount());
+
+  // a full parse does
+  BitBuffer bit_buffer_full(buffer, arraysize(buffer));
+  EXPECT_EQ(nullptr, H264SliceHeaderParser::ParseSliceHeader(
+                         &bit_buffer_full, nal_ref_idc, nal_unit_type,
+                         SLICE_HEADER_FRAME_NUM, &bitstream_parser_state));
+}
+
 TEST_F(H264SliceHeaderParserTest, TestSampleSliceNonIDR601) {
   // fuzzer::conv: data
   const uint8_t buffer[] = {
@@ -317,4 +349,21 @@ TEST_F(H264SliceHeaderParserTest, TestDeltaPicOrderCntBothEntries) {
   EXPECT_EQ(0, slice_header->slice_qp_delta);
 }
 
+TEST_F(H264SliceHeaderParserTest, TestCompactState) {
+  // the slice header fields fit in 2 cache lines
+  EXPECT_LE(sizeof(H264SliceHeaderParser::SliceHeaderState), 128u);
+
+  // the fields are as narrow as their ranges allow
+  EXPECT_EQ(1u, sizeof(H264SliceHeaderParser::SliceHeaderState::slice_type));
+  EXPECT_EQ(1u, sizeof(H264SliceHeaderParser::SliceHeaderState::
+                           pic_parameter_set_id));
+  EXPECT_EQ(2u, sizeof(H264SliceHeaderParser::SliceHeaderState::frame_num));
+  EXPECT_EQ(2u, sizeof(H264SliceHeaderParser::SliceHeaderState::
+                           pic_order_cnt_lsb));
+  EXPECT_EQ(1u, sizeof(H264SliceHeaderParser::SliceHeaderState::
+                           num_ref_idx_l0_active_minus1));
+  EXPECT_EQ(1u,
+            sizeof(H264SliceHeaderParser::SliceHeaderState::slice_qp_delta));
+}
+
 }  // namespace h264nal
@@ -344,6 +344,22 @@ TEST_F(H264SpsParserTest, TestInterlacedSpsFrameHeight) {
   EXPECT_EQ(0, sps_data->getResolution(&width, &height));
   EXPECT_EQ(704, width);
   EXPECT_EQ(480, height);  // would be 240 without the eq. 7-18 fix
+
+  // the derived values, computed once by the parser
+  const auto& derived = sps_data->derived;
+  EXPECT_TRUE(derived.valid);
+  EXPECT_EQ(1, derived.ChromaArrayType);
+  EXPECT_EQ(sps_data->log2_max_frame_num_minus4 + 4, derived.frame_num_len);
+  EXPECT_EQ(1u << derived.frame_num_len, derived.MaxFrameNum);
+  EXPECT_EQ(sps_data->log2_max_pic_order_cnt_lsb_minus4 + 4,
+            derived.pic_order_cnt_lsb_len);
+  EXPECT_EQ(1u << derived.pic_order_cnt_lsb_len, derived.MaxPicOrderCntLsb);
+  EXPECT_EQ(44, derived.PicWidthInMbs);
+  EXPECT_EQ(15, derived.PicHeightInMapUnits);
+  EXPECT_EQ(44 * 15, derived.PicSizeInMapUnits);
+  EXPECT_EQ(30, derived.FrameHeightInMbs);
+  EXPECT_EQ(704, derived.width);
+  EXPECT_EQ(480, derived.height);
 }
 
 // The 3 tests below share a hand-built High profile SPS header that turns
@@ -436,6 +452,15 @@ TEST_F(H264SpsParserTest, TestGetResolutionRejectsEmptyPicture) {
   // and it does not leave a bogus value behind for the caller to print
   EXPECT_EQ(-1, width);
   EXPECT_EQ(-1, height);
+
+  // a hand-built state has no derived values: they are computed on demand
+  EXPECT_FALSE(sps_data.derived.valid);
+  H264SpsDataParser::SpsDataState::DerivedValues scratch;
+  const auto& derived = sps_data.getDerivedValues(&scratch);
+  EXPECT_EQ(&scratch, &derived);
+  EXPECT_EQ(1, derived.PicSizeInMapUnits);
+  EXPECT_EQ(-1, derived.width);
+  EXPECT_EQ(-1, derived.height);
 }
 
 TEST_F(H264SpsParserTest, TestTruncatedSps) {
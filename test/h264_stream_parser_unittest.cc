@@ -0,0 +1,137 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#include "h264_stream_parser.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "h264_bitstream_parser.h"
+#include "h264_bitstream_parser_state.h"
+#include "h264_common.h"
+#include "rtc_common.h"
+
+namespace h264nal {
+
+class H264StreamParserTest : public ::testing::Test {
+ public:
+  H264StreamParserTest() {}
+  ~H264StreamParserTest() override {}
+};
+
+// SPS, PPS, slice IDR, slice non-IDR (601.264)
+const uint8_t buffer[] = {
+    // SPS
+    0x00, 0x00, 0x00, 0x01,
+    0x67, 0x42, 0xc0, 0x16, 0xa6, 0x11, 0x05, 0x07,
+    0xe9, 0xb2, 0x00, 0x00, 0x03, 0x00, 0x02, 0x00,
+    0x00, 0x03, 0x00, 0x64, 0x1e, 0x2c, 0x5c, 0x23,
+    // PPS
+    0x00, 0x00, 0x00, 0x01,
+    0x68, 0xc8, 0x42, 0x02, 0x32, 0xc8,
+    // slice (IDR)
+    0x00, 0x00, 0x00, 0x01,
+    0x65, 0x88, 0x82, 0x06, 0x78, 0x8c, 0x50, 0x00,
+    0x1c, 0xab, 0x8e, 0x00, 0x02, 0xfb, 0x31, 0xc0,
+    0x00, 0x5f, 0x66, 0xfb, 0xef, 0xbe,
+    // slice (non-IDR)
+    0x00, 0x00, 0x00, 0x01,
+    0x41, 0x9a, 0x1c, 0x0c, 0xf0, 0x09, 0x6c
+};
+
+// Pushes |data| in chunks of |chunk_size| bytes, and checks the NAL units
+// match the ones ParseBitstream() gets from the whole buffer.
+void CheckStreamMatchesBitstream(const uint8_t* data, size_t length,
+                                 size_t chunk_size) {
+  ParsingOptions parsing_options;
+  auto expected =
+      H264BitstreamParser::ParseBitstream(data, length, parsing_options);
+  ASSERT_TRUE(expected != nullptr);
+
+  std::vector<std::unique_ptr<struct H264NalUnitParser::NalUnitState>>
+      nal_units;
+  H264StreamParser stream_parser(
+      parsing_options,
+      [&nal_units](
+          std::unique_ptr<struct H264NalUnitParser::NalUnitState> nal_unit) {
+        nal_units.push_back(std::move(nal_unit));
+      });
+  for (size_t i = 0; i < length; i += chunk_size) {
+    stream_parser.Push(data + i, std::min(chunk_size, length - i));
+  }
+  stream_parser.Flush();
+  EXPECT_EQ(0, stream_parser.GetBufferedLength());
+
+  ASSERT_EQ(expected->nal_units.size(), nal_units.size())
+      << "chunk_size: " << chunk_size;
+  for (size_t i = 0; i < nal_units.size(); i++) {
+    const auto& e = expected->nal_units[i];
+    const auto& a = nal_units[i];
+    EXPECT_EQ(e->offset, a->offset) << "chunk_size: " << chunk_size;
+    EXPECT_EQ(e->length, a->length) << "chunk_size: " << chunk_size;
+    EXPECT_EQ(e->parsed_length, a->parsed_length);
+    EXPECT_EQ(e->nal_unit_header->nal_unit_type,
+              a->nal_unit_header->nal_unit_type);
+    ASSERT_TRUE(a->checksum != nullptr);
+    EXPECT_EQ(e->checksum->GetPrintableChecksum(),
+              a->checksum->GetPrintableChecksum());
+  }
+}
+
+TEST_F(H264StreamParserTest, TestSampleBitstream601) {
+  // every chunk size, so that start codes (and the zero of the 4-byte
+  // ones) are split across pushes at every position
+  for (size_t chunk_size = 1; chunk_size <= arraysize(buffer); chunk_size++) {
+    CheckStreamMatchesBitstream(buffer, arraysize(buffer), chunk_size);
+  }
+}
+
+TEST_F(H264StreamParserTest, TestLeadingGarbageAndShortStartCodes) {
+  // bytes before the first start code
+  std::vector<uint8_t> data = {0x12, 0x00, 0x34, 0x00, 0x00};
+  data.insert(data.end(), buffer, buffer + arraysize(buffer));
+  // a zero run before a start code, 3-byte start codes, and a start code
+  // in the last 3 bytes (which FindNaluIndices() does not count)
+  const uint8_t tail[] = {0x00, 0x00, 0x00, 0x00, 0x01, 0x09, 0xf0,
+                          0x00, 0x00, 0x01, 0x09, 0x10, 0x00, 0x00,
+                          0x01};
+  data.insert(data.end(), tail, tail + arraysize(tail));
+  for (size_t chunk_size = 1; chunk_size <= data.size(); chunk_size++) {
+    CheckStreamMatchesBitstream(data.data(), data.size(), chunk_size);
+  }
+}
+
+TEST_F(H264StreamParserTest, TestBoundedBuffer) {
+  // the stream parser holds back the pending NAL unit, not the stream
+  H264BitstreamParserState bitstream_parser_state;
+  ParsingOptions parsing_options;
+  size_t nal_unit_count = 0;
+  H264StreamParser stream_parser(
+      &bitstream_parser_state, parsing_options,
+      [&nal_unit_count](
+          std::unique_ptr<struct H264NalUnitParser::NalUnitState> nal_unit) {
+        EXPECT_TRUE(nal_unit != nullptr);
+        nal_unit_count++;
+      });
+  size_t max_buffered_length = 0;
+  for (size_t i = 0; i < 100; i++) {
+    stream_parser.Push(buffer, arraysize(buffer));
+    max_buffered_length =
+        std::max(max_buffered_length, stream_parser.GetBufferedLength());
+  }
+  stream_parser.Flush();
+  EXPECT_EQ(400, nal_unit_count);
+  // the last slice, plus the chunk being pushed
+  EXPECT_LE(max_buffered_length, 2 * arraysize(buffer));
+  // the SPS/PPS went into the caller's state
+  EXPECT_EQ(&bitstream_parser_state, stream_parser.GetBitstreamParserState());
+  EXPECT_TRUE(bitstream_parser_state.GetSps(0) != nullptr);
+  EXPECT_TRUE(bitstream_parser_state.GetPps(0) != nullptr);
+}
+
+}  // namespace h264nal
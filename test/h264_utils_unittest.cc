@@ -0,0 +1,85 @@
+/*
+ *  Copyright (c) Facebook, Inc. and its affiliates.
+ */
+
+#include "h264_utils.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "h264_bitstream_parser.h"
+#include "h264_common.h"
+#include "rtc_common.h"
+
+namespace h264nal {
+
+class H264UtilsTest : public ::testing::Test {
+ public:
+  H264UtilsTest() {}
+  ~H264UtilsTest() override {}
+};
+
+// SPS, PPS, slice IDR, slice non-IDR (601.264)
+const uint8_t buffer[] = {
+    // SPS
+    0x00, 0x00, 0x00, 0x01,
+    0x67, 0x42, 0xc0, 0x16, 0xa6, 0x11, 0x05, 0x07,
+    0xe9, 0xb2, 0x00, 0x00, 0x03, 0x00, 0x02, 0x00,
+    0x00, 0x03, 0x00, 0x64, 0x1e, 0x2c, 0x5c, 0x23,
+    // PPS
+    0x00, 0x00, 0x00, 0x01,
+    0x68, 0xc8, 0x42, 0x02, 0x32, 0xc8,
+    // slice (IDR)
+    0x00, 0x00, 0x00, 0x01,
+    0x65, 0x88, 0x82, 0x06, 0x78, 0x8c, 0x50, 0x00,
+    0x1c, 0xab, 0x8e, 0x00, 0x02, 0xfb, 0x31, 0xc0,
+    0x00, 0x5f, 0x66, 0xfb, 0xef, 0xbe,
+    // slice (non-IDR)
+    0x00, 0x00, 0x00, 0x01,
+    0x41, 0x9a, 0x1c, 0x0c, 0xf0, 0x09, 0x6c
+};
+
+TEST_F(H264UtilsTest, TestInputFile) {
+  // write the buffer into a temporary file
+  std::string filename = ::testing::TempDir() + "h264_utils_unittest.264";
+  FILE* outfp = fopen(filename.c_str(), "wb");
+  ASSERT_TRUE(outfp != nullptr);
+  ASSERT_EQ(arraysize(buffer), fwrite(buffer, 1, arraysize(buffer), outfp));
+  fclose(outfp);
+
+  auto input_file = H264InputFile::Open(filename.c_str());
+  ASSERT_TRUE(input_file != nullptr);
+#if !(defined WIN32 || defined _WIN32)
+  EXPECT_TRUE(input_file->IsMapped());
+#endif
+  ASSERT_EQ(arraysize(buffer), input_file->size());
+  EXPECT_THAT(std::vector<uint8_t>(input_file->data(),
+                                   input_file->data() + input_file->size()),
+              ::testing::ElementsAreArray(buffer));
+  EXPECT_EQ(0x67, (*input_file)[4]);
+
+  // same as ReadFile()
+  std::vector<uint8_t> read_buffer;
+  ASSERT_EQ(0, H264Utils::ReadFile(filename.c_str(), read_buffer));
+  EXPECT_THAT(read_buffer, ::testing::ElementsAreArray(buffer));
+
+  // the parsers take it as is
+  ParsingOptions parsing_options;
+  auto bitstream = H264BitstreamParser::ParseBitstream(
+      input_file->data(), input_file->size(), parsing_options);
+  ASSERT_TRUE(bitstream != nullptr);
+  EXPECT_EQ(4, bitstream->nal_units.size());
+
+  remove(filename.c_str());
+}
+
+TEST_F(H264UtilsTest, TestInputFileMissing) {
+  EXPECT_TRUE(H264InputFile::Open("/nonexistent/h264_utils_unittest.264") ==
+              nullptr);
+}
+
+}  // namespace h264nal
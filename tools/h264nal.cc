@@ -27,11 +27,16 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "config.h"
+#include "h264_access_unit_assembler.h"
 #include "h264_bitstream_parser.h"
 #include "h264_common.h"
+#include "h264_dpb_simulator.h"
 // #include "h264_configuration_box_parser.h"
 #include "h264_utils.h"
 #include "rtc_common.h"
@@ -43,7 +48,7 @@ constexpr int kExitOk = 0;
 constexpr int kExitInvalidBitstream = 1;
 constexpr int kExitUnimplemented = 2;
 
-enum Dumpmode { dump_all, dump_length };
+enum Dumpmode { dump_all, dump_length, dump_dpb };
 
 typedef struct arg_options {
   int debug;
@@ -93,6 +98,9 @@ void usage(char* name) {
   fprintf(stderr, "\t-o <output>:\t\tH264 parsing output [default: stdout]\n");
   fprintf(stderr, "\t--dump-all\t\tDump all the parsed contents\n");
   fprintf(stderr, "\t--dump-length\t\tDump only the length information\n");
+  fprintf(stderr,
+          "\t--dump-dpb\t\tDump the reference lists, DPB contents, and "
+          "output order of each picture\n");
   fprintf(stderr, "\t--as-one-line:\tSet as_one_line flag%s\n",
           DEFAULT_OPTIONS.as_one_line ? " [default]" : "");
   fprintf(stderr, "\t--no-as-one-line:\tReset as_one_line flag%s\n",
@@ -140,6 +148,7 @@ enum {
   QUIET_OPTION = CHAR_MAX + 1,
   DUMP_ALL_OPTION,
   DUMP_LENGTH_OPTION,
+  DUMP_DPB_OPTION,
   AS_ONE_LINE_FLAG_OPTION,
   NO_AS_ONE_LINE_FLAG_OPTION,
   ADD_OFFSET_FLAG_OPTION,
@@ -180,6 +189,7 @@ int parse_args(int argc, char** argv, arg_options* options) {
       {"quiet", no_argument, NULL, QUIET_OPTION},
       {"dump-all", no_argument, NULL, DUMP_ALL_OPTION},
       {"dump-length", no_argument, NULL, DUMP_LENGTH_OPTION},
+      {"dump-dpb", no_argument, NULL, DUMP_DPB_OPTION},
       {"as-one-line", no_argument, NULL, AS_ONE_LINE_FLAG_OPTION},
       {"no-as-one-line", no_argument, NULL, NO_AS_ONE_LINE_FLAG_OPTION},
       {"add-offset", no_argument, NULL, ADD_OFFSET_FLAG_OPTION},
@@ -241,6 +251,10 @@ int parse_args(int argc, char** argv, arg_options* options) {
         options->dumpmode = dump_length;
         break;
 
+      case DUMP_DPB_OPTION:
+        options->dumpmode = dump_dpb;
+        break;
+
       case AS_ONE_LINE_FLAG_OPTION:
         options->as_one_line = true;
         break;
@@ -352,6 +366,32 @@ inline std::string opt_value(int value, bool has_value) {
   return has_value ? std::to_string(value) : std::string{};
 }
 
+// A list of DPB frames, as "fn=<frame_num>/<marking>/poc=<PicOrderCnt>"
+// entries separated by semicolons.
+std::string dpb_pictures_str(
+    const std::vector<h264nal::H264DpbSimulator::DpbPicture>& pictures) {
+  std::string str;
+  for (const auto& picture : pictures) {
+    if (!str.empty()) {
+      str += ";";
+    }
+    str += "fn=" + std::to_string(picture.frame_num);
+    if (picture.reference_marking == h264nal::SHORT_TERM_REFERENCE) {
+      str += "/STR";
+    } else if (picture.reference_marking == h264nal::LONG_TERM_REFERENCE) {
+      str += "/LTR[" + std::to_string(picture.long_term_frame_idx) + "]";
+    } else {
+      str += "/unused";
+    }
+    if (picture.non_existing) {
+      str += "/non-existing";
+    } else {
+      str += "/poc=" + std::to_string(picture.PicOrderCnt);
+    }
+  }
+  return str;
+}
+
 int main(int argc, char** argv) {
   arg_options options;
 
@@ -430,15 +470,54 @@ int main(int argc, char** argv) {
 
   // 3. parse bitstream
   h264nal::reset_unimplemented_count();
-  std::vector<uint8_t> buffer;
+  std::unique_ptr<h264nal::H264InputFile> input_file;
   std::unique_ptr<h264nal::H264BitstreamParser::BitstreamState> bitstream;
+  // the DPB results of each picture, and the frames left at the end
+  std::vector<h264nal::H264DpbSimulator::PictureState> dpb_pictures;
+  std::vector<h264nal::H264DpbSimulator::DpbPicture> dpb_output;
   if (options.infile != nullptr) {
-    // 3.1. read infile into buffer
-    if (h264nal::H264Utils::ReadFile(options.infile, buffer) < 0) {
+    // 3.1. open infile (memory-mapped if possible)
+    input_file = h264nal::H264InputFile::Open(options.infile);
+    if (input_file == nullptr) {
       return -1;
     }
+    const h264nal::H264InputFile& buffer = *input_file;
     // 3.2. parse buffer
-    if (options.nalu_length_bytes < 0) {
+    if (options.dumpmode == dump_dpb) {
+      // run the DPB over the primary coded picture of each access unit
+      // during the parse, so that each one gets the parameter sets in
+      // effect at its position
+      bitstream =
+          std::make_unique<h264nal::H264BitstreamParser::BitstreamState>();
+      h264nal::H264DpbSimulator simulator;
+      h264nal::H264AccessUnitAssembler assembler(
+          [&](std::unique_ptr<h264nal::H264AccessUnitAssembler::AccessUnitState>
+                  access_unit) {
+            h264nal::H264DpbSimulator::PictureState picture;
+            if (simulator.DecodePicture(*access_unit, &picture)) {
+              dpb_pictures.push_back(std::move(picture));
+            }
+            // keep the NAL units, for the parse report below
+            for (auto& nal_unit : access_unit->nal_units) {
+              bitstream->nal_units.push_back(std::move(nal_unit));
+            }
+          },
+          &bitstream_parser_state);
+      if (options.nalu_length_bytes < 0) {
+        h264nal::H264BitstreamParser::ParseBitstream(
+            buffer.data(), buffer.size(), &bitstream_parser_state,
+            parsing_options, assembler.GetNalUnitCallback());
+      } else {
+        h264nal::H264BitstreamParser::ParseBitstreamNALULength(
+            buffer.data(), buffer.size(),
+            static_cast<size_t>(options.nalu_length_bytes),
+            &bitstream_parser_state, parsing_options,
+            assembler.GetNalUnitCallback());
+      }
+      assembler.Flush();
+      // the end of the stream outputs the frames left in the DPB
+      simulator.Flush(&dpb_output);
+    } else if (options.nalu_length_bytes < 0) {
       bitstream = h264nal::H264BitstreamParser::ParseBitstream(
           buffer.data(), buffer.size(), &bitstream_parser_state,
           parsing_options);
@@ -486,13 +565,10 @@ int main(int argc, char** argv) {
               "nal_num,frame_num,nal_unit_type,nal_unit_type_str,"
               "nal_length_bytes,bitrate_bps,first_mb_in_slice\n");
     }
+    const h264nal::H264InputFile& buffer = *input_file;
     // 4.3. dump the contents of each NALU
-    int total_bytes = 0;
-    int nal_num = 0;
-    int frame_num = 0;
-    int last_slice_nal_unit_type = -1;
-    for (auto& nal_unit : bitstream->nal_units) {
-      if (options.dumpmode == dump_all) {
+    if (options.dumpmode == dump_all) {
+      for (auto& nal_unit : bitstream->nal_units) {
         nal_unit->fdump(outfp, indent_level, parsing_options);
         if (options.add_contents) {
           fprintf(outfp, " contents {");
@@ -507,52 +583,93 @@ int main(int argc, char** argv) {
           fprintf(outfp, " }");
         }
         fprintf(outfp, "\n");
-      } else if (options.dumpmode == dump_length) {
-        uint32_t nal_unit_type = nal_unit->nal_unit_header->nal_unit_type;
-        std::string nal_unit_type_str =
-            h264nal::NalUnitTypeToString(nal_unit_type);
-        int nal_length_bytes = nal_unit->length;
-        int64_t bitrate_bps = -1;
-        int first_mb_in_slice = -1;
-        bool is_slice_segment = h264nal::IsSliceSegment(nal_unit_type);
-        if (is_slice_segment) {
-          if (nal_unit->nal_unit_payload
-                  ->slice_layer_without_partitioning_rbsp != nullptr) {
-            first_mb_in_slice =
-                static_cast<int>(nal_unit->nal_unit_payload
-                                     ->slice_layer_without_partitioning_rbsp
-                                     ->slice_header->first_mb_in_slice);
-          } else {
-            fprintf(stderr,
-                    "error: NO slice_layer_without_partitioning_rbsp\n");
-            first_mb_in_slice = 0;
-          }
-          if (first_mb_in_slice == 0 && total_bytes > 0) {
-            // dump last frame info
-            bitrate_bps = static_cast<int64_t>(total_bytes) * 8 *
-                          options.frames_per_second;
-            fprintf(outfp, ",%i,%i,frame,,%" PRIi64 ",\n", frame_num,
-                    last_slice_nal_unit_type, bitrate_bps);
-            frame_num += 1;
-            total_bytes = 0;
-          }
-          last_slice_nal_unit_type = static_cast<int>(nal_unit_type);
-          total_bytes += nal_length_bytes;
+      }
+    } else if (options.dumpmode == dump_length) {
+      // group the NAL units into access units (frames). A frame line is
+      // printed when the first slice of the next frame arrives, so the
+      // non-VCL NAL units before that slice (AUD, SPS, PPS, SEI) count in
+      // the frame before it.
+      int nal_num = 0;
+      int frame_num = 0;
+      int total_bytes = 0;
+      int last_slice_nal_unit_type = -1;
+      auto dump_frame = [&]() {
+        if (total_bytes > 0) {
+          // dump last frame info
+          int64_t bitrate_bps = static_cast<int64_t>(total_bytes) * 8 *
+                                options.frames_per_second;
+          fprintf(outfp, ",%i,%i,frame,,%" PRIi64 ",\n", frame_num,
+                  last_slice_nal_unit_type, bitrate_bps);
+          frame_num += 1;
+          total_bytes = 0;
         }
-        fprintf(outfp, "%i,%i,%i,%s,%i,,%s\n", nal_num, frame_num,
-                nal_unit_type, nal_unit_type_str.c_str(), nal_length_bytes,
-                opt_value(first_mb_in_slice, is_slice_segment).c_str());
-        nal_num += 1;
+      };
+      h264nal::H264AccessUnitAssembler assembler(
+          [&](std::unique_ptr<h264nal::H264AccessUnitAssembler::AccessUnitState>
+                  access_unit) {
+            bool first_slice = true;
+            for (auto& nal_unit : access_unit->nal_units) {
+              uint32_t nal_unit_type = nal_unit->nal_unit_header->nal_unit_type;
+              std::string nal_unit_type_str =
+                  h264nal::NalUnitTypeToString(nal_unit_type);
+              int nal_length_bytes = static_cast<int>(nal_unit->length);
+              int first_mb_in_slice = -1;
+              bool is_slice_segment = h264nal::IsSliceSegment(nal_unit_type);
+              if (is_slice_segment) {
+                if (nal_unit->nal_unit_payload
+                        ->slice_layer_without_partitioning_rbsp != nullptr) {
+                  first_mb_in_slice = static_cast<int>(
+                      nal_unit->nal_unit_payload
+                          ->slice_layer_without_partitioning_rbsp
+                          ->slice_header->first_mb_in_slice);
+                } else {
+                  fprintf(stderr,
+                          "error: NO slice_layer_without_partitioning_rbsp\n");
+                  first_mb_in_slice = 0;
+                }
+                if (first_slice) {
+                  dump_frame();
+                  first_slice = false;
+                }
+                last_slice_nal_unit_type = static_cast<int>(nal_unit_type);
+                total_bytes += nal_length_bytes;
+              }
+              fprintf(outfp, "%i,%i,%i,%s,%i,,%s\n", nal_num, frame_num,
+                      nal_unit_type, nal_unit_type_str.c_str(),
+                      nal_length_bytes,
+                      opt_value(first_mb_in_slice, is_slice_segment).c_str());
+              nal_num += 1;
+            }
+            // give the NAL units back, for the parse report below
+            for (auto& nal_unit : access_unit->nal_units) {
+              bitstream->nal_units.push_back(std::move(nal_unit));
+            }
+          });
+      auto nal_units = std::move(bitstream->nal_units);
+      bitstream->nal_units.clear();
+      for (auto& nal_unit : nal_units) {
+        assembler.Push(std::move(nal_unit));
       }
-    }
-    if (options.dumpmode == dump_length) {
-      if (total_bytes > 0) {
-        // dump last frame info
-        int64_t bitrate_bps =
-            static_cast<int64_t>(total_bytes) * 8 * options.frames_per_second;
-        fprintf(outfp, ",%i,%i,frame,,%" PRIi64 ",\n", frame_num,
-                last_slice_nal_unit_type, bitrate_bps);
+      assembler.Flush();
+      dump_frame();
+    } else if (options.dumpmode == dump_dpb) {
+      // the DPB ran during the parse
+      fprintf(outfp,
+              "picture,nal_unit_type,slice_type,frame_num,nal_ref_idc,poc,"
+              "ref_pic_list0,ref_pic_list1,dpb,output\n");
+      for (const auto& picture : dpb_pictures) {
+        fprintf(outfp,
+                "%zu,%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32
+                ",%" PRIi32 ",%s,%s,%s,%s\n",
+                picture.picture_index, picture.nal_unit_type,
+                picture.slice_type, picture.frame_num, picture.nal_ref_idc,
+                picture.pic_order_cnt.PicOrderCnt,
+                dpb_pictures_str(picture.ref_pic_list0).c_str(),
+                dpb_pictures_str(picture.ref_pic_list1).c_str(),
+                dpb_pictures_str(picture.dpb).c_str(),
+                dpb_pictures_str(picture.output).c_str());
       }
+      fprintf(outfp, ",,,,,,,,,%s\n", dpb_pictures_str(dpb_output).c_str());
     }
   }
 #endif  // FDUMP_DEFINE
@@ -578,7 +695,7 @@ int main(int argc, char** argv) {
   size_t unparsed_nal_units = 0;
   if (options.nalu_length_bytes < 0) {
     size_t total_nal_units = h264nal::H264BitstreamParser::FindNaluIndices(
-                                 buffer.data(), buffer.size())
+                                 input_file->data(), input_file->size())
                                  .size();
     unparsed_nal_units = total_nal_units - bitstream->nal_units.size();
   }